@@ -0,0 +1,710 @@
+#pragma once
+// Append-only file output that never blocks the caller on the disk.
+// Appends are copied into large page-aligned batches; a full batch is queued for writing
+// and the caller moves on. On Linux the batches go through io_uring: they are registered
+// once as fixed buffers, submitted with one syscall each and reaped from the completion
+// ring without any. Elsewhere, or where the kernel refuses io_uring, a writer thread
+// drains the queue. With directIo the file is opened O_DIRECT and every write is a whole
+// number of pages; the tail is padded and truncated away on Close. Pipes and other
+// unseekable destinations work too, one write in flight at a time to keep the order.
+// When the disk stalls, batches pile up in memory rather than holding up the caller; past
+// maxQueuedBytes appends are refused (and counted) instead. Only Close waits.
+// BackgroundFileQueue does the same for whole files (one PNG per frame).
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+#endif
+
+enum class AsyncWriteBackend {
+    Auto,       // io_uring where the kernel allows it, else the writer thread
+    IoUring,
+    Thread
+};
+
+struct AsyncFileWriterOptions {
+    AsyncWriteBackend backend = AsyncWriteBackend::Auto;
+    size_t batchBytes = 4 << 20;            // Rounded up to whole pages
+    size_t batches = 8;                     // Preallocated (and registered) batches
+    size_t maxQueuedBytes = 512 << 20;      // Memory a stalled disk may hold before appends fail
+    uint32_t maxBatchAgeMs = 250;           // A partial batch older than this is written anyway
+    bool directIo = false;                  // O_DIRECT, bypassing the page cache (Linux)
+};
+
+struct AsyncFileWriterStats {
+    uint64_t appendedBytes = 0;
+    uint64_t writtenBytes = 0;          // Completed, padding included
+    uint64_t batches = 0;               // Writes completed
+    uint64_t extraBatches = 0;          // Allocated beyond the preallocated set while the disk lagged
+    uint64_t rejectedAppends = 0;       // Refused at maxQueuedBytes
+    size_t queueDepth = 0;              // Batches queued or in flight now
+    size_t maxQueueDepth = 0;
+    double maxWriteMs = 0.0;            // Longest single batch, queue to completion
+    double seconds = 0.0;               // Since Open (or until Close)
+
+    double MegabytesPerSecond() const { return seconds > 0 ? writtenBytes / (1024.0 * 1024.0) / seconds : 0.0; }
+};
+
+inline const char* AsyncWriteBackendName(AsyncWriteBackend backend) {
+    switch (backend) {
+    case AsyncWriteBackend::IoUring: return "io_uring";
+    case AsyncWriteBackend::Thread: return "thread";
+    default: return "auto";
+    }
+}
+
+namespace AsyncFileDetail {
+
+const size_t kAlignment = 4096;
+
+inline uint8_t* AllocateAligned(size_t bytes) {
+#ifdef _WIN32
+    return static_cast<uint8_t*>(_aligned_malloc(bytes, kAlignment));
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, kAlignment, bytes) == 0 ? static_cast<uint8_t*>(p) : nullptr;
+#endif
+}
+
+inline void FreeAligned(uint8_t* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+struct Batch {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;            // Bytes of file data
+    size_t length = 0;          // Bytes to write: used, or padded to a page for O_DIRECT
+    size_t written = 0;         // Of length, for short writes
+    uint64_t offset = 0;
+    int fixedIndex = -1;        // Registered buffer index, -1 for extra batches
+    std::chrono::steady_clock::time_point queued;
+};
+
+#ifdef __linux__
+// The raw io_uring interface: liburing is not assumed to be installed
+class IoUring {
+public:
+    ~IoUring() { Release(); }
+
+    bool Setup(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0) return false;
+        m_sqBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) m_sqBytes = m_cqBytes = std::max(m_sqBytes, m_cqBytes);
+        m_sqRing = mmap(nullptr, m_sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED) { m_sqRing = nullptr; Release(); return false; }
+        if (single) {
+            m_cqRing = m_sqRing;
+        }
+        else {
+            m_cqRing = mmap(nullptr, m_cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED) { m_cqRing = nullptr; Release(); return false; }
+        }
+        m_sqeBytes = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) { Release(); return false; }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+        uint8_t* sq = static_cast<uint8_t*>(m_sqRing);
+        uint8_t* cq = static_cast<uint8_t*>(m_cqRing);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        m_entries = params.sq_entries;
+        return true;
+    }
+
+    // Pins the buffers once so fixed writes skip the per-write page lookup
+    bool RegisterBuffers(const std::vector<iovec>& buffers) {
+        return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+    }
+
+    unsigned Entries() const { return m_entries; }
+
+    // Queues and submits one write; the caller keeps in-flight writes within Entries()
+    bool SubmitWrite(int fd, const uint8_t* data, unsigned length, uint64_t offset, int fixedIndex, uint64_t userData) {
+        unsigned tail = *m_sqTail;
+        unsigned index = tail & m_sqMask;
+        io_uring_sqe& sqe = m_sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = fixedIndex >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe.fd = fd;
+        sqe.off = offset;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        sqe.len = length;
+        if (fixedIndex >= 0) sqe.buf_index = static_cast<uint16_t>(fixedIndex);
+        sqe.user_data = userData;
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        long submitted;
+        do {
+            submitted = syscall(__NR_io_uring_enter, m_fd, 1, 0, 0, nullptr, 0);
+        } while (submitted < 0 && errno == EINTR);
+        return submitted == 1;
+    }
+
+    // Takes one completion if there is one; wait blocks until there is
+    bool Reap(bool wait, uint64_t& userData, int& result) {
+        for (;;) {
+            unsigned head = *m_cqHead;
+            if (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+                userData = cqe.user_data;
+                result = cqe.res;
+                __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (!wait) return false;
+            if (syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) return false;
+        }
+    }
+
+    void Release() {
+        if (m_sqes) munmap(m_sqes, m_sqeBytes);
+        if (m_cqRing && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqBytes);
+        if (m_sqRing) munmap(m_sqRing, m_sqBytes);
+        if (m_fd >= 0) close(m_fd);
+        m_sqes = nullptr;
+        m_sqRing = m_cqRing = nullptr;
+        m_fd = -1;
+    }
+
+private:
+    int m_fd = -1;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqBytes = 0;
+    size_t m_cqBytes = 0;
+    size_t m_sqeBytes = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned* m_sqArray = nullptr;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+    unsigned m_entries = 0;
+};
+#endif
+
+}  // namespace AsyncFileDetail
+
+class AsyncFileWriter {
+public:
+    AsyncFileWriter() = default;
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+    ~AsyncFileWriter() { Close(); }
+
+    // Creates or truncates 'path'. Opening is synchronous; everything after is not.
+    bool Open(const std::string& path, const AsyncFileWriterOptions& options = AsyncFileWriterOptions()) {
+        using namespace AsyncFileDetail;
+        Close();
+        m_options = options;
+        m_options.batchBytes = std::max<size_t>(kAlignment, (options.batchBytes + kAlignment - 1) / kAlignment * kAlignment);
+        m_options.batches = std::max<size_t>(2, options.batches);
+        m_stats = AsyncFileWriterStats();
+        m_failed = false;
+        m_fileOffset = 0;
+        m_queuedBytes = 0;
+#ifdef _WIN32
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file) return false;
+        m_direct = false;
+#else
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        m_direct = false;
+#ifdef __linux__
+        if (options.directIo) {
+            m_fd = open(path.c_str(), flags | O_DIRECT, 0644);
+            m_direct = m_fd >= 0;   // tmpfs and some network filesystems refuse O_DIRECT
+        }
+#endif
+        if (m_fd < 0) m_fd = open(path.c_str(), flags, 0644);
+        if (m_fd < 0) return false;
+        m_stream = lseek(m_fd, 0, SEEK_CUR) < 0;
+#ifdef __linux__
+        if (m_stream && m_direct) {
+            fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);     // Nothing to align to
+            m_direct = false;
+        }
+#endif
+#endif
+        for (size_t i = 0; i < m_options.batches; ++i) {
+            Batch* batch = NewBatch();
+            if (!batch) {
+                Close();
+                return false;
+            }
+            batch->fixedIndex = static_cast<int>(i);
+            m_free.push_back(batch);
+        }
+        m_backend = AsyncWriteBackend::Thread;
+#ifdef __linux__
+        if (options.backend != AsyncWriteBackend::Thread && StartIoUring()) m_backend = AsyncWriteBackend::IoUring;
+#endif
+        if (m_backend == AsyncWriteBackend::Thread) {
+            if (options.backend == AsyncWriteBackend::IoUring) {
+                Close();
+                return false;
+            }
+            for (Batch* batch : m_free) batch->fixedIndex = -1;
+            m_stopping = false;
+            m_thread = std::thread([this] { WriterThread(); });
+        }
+        m_opened = std::chrono::steady_clock::now();
+        m_current = nullptr;
+        return true;
+    }
+
+    // Whether 'bytes' more would be accepted right now; lets a caller keep a record whole
+    bool CanAppend(size_t bytes) const {
+        return IsOpen() && !m_failed && QueuedBytes() + bytes <= m_options.maxQueuedBytes;
+    }
+
+    // Copies 'data' into the current batch, queueing batches as they fill. Never waits on
+    // the disk; returns false if the memory limit would be passed or a write has failed.
+    bool Append(const void* data, size_t size) {
+        if (!IsOpen()) return false;
+        Reap();
+        if (!CanAppend(size)) {
+            Lock lock(m_mutex);
+            m_stats.rejectedAppends++;
+            return false;
+        }
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            if (!m_current) {
+                m_current = TakeBatch();
+                if (!m_current) return false;
+                m_current->queued = std::chrono::steady_clock::now();
+            }
+            size_t n = std::min(size, m_current->capacity - m_current->used);
+            std::memcpy(m_current->data + m_current->used, bytes, n);
+            m_current->used += n;
+            bytes += n;
+            size -= n;
+            if (m_current->used == m_current->capacity) QueueCurrent();
+        }
+        {
+            Lock lock(m_mutex);
+            m_stats.appendedBytes += static_cast<uint64_t>(bytes - static_cast<const uint8_t*>(data));
+        }
+        // An idle recording should not sit in memory for long; O_DIRECT can only write
+        // whole pages, so there it waits for the batch to fill
+        if (m_current && !m_direct && m_current->used > 0 &&
+            std::chrono::steady_clock::now() - m_current->queued > std::chrono::milliseconds(m_options.maxBatchAgeMs)) {
+            QueueCurrent();
+        }
+        return true;
+    }
+
+    // Writes out everything appended so far and closes the file. This is the one call
+    // that waits on the disk. Returns false if any write failed.
+    bool Close() {
+        if (!IsOpen()) return true;
+        if (m_current && m_current->used > 0) QueueCurrent();
+        else if (m_current) ReturnBatch(m_current);
+        m_current = nullptr;
+        WaitIdle();
+        bool ok = !m_failed;
+        if (m_thread.joinable()) {
+            {
+                Lock lock(m_mutex);
+                m_stopping = true;
+            }
+            m_wake.notify_all();
+            m_thread.join();
+        }
+#ifdef __linux__
+        m_ring.Release();
+#endif
+#ifdef _WIN32
+        ok = std::fclose(m_file) == 0 && ok;
+        m_file = nullptr;
+#else
+        // O_DIRECT wrote the tail padded to a page
+        if (m_direct && ftruncate(m_fd, static_cast<off_t>(m_stats.appendedBytes)) != 0) ok = false;
+        ok = close(m_fd) == 0 && ok;
+        m_fd = -1;
+#endif
+        m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_opened).count();
+        for (AsyncFileDetail::Batch* batch : m_free) FreeBatch(batch);
+        m_free.clear();
+        return ok;
+    }
+
+    bool IsOpen() const {
+#ifdef _WIN32
+        return m_file != nullptr;
+#else
+        return m_fd >= 0;
+#endif
+    }
+
+    bool Failed() const { return m_failed; }
+    bool DirectIo() const { return m_direct; }
+    AsyncWriteBackend Backend() const { return m_backend; }
+    uint64_t AppendedBytes() const { Lock lock(m_mutex); return m_stats.appendedBytes; }
+
+    AsyncFileWriterStats Stats() const {
+        Lock lock(m_mutex);
+        AsyncFileWriterStats stats = m_stats;
+        if (IsOpen()) stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_opened).count();
+        return stats;
+    }
+
+private:
+    using Lock = std::lock_guard<std::mutex>;
+    using Batch = AsyncFileDetail::Batch;
+
+    Batch* NewBatch() {
+        Batch* batch = new Batch();
+        batch->capacity = m_options.batchBytes;
+        batch->data = AsyncFileDetail::AllocateAligned(batch->capacity);
+        if (!batch->data) {
+            delete batch;
+            return nullptr;
+        }
+        return batch;
+    }
+
+    void FreeBatch(Batch* batch) {
+        AsyncFileDetail::FreeAligned(batch->data);
+        delete batch;
+    }
+
+    size_t QueuedBytes() const {
+        Lock lock(m_mutex);
+        return m_queuedBytes + (m_current ? m_current->used : 0);
+    }
+
+    // A free batch, or a new one while the disk is behind
+    Batch* TakeBatch() {
+        {
+            Lock lock(m_mutex);
+            if (!m_free.empty()) {
+                Batch* batch = m_free.back();
+                m_free.pop_back();
+                batch->used = batch->written = 0;
+                return batch;
+            }
+            m_stats.extraBatches++;
+        }
+        Batch* batch = NewBatch();
+        if (!batch) m_failed = true;
+        return batch;
+    }
+
+    void ReturnBatch(Batch* batch) {
+        Lock lock(m_mutex);
+        // Extra batches beyond the preallocated set are dropped once the disk catches up
+        if (batch->fixedIndex >= 0 || m_free.size() < m_options.batches) m_free.push_back(batch);
+        else FreeBatch(batch);
+    }
+
+    void QueueCurrent() {
+        Batch* batch = m_current;
+        m_current = nullptr;
+        batch->offset = m_fileOffset;
+        batch->length = batch->used;
+        if (m_direct) {
+            const size_t a = AsyncFileDetail::kAlignment;
+            batch->length = (batch->used + a - 1) / a * a;
+            std::memset(batch->data + batch->used, 0, batch->length - batch->used);
+        }
+        batch->written = 0;
+        batch->queued = std::chrono::steady_clock::now();
+        m_fileOffset += batch->used;
+        {
+            Lock lock(m_mutex);
+            m_pending.push_back(batch);
+            m_queuedBytes += batch->used;
+            m_stats.queueDepth++;
+            m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_stats.queueDepth);
+        }
+        if (m_backend == AsyncWriteBackend::Thread) m_wake.notify_one();
+#ifdef __linux__
+        else SubmitPending();
+#endif
+    }
+
+    void Completed(Batch* batch) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batch->queued).count();
+        {
+            Lock lock(m_mutex);
+            m_queuedBytes -= batch->used;
+            m_stats.queueDepth--;
+            m_stats.batches++;
+            m_stats.writtenBytes += batch->length;
+            m_stats.maxWriteMs = std::max(m_stats.maxWriteMs, ms);
+        }
+        ReturnBatch(batch);
+        m_idle.notify_all();
+    }
+
+    // Collects finished io_uring writes without blocking
+    void Reap() {
+#ifdef __linux__
+        if (m_backend != AsyncWriteBackend::IoUring) return;
+        uint64_t userData;
+        int result;
+        while (m_ring.Reap(false, userData, result)) Finish(reinterpret_cast<Batch*>(userData), result);
+        SubmitPending();
+#endif
+    }
+
+    void WaitIdle() {
+#ifdef __linux__
+        if (m_backend == AsyncWriteBackend::IoUring) {
+            SubmitPending();
+            uint64_t userData;
+            int result;
+            while (m_inFlight > 0 && m_ring.Reap(true, userData, result)) {
+                Finish(reinterpret_cast<Batch*>(userData), result);
+                SubmitPending();
+            }
+            return;
+        }
+#endif
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_stats.queueDepth == 0; });
+    }
+
+#ifdef __linux__
+    bool StartIoUring() {
+        if (!m_ring.Setup(static_cast<unsigned>(std::min<size_t>(m_options.batches * 2, 256)))) return false;
+        std::vector<iovec> buffers;
+        for (Batch* batch : m_free) buffers.push_back(iovec{ batch->data, batch->capacity });
+        // Registering counts against the locked-memory limit; plain writes still work without it
+        if (!m_ring.RegisterBuffers(buffers)) {
+            for (Batch* batch : m_free) batch->fixedIndex = -1;
+        }
+        m_inFlight = 0;
+        return true;
+    }
+
+    // Submits queued batches while the ring has room; the rest wait for completions
+    void SubmitPending() {
+        for (;;) {
+            Batch* batch;
+            {
+                Lock lock(m_mutex);
+                if (m_pending.empty() || m_inFlight >= (m_stream ? 1u : m_ring.Entries())) return;
+                batch = m_pending.front();
+                m_pending.pop_front();
+            }
+            const uint8_t* data = batch->data + batch->written;
+            unsigned length = static_cast<unsigned>(batch->length - batch->written);
+            // A fixed write of a partial buffer is fine; the registration covers the whole batch
+            if (!m_ring.SubmitWrite(m_fd, data, length, batch->offset + batch->written, batch->fixedIndex, reinterpret_cast<uint64_t>(batch))) {
+                m_failed = true;
+                Completed(batch);
+                continue;
+            }
+            m_inFlight++;
+        }
+    }
+
+    void Finish(Batch* batch, int result) {
+        m_inFlight--;
+        if (result < 0 || result == 0) {
+            m_failed = true;
+            Completed(batch);
+            return;
+        }
+        batch->written += static_cast<size_t>(result);
+        if (batch->written < batch->length) {
+            Lock lock(m_mutex);
+            m_pending.push_front(batch);    // Short write: the rest goes next
+            return;
+        }
+        Completed(batch);
+    }
+#endif
+
+    void WriterThread() {
+        for (;;) {
+            Batch* batch;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this] { return !m_pending.empty() || m_stopping; });
+                if (m_pending.empty()) return;
+                batch = m_pending.front();
+                m_pending.pop_front();
+            }
+            if (!WriteBatch(*batch)) m_failed = true;
+            Completed(batch);
+        }
+    }
+
+    bool WriteBatch(Batch& batch) {
+#ifdef _WIN32
+        return std::fwrite(batch.data, 1, batch.length, m_file) == batch.length;
+#else
+        while (batch.written < batch.length) {
+            const uint8_t* data = batch.data + batch.written;
+            size_t size = batch.length - batch.written;
+            ssize_t n = m_stream ? write(m_fd, data, size) : pwrite(m_fd, data, size, static_cast<off_t>(batch.offset + batch.written));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            batch.written += static_cast<size_t>(n);
+        }
+        return true;
+#endif
+    }
+
+    AsyncFileWriterOptions m_options;
+    AsyncWriteBackend m_backend = AsyncWriteBackend::Thread;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::thread m_thread;
+    bool m_stopping = false;
+    std::atomic<bool> m_failed{ false };
+    bool m_direct = false;
+    bool m_stream = false;                  // Not seekable: writes go out strictly in order
+    Batch* m_current = nullptr;             // Being filled by Append; caller's thread only
+    std::vector<Batch*> m_free;
+    std::deque<Batch*> m_pending;           // Queued, not yet handed to the disk
+    size_t m_queuedBytes = 0;
+    uint64_t m_fileOffset = 0;
+    AsyncFileWriterStats m_stats;
+    std::chrono::steady_clock::time_point m_opened;
+#ifdef _WIN32
+    std::FILE* m_file = nullptr;
+#else
+    int m_fd = -1;
+#endif
+#ifdef __linux__
+    AsyncFileDetail::IoUring m_ring;
+    unsigned m_inFlight = 0;
+#endif
+};
+
+// Whole files written in the background, in order, by one thread: the per-frame PNG output.
+// Write() takes ownership of the bytes and returns at once; past maxQueuedBytes files are
+// refused and counted instead of waiting.
+class BackgroundFileQueue {
+public:
+    explicit BackgroundFileQueue(size_t maxQueuedBytes = 512 << 20) : m_maxQueuedBytes(maxQueuedBytes) {}
+    ~BackgroundFileQueue() { Stop(); }
+
+    bool Write(const std::string& path, std::vector<uint8_t>&& bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queuedBytes + bytes.size() > m_maxQueuedBytes) {
+                m_rejected++;
+                return false;
+            }
+            if (!m_thread.joinable()) {
+                m_stopping = false;
+                m_thread = std::thread([this] { Run(); });
+            }
+            m_queuedBytes += bytes.size();
+            m_files.push_back(Item{ path, std::move(bytes) });
+            m_maxDepth = std::max(m_maxDepth, m_files.size());
+        }
+        m_wake.notify_one();
+        return true;
+    }
+
+    // Waits until every queued file is written
+    void Drain() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_files.empty() && !m_busy; });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    uint64_t Written() const { std::lock_guard<std::mutex> lock(m_mutex); return m_written; }
+    uint64_t Failed() const { std::lock_guard<std::mutex> lock(m_mutex); return m_failed; }
+    uint64_t Rejected() const { std::lock_guard<std::mutex> lock(m_mutex); return m_rejected; }
+    size_t MaxDepth() const { std::lock_guard<std::mutex> lock(m_mutex); return m_maxDepth; }
+
+private:
+    struct Item {
+        std::string path;
+        std::vector<uint8_t> bytes;
+    };
+
+    void Run() {
+        for (;;) {
+            Item item;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this] { return !m_files.empty() || m_stopping; });
+                if (m_files.empty()) return;
+                item = std::move(m_files.front());
+                m_files.pop_front();
+                m_busy = true;
+            }
+            std::FILE* file = std::fopen(item.path.c_str(), "wb");
+            bool ok = file && std::fwrite(item.bytes.data(), 1, item.bytes.size(), file) == item.bytes.size();
+            if (file) ok = std::fclose(file) == 0 && ok;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queuedBytes -= item.bytes.size();
+                if (ok) m_written++;
+                else m_failed++;
+                m_busy = false;
+            }
+            m_idle.notify_all();
+        }
+    }
+
+    size_t m_maxQueuedBytes;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::thread m_thread;
+    std::deque<Item> m_files;
+    size_t m_queuedBytes = 0;
+    size_t m_maxDepth = 0;
+    uint64_t m_written = 0;
+    uint64_t m_failed = 0;
+    uint64_t m_rejected = 0;
+    bool m_busy = false;
+    bool m_stopping = false;
+};
@@ -0,0 +1,230 @@
+// Checks and times AsyncFileWriter. Random-sized appends go through every backend, buffered
+// and O_DIRECT, with batches small enough to split them, and the file must read back
+// exactly. Then a disk hiccup: frames are appended at 120 fps to a pipe whose reader stops
+// for half a second, and no append may take longer than a frame while the queue absorbs
+// the stall. Last, bulk throughput of each backend against plain fwrite.
+// Passes if every file reads back exactly and no append stalls through the hiccup.
+// Usage: AsyncFileWriterBenchmark [megabytes]
+#include "AsyncFileWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+const double kFrameMs = 1000.0 / 120.0;
+
+std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::vector<uint8_t> bytes;
+    if (std::FILE* file = std::fopen(path.c_str(), "rb")) {
+        uint8_t buffer[1 << 16];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t& b : bytes) b = static_cast<uint8_t>(rng());
+    return bytes;
+}
+
+std::vector<AsyncWriteBackend> Backends() {
+    std::vector<AsyncWriteBackend> backends = { AsyncWriteBackend::Thread };
+    AsyncFileWriterOptions options;
+    options.backend = AsyncWriteBackend::IoUring;
+    AsyncFileWriter probe;
+    if (probe.Open("async_writer_probe.bin", options)) backends.push_back(AsyncWriteBackend::IoUring);
+    probe.Close();
+    std::remove("async_writer_probe.bin");
+    return backends;
+}
+
+bool VerifyContents(const std::vector<AsyncWriteBackend>& backends) {
+    const std::vector<uint8_t> source = RandomBytes(24 << 20, 19);
+    const std::string path = "async_writer_check.bin";
+    size_t cases = 0;
+    for (AsyncWriteBackend backend : backends) {
+        for (bool direct : { false, true }) {
+            for (uint32_t ageMs : { 0u, 250u }) {
+                AsyncFileWriterOptions options;
+                options.backend = backend;
+                options.directIo = direct;
+                options.batchBytes = 256 << 10;
+                options.batches = 3;
+                options.maxBatchAgeMs = ageMs;      // 0 writes partial batches after every append
+                AsyncFileWriter writer;
+                if (!writer.Open(path, options) || writer.Backend() != backend) {
+                    std::cerr << AsyncWriteBackendName(backend) << ": open failed" << std::endl;
+                    return false;
+                }
+                std::mt19937 rng(static_cast<uint32_t>(cases));
+                size_t at = 0;
+                while (at < source.size()) {
+                    size_t size = std::min(source.size() - at, static_cast<size_t>(rng() % 3 == 0 ? rng() % 1000000 : rng() % 5000));
+                    if (!writer.Append(source.data() + at, size)) {
+                        std::cerr << AsyncWriteBackendName(backend) << ": append refused" << std::endl;
+                        return false;
+                    }
+                    at += size;
+                }
+                bool usedDirect = writer.DirectIo();
+                if (!writer.Close() || ReadFile(path) != source) {
+                    std::cerr << AsyncWriteBackendName(backend) << (usedDirect ? " O_DIRECT" : "") << ": file differs from what was appended" << std::endl;
+                    return false;
+                }
+                cases++;
+            }
+        }
+    }
+    std::remove(path.c_str());
+    std::cout << "Files read back exactly in " << cases << " cases (" << backends.size() << " backends, buffered and O_DIRECT)" << std::endl;
+    return true;
+}
+
+#ifndef _WIN32
+// Appends 'frames' frames at 120 fps to a FIFO whose reader sleeps 'stallMs' first, then
+// checks everything arrived in order. Returns the slowest append in ms.
+double StalledPipe(AsyncWriteBackend backend, size_t frames, size_t frameBytes, int stallMs, size_t& maxDepth, bool& intact) {
+    const std::string path = "async_writer_fifo";
+    std::remove(path.c_str());
+    if (mkfifo(path.c_str(), 0600) != 0) return -1.0;
+    std::vector<uint8_t> frame = RandomBytes(frameBytes, 7);
+    std::vector<uint8_t> received;
+    std::thread reader([&]() {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        std::this_thread::sleep_for(std::chrono::milliseconds(stallMs));
+        std::vector<uint8_t> buffer(1 << 20);
+        size_t n;
+        while (file && (n = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) received.insert(received.end(), buffer.data(), buffer.data() + n);
+        if (file) std::fclose(file);
+    });
+    AsyncFileWriterOptions options;
+    options.backend = backend;
+    options.batchBytes = 1 << 20;
+    AsyncFileWriter writer;
+    double slowest = 0.0;
+    if (writer.Open(path, options)) {
+        auto next = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < frames; ++i) {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::microseconds(static_cast<int64_t>(kFrameMs * 1000));
+            frame[0] = static_cast<uint8_t>(i);
+            auto start = std::chrono::steady_clock::now();
+            writer.Append(frame.data(), frame.size());
+            slowest = std::max(slowest, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        writer.Close();
+        maxDepth = writer.Stats().maxQueueDepth;
+    }
+    reader.join();
+    std::remove(path.c_str());
+    intact = received.size() == frames * frameBytes;
+    for (size_t i = 0; intact && i < frames; ++i) {
+        frame[0] = static_cast<uint8_t>(i);
+        intact = std::equal(frame.begin(), frame.end(), received.begin() + i * frameBytes);
+    }
+    return slowest;
+}
+#endif
+
+struct Throughput {
+    double megabytesPerSecond = 0.0;    // Appended bytes over the time until Close returned
+    double slowestAppendMs = 0.0;
+    double p99AppendMs = 0.0;
+    size_t maxQueueDepth = 0;
+};
+
+Throughput TimeBulk(const AsyncWriteBackend* backend, bool direct, size_t megabytes) {
+    const std::string path = "async_writer_bulk.bin";
+    const size_t chunk = 1 << 20;
+    std::vector<uint8_t> data = RandomBytes(chunk, 3);
+    std::vector<double> latencies;
+    Throughput result;
+    auto start = std::chrono::steady_clock::now();
+    if (backend) {
+        AsyncFileWriterOptions options;
+        options.backend = *backend;
+        options.directIo = direct;
+        AsyncFileWriter writer;
+        if (!writer.Open(path, options)) return result;
+        for (size_t i = 0; i < megabytes; ++i) {
+            auto t = std::chrono::steady_clock::now();
+            writer.Append(data.data(), data.size());
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count());
+        }
+        writer.Close();
+        result.maxQueueDepth = writer.Stats().maxQueueDepth;
+    }
+    else {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) return result;
+        for (size_t i = 0; i < megabytes; ++i) {
+            auto t = std::chrono::steady_clock::now();
+            std::fwrite(data.data(), 1, data.size(), file);
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count());
+        }
+        std::fclose(file);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::remove(path.c_str());
+    std::sort(latencies.begin(), latencies.end());
+    result.megabytesPerSecond = megabytes / seconds;
+    result.slowestAppendMs = latencies.back();
+    result.p99AppendMs = latencies[latencies.size() * 99 / 100];
+    return result;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 1024;
+
+    std::vector<AsyncWriteBackend> backends = Backends();
+    if (!VerifyContents(backends)) {
+        std::cout << "FAIL: written files are wrong" << std::endl;
+        return 1;
+    }
+
+    bool pass = true;
+    std::cout << std::fixed << std::setprecision(2);
+#ifndef _WIN32
+    const size_t frames = 120, frameBytes = 1 << 20;
+    const int stallMs = 500;
+    std::cout << "Reader stalls " << stallMs << " ms while " << frames << " x 1 MB frames are appended at 120 fps" << std::endl;
+    for (AsyncWriteBackend backend : backends) {
+        size_t depth = 0;
+        bool intact = false;
+        double slowest = StalledPipe(backend, frames, frameBytes, stallMs, depth, intact);
+        bool ok = intact && slowest >= 0 && slowest < kFrameMs;
+        pass = pass && ok;
+        std::cout << "  " << std::left << std::setw(9) << AsyncWriteBackendName(backend) << std::right << " slowest append " << std::setw(6)
+                  << slowest << " ms, queue depth max " << depth << (intact ? ", stream intact" : ", STREAM DAMAGED") << std::endl;
+    }
+#endif
+
+    std::cout << megabytes << " MB in 1 MB appends" << std::endl;
+    auto report = [](const char* name, const Throughput& t) {
+        std::cout << "  " << std::left << std::setw(18) << name << std::right << std::setw(8) << t.megabytesPerSecond << " MB/s, append p99 "
+                  << std::setw(6) << t.p99AppendMs << " ms, slowest " << std::setw(7) << t.slowestAppendMs << " ms";
+        if (t.maxQueueDepth) std::cout << ", queue depth max " << t.maxQueueDepth;
+        std::cout << std::endl;
+    };
+    report("fwrite", TimeBulk(nullptr, false, megabytes));
+    for (AsyncWriteBackend backend : backends) {
+        for (bool direct : { false, true }) {
+            std::string name = std::string(AsyncWriteBackendName(backend)) + (direct ? " O_DIRECT" : "");
+            report(name.c_str(), TimeBulk(&backend, direct, megabytes));
+        }
+    }
+
+    std::cout << (pass ? "PASS" : "FAIL") << ": files exact, and appends through a " << "stalled reader stay under one 120 fps frame" << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,486 @@
+// Benchmarks the CPU side of the capture hot path on synthetic 5120x1440 BGRA desktops:
+// the half split, the pitch-aware staging readback, the row flip from
+// CaptureBackbufferAndSave() (original loop and the PixelKernels flip + swizzle at each
+// SIMD level), BGRA -> NV12, PNG encoding (one thread, and row strips on a thread pool)
+// and the streaming screen codec. No D3D, so it runs on any build box.
+// Reports per-stage latency percentiles and throughput (MB/s of input) for each content type.
+// The pixel kernels are first checked bit-exact against a per-pixel reference, and the
+// screen codec must round-trip every test image losslessly; the strip-parallel PNG must carry
+// valid chunk CRCs and the Adler-32 of the whole image, and match EncodePng() as one strip.
+// Usage: Benchmark [--pattern static|scroll|noise|all] [--stage name] [--seconds s] [--csv file] [--threads n]
+#include "FramePacer.h"
+#include "PixelKernels.h"
+#include "PngWriter.h"
+#include "ScreenCodec.h"
+#include "SyntheticFrameSource.h"
+#include "TileLayout.h"
+#include "YuvConvert.h"
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+const uint32_t kWidth = 5120;
+const uint32_t kHeight = 1440;
+const uint32_t kStagingPitchPadding = 256;  // Drivers often pad staging rows beyond width * 4
+
+// Input shared by every stage: a few distinct desktops so caches cannot hold one frame
+struct BenchFrames {
+    std::vector<std::vector<uint8_t>> desktops;         // Tight kWidth * 4 pitch
+    std::vector<std::vector<uint8_t>> pitchedHalves;    // Left half as a staging texture would map it
+    uint32_t halfWidth = 0;
+    size_t pitchedRowPitch = 0;
+    TileLayout layout;
+    uint32_t id = 0;                                    // Distinguishes frame sets for per-set caches
+};
+
+struct BenchStage {
+    std::string name;
+    size_t bytesPerRun;                                 // Input bytes one run consumes
+    std::function<void(const BenchFrames&, size_t frame)> run;
+};
+
+struct BenchResult {
+    std::string pattern;
+    std::string stage;
+    JitterStats latency;
+    size_t bytesPerRun = 0;
+    size_t outputBytes = 0;
+};
+
+BenchFrames BuildFrames(SyntheticPattern pattern, size_t count) {
+    static uint32_t nextId = 1;
+    BenchFrames frames;
+    frames.id = nextId++;
+    BuildTileLayout(kWidth, kHeight, TileLayoutConfig(), frames.layout);
+    frames.halfWidth = frames.layout.tileWidth;
+    frames.pitchedRowPitch = static_cast<size_t>(frames.halfWidth) * 4 + kStagingPitchPadding;
+
+    SyntheticFrameSource source(kWidth, kHeight, pattern);
+    for (size_t i = 0; i < count; ++i) {
+        frames.desktops.emplace_back(source.FrameBytes());
+        source.RenderFrame(frames.desktops.back().data(), i * 7);
+
+        std::vector<uint8_t> pitched(frames.pitchedRowPitch * kHeight, 0);
+        for (uint32_t y = 0; y < kHeight; ++y) {
+            std::memcpy(pitched.data() + y * frames.pitchedRowPitch, frames.desktops.back().data() + static_cast<size_t>(y) * kWidth * 4, static_cast<size_t>(frames.halfWidth) * 4);
+        }
+        frames.pitchedHalves.push_back(std::move(pitched));
+    }
+    return frames;
+}
+
+// Sinks the stages write into, kept outside the lambdas so allocation is not timed
+struct BenchOutputs {
+    std::vector<uint8_t> halves[2];
+    std::vector<uint8_t> readback;
+    std::vector<uint8_t> converted;
+    std::vector<uint8_t> png;
+    std::vector<uint8_t> codec;
+    std::vector<std::vector<uint8_t>> codecFrames;      // Encoded halves "decode" reads
+    uint32_t codecFramesId = 0;
+    std::vector<uint8_t> decoded;
+    std::vector<uint8_t> yuv;
+    std::vector<ImageView> tileViews;
+    std::unique_ptr<ThreadPool> pool;
+    uint64_t checksum = 0;
+};
+
+std::vector<BenchStage> BuildStages(BenchOutputs& outputs) {
+    std::vector<BenchStage> stages;
+    const size_t halfBytes = static_cast<size_t>(kWidth / 2) * kHeight * 4;
+
+    // CPU equivalent of the CopySubresourceRegion per tile in CaptureFrame()
+    stages.push_back({ "split", static_cast<size_t>(kWidth) * kHeight * 4, [&outputs](const BenchFrames& frames, size_t frame) {
+        const uint8_t* desktop = frames.desktops[frame].data();
+        size_t tilePitch = static_cast<size_t>(frames.layout.tileWidth) * 4;
+        for (const TileCopy& tile : frames.layout.copies) {
+            std::vector<uint8_t>& out = outputs.halves[tile.output];
+            out.resize(tilePitch * frames.layout.tileHeight);
+            for (uint32_t y = 0; y < frames.layout.tileHeight; ++y) {
+                std::memcpy(out.data() + y * tilePitch, desktop + (static_cast<size_t>(tile.top) + y) * kWidth * 4 + tile.left * 4, tilePitch);
+            }
+        }
+    } });
+
+    // Map + row-by-row copy honouring RowPitch, as in the pipeline's readback stage
+    stages.push_back({ "readback", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        const uint8_t* source = frames.pitchedHalves[frame].data();
+        size_t rowBytes = static_cast<size_t>(frames.halfWidth) * 4;
+        outputs.readback.resize(rowBytes * kHeight);
+        for (uint32_t y = 0; y < kHeight; ++y) {
+            std::memcpy(outputs.readback.data() + y * rowBytes, source + y * frames.pitchedRowPitch, rowBytes);
+        }
+    } });
+
+    // CaptureBackbufferAndSave(): fresh vector, then one memcpy per row bottom-up
+    stages.push_back({ "flip", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        const unsigned char* pixels = frames.pitchedHalves[frame].data();
+        int width = static_cast<int>(frames.halfWidth);
+        int height = static_cast<int>(kHeight);
+        int pitch = static_cast<int>(frames.pitchedRowPitch);
+        std::vector<unsigned char> imageData(width * height * 4);
+        for (int y = 0; y < height; ++y) {
+            memcpy(&imageData[y * width * 4], &pixels[(height - y - 1) * pitch], width * 4);
+        }
+        outputs.checksum += imageData[imageData.size() / 2];
+    } });
+
+    // CaptureBackbufferAndSave() now: flip + BGRA -> RGBA in one pass into a reused buffer
+    const PixelKernelLevel levels[] = { PixelKernelLevel::Scalar, PixelKernelLevel::Sse2, PixelKernelLevel::Avx2 };
+    for (PixelKernelLevel level : levels) {
+        if (!PixelKernelLevelSupported(level)) continue;
+        stages.push_back({ std::string("flip-") + PixelKernelLevelName(level), halfBytes, [&outputs, level](const BenchFrames& frames, size_t frame) {
+            PixelConvertOptions options;
+            options.flipVertical = true;
+            options.swapRedBlue = true;
+            ImageView source(frames.pitchedHalves[frame].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch);
+            size_t rowBytes = ConvertedRowBytes(source.width, options);
+            outputs.converted.resize(rowBytes * kHeight);
+            ConvertPixels(source, outputs.converted.data(), rowBytes, options, level);
+        } });
+    }
+
+    // Same, straight to 24-bit RGB
+    stages.push_back({ "flip-rgb", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        PixelConvertOptions options;
+        options.flipVertical = true;
+        options.swapRedBlue = true;
+        options.dropAlpha = true;
+        ImageView source(frames.pitchedHalves[frame].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch);
+        size_t rowBytes = ConvertedRowBytes(source.width, options);
+        outputs.converted.resize(rowBytes * kHeight);
+        ConvertPixels(source, outputs.converted.data(), rowBytes, options);
+    } });
+
+    // One half to NV12 for video consumers, on one thread and with row bands on the pool
+    for (bool pooled : { false, true }) {
+        stages.push_back({ pooled ? "nv12-mt" : "nv12", halfBytes, [&outputs, pooled](const BenchFrames& frames, size_t frame) {
+            ImageView source(frames.pitchedHalves[frame].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch);
+            outputs.yuv.resize(YuvFrameBytes(source.width, source.height));
+            ConvertToYuv(source, PackedYuvPlanes(outputs.yuv.data(), source.width, source.height, YuvLayout::Nv12), YuvOptions(),
+                         pooled ? outputs.pool.get() : nullptr);
+        } });
+    }
+
+    // One half to PNG, what SaveTextureAsPNGStandalone() does per tile per frame
+    stages.push_back({ "png", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        EncodePng(frames.pitchedHalves[frame].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch, outputs.png);
+    } });
+
+    // The same half with its row strips deflated on the thread pool
+    stages.push_back({ "png-mt", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        EncodePngParallel(frames.pitchedHalves[frame].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch, outputs.png, *outputs.pool);
+    } });
+
+    // The same half read in place from the full-frame readback through a tile view
+    stages.push_back({ "png-view", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        ImageView desktop(frames.desktops[frame].data(), kWidth, kHeight, static_cast<size_t>(kWidth) * 4);
+        std::vector<ImageView>& views = outputs.tileViews;
+        BuildTileViews(desktop, frames.layout, views);
+        EncodePng(views[0].data, views[0].width, views[0].height, views[0].rowPitch, outputs.png);
+    } });
+
+    // One half into the screen stream codec, what each output's stream writer does per frame
+    stages.push_back({ "codec", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        outputs.codec.clear();
+        EncodeScreenFrame(ImageView(frames.pitchedHalves[frame].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch), outputs.codec);
+    } });
+
+    // Decoding those halves again; throughput is of decoded pixels. The warm-up run encodes them.
+    stages.push_back({ "decode", halfBytes, [&outputs](const BenchFrames& frames, size_t frame) {
+        if (outputs.codecFramesId != frames.id) {
+            outputs.codecFrames.assign(frames.pitchedHalves.size(), std::vector<uint8_t>());
+            for (size_t i = 0; i < frames.pitchedHalves.size(); ++i) {
+                EncodeScreenFrame(ImageView(frames.pitchedHalves[i].data(), frames.halfWidth, kHeight, frames.pitchedRowPitch), outputs.codecFrames[i]);
+            }
+            outputs.codecFramesId = frames.id;
+        }
+        const std::vector<uint8_t>& encoded = outputs.codecFrames[frame];
+        size_t pitch = static_cast<size_t>(frames.halfWidth) * 4;
+        outputs.decoded.resize(pitch * kHeight);
+        if (!DecodeScreenFrame(encoded.data(), encoded.size(), frames.halfWidth, kHeight, outputs.decoded.data(), pitch)) {
+            outputs.checksum = 0xFFFFFFFFFFFFFFFFull;
+        }
+    } });
+
+    return stages;
+}
+
+// Per-pixel reference for ConvertPixels()
+void ReferenceConvert(const ImageView& source, uint8_t* dest, size_t destPitch, const PixelConvertOptions& options) {
+    for (uint32_t y = 0; y < source.height; ++y) {
+        uint32_t sourceY = options.flipVertical ? source.height - 1 - y : y;
+        uint8_t* out = dest + y * destPitch;
+        for (uint32_t x = 0; x < source.width; ++x) {
+            const uint8_t* p = source.Pixel(x, sourceY);
+            uint8_t pixel[4] = { p[0], p[1], p[2], p[3] };
+            if (options.swapRedBlue) std::swap(pixel[0], pixel[2]);
+            size_t channels = options.dropAlpha ? 3 : 4;
+            for (size_t c = 0; c < channels; ++c) *out++ = pixel[c];
+        }
+    }
+}
+
+// Every supported level against the reference, over odd widths, padded pitches and all
+// option combinations; guard bytes after each destination row catch overruns
+bool VerifyPixelKernels() {
+    std::mt19937 rng(7);
+    const uint32_t widths[] = { 1, 2, 3, 4, 7, 8, 9, 10, 11, 15, 16, 17, 18, 31, 33, 64, 100, 2563 };
+    const uint32_t heights[] = { 1, 2, 5 };
+    const PixelKernelLevel levels[] = { PixelKernelLevel::Scalar, PixelKernelLevel::Sse2, PixelKernelLevel::Avx2 };
+    const size_t guard = 32;
+    size_t cases = 0;
+
+    for (uint32_t width : widths) {
+        for (uint32_t height : heights) {
+            size_t sourcePitch = static_cast<size_t>(width) * 4 + 12;
+            std::vector<uint8_t> source(sourcePitch * height);
+            for (uint8_t& b : source) b = static_cast<uint8_t>(rng());
+            ImageView view(source.data(), width, height, sourcePitch);
+
+            for (int flags = 0; flags < 8; ++flags) {
+                PixelConvertOptions options;
+                options.flipVertical = (flags & 1) != 0;
+                options.swapRedBlue = (flags & 2) != 0;
+                options.dropAlpha = (flags & 4) != 0;
+                size_t destPitch = ConvertedRowBytes(width, options) + guard;
+                std::vector<uint8_t> expected(destPitch * height, 0xCD);
+                ReferenceConvert(view, expected.data(), destPitch, options);
+
+                for (PixelKernelLevel level : levels) {
+                    if (!PixelKernelLevelSupported(level)) continue;
+                    std::vector<uint8_t> actual(destPitch * height, 0xCD);
+                    ConvertPixels(view, actual.data(), destPitch, options, level);
+                    cases++;
+                    if (actual != expected) {
+                        std::cerr << "Pixel kernel mismatch: " << PixelKernelLevelName(level) << " " << width << "x" << height
+                                  << " flip " << options.flipVertical << " swap " << options.swapRedBlue << " drop " << options.dropAlpha << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    std::cout << "Pixel kernels bit-exact against reference in " << cases << " cases (best: "
+              << PixelKernelLevelName(BestPixelKernelLevel()) << ")" << std::endl;
+    return true;
+}
+
+bool RoundTripScreenFrame(const ImageView& image) {
+    std::vector<uint8_t> encoded;
+    EncodeScreenFrame(image, encoded);
+    size_t pitch = static_cast<size_t>(image.width) * 4;
+    std::vector<uint8_t> decoded(pitch * image.height);
+    if (!DecodeScreenFrame(encoded.data(), encoded.size(), image.width, image.height, decoded.data(), pitch)) return false;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        if (std::memcmp(decoded.data() + y * pitch, image.Row(y), pitch) != 0) return false;
+    }
+    return true;
+}
+
+// Random pixels hit every op; runs, row repeats and alpha changes are mixed in on purpose
+bool VerifyScreenCodec() {
+    std::mt19937 rng(11);
+    size_t cases = 0;
+    const uint32_t sizes[][2] = { { 1, 1 }, { 1, 7 }, { 7, 1 }, { 3, 3 }, { 64, 16 }, { 257, 33 }, { 1000, 9 } };
+    for (const auto& size : sizes) {
+        for (int mode = 0; mode < 4; ++mode) {
+            size_t pitch = static_cast<size_t>(size[0]) * 4 + 8;
+            std::vector<uint8_t> pixels(pitch * size[1]);
+            for (uint32_t y = 0; y < size[1]; ++y) {
+                uint32_t* row = reinterpret_cast<uint32_t*>(pixels.data() + y * pitch);
+                for (uint32_t x = 0; x < size[0]; ++x) {
+                    uint32_t px = rng();
+                    if (mode >= 1) px |= 0xFF000000u;                       // Opaque, like a desktop
+                    if (mode >= 2 && x > 0 && rng() % 4) px = row[x - 1] + (rng() % 3) * 0x010101u;   // Small steps and runs
+                    if (mode == 3 && y > 0 && rng() % 3) px = reinterpret_cast<uint32_t*>(pixels.data() + (y - 1) * pitch)[x];
+                    row[x] = px;
+                }
+            }
+            cases++;
+            if (!RoundTripScreenFrame(ImageView(pixels.data(), size[0], size[1], pitch))) {
+                std::cerr << "Screen codec round trip failed: " << size[0] << "x" << size[1] << " mode " << mode << std::endl;
+                return false;
+            }
+        }
+    }
+
+    const SyntheticPattern patterns[] = { SyntheticPattern::Static, SyntheticPattern::ScrollingText, SyntheticPattern::Noise };
+    for (SyntheticPattern pattern : patterns) {
+        SyntheticFrameSource source(1283, 721, pattern);
+        std::vector<uint8_t> frame(source.FrameBytes());
+        for (uint64_t i = 0; i < 3; ++i) {
+            source.RenderFrame(frame.data(), i * 13);
+            cases++;
+            if (!RoundTripScreenFrame(ImageView(frame.data(), source.Width(), source.Height(), source.RowPitch()))) {
+                std::cerr << "Screen codec round trip failed on a synthetic frame" << std::endl;
+                return false;
+            }
+        }
+    }
+    std::cout << "Screen codec lossless in " << cases << " round trips" << std::endl;
+    return true;
+}
+
+// Walks the chunks of 'png', checking every CRC, and returns the concatenated IDAT data
+bool ReadPngIdat(const std::vector<uint8_t>& png, std::vector<uint8_t>& idat, size_t& idatChunks) {
+    idat.clear();
+    idatChunks = 0;
+    size_t p = 8;
+    while (p + 12 <= png.size()) {
+        size_t length = size_t(png[p]) << 24 | size_t(png[p + 1]) << 16 | size_t(png[p + 2]) << 8 | png[p + 3];
+        if (p + 12 + length > png.size()) return false;
+        const uint8_t* c = png.data() + p + 8 + length;
+        uint32_t crc = uint32_t(c[0]) << 24 | uint32_t(c[1]) << 16 | uint32_t(c[2]) << 8 | c[3];
+        if (Crc32(png.data() + p + 4, length + 4) != crc) return false;
+        if (std::memcmp(png.data() + p + 4, "IDAT", 4) == 0) {
+            idat.insert(idat.end(), png.data() + p + 8, png.data() + p + 8 + length);
+            idatChunks++;
+        }
+        p += 12 + length;
+    }
+    return p == png.size();
+}
+
+// Strip-parallel PNGs over awkward sizes and strip heights, from one row per strip up to one strip
+bool VerifyParallelPng(ThreadPool& pool) {
+    size_t cases = 0;
+    const uint32_t sizes[][2] = { { 1, 1 }, { 7, 300 }, { 333, 97 }, { 1280, 64 } };
+    const uint32_t stripRows[] = { 1, 3, 16, 0, 100000 };
+    const SyntheticPattern patterns[] = { SyntheticPattern::ScrollingText, SyntheticPattern::Noise };
+    for (const auto& size : sizes) {
+        for (SyntheticPattern pattern : patterns) {
+            SyntheticFrameSource source(size[0], size[1], pattern);
+            std::vector<uint8_t> frame(source.FrameBytes());
+            source.RenderFrame(frame.data(), 3);
+
+            std::vector<uint8_t> single, scanlines;
+            EncodePng(frame.data(), size[0], size[1], source.RowPitch(), single);
+            BuildPngScanlines(frame.data(), size[0], 0, size[1], source.RowPitch(), PngWriteOptions(), scanlines);
+            uint32_t adler = Adler32(scanlines.data(), scanlines.size());
+
+            for (uint32_t rows : stripRows) {
+                std::vector<uint8_t> png, idat;
+                size_t chunks = 0;
+                EncodePngParallel(frame.data(), size[0], size[1], source.RowPitch(), png, pool, PngWriteOptions(), rows);
+                cases++;
+                bool ok = ReadPngIdat(png, idat, chunks) && idat.size() > 6 && idat[0] == 0x78 && idat[1] == 0x5E;
+                if (ok) {
+                    const uint8_t* a = idat.data() + idat.size() - 4;
+                    ok = (uint32_t(a[0]) << 24 | uint32_t(a[1]) << 16 | uint32_t(a[2]) << 8 | a[3]) == adler;
+                }
+                if (ok && rows >= size[1]) ok = png == single;
+                if (!ok) {
+                    std::cerr << "Parallel PNG check failed: " << size[0] << "x" << size[1] << ", " << rows << " rows per strip" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    std::cout << "Parallel PNG streams valid in " << cases << " cases on " << pool.Concurrency() << " threads" << std::endl;
+    return true;
+}
+
+BenchResult RunStage(const std::string& pattern, const BenchStage& stage, const BenchFrames& frames, double minSeconds, BenchOutputs& outputs) {
+    BenchResult result;
+    result.pattern = pattern;
+    result.stage = stage.name;
+    result.bytesPerRun = stage.bytesPerRun;
+
+    stage.run(frames, 0);   // Warm-up: page in outputs, build tables
+    const uint32_t minRuns = 5;
+    const uint32_t maxRuns = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < maxRuns; ++i) {
+        auto runStart = std::chrono::steady_clock::now();
+        stage.run(frames, i % frames.desktops.size());
+        auto runEnd = std::chrono::steady_clock::now();
+        result.latency.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(runEnd - runStart).count());
+        if (i + 1 >= minRuns && std::chrono::duration<double>(runEnd - start).count() >= minSeconds) break;
+    }
+    if (stage.name.compare(0, 3, "png") == 0) result.outputBytes = outputs.png.size();
+    if (stage.name == "codec") result.outputBytes = outputs.codec.size();
+    return result;
+}
+
+void PrintResult(const BenchResult& r) {
+    double mbPerSecond = r.bytesPerRun / (r.latency.MeanMs() / 1000.0) / 1e6;
+    std::cout << std::left << std::setw(8) << r.pattern << std::setw(12) << r.stage << std::right
+              << std::setw(7) << r.latency.Count()
+              << std::fixed << std::setprecision(3)
+              << std::setw(10) << r.latency.MeanMs()
+              << std::setw(10) << r.latency.PercentileMs(50)
+              << std::setw(10) << r.latency.PercentileMs(90)
+              << std::setw(10) << r.latency.PercentileMs(99)
+              << std::setw(10) << r.latency.MaxMs()
+              << std::setprecision(1) << std::setw(11) << mbPerSecond;
+    if (r.outputBytes) std::cout << "  ratio " << std::setprecision(2) << static_cast<double>(r.bytesPerRun) / r.outputBytes;
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string patternFilter = "all";
+    std::string stageFilter;
+    std::string csvPath;
+    double minSeconds = 0.5;
+    size_t threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--pattern") patternFilter = argv[i + 1];
+        else if (flag == "--stage") stageFilter = argv[i + 1];
+        else if (flag == "--seconds") minSeconds = std::stod(argv[i + 1]);
+        else if (flag == "--csv") csvPath = argv[i + 1];
+        else if (flag == "--threads") threads = std::stoul(argv[i + 1]);
+        else {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return -1;
+        }
+    }
+
+    const std::pair<const char*, SyntheticPattern> patterns[] = {
+        { "static", SyntheticPattern::Static },
+        { "scroll", SyntheticPattern::ScrollingText },
+        { "noise", SyntheticPattern::Noise },
+    };
+
+    BenchOutputs outputs;
+    outputs.pool.reset(new ThreadPool(threads));
+    if (!VerifyPixelKernels() || !VerifyScreenCodec() || !VerifyParallelPng(*outputs.pool)) return 1;
+
+    std::vector<BenchStage> stages = BuildStages(outputs);
+    std::vector<BenchResult> results;
+
+    std::cout << kWidth << "x" << kHeight << " BGRA, latency in ms, throughput in MB/s of input" << std::endl;
+    std::cout << std::left << std::setw(8) << "pattern" << std::setw(12) << "stage" << std::right << std::setw(7) << "runs"
+              << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+              << std::setw(10) << "max" << std::setw(11) << "MB/s" << std::endl;
+
+    for (const auto& pattern : patterns) {
+        if (patternFilter != "all" && patternFilter != pattern.first) continue;
+        BenchFrames frames = BuildFrames(pattern.second, 4);
+        for (const BenchStage& stage : stages) {
+            if (!stageFilter.empty() && stageFilter != stage.name) continue;
+            results.push_back(RunStage(pattern.first, stage, frames, minSeconds, outputs));
+            PrintResult(results.back());
+        }
+    }
+
+    if (!csvPath.empty()) {
+        std::ofstream csv(csvPath);
+        csv << "pattern,stage,runs,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,mb_per_s\n";
+        for (const BenchResult& r : results) {
+            csv << r.pattern << "," << r.stage << "," << r.latency.Count() << "," << r.latency.MeanMs() << ","
+                << r.latency.PercentileMs(50) << "," << r.latency.PercentileMs(90) << "," << r.latency.PercentileMs(99) << ","
+                << r.latency.MaxMs() << "," << r.bytesPerRun / (r.latency.MeanMs() / 1000.0) / 1e6 << "\n";
+        }
+        if (!csv) {
+            std::cerr << "Failed to write " << csvPath << std::endl;
+            return -1;
+        }
+    }
+    return outputs.checksum == 0xFFFFFFFFFFFFFFFFull ? 1 : 0;  // Keeps the flip's output observable
+}
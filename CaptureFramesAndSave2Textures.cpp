@@ -4,6 +4,8 @@
 #include <iostream>
 #include <windows.h>
 #include <fstream>
+#include "FramePacer.h"
+#include "TileLayout.h"
 using Microsoft::WRL::ComPtr;
 
 // Global Variables
@@ -13,8 +15,13 @@ ComPtr<IDXGIOutputDuplication> g_duplication;
 ComPtr<ID3D11Texture2D> g_leftTexture;
 ComPtr<ID3D11Texture2D> g_rightTexture;
 
-D3D11_BOX leftBox = { 0, 0, 0, 2560, 1440, 1 };  // Adjust resolution as needed
-D3D11_BOX rightBox = { 2560, 0, 0, 5120, 1440, 1 };
+// Split layout - left and right halves by default, sized from the captured desktop
+TileLayoutConfig g_tileConfig;
+TileLayoutCache g_tileLayout;
+
+// Output pacing - wait for the next tick instead of spinning on AcquireNextFrame
+QpcPacerClock g_pacerClock;
+FramePacer g_pacer({ 60.0, PacingPolicy::DuplicateLast }, g_pacerClock);
 
 void CreateConsole() {
     // Allocate a console for the application
@@ -107,9 +114,17 @@ bool InitializeDeviceAndDuplication() {
 }
 
 bool InitializeTextures() {
+    DXGI_OUTDUPL_DESC duplicationDesc;
+    g_duplication->GetDesc(&duplicationDesc);
+    const TileLayout* layout = g_tileLayout.Get(duplicationDesc.ModeDesc.Width, duplicationDesc.ModeDesc.Height, g_tileConfig);
+    if (!layout || layout->TileCount() != 2) {
+        std::cerr << "Tile layout does not split the desktop into left and right textures." << std::endl;
+        return false;
+    }
+
     D3D11_TEXTURE2D_DESC textureDesc = {};
-    textureDesc.Width = 2560;  // Half the screen width
-    textureDesc.Height = 1440; // Screen height
+    textureDesc.Width = layout->tileWidth;
+    textureDesc.Height = layout->tileHeight;
     textureDesc.MipLevels = 1;
     textureDesc.ArraySize = 1;
     textureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -142,7 +157,7 @@ bool CaptureFrame() {
     ComPtr<IDXGIResource> desktopResource;
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
 
-    HRESULT hr = g_duplication->AcquireNextFrame(500, &frameInfo, &desktopResource);
+    HRESULT hr = g_duplication->AcquireNextFrame(g_pacer.AcquireTimeoutMs(), &frameInfo, &desktopResource);
     if (FAILED(hr)) {
         if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
             return true; // No new frame
@@ -162,6 +177,19 @@ bool CaptureFrame() {
 
     std::cout << "Frame captured successfully." << std::endl;
 
+    // Split into the left and right textures
+    D3D11_TEXTURE2D_DESC desc;
+    capturedTexture->GetDesc(&desc);
+    const TileLayout* layout = g_tileLayout.Get(desc.Width, desc.Height, g_tileConfig);
+    if (layout && layout->TileCount() == 2) {
+        ID3D11Texture2D* tileTextures[2] = { g_leftTexture.Get(), g_rightTexture.Get() };
+        for (const TileCopy& tile : layout->copies) {
+            D3D11_BOX box = TileSourceBox(tile);
+            g_context->CopySubresourceRegion(tileTextures[tile.output], 0, 0, 0, 0, capturedTexture.Get(), 0, &box);
+        }
+    }
+    g_pacer.OnFrameArrived(QpcToNanoseconds(frameInfo.LastPresentTime.QuadPart), frameInfo.AccumulatedFrames);
+
     g_duplication->ReleaseFrame();
     return true;
 }
@@ -187,6 +215,10 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
             std::cerr << "Error capturing frame." << std::endl;
             break;
         }
+
+        if (g_pacer.Poll() != PacingDecision::Wait && g_pacer.Stats().ticks % 600 == 0) {
+            WritePacingStats(std::cout, g_pacer.Stats());
+        }
     }
 
     return 0;
@@ -0,0 +1,613 @@
+#pragma once
+// Fixed-size circular recordings (.sring) for capture that never stops. One file is
+// preallocated to its final size and memory-mapped; delta-encoded frames are written into
+// its data region as a ring, overwriting the oldest keyframe group in place when space runs
+// out. Disk use is constant, nothing is created or deleted while recording, and a reader
+// can map the same file and look at the recent history without copying it.
+//
+// File: page 0 holds two header slots { "SRNG", version, width, height, keyframe interval,
+// index entries u32, data bytes u64, header sequence u64, first frame u64, next frame u64,
+// write position u64, checksum u64 }; the writer alternates between them, so one is always
+// whole. From page 1 a ring of 64-byte index entries { frame sequence u64, data offset u64,
+// frameIndex u64, timestamp i64, payload bytes u32, flags u32, payload hash u64, reserved,
+// checksum u64 }, entry for sequence s at s % entries. Then the data region, records laid
+// end to end and wrapping to its start. Payloads are ScreenRecording deltas/keyframes.
+//
+// Crash safety: a payload is copied before its entry, and its entry before the header that
+// counts it; the header that frees old space is published before that space is
+// overwritten. Entries carry a checksum and the hash of their payload, so after a crash a
+// reader trusts the newest whole header, picks up any later entries that check out, and
+// never decodes a payload that was half overwritten. Sync() pushes the map to disk for
+// power loss; a process crash loses nothing already copied into the map.
+#include "ScreenRecording.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CircularRecordingDetail {
+
+const char kMagic[4] = { 'S', 'R', 'N', 'G' };
+const uint32_t kVersion = 1;
+const size_t kPageBytes = 4096;
+const size_t kHeaderSlotBytes = 128;
+const size_t kHeaderBytes = 72;
+const size_t kEntryBytes = 64;
+const uint32_t kFlagKeyframe = 1;
+
+struct RingHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t keyframeInterval = 0;
+    uint32_t indexEntries = 0;
+    uint64_t dataBytes = 0;
+    uint64_t headerSeq = 0;
+    uint64_t firstSeq = 0;      // Oldest frame still held
+    uint64_t nextSeq = 0;       // One past the newest
+    uint64_t writePos = 0;      // Data offset after the newest record
+};
+
+struct RingEntry {
+    uint64_t seq = 0;
+    uint64_t offset = 0;
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;
+    uint32_t size = 0;
+    uint32_t flags = 0;
+    uint64_t payloadHash = 0;
+};
+
+inline uint64_t Mix(uint64_t h) {
+    h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDull;
+    h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 33);
+}
+
+// Catches torn writes: unlike RowHash, whose multiplies only carry a difference upward, every
+// step here is a bijection that rotates it around, so no single changed word cancels out
+inline uint64_t Checksum(const uint8_t* data, size_t bytes) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h[4] = { k, k ^ 1, k ^ 2, k ^ 3 };
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t w;
+            std::memcpy(&w, data + i + lane * 8, 8);
+            w ^= h[lane];
+            h[lane] = ((w << 29) | (w >> 35)) * 0xFF51AFD7ED558CCDull;
+        }
+    }
+    for (; i < bytes; ++i) h[0] = (h[0] ^ data[i]) * 0xC4CEB9FE1A85EC53ull;
+    return Mix(h[0] ^ Mix(h[1] ^ Mix(h[2] ^ Mix(h[3] ^ bytes))));
+}
+
+inline size_t IndexOffset() { return kPageBytes; }
+
+inline size_t DataOffset(uint32_t indexEntries) {
+    return kPageBytes + (indexEntries * kEntryBytes + kPageBytes - 1) / kPageBytes * kPageBytes;
+}
+
+inline void PutHeader(uint8_t* slot, const RingHeader& h) {
+    uint8_t bytes[kHeaderBytes];
+    std::memcpy(bytes, kMagic, 4);
+    std::memcpy(bytes + 4, &kVersion, 4);
+    std::memcpy(bytes + 8, &h.width, 4);
+    std::memcpy(bytes + 12, &h.height, 4);
+    std::memcpy(bytes + 16, &h.keyframeInterval, 4);
+    std::memcpy(bytes + 20, &h.indexEntries, 4);
+    std::memcpy(bytes + 24, &h.dataBytes, 8);
+    std::memcpy(bytes + 32, &h.headerSeq, 8);
+    std::memcpy(bytes + 40, &h.firstSeq, 8);
+    std::memcpy(bytes + 48, &h.nextSeq, 8);
+    std::memcpy(bytes + 56, &h.writePos, 8);
+    uint64_t checksum = Checksum(bytes, 64);
+    std::memcpy(bytes + 64, &checksum, 8);
+    std::memcpy(slot, bytes, kHeaderBytes);
+}
+
+inline bool GetHeader(const uint8_t* slot, RingHeader& h) {
+    uint8_t bytes[kHeaderBytes];
+    std::memcpy(bytes, slot, kHeaderBytes);
+    uint32_t version;
+    uint64_t checksum;
+    std::memcpy(&version, bytes + 4, 4);
+    std::memcpy(&checksum, bytes + 64, 8);
+    if (std::memcmp(bytes, kMagic, 4) != 0 || version != kVersion || checksum != Checksum(bytes, 64)) return false;
+    std::memcpy(&h.width, bytes + 8, 4);
+    std::memcpy(&h.height, bytes + 12, 4);
+    std::memcpy(&h.keyframeInterval, bytes + 16, 4);
+    std::memcpy(&h.indexEntries, bytes + 20, 4);
+    std::memcpy(&h.dataBytes, bytes + 24, 8);
+    std::memcpy(&h.headerSeq, bytes + 32, 8);
+    std::memcpy(&h.firstSeq, bytes + 40, 8);
+    std::memcpy(&h.nextSeq, bytes + 48, 8);
+    std::memcpy(&h.writePos, bytes + 56, 8);
+    return true;
+}
+
+// The newer of the two header slots that checks out
+inline bool NewestHeader(const uint8_t* base, RingHeader& header) {
+    RingHeader slots[2];
+    bool valid[2] = { GetHeader(base, slots[0]), GetHeader(base + kHeaderSlotBytes, slots[1]) };
+    if (!valid[0] && !valid[1]) return false;
+    header = !valid[1] || (valid[0] && slots[0].headerSeq > slots[1].headerSeq) ? slots[0] : slots[1];
+    return true;
+}
+
+inline void PutEntry(uint8_t* slot, const RingEntry& e) {
+    uint8_t bytes[kEntryBytes] = {};
+    std::memcpy(bytes, &e.seq, 8);
+    std::memcpy(bytes + 8, &e.offset, 8);
+    std::memcpy(bytes + 16, &e.frameIndex, 8);
+    std::memcpy(bytes + 24, &e.timestamp, 8);
+    std::memcpy(bytes + 32, &e.size, 4);
+    std::memcpy(bytes + 36, &e.flags, 4);
+    std::memcpy(bytes + 40, &e.payloadHash, 8);
+    uint64_t checksum = Checksum(bytes, 56);
+    std::memcpy(bytes + 56, &checksum, 8);
+    std::memcpy(slot, bytes, kEntryBytes);
+}
+
+inline bool GetEntry(const uint8_t* slot, RingEntry& e) {
+    uint8_t bytes[kEntryBytes];
+    std::memcpy(bytes, slot, kEntryBytes);
+    uint64_t checksum;
+    std::memcpy(&checksum, bytes + 56, 8);
+    if (checksum != Checksum(bytes, 56)) return false;
+    std::memcpy(&e.seq, bytes, 8);
+    std::memcpy(&e.offset, bytes + 8, 8);
+    std::memcpy(&e.frameIndex, bytes + 16, 8);
+    std::memcpy(&e.timestamp, bytes + 24, 8);
+    std::memcpy(&e.size, bytes + 32, 4);
+    std::memcpy(&e.flags, bytes + 36, 4);
+    std::memcpy(&e.payloadHash, bytes + 40, 8);
+    return true;
+}
+
+// Frames a reader can trust: from the first keyframe at or after the header's first frame,
+// through the header's last and on past it while entries (written before a crash, say) and
+// their payloads check out, stopping at the first that does not. Payloads the header counts
+// are not rehashed; the header is only published after they are whole.
+inline void CollectFrames(const uint8_t* base, const RingHeader& header, std::vector<RingEntry>& frames) {
+    frames.clear();
+    const uint8_t* index = base + IndexOffset();
+    const uint8_t* data = base + DataOffset(header.indexEntries);
+    for (uint64_t seq = header.firstSeq; seq < header.firstSeq + header.indexEntries; ++seq) {
+        RingEntry entry;
+        if (!GetEntry(index + (seq % header.indexEntries) * kEntryBytes, entry) || entry.seq != seq ||
+            entry.offset + entry.size > header.dataBytes || entry.size == 0 ||
+            (seq >= header.nextSeq && entry.payloadHash != Checksum(data + entry.offset, entry.size))) {
+            if (seq < header.nextSeq && frames.empty()) continue;   // Overwritten before the header caught up
+            break;
+        }
+        if (frames.empty() && !(entry.flags & kFlagKeyframe)) continue;
+        frames.push_back(entry);
+    }
+}
+
+// A shared mapping of a whole file; the writer's is read-write and sized by it
+class MappedFile {
+public:
+    ~MappedFile() { Close(); }
+
+    // bytes == 0 maps an existing file read-only at its current size
+    bool Open(const std::string& path, uint64_t bytes) {
+        Close();
+        m_writable = bytes != 0;
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), m_writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             nullptr, m_writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size)) return Fail();
+        if (m_writable && static_cast<uint64_t>(size.QuadPart) != bytes) {
+            // Reserve the whole file now so recording never extends it
+            LARGE_INTEGER end;
+            end.QuadPart = static_cast<LONGLONG>(bytes);
+            if (!SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file)) return Fail();
+            m_created = true;
+            size.QuadPart = end.QuadPart;
+        }
+        m_bytes = static_cast<uint64_t>(size.QuadPart);
+        if (m_bytes == 0) return Fail();
+        m_mapping = CreateFileMappingA(m_file, nullptr, m_writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping) return Fail();
+        m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, m_writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+        if (!m_data) return Fail();
+#else
+        m_fd = open(path.c_str(), m_writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644);
+        if (m_fd < 0) return false;
+        struct stat info;
+        if (fstat(m_fd, &info) != 0) return Fail();
+        if (m_writable && static_cast<uint64_t>(info.st_size) != bytes) {
+            // Start from zeros and reserve every block now: no ENOSPC (SIGBUS) mid-recording
+            if (ftruncate(m_fd, 0) != 0 || ftruncate(m_fd, static_cast<off_t>(bytes)) != 0) return Fail();
+#ifdef __linux__
+            if (posix_fallocate(m_fd, 0, static_cast<off_t>(bytes)) != 0) return Fail();
+#endif
+            m_created = true;
+            info.st_size = static_cast<off_t>(bytes);
+        }
+        m_bytes = static_cast<uint64_t>(info.st_size);
+        if (m_bytes == 0) return Fail();
+        void* data = mmap(nullptr, m_bytes, m_writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED) return Fail();
+        m_data = static_cast<uint8_t*>(data);
+#endif
+        return true;
+    }
+
+    // Writes dirty pages back and waits for them
+    bool Sync() {
+        if (!m_data || !m_writable) return true;
+#ifdef _WIN32
+        return FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_file);
+#else
+        return msync(m_data, m_bytes, MS_SYNC) == 0;
+#endif
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data) munmap(m_data, m_bytes);
+        if (m_fd >= 0) close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = nullptr;
+        m_bytes = 0;
+        m_created = false;
+    }
+
+    uint8_t* Data() const { return m_data; }
+    uint64_t Bytes() const { return m_bytes; }
+    bool Created() const { return m_created; }     // Sized (and zeroed) by this Open
+
+private:
+    bool Fail() {
+        Close();
+        return false;
+    }
+
+    uint8_t* m_data = nullptr;
+    uint64_t m_bytes = 0;
+    bool m_writable = false;
+    bool m_created = false;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+}  // namespace CircularRecordingDetail
+
+struct CircularRecordingOptions {
+    uint64_t fileBytes = 4ull << 30;    // Whole file, index and header included
+    uint32_t indexEntries = 0;          // 0: one per 16 KB of data
+    uint32_t keyframeInterval = 120;
+};
+
+struct CircularRecordingStats {
+    uint64_t frames = 0;            // Held now
+    uint64_t bytes = 0;             // Payload bytes held now
+    uint64_t added = 0;
+    uint64_t evicted = 0;           // Overwritten
+    uint64_t dropped = 0;           // Larger than the data region
+    uint64_t laps = 0;              // Times the write position wrapped
+    uint64_t fileBytes = 0;         // Never changes after Open
+    bool resumed = false;           // Open continued an existing ring
+};
+
+class CircularRecordingWriter {
+public:
+    ~CircularRecordingWriter() { Close(); }
+
+    // Opens 'path', continuing the ring in it if its geometry matches; otherwise the file is
+    // (re)created at options.fileBytes
+    bool Open(const std::string& path, uint32_t width, uint32_t height, const CircularRecordingOptions& options = CircularRecordingOptions()) {
+        using namespace CircularRecordingDetail;
+        Close();
+        uint32_t entries = options.indexEntries ? options.indexEntries : static_cast<uint32_t>(std::max<uint64_t>(64, options.fileBytes / 16384));
+        if (options.fileBytes <= DataOffset(entries) + kPageBytes) return false;
+        if (!m_map.Open(path, options.fileBytes)) return false;
+        m_stats = CircularRecordingStats();
+        m_stats.fileBytes = m_map.Bytes();
+
+        RingHeader existing;
+        std::vector<RingEntry> frames;
+        bool resume = !m_map.Created() && NewestHeader(m_map.Data(), existing) && existing.width == width && existing.height == height &&
+                      existing.indexEntries == entries && DataOffset(entries) + existing.dataBytes == m_map.Bytes();
+        if (resume) {
+            m_header = existing;
+            CollectFrames(m_map.Data(), m_header, frames);
+        }
+        else {
+            m_header = RingHeader();
+            m_header.width = width;
+            m_header.height = height;
+            m_header.indexEntries = entries;
+            m_header.dataBytes = m_map.Bytes() - DataOffset(entries);
+        }
+        m_header.keyframeInterval = options.keyframeInterval;
+        if (frames.empty()) {
+            m_header.firstSeq = m_header.nextSeq;
+            m_header.writePos = 0;
+        }
+        else {
+            // Continue after the last frame that checked out
+            m_header.firstSeq = frames.front().seq;
+            m_header.nextSeq = frames.back().seq + 1;
+            m_header.writePos = frames.back().offset + frames.back().size;
+            for (const RingEntry& e : frames) m_heldBytes += e.size;
+        }
+        m_stats.resumed = resume;
+        m_index = m_map.Data() + IndexOffset();
+        m_data = m_map.Data() + DataOffset(entries);
+        m_encoder.SetKeyframeInterval(options.keyframeInterval);
+        m_encoder.Reset();
+        m_chainBroken = true;
+        Publish();
+        return true;
+    }
+
+    // Delta-encodes one frame into the ring
+    bool WriteFrame(const ImageView& image, const ScreenStreamFrameInfo& info) {
+        if (!m_data || image.width != m_header.width || image.height != m_header.height) return false;
+        if (m_chainBroken) m_encoder.Reset();
+        m_scratch.clear();
+        m_encoder.Encode(image, m_scratch);
+        bool stored = WriteEncodedFrame(m_scratch.data(), m_scratch.size(), info);
+        if (!stored) m_encoder.Reset();
+        return stored;
+    }
+
+    // Appends a payload from a ScreenDeltaEncoder run elsewhere; after a drop only a
+    // keyframe is accepted
+    bool WriteEncodedFrame(const uint8_t* payload, size_t size, const ScreenStreamFrameInfo& info) {
+        using namespace CircularRecordingDetail;
+        if (!m_data || size == 0) return false;
+        bool keyframe = payload[0] == kScreenFrameKey;
+        if ((m_chainBroken && !keyframe) || size > m_header.dataBytes) return Drop();
+
+        // Free whole groups until the record fits, and publish that before overwriting them
+        uint64_t offset = 0;
+        bool evicted = false;
+        while (!Place(size, offset) || Held() == m_header.indexEntries) {
+            EvictGroup();
+            evicted = true;
+            if (Held() == 0 && !keyframe) return Drop();
+        }
+        if (evicted) Publish();
+        if (offset < m_header.writePos) m_stats.laps++;
+
+        RingEntry entry;
+        entry.seq = m_header.nextSeq;
+        entry.offset = offset;
+        entry.frameIndex = info.frameIndex;
+        entry.timestamp = info.timestamp;
+        entry.size = static_cast<uint32_t>(size);
+        entry.flags = keyframe ? kFlagKeyframe : 0;
+        entry.payloadHash = Checksum(payload, size);
+        std::memcpy(m_data + offset, payload, size);
+        std::atomic_thread_fence(std::memory_order_release);
+        PutEntry(m_index + (entry.seq % m_header.indexEntries) * kEntryBytes, entry);
+        m_header.nextSeq++;
+        m_header.writePos = offset + size;
+        m_heldBytes += size;
+        m_last.offset = DataOffset(m_header.indexEntries) + offset;
+        m_last.frameIndex = info.frameIndex;
+        m_last.timestamp = info.timestamp;
+        m_last.payloadSize = entry.size;
+        m_last.keyframe = keyframe;
+        m_chainBroken = false;
+        m_stats.added++;
+        Publish();
+        return true;
+    }
+
+    // Pushes everything written so far to the disk
+    bool Sync() { return m_map.Sync(); }
+
+    void Close() {
+        if (m_data) m_map.Sync();
+        m_map.Close();
+        m_data = nullptr;
+        m_index = nullptr;
+        m_heldBytes = 0;
+    }
+
+    bool IsOpen() const { return m_data != nullptr; }
+
+    // The frame just written, after a WriteFrame that returned true. The offset is of its
+    // payload in the file and only holds until the ring overwrites it; the ring's own
+    // entries, checked by frame number, say whether it still does.
+    const ScreenRecordingEntry& LastFrame() const { return m_last; }
+
+    CircularRecordingStats Stats() const {
+        CircularRecordingStats stats = m_stats;
+        stats.frames = Held();
+        stats.bytes = m_heldBytes;
+        return stats;
+    }
+
+private:
+    uint64_t Held() const { return m_header.nextSeq - m_header.firstSeq; }
+
+    CircularRecordingDetail::RingEntry Entry(uint64_t seq) const {
+        CircularRecordingDetail::RingEntry entry;
+        CircularRecordingDetail::GetEntry(m_index + (seq % m_header.indexEntries) * CircularRecordingDetail::kEntryBytes, entry);
+        return entry;
+    }
+
+    bool Drop() {
+        m_chainBroken = true;
+        m_stats.dropped++;
+        return false;
+    }
+
+    // Room for 'size' bytes after the newest record, wrapping to the start of the region
+    bool Place(uint64_t size, uint64_t& offset) const {
+        const uint64_t capacity = m_header.dataBytes;
+        if (Held() == 0) {
+            offset = m_header.writePos + size <= capacity ? m_header.writePos : 0;
+            return true;
+        }
+        uint64_t oldest = Entry(m_header.firstSeq).offset;
+        if (m_header.writePos > oldest) {
+            if (capacity - m_header.writePos >= size) {
+                offset = m_header.writePos;
+                return true;
+            }
+            if (oldest >= size) {
+                offset = 0;
+                return true;
+            }
+            return false;
+        }
+        if (oldest - m_header.writePos >= size) {
+            offset = m_header.writePos;
+            return true;
+        }
+        return false;
+    }
+
+    // Forgets the oldest keyframe group; its bytes are only overwritten after the next Publish
+    void EvictGroup() {
+        do {
+            m_heldBytes -= Entry(m_header.firstSeq).size;
+            m_header.firstSeq++;
+            m_stats.evicted++;
+        } while (Held() > 0 && !(Entry(m_header.firstSeq).flags & CircularRecordingDetail::kFlagKeyframe));
+    }
+
+    // Writes the header into the older slot
+    void Publish() {
+        using namespace CircularRecordingDetail;
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header.headerSeq++;
+        PutHeader(m_map.Data() + (m_header.headerSeq & 1) * kHeaderSlotBytes, m_header);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    CircularRecordingDetail::MappedFile m_map;
+    CircularRecordingDetail::RingHeader m_header;
+    uint8_t* m_index = nullptr;
+    uint8_t* m_data = nullptr;
+    uint64_t m_heldBytes = 0;
+    bool m_chainBroken = true;
+    CircularRecordingStats m_stats;
+    ScreenDeltaEncoder m_encoder;
+    std::vector<uint8_t> m_scratch;
+    ScreenRecordingEntry m_last;
+};
+
+// Maps a ring read-only, alongside a live writer or after it is gone. Refresh() takes a new
+// look at what is held; payloads are pointers into the mapping, so a frame the writer may
+// have overwritten since must be confirmed with StillHeld() after it is used.
+class CircularRecordingReader {
+public:
+    bool Open(const std::string& path) {
+        if (!m_map.Open(path, 0)) return false;
+        if (!Refresh()) {
+            m_map.Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        m_map.Close();
+        m_frames.clear();
+        m_decoder.Reset();
+        m_next = 0;
+    }
+
+    // Rereads the header and the entries it covers; positions at the oldest frame
+    bool Refresh() {
+        using namespace CircularRecordingDetail;
+        if (!m_map.Data() || !NewestHeader(m_map.Data(), m_header)) return false;
+        if (DataOffset(m_header.indexEntries) + m_header.dataBytes > m_map.Bytes()) return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        CollectFrames(m_map.Data(), m_header, m_frames);
+        m_decoder.Reset();
+        m_next = 0;
+        return true;
+    }
+
+    uint32_t Width() const { return m_header.width; }
+    uint32_t Height() const { return m_header.height; }
+    size_t FrameCount() const { return m_frames.size(); }
+    uint64_t FrameIndex(size_t position) const { return m_frames[position].frameIndex; }
+    int64_t Timestamp(size_t position) const { return m_frames[position].timestamp; }
+    bool Keyframe(size_t position) const { return (m_frames[position].flags & CircularRecordingDetail::kFlagKeyframe) != 0; }
+
+    // The encoded frame, in place in the mapping
+    const uint8_t* Payload(size_t position, size_t& size) const {
+        const CircularRecordingDetail::RingEntry& entry = m_frames[position];
+        size = entry.size;
+        return m_map.Data() + CircularRecordingDetail::DataOffset(m_header.indexEntries) + entry.offset;
+    }
+
+    // Whether the writer has not started overwriting 'position' since Refresh()
+    bool StillHeld(size_t position) const {
+        CircularRecordingDetail::RingHeader live;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return CircularRecordingDetail::NewestHeader(m_map.Data(), live) && live.firstSeq <= m_frames[position].seq;
+    }
+
+    // Decodes the next frame into tightly packed BGRA; false at the end, or if the writer
+    // overtook the reader (Refresh() and start again)
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        if (m_next >= m_frames.size()) return false;
+        size_t size;
+        const uint8_t* payload = Payload(m_next, size);
+        pixels.resize(static_cast<size_t>(m_header.width) * m_header.height * 4);
+        if (!m_decoder.Decode(payload, size, m_header.width, m_header.height, pixels.data(), static_cast<size_t>(m_header.width) * 4) ||
+            !StillHeld(m_next)) {
+            return false;
+        }
+        info.frameIndex = m_frames[m_next].frameIndex;
+        info.timestamp = m_frames[m_next].timestamp;
+        m_next++;
+        return true;
+    }
+
+    // The next ReadFrame() returns 'position'; decoding restarts at the keyframe before it
+    bool Seek(size_t position) {
+        if (position > m_frames.size()) return false;
+        size_t start = position;
+        while (start > 0 && !Keyframe(start)) start--;
+        m_decoder.Reset();
+        for (size_t i = start; i < position; ++i) {
+            size_t size;
+            const uint8_t* payload = Payload(i, size);
+            if (!m_decoder.Decode(payload, size, m_header.width, m_header.height, nullptr, 0)) return false;
+        }
+        m_next = position;
+        return true;
+    }
+
+private:
+    CircularRecordingDetail::MappedFile m_map;
+    CircularRecordingDetail::RingHeader m_header;
+    std::vector<CircularRecordingDetail::RingEntry> m_frames;
+    ScreenDeltaDecoder m_decoder;
+    size_t m_next = 0;
+};
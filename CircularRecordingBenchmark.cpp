@@ -0,0 +1,315 @@
+// Checks and times CircularRecording. Synthetic typing at 60 fps goes into ring files small
+// enough to wrap many times, bound by data bytes and by index entries; the file must keep
+// its size, start on a keyframe and decode back to exactly the newest frames. The writer is
+// then reopened and must continue the same ring. Crashes are faked by rolling back and
+// tearing the header slots and a payload, and a reader maps the file while a writer laps
+// it. Last, the per-frame cost of the ring against the bare delta encode.
+// Passes if every check holds and the ring adds under 10% to the encode.
+// Usage: CircularRecordingBenchmark [frames]
+#include "CircularRecording.h"
+#include "SyntheticFrameSource.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+const double kFps = 60.0;
+const int64_t kTicksPerFrame = static_cast<int64_t>(1e9 / kFps);
+
+struct RingFeed {
+    SyntheticFrameSource source;
+    std::vector<uint8_t> pixels;
+    uint64_t next = 0;
+
+    RingFeed(uint32_t width, uint32_t height) : source(width, height, SyntheticPattern::Typing), pixels(source.FrameBytes()) {}
+
+    ImageView Render(uint64_t index) {
+        source.RenderFrame(pixels.data(), index);
+        return ImageView(pixels.data(), source.Width(), source.Height(), source.RowPitch());
+    }
+
+    bool Add(CircularRecordingWriter& ring) {
+        ScreenStreamFrameInfo info;
+        info.frameIndex = next;
+        info.timestamp = static_cast<int64_t>(next) * kTicksPerFrame;
+        ImageView view = Render(next++);
+        return ring.WriteFrame(view, info);
+    }
+};
+
+uint64_t FileBytes(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? static_cast<uint64_t>(file.tellg()) : 0;
+}
+
+// Every frame the reader holds decodes to a fresh render of its index, and together they
+// are the 'frames' newest ones ending at 'last'
+bool CheckFrames(const std::string& path, RingFeed& feed, uint64_t frames, uint64_t last, const std::string& label) {
+    CircularRecordingReader reader;
+    if (!reader.Open(path) || reader.FrameCount() != frames || frames == 0) {
+        std::cerr << label << ": reader sees " << reader.FrameCount() << " frames, expected " << frames << std::endl;
+        return false;
+    }
+    if (!reader.Keyframe(0) || reader.FrameIndex(frames - 1) != last) {
+        std::cerr << label << ": ring does not start on a keyframe or end on frame " << last << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> pixels;
+    ScreenStreamFrameInfo info;
+    for (uint64_t i = 0; i < frames; ++i) {
+        if (!reader.ReadFrame(pixels, info) || info.frameIndex != last + 1 - frames + i) {
+            std::cerr << label << ": frame " << i << " of the ring does not decode in order" << std::endl;
+            return false;
+        }
+        ImageView expected = feed.Render(info.frameIndex);
+        if (info.timestamp != static_cast<int64_t>(info.frameIndex) * kTicksPerFrame || !std::equal(pixels.begin(), pixels.end(), expected.data)) {
+            std::cerr << label << ": frame " << info.frameIndex << " differs from what was captured" << std::endl;
+            return false;
+        }
+    }
+    // Random access lands on the same pixels
+    size_t middle = static_cast<size_t>(frames / 2);
+    if (!reader.Seek(middle) || !reader.ReadFrame(pixels, info) || info.frameIndex != reader.FrameIndex(middle) ||
+        !std::equal(pixels.begin(), pixels.end(), feed.Render(info.frameIndex).data)) {
+        std::cerr << label << ": seek to frame " << middle << " decodes wrong" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool VerifyWrap() {
+    const uint32_t w = 480, h = 270;
+    const std::string path = "ring_check.sring";
+    struct Case {
+        const char* label;
+        uint64_t fileBytes;
+        uint32_t indexEntries;
+    };
+    const Case cases[] = {
+        { "byte-bound", 2 << 20, 4096 },
+        { "index-bound", 64 << 20, 100 },
+    };
+    for (const Case& c : cases) {
+        std::remove(path.c_str());
+        CircularRecordingOptions options;
+        options.fileBytes = c.fileBytes;
+        options.indexEntries = c.indexEntries;
+        options.keyframeInterval = 30;
+        CircularRecordingWriter ring;
+        RingFeed feed(w, h);
+        if (!ring.Open(path, w, h, options)) return false;
+        for (int i = 0; i < 900; ++i) feed.Add(ring);
+        CircularRecordingStats stats = ring.Stats();
+        std::cout << "  " << std::left << std::setw(12) << c.label << std::right << std::setw(5) << stats.frames << " frames, " << std::setw(8)
+                  << std::fixed << std::setprecision(1) << stats.bytes / 1024.0 << " KB held in a " << stats.fileBytes / 1024 << " KB file, "
+                  << stats.evicted << " overwritten, " << stats.laps << " laps" << std::endl;
+        if (stats.fileBytes != c.fileBytes || FileBytes(path) != c.fileBytes || stats.evicted == 0 || stats.dropped != 0 ||
+            stats.frames > c.indexEntries || (c.indexEntries > 1000 && stats.laps == 0)) {
+            std::cerr << c.label << ": ring left its bounds" << std::endl;
+            return false;
+        }
+        if (!CheckFrames(path, feed, stats.frames, feed.next - 1, c.label)) return false;
+
+        // Reopening continues the ring: same file, same frames, then more of them
+        ring.Close();
+        if (!ring.Open(path, w, h, options) || !ring.Stats().resumed || ring.Stats().frames != stats.frames) {
+            std::cerr << c.label << ": reopening did not continue the ring" << std::endl;
+            return false;
+        }
+        for (int i = 0; i < 100; ++i) feed.Add(ring);
+        stats = ring.Stats();
+        ring.Close();
+        if (FileBytes(path) != c.fileBytes || !CheckFrames(path, feed, stats.frames, feed.next - 1, std::string(c.label) + " resumed")) return false;
+    }
+    std::remove(path.c_str());
+    return true;
+}
+
+// Reads, edits and writes back bytes of a closed ring file
+struct RingFileBytes {
+    std::string path;
+    std::vector<uint8_t> bytes;
+
+    explicit RingFileBytes(const std::string& p) : path(p) {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    void Save() {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+};
+
+// A crash between copying frames and publishing the header that counts them: the reader
+// must recover them from their entries, stop at a torn payload, and survive a torn header
+bool VerifyRecovery() {
+    using namespace CircularRecordingDetail;
+    const uint32_t w = 480, h = 270;
+    const std::string path = "ring_crash.sring";
+    std::remove(path.c_str());
+    CircularRecordingOptions options;
+    options.fileBytes = 4 << 20;
+    options.indexEntries = 1024;
+    options.keyframeInterval = 30;
+    CircularRecordingWriter ring;
+    RingFeed feed(w, h);
+    if (!ring.Open(path, w, h, options)) return false;
+    for (int i = 0; i < 500; ++i) feed.Add(ring);
+    CircularRecordingStats stats = ring.Stats();
+    ring.Close();
+    const uint64_t last = feed.next - 1;
+
+    // Roll the newest header back 5 frames, as if the process died before publishing them
+    RingFileBytes file(path);
+    RingHeader header;
+    if (!NewestHeader(file.bytes.data(), header)) return false;
+    uint8_t* newest = file.bytes.data() + (header.headerSeq & 1) * kHeaderSlotBytes;
+    RingHeader rolledBack = header;
+    rolledBack.nextSeq -= 5;
+    PutHeader(newest, rolledBack);
+    file.Save();
+    if (!CheckFrames(path, feed, stats.frames, last, "unpublished frames")) return false;
+
+    // Tear the last of those payloads: recovery stops before it
+    RingEntry torn;
+    GetEntry(file.bytes.data() + IndexOffset() + ((header.nextSeq - 1) % header.indexEntries) * kEntryBytes, torn);
+    file.bytes[DataOffset(header.indexEntries) + torn.offset + torn.size / 2] ^= 0x5a;
+    file.Save();
+    if (!CheckFrames(path, feed, stats.frames - 1, last - 1, "torn payload")) return false;
+
+    // Tear the newest header: the reader falls back to the other slot and recovers from there
+    newest[20] ^= 0xff;
+    file.Save();
+    if (!CheckFrames(path, feed, stats.frames - 1, last - 1, "torn header")) return false;
+
+    // The writer continues after the last frame that checks out
+    if (!ring.Open(path, w, h, options) || !ring.Stats().resumed || ring.Stats().frames != stats.frames - 1) {
+        std::cerr << "writer did not recover the ring" << std::endl;
+        return false;
+    }
+    feed.next = last;
+    for (int i = 0; i < 40; ++i) feed.Add(ring);
+    stats = ring.Stats();
+    ring.Close();
+    if (!CheckFrames(path, feed, stats.frames, feed.next - 1, "recovered and continued")) return false;
+    std::remove(path.c_str());
+    std::cout << "  recovery    unpublished frames picked up, torn payload and torn header skipped, writer continues" << std::endl;
+    return true;
+}
+
+// A reader maps the file while a writer laps it; every frame it manages to read is exact
+bool VerifyLiveReader() {
+    const uint32_t w = 480, h = 270;
+    const std::string path = "ring_live.sring";
+    std::remove(path.c_str());
+    CircularRecordingOptions options;
+    options.fileBytes = 1 << 20;
+    options.keyframeInterval = 30;
+    CircularRecordingWriter ring;
+    RingFeed feed(w, h);
+    if (!ring.Open(path, w, h, options)) return false;
+    for (int i = 0; i < 60; ++i) feed.Add(ring);
+
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int i = 0; i < 1500; ++i) {
+            feed.Add(ring);
+            if (i % 16 == 0) std::this_thread::yield();
+        }
+        done = true;
+    });
+    RingFeed check(w, h);
+    CircularRecordingReader reader;
+    bool exact = reader.Open(path);
+    uint64_t read = 0, overtaken = 0, refreshes = 0;
+    std::vector<uint8_t> pixels;
+    ScreenStreamFrameInfo info;
+    while (exact && !done) {
+        reader.Refresh();
+        refreshes++;
+        while (reader.ReadFrame(pixels, info)) {
+            if (!std::equal(pixels.begin(), pixels.end(), check.Render(info.frameIndex).data)) {
+                std::cerr << "live reader: frame " << info.frameIndex << " differs from what was captured" << std::endl;
+                exact = false;
+                break;
+            }
+            read++;
+        }
+        if (reader.FrameCount() && reader.FrameIndex(reader.FrameCount() - 1) != info.frameIndex) overtaken++;
+    }
+    writer.join();
+    ring.Close();
+    std::remove(path.c_str());
+    std::cout << "  live reader " << read << " frames read exactly over " << refreshes << " refreshes, overtaken by the writer " << overtaken
+              << " times" << std::endl;
+    return exact && read > 0;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::stoi(argv[1]) : 240;
+
+    std::cout << "Rings (typing at 60 fps, keyframe every 30)" << std::endl;
+    if (!VerifyWrap() || !VerifyRecovery() || !VerifyLiveReader()) {
+        std::cout << "FAIL: circular recording is wrong" << std::endl;
+        return 1;
+    }
+    std::cout << "Files keep their size, decode exactly, resume and recover after a crash" << std::endl;
+
+    // Steady state at one 2560x1440 half: the encode against encode + ring
+    const uint32_t w = 2560, h = 1440;
+    const std::string path = "ring_bench.sring";
+    RingFeed feed(w, h);
+    std::vector<std::vector<uint8_t>> rendered;
+    for (int i = 0; i < 8; ++i) {
+        feed.Render(i);
+        rendered.push_back(feed.pixels);
+    }
+    CircularRecordingWriter ring;
+    CircularRecordingOptions options;
+    options.fileBytes = 256 << 20;
+    std::remove(path.c_str());
+    if (!ring.Open(path, w, h, options)) {
+        std::cout << "FAIL: could not map " << path << std::endl;
+        return 1;
+    }
+    auto time = [&](bool toRing) {
+        ScreenDeltaEncoder encoder(options.keyframeInterval);
+        std::vector<uint8_t> out;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            ImageView view(rendered[i % rendered.size()].data(), w, h, w * 4);
+            ScreenStreamFrameInfo info;
+            info.frameIndex = i;
+            info.timestamp = i * kTicksPerFrame;
+            if (toRing) {
+                ring.WriteFrame(view, info);
+            }
+            else {
+                out.clear();
+                encoder.Encode(view, out);
+            }
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    };
+    time(true);
+    double encodeMs = 1e9, ringMs = 1e9;
+    for (int round = 0; round < 3; ++round) {
+        encodeMs = std::min(encodeMs, time(false));
+        ringMs = std::min(ringMs, time(true));
+    }
+    CircularRecordingStats stats = ring.Stats();
+    ring.Close();
+    bool sized = FileBytes(path) == options.fileBytes;
+    std::remove(path.c_str());
+    double overhead = (ringMs - encodeMs) / encodeMs;
+    std::cout << std::setprecision(3) << w << "x" << h << ": encode " << encodeMs << " ms/frame, encode + ring " << ringMs << " ms/frame ("
+              << std::setprecision(1) << overhead * 100.0 << "%), " << stats.added << " frames into a constant "
+              << options.fileBytes / (1024 * 1024) << " MB file" << std::endl;
+    bool pass = sized && overhead < 0.10;
+    std::cout << (pass ? "PASS" : "FAIL") << ": rings are exact and add " << overhead * 100.0 << "% to the encode (under 10% needed)" << std::endl;
+    return pass ? 0 : 1;
+}
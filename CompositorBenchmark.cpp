@@ -0,0 +1,155 @@
+// Checks and times SoftwareCompositor, the CPU version of RenderTextures.
+// Draws are compared with a double-precision model of the shader (texel-centre sampling,
+// bilinear, wrap addressing): every output channel must be within 0.5 of it when its weights
+// are rounded to 8 bits as D3D11 filtering does, and within 1.5 of the unrounded model
+// (an 8-bit weight moves a sample up to 1/512 texel per axis). Every kernel
+// level must produce the same bytes, threaded bands must match a single thread, and a
+// same-size draw must be an exact copy. Memory outputs must show the last presented frame,
+// and PNG outputs must read back exactly. Then a 5120x1440 synthetic desktop is split in two
+// and composed onto two outputs per frame, at the tile size and scaled to 1920x1080, per level.
+// Usage: CompositorBenchmark [frames] [outputWidth] [outputHeight]
+#include "PngReader.h"
+#include "SoftwareCompositor.h"
+#include "SyntheticFrameSource.h"
+#include "TileLayout.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The shader's sample of channel k at output pixel (x, y) of a width x height target,
+// optionally with weights rounded to 8 bits
+double ReferenceSample(const ImageView& source, uint32_t x, uint32_t y, uint32_t width, uint32_t height, int k, bool quantized) {
+    double u = (x + 0.5) / width * source.width - 0.5, v = (y + 0.5) / height * source.height - 0.5;
+    double fu = std::floor(u), fv = std::floor(v);
+    auto wrap = [](int64_t i, uint32_t n) { return static_cast<uint32_t>(((i % n) + n) % n); };
+    uint32_t x0 = wrap(static_cast<int64_t>(fu), source.width), x1 = wrap(static_cast<int64_t>(fu) + 1, source.width);
+    uint32_t y0 = wrap(static_cast<int64_t>(fv), source.height), y1 = wrap(static_cast<int64_t>(fv) + 1, source.height);
+    double ax = u - fu, ay = v - fv;
+    if (quantized) {
+        ax = std::round(ax * 256.0) / 256.0;
+        ay = std::round(ay * 256.0) / 256.0;
+    }
+    double top = source.Pixel(x0, y0)[k] * (1 - ax) + source.Pixel(x1, y0)[k] * ax;
+    double bottom = source.Pixel(x0, y1)[k] * (1 - ax) + source.Pixel(x1, y1)[k] * ax;
+    return top * (1 - ay) + bottom * ay;
+}
+
+struct DrawCheck {
+    double maxError = 0.0;          // Against the unrounded model
+    double maxQuantizedError = 0.0; // Against 8-bit weights
+    bool levelsMatch = true;
+    bool threadsMatch = true;
+};
+
+// Draws 'source' to width x height at every level, single-threaded and banded
+DrawCheck CheckDraw(const ImageView& source, uint32_t width, uint32_t height, ThreadPool& pool) {
+    DrawCheck check;
+    const size_t pitch = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> scalar(pitch * height), other(pitch * height);
+    SoftwareCompositor(nullptr, PixelKernelLevel::Scalar).DrawFullScreenQuad(source, scalar.data(), width, height, pitch);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            for (int k = 0; k < 4; ++k) {
+                double value = scalar[y * pitch + x * 4 + k];
+                check.maxError = std::max(check.maxError, std::fabs(value - ReferenceSample(source, x, y, width, height, k, false)));
+                check.maxQuantizedError = std::max(check.maxQuantizedError, std::fabs(value - ReferenceSample(source, x, y, width, height, k, true)));
+            }
+        }
+    }
+    for (PixelKernelLevel level : { PixelKernelLevel::Sse2, PixelKernelLevel::Avx2 }) {
+        if (!PixelKernelLevelSupported(level)) continue;
+        SoftwareCompositor(nullptr, level).DrawFullScreenQuad(source, other.data(), width, height, pitch);
+        check.levelsMatch = check.levelsMatch && other == scalar;
+    }
+    // Odd band height so bands do not line up with anything
+    SoftwareCompositor(&pool, BestPixelKernelLevel(), 7).DrawFullScreenQuad(source, other.data(), width, height, pitch);
+    check.threadsMatch = other == scalar;
+    return check;
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::stoi(argv[1]) : 60;
+    uint32_t scaledWidth = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1920;
+    uint32_t scaledHeight = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 1080;
+    ThreadPool pool;
+    bool ok = true;
+
+    // Sampling against the shader model: up, down, non-integer and same-size draws
+    SyntheticFrameSource tileSource(333, 187, SyntheticPattern::Video);
+    std::vector<uint8_t> tilePixels(tileSource.FrameBytes());
+    tileSource.RenderFrame(tilePixels.data(), 7);
+    // Random alpha too, so all four channels are exercised
+    for (size_t i = 3; i < tilePixels.size(); i += 4) tilePixels[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+    const ImageView tile(tilePixels.data(), tileSource.Width(), tileSource.Height(), tileSource.RowPitch());
+    const uint32_t sizes[][2] = { { 333, 187 }, { 640, 360 }, { 1000, 561 }, { 160, 90 }, { 97, 301 }, { 3, 2 } };
+    std::cout << "level " << PixelKernelLevelName(BestPixelKernelLevel()) << ", " << pool.Concurrency() << " threads" << std::endl;
+    for (const auto& size : sizes) {
+        DrawCheck check = CheckDraw(tile, size[0], size[1], pool);
+        bool same = size[0] == tile.width && size[1] == tile.height;
+        bool good = check.levelsMatch && check.threadsMatch && check.maxQuantizedError <= (same ? 1e-6 : 0.5 + 1e-6) &&
+                    check.maxError <= (same ? 1e-6 : 1.5);
+        std::cout << "333x187 -> " << std::left << std::setw(10) << (std::to_string(size[0]) + "x" + std::to_string(size[1]))
+                  << std::fixed << std::setprecision(3) << " max error " << check.maxError << ", with 8-bit weights "
+                  << check.maxQuantizedError << (check.levelsMatch ? "" : ", levels differ") << (check.threadsMatch ? "" : ", bands differ")
+                  << (good ? "  ok" : "  WRONG") << std::endl;
+        ok = ok && good;
+    }
+
+    // Outputs: memory keeps the last presented frame; PNG files read back exactly
+    {
+        SoftwareCompositor compositor(&pool);
+        MemoryCompositorOutput memory(200, 120);
+        FileCompositorOutput file(200, 120, &pool);
+        bool outputs = file.Open("compositor_check", CompositorFileFormat::Png);
+        std::vector<CompositorOutput*> targets = { &memory, &file };
+        for (uint64_t frame = 0; frame < 3 && outputs; ++frame) {
+            tileSource.RenderFrame(tilePixels.data(), frame);
+            outputs = compositor.Compose({ tile, tile }, targets, frame);
+        }
+        outputs = file.Close() && outputs && memory.Presented() == 3 && memory.FrontFrame() == 2;
+        std::vector<uint8_t> expected(200 * 120 * 4), png;
+        compositor.DrawFullScreenQuad(tile, expected.data(), 200, 120, 800);
+        uint32_t w = 0, h = 0;
+        const ImageView front = memory.Front();
+        outputs = outputs && std::memcmp(front.data, expected.data(), expected.size()) == 0 &&
+                  ReadPngFile("compositor_check_frame_2.png", png, w, h) && w == 200 && h == 120 && png == expected;
+        std::cout << "memory and png outputs  " << (outputs ? "ok" : "WRONG") << std::endl;
+        ok = ok && outputs;
+    }
+
+    // RenderTextures at desktop scale: two 2560x1440 halves onto two outputs each frame
+    SyntheticFrameSource desktop(5120, 1440, SyntheticPattern::Video);
+    std::vector<uint8_t> desktopPixels(desktop.FrameBytes());
+    TileLayout layout;
+    BuildTileLayout(desktop.Width(), desktop.Height(), TileLayoutConfig(), layout);
+    std::vector<ImageView> tiles;
+    desktop.RenderFrame(desktopPixels.data(), 0);
+    BuildTileViews(ImageView(desktopPixels.data(), desktop.Width(), desktop.Height(), desktop.RowPitch()), layout, tiles);
+    for (bool scaled : { false, true }) {
+        uint32_t w = scaled ? scaledWidth : layout.tileWidth, h = scaled ? scaledHeight : layout.tileHeight;
+        for (PixelKernelLevel level : { PixelKernelLevel::Scalar, PixelKernelLevel::Avx2 }) {
+            if (!PixelKernelLevelSupported(level) || (!scaled && level != PixelKernelLevel::Scalar)) continue;
+            SoftwareCompositor compositor(&pool, level);
+            MemoryCompositorOutput left(w, h), right(w, h);
+            std::vector<CompositorOutput*> outputs = { &left, &right };
+            compositor.Compose(tiles, outputs, 0);      // Warm up taps and band buffers
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; ++i) compositor.Compose(tiles, outputs, i);
+            double ms = MsSince(start) / frames;
+            std::cout << "2x " << layout.tileWidth << "x" << layout.tileHeight << " -> " << w << "x" << h << " "
+                      << std::setw(7) << (scaled ? PixelKernelLevelName(level) : "copy") << std::setprecision(2) << ms
+                      << " ms/frame, " << std::setprecision(0) << 1000.0 / ms << " fps" << std::endl;
+        }
+    }
+
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
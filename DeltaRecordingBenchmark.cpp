@@ -0,0 +1,190 @@
+// Records synthetic 2560x1440 halves into .srec delta recordings and compares the storage
+// with the PNG-per-frame sequence the recorder used to write (PNG sizes are sampled every
+// 30th frame). Every recording is read back in full and at random seek targets and must
+// match the source frames exactly; a copy cut short without its index must still open.
+// Passes if typical desktop content (the typing pattern) is at least 10x smaller than PNGs.
+// Usage: DeltaRecordingBenchmark [frames] [keyframeInterval]
+#include "PngWriter.h"
+#include "ScreenRecording.h"
+#include "SyntheticFrameSource.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+const uint32_t kWidth = 2560;
+const uint32_t kHeight = 1440;
+const double kFps = 60.0;
+
+struct RecordingRun {
+    std::string pattern;
+    uint64_t bytes = 0;
+    uint64_t keyframes = 0;
+    double pngBytesPerFrame = 0.0;
+    double encodeMsPerFrame = 0.0;
+    double decodeMsPerFrame = 0.0;
+    bool verified = false;
+};
+
+bool FramesEqual(const std::vector<uint8_t>& decoded, const std::vector<uint8_t>& expected) {
+    return decoded.size() == expected.size() && std::memcmp(decoded.data(), expected.data(), expected.size()) == 0;
+}
+
+// Sequential playback, then random seeks, both against freshly rendered frames
+bool VerifyRecording(const std::string& path, SyntheticFrameSource& source, uint64_t frames, RecordingRun& run) {
+    ScreenRecordingReader reader;
+    if (!reader.Open(path) || reader.FrameCount() != frames || reader.IndexRecovered()) {
+        std::cerr << path << ": index missing or wrong" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> expected(source.FrameBytes()), decoded;
+    ScreenStreamFrameInfo info;
+    double decodeMs = 0.0;
+    for (uint64_t i = 0; i < frames; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = reader.ReadFrame(decoded, info);
+        decodeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        source.RenderFrame(expected.data(), i);
+        if (!ok || info.frameIndex != i || !FramesEqual(decoded, expected)) {
+            std::cerr << path << ": frame " << i << " does not match" << std::endl;
+            return false;
+        }
+    }
+    run.decodeMsPerFrame = decodeMs / frames;
+
+    std::mt19937 rng(5);
+    for (int i = 0; i < 20; ++i) {
+        uint64_t target = rng() % frames;
+        source.RenderFrame(expected.data(), target);
+        if (!reader.Seek(static_cast<size_t>(target)) || !reader.ReadFrame(decoded, info) || info.frameIndex != target || !FramesEqual(decoded, expected)) {
+            std::cerr << path << ": seek to " << target << " failed" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// A recording whose writer died mid-frame: no index, last record torn
+bool VerifyRecovery(const std::string& path, uint64_t frames) {
+    uint64_t cut = 0;
+    {
+        ScreenRecordingReader indexed;
+        if (!indexed.Open(path) || indexed.FrameCount() < 2) return false;
+        const ScreenRecordingEntry& last = indexed.Entry(indexed.FrameCount() - 1);
+        cut = last.offset + 20 + last.payloadSize / 2;
+    }
+
+    std::string tornPath = path + ".torn";
+    std::FILE* in = std::fopen(path.c_str(), "rb");
+    std::FILE* out = std::fopen(tornPath.c_str(), "wb");
+    bool ok = in && out;
+    std::vector<uint8_t> buffer(1 << 20);
+    while (ok && cut > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(cut, buffer.size()));
+        ok = std::fread(buffer.data(), 1, chunk, in) == chunk && std::fwrite(buffer.data(), 1, chunk, out) == chunk;
+        cut -= chunk;
+    }
+    if (in) std::fclose(in);
+    if (out) std::fclose(out);
+
+    ScreenRecordingReader reader;
+    ok = ok && reader.Open(tornPath) && reader.IndexRecovered() && reader.FrameCount() == frames - 1;
+    std::vector<uint8_t> decoded;
+    ScreenStreamFrameInfo info;
+    while (ok && reader.ReadFrame(decoded, info)) {}
+    ok = ok && reader.Position() == frames - 1;
+    reader.Close();
+    std::remove(tornPath.c_str());
+    return ok;
+}
+
+bool RecordPattern(const char* name, SyntheticPattern pattern, uint64_t frames, uint32_t keyframeInterval, RecordingRun& run) {
+    run.pattern = name;
+    std::string path = std::string("recording_") + name + ".srec";
+    SyntheticFrameSource source(kWidth, kHeight, pattern);
+    std::vector<uint8_t> frame(source.FrameBytes()), previous;
+    std::vector<uint8_t> png;
+    uint64_t pngBytes = 0, pngSamples = 0;
+    double encodeMs = 0.0;
+
+    {
+        ScreenRecordingWriter writer;
+        if (!writer.Open(path, kWidth, kHeight, keyframeInterval)) {
+            std::cerr << "Failed to open " << path << std::endl;
+            return false;
+        }
+        for (uint64_t i = 0; i < frames; ++i) {
+            source.RenderFrame(frame.data(), i);
+            ImageView view(frame.data(), kWidth, kHeight, source.RowPitch());
+            ScreenStreamFrameInfo info;
+            info.frameIndex = i;
+            info.timestamp = static_cast<int64_t>(i * 1e9 / kFps);
+            // Stand-in for the recorder's dirty rects: a frame known to be unchanged is repeated unread
+            bool unchanged = previous == frame;
+            auto start = std::chrono::steady_clock::now();
+            bool ok = unchanged && writer.CanRepeatFrame() ? writer.WriteRepeatedFrame(info) : writer.WriteFrame(view, info);
+            encodeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!ok) {
+                std::cerr << "Failed to append frame " << i << " to " << path << std::endl;
+                return false;
+            }
+            previous = frame;
+            if (i % 30 == 0) {
+                EncodePng(frame.data(), kWidth, kHeight, source.RowPitch(), png);
+                pngBytes += png.size();
+                pngSamples++;
+            }
+        }
+        run.keyframes = writer.Keyframes();
+        if (!writer.Close()) return false;
+        run.bytes = writer.Bytes();
+    }
+    run.pngBytesPerFrame = static_cast<double>(pngBytes) / pngSamples;
+    run.encodeMsPerFrame = encodeMs / frames;
+    run.verified = VerifyRecording(path, source, frames, run) && VerifyRecovery(path, frames);
+    std::remove(path.c_str());
+    return run.verified;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 300;
+    uint32_t keyframeInterval = argc > 2 ? std::stoul(argv[2]) : 120;
+    if (frames < 2) frames = 2;
+
+    const std::pair<const char*, SyntheticPattern> patterns[] = {
+        { "typing", SyntheticPattern::Typing },
+        { "static", SyntheticPattern::Static },
+        { "scroll", SyntheticPattern::ScrollingText },
+    };
+
+    std::cout << kWidth << "x" << kHeight << " half, " << frames << " frames, keyframe every " << keyframeInterval
+              << ", per hour at " << kFps << " fps" << std::endl;
+    std::cout << std::left << std::setw(8) << "pattern" << std::right << std::setw(12) << "srec GB/h" << std::setw(12) << "PNG GB/h"
+              << std::setw(10) << "smaller" << std::setw(11) << "enc ms" << std::setw(11) << "dec ms" << std::setw(7) << "keys" << std::endl;
+
+    bool pass = true;
+    for (const auto& pattern : patterns) {
+        RecordingRun run;
+        if (!RecordPattern(pattern.first, pattern.second, frames, keyframeInterval, run)) {
+            std::cout << pattern.first << ": round trip FAILED" << std::endl;
+            pass = false;
+            continue;
+        }
+        const double framesPerHour = kFps * 3600.0;
+        double srecPerHour = static_cast<double>(run.bytes) / frames * framesPerHour / 1e9;
+        double pngPerHour = run.pngBytesPerFrame * framesPerHour / 1e9;
+        double ratio = pngPerHour / srecPerHour;
+        std::cout << std::left << std::setw(8) << run.pattern << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << srecPerHour << std::setw(12) << pngPerHour << std::setprecision(1) << std::setw(9) << ratio << "x"
+                  << std::setprecision(2) << std::setw(11) << run.encodeMsPerFrame << std::setw(11) << run.decodeMsPerFrame
+                  << std::setw(7) << run.keyframes << std::endl;
+        if (pattern.second == SyntheticPattern::Typing && ratio < 10.0) pass = false;
+    }
+
+    std::cout << (pass ? "PASS" : "FAIL") << ": recordings round-trip and typical desktop content is "
+              << (pass ? "at least" : "less than") << " 10x smaller than PNGs" << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+#pragma once
+// Dirty/move rect clipping and merging for incremental capture.
+// Kept free of Windows headers so recorded rect streams can be replayed on any box.
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Same field order as the Win32 RECT returned by GetFrameDirtyRects
+struct DirtyRect {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+// Mirrors DXGI_OUTDUPL_MOVE_RECT: content at (sourceX, sourceY) moved to destination
+struct MoveRect {
+    int32_t sourceX;
+    int32_t sourceY;
+    DirtyRect destination;
+};
+
+// One frame worth of update metadata, as read back from a recorded rect stream
+struct RectFrame {
+    uint64_t frameIndex = 0;
+    std::vector<DirtyRect> dirtyRects;
+    std::vector<MoveRect> moveRects;
+};
+
+// Running totals so incremental and full copies can be compared
+struct IncrementalStats {
+    uint64_t frames = 0;
+    uint64_t skippedFrames = 0;    // Frames with no update in any region
+    uint64_t copiedRegions = 0;    // Number of CopySubresourceRegion calls
+    uint64_t fullBytes = 0;        // Bytes a full split copy would have moved
+    uint64_t copiedBytes = 0;      // Bytes the incremental copy actually moved
+};
+
+inline bool RectIsEmpty(const DirtyRect& r) {
+    return r.right <= r.left || r.bottom <= r.top;
+}
+
+inline int64_t RectArea(const DirtyRect& r) {
+    if (RectIsEmpty(r)) return 0;
+    return static_cast<int64_t>(r.right - r.left) * (r.bottom - r.top);
+}
+
+inline DirtyRect RectIntersection(const DirtyRect& a, const DirtyRect& b) {
+    return { std::max(a.left, b.left), std::max(a.top, b.top),
+             std::min(a.right, b.right), std::min(a.bottom, b.bottom) };
+}
+
+inline DirtyRect RectUnion(const DirtyRect& a, const DirtyRect& b) {
+    return { std::min(a.left, b.left), std::min(a.top, b.top),
+             std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+}
+
+// True if the rects overlap or are within 'distance' pixels of each other
+inline bool RectsNear(const DirtyRect& a, const DirtyRect& b, int32_t distance) {
+    return a.left <= b.right + distance && b.left <= a.right + distance &&
+           a.top <= b.bottom + distance && b.top <= a.bottom + distance;
+}
+
+// Clip rects against a region of the desktop (e.g. the left half) and translate
+// them into that region's local coordinates, ready to be used as copy destinations.
+inline void ClipRectsToRegion(const std::vector<DirtyRect>& rects, const DirtyRect& region, std::vector<DirtyRect>& out) {
+    out.clear();
+    for (const DirtyRect& r : rects) {
+        DirtyRect clipped = RectIntersection(r, region);
+        if (RectIsEmpty(clipped)) continue;
+        out.push_back({ clipped.left - region.left, clipped.top - region.top,
+                        clipped.right - region.left, clipped.bottom - region.top });
+    }
+}
+
+// Coalesce rects that overlap or sit within mergeDistance pixels of each other, then
+// keep merging the cheapest pair until at most maxRects remain. Fewer, slightly
+// larger copies are cheaper than many tiny CopySubresourceRegion calls.
+inline void MergeRects(std::vector<DirtyRect>& rects, int32_t mergeDistance = 16, size_t maxRects = 8) {
+    rects.erase(std::remove_if(rects.begin(), rects.end(), RectIsEmpty), rects.end());
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                if (RectsNear(rects[i], rects[j], mergeDistance)) {
+                    rects[i] = RectUnion(rects[i], rects[j]);
+                    rects.erase(rects.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    while (maxRects > 0 && rects.size() > maxRects) {
+        size_t bestI = 0, bestJ = 1;
+        int64_t bestGrowth = INT64_MAX;
+        for (size_t i = 0; i < rects.size(); ++i) {
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                int64_t growth = RectArea(RectUnion(rects[i], rects[j])) - RectArea(rects[i]) - RectArea(rects[j]);
+                if (growth < bestGrowth) {
+                    bestGrowth = growth;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        rects[bestI] = RectUnion(rects[bestI], rects[bestJ]);
+        rects.erase(rects.begin() + bestJ);
+    }
+
+    // Stable order keeps the copy and encode order deterministic between runs
+    std::sort(rects.begin(), rects.end(), [](const DirtyRect& a, const DirtyRect& b) {
+        return a.top != b.top ? a.top < b.top : a.left < b.left;
+    });
+}
+
+// Turn one frame's metadata into per-region copy lists (region-local coordinates).
+// The acquired desktop image already contains moved content, so a move rect only
+// needs its destination refreshed; the source area shows up as a dirty rect.
+inline void PlanIncrementalCopy(
+    const std::vector<DirtyRect>& dirtyRects,
+    const std::vector<MoveRect>& moveRects,
+    const DirtyRect* regions,
+    size_t regionCount,
+    std::vector<std::vector<DirtyRect>>& regionUpdates,
+    int32_t mergeDistance = 16,
+    size_t maxRectsPerRegion = 8
+) {
+    std::vector<DirtyRect> updated(dirtyRects);
+    for (const MoveRect& move : moveRects) {
+        updated.push_back(move.destination);
+    }
+
+    regionUpdates.resize(regionCount);
+    for (size_t i = 0; i < regionCount; ++i) {
+        ClipRectsToRegion(updated, regions[i], regionUpdates[i]);
+        MergeRects(regionUpdates[i], mergeDistance, maxRectsPerRegion);
+    }
+}
+
+inline void AccumulateIncrementalStats(
+    IncrementalStats& stats,
+    const DirtyRect* regions,
+    size_t regionCount,
+    const std::vector<std::vector<DirtyRect>>& regionUpdates,
+    uint32_t bytesPerPixel = 4
+) {
+    stats.frames++;
+    bool anyUpdate = false;
+    for (size_t i = 0; i < regionCount && i < regionUpdates.size(); ++i) {
+        stats.fullBytes += static_cast<uint64_t>(RectArea(regions[i])) * bytesPerPixel;
+        for (const DirtyRect& r : regionUpdates[i]) {
+            stats.copiedBytes += static_cast<uint64_t>(RectArea(r)) * bytesPerPixel;
+            stats.copiedRegions++;
+            anyUpdate = true;
+        }
+    }
+    if (!anyUpdate) stats.skippedFrames++;
+}
+
+// Rect stream format, one frame per line:
+//   F <frameIndex> [D <left> <top> <right> <bottom>]... [M <srcX> <srcY> <left> <top> <right> <bottom>]...
+inline void WriteRectFrame(std::ostream& out, const RectFrame& frame) {
+    out << "F " << frame.frameIndex;
+    for (const DirtyRect& r : frame.dirtyRects) {
+        out << " D " << r.left << ' ' << r.top << ' ' << r.right << ' ' << r.bottom;
+    }
+    for (const MoveRect& m : frame.moveRects) {
+        out << " M " << m.sourceX << ' ' << m.sourceY << ' '
+            << m.destination.left << ' ' << m.destination.top << ' '
+            << m.destination.right << ' ' << m.destination.bottom;
+    }
+    out << '\n';
+}
+
+// Returns false at end of stream or on a malformed line
+inline bool ReadRectFrame(std::istream& in, RectFrame& frame) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream tokens(line);
+        std::string tag;
+        if (!(tokens >> tag) || tag != "F" || !(tokens >> frame.frameIndex)) {
+            return false;
+        }
+        frame.dirtyRects.clear();
+        frame.moveRects.clear();
+        while (tokens >> tag) {
+            if (tag == "D") {
+                DirtyRect r;
+                if (!(tokens >> r.left >> r.top >> r.right >> r.bottom)) return false;
+                frame.dirtyRects.push_back(r);
+            }
+            else if (tag == "M") {
+                MoveRect m;
+                if (!(tokens >> m.sourceX >> m.sourceY >> m.destination.left >> m.destination.top
+                             >> m.destination.right >> m.destination.bottom)) return false;
+                frame.moveRects.push_back(m);
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
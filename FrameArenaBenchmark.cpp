@@ -0,0 +1,133 @@
+// Checks that steady-state capture makes no heap allocations once its buffers come from a
+// FrameArena. Global operator new is counted; after a warm-up, a loop of acquire ->
+// tile views -> flip/swizzle readback of each tile must not allocate at all.
+// Also times the same loop with a fresh std::vector per frame, as the save paths used to.
+// Usage: FrameArenaBenchmark [frames] [width height]
+#include "FrameArena.h"
+#include "PixelKernels.h"
+#include "SyntheticFrameSource.h"
+#include "TileLayout.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+std::atomic<uint64_t> g_heapAllocations{ 0 };
+
+// Every plain, array, sized and nothrow form is replaced, so whichever pair the compiler
+// picks allocates with malloc and frees with free. The free stays out of line: GCC inlines
+// the replaced deletes into std::allocator and would then report free() on memory from new.
+#ifdef _MSC_VER
+#define FRAME_ARENA_NOINLINE __declspec(noinline)
+#else
+#define FRAME_ARENA_NOINLINE __attribute__((noinline))
+#endif
+
+FRAME_ARENA_NOINLINE void CountedFree(void* p) noexcept { std::free(p); }
+
+void* CountedAllocate(size_t size) noexcept {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+    if (void* p = CountedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    if (void* p = CountedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAllocate(size); }
+
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+struct CaptureScratch {
+    std::vector<ImageView> tileViews;
+    uint64_t checksum = 0;
+};
+
+// One frame of the save path; tile buffers go back to the arena when 'tiles' is released
+void CaptureWithArena(SyntheticFrameSource& source, const TileLayout& layout, FrameArena& arena, CaptureScratch& scratch) {
+    FrameBuffer desktop = arena.Acquire();
+    SyntheticFrameInfo info;
+    source.AcquireNextFrame(desktop.Data(), info);
+
+    BuildTileViews(ImageView(desktop.Data(), source.Width(), source.Height(), source.RowPitch()), layout, scratch.tileViews);
+    PixelConvertOptions options;
+    options.flipVertical = true;
+    options.swapRedBlue = true;
+    for (const ImageView& view : scratch.tileViews) {
+        size_t rowBytes = ConvertedRowBytes(view.width, options);
+        FrameBuffer tile = arena.Acquire(rowBytes * view.height);
+        ConvertPixels(view, tile.Data(), rowBytes, options);
+        scratch.checksum += tile.Data()[tile.Size() / 2];
+    }
+}
+
+// The same with a new vector per buffer per frame
+void CaptureWithVectors(SyntheticFrameSource& source, const TileLayout& layout, CaptureScratch& scratch) {
+    std::vector<uint8_t> desktop(source.FrameBytes());
+    SyntheticFrameInfo info;
+    source.AcquireNextFrame(desktop.data(), info);
+
+    BuildTileViews(ImageView(desktop.data(), source.Width(), source.Height(), source.RowPitch()), layout, scratch.tileViews);
+    PixelConvertOptions options;
+    options.flipVertical = true;
+    options.swapRedBlue = true;
+    for (const ImageView& view : scratch.tileViews) {
+        size_t rowBytes = ConvertedRowBytes(view.width, options);
+        std::vector<uint8_t> tile(rowBytes * view.height);
+        ConvertPixels(view, tile.data(), rowBytes, options);
+        scratch.checksum += tile[tile.size() / 2];
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 120;
+    uint32_t width = argc > 3 ? std::stoul(argv[2]) : 5120;
+    uint32_t height = argc > 3 ? std::stoul(argv[3]) : 1440;
+
+    TileLayout layout;
+    if (!BuildTileLayout(width, height, TileLayoutConfig(), layout)) {
+        std::cerr << "Tile layout does not fit a " << width << "x" << height << " desktop." << std::endl;
+        return -1;
+    }
+    SyntheticFrameSource source(width, height, SyntheticPattern::ScrollingText);
+    FrameArena arena;
+    arena.SetFrameBytes(source.FrameBytes());
+    CaptureScratch scratch;
+
+    for (int i = 0; i < 3; ++i) CaptureWithArena(source, layout, arena, scratch);
+    FrameArenaStats warm = arena.Stats();
+
+    uint64_t heapBefore = g_heapAllocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < frames; ++i) CaptureWithArena(source, layout, arena, scratch);
+    double arenaMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+    uint64_t heapAllocations = g_heapAllocations.load() - heapBefore;
+    FrameArenaStats steady = arena.Stats();
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < frames; ++i) CaptureWithVectors(source, layout, scratch);
+    double vectorMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    std::cout << width << "x" << height << ", " << frames << " frames" << std::endl;
+    std::cout << "Arena:   " << arenaMs << " ms/frame, " << steady.bytesReserved / (1024 * 1024) << " MB reserved in "
+              << steady.systemAllocations << " blocks (" << steady.hugePageBlocks << " huge-page advised), "
+              << steady.reuses - warm.reuses << " reuses" << std::endl;
+    std::cout << "Vectors: " << vectorMs << " ms/frame" << std::endl;
+    std::cout << "Steady state: " << heapAllocations << " heap allocations, "
+              << steady.systemAllocations - warm.systemAllocations << " arena block allocations" << std::endl;
+
+    bool pass = heapAllocations == 0 && steady.systemAllocations == warm.systemAllocations && steady.outstanding == 0;
+    std::cout << (pass ? "PASS" : "FAIL") << ": steady-state capture " << (pass ? "makes no" : "still makes") << " heap allocations" << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+#pragma once
+// Target-rate frame pacing for the capture loops.
+// Instead of spinning on AcquireNextFrame(500) or polling with a 0 ms timeout, the
+// loop waits only until the next output tick, feeds arrivals (LastPresentTime /
+// AccumulatedFrames) to the pacer and asks it what to do when the tick is due.
+// The clock is pluggable so a frame-arrival trace can be replayed deterministically.
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+class PacerClock {
+public:
+    virtual ~PacerClock() = default;
+    virtual int64_t NowNs() = 0;
+};
+
+class SteadyPacerClock : public PacerClock {
+public:
+    int64_t NowNs() override {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+#ifdef _WIN32
+// LastPresentTime is a QueryPerformanceCounter value, so pace on the same clock
+inline int64_t QpcToNanoseconds(int64_t ticks) {
+    static const int64_t frequency = [] { LARGE_INTEGER f; QueryPerformanceFrequency(&f); return f.QuadPart; }();
+    return (ticks / frequency) * 1000000000ll + (ticks % frequency) * 1000000000ll / frequency;
+}
+
+class QpcPacerClock : public PacerClock {
+public:
+    int64_t NowNs() override {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return QpcToNanoseconds(now.QuadPart);
+    }
+};
+#endif
+
+// Manually advanced clock for replaying traces
+class SimulatedPacerClock : public PacerClock {
+public:
+    int64_t NowNs() override { return m_now; }
+    void SetNs(int64_t now) { m_now = now; }
+    void AdvanceNs(int64_t delta) { m_now += delta; }
+private:
+    int64_t m_now = 0;
+};
+
+// What to do when a tick has no new frame
+enum class PacingPolicy {
+    DuplicateLast,  // Constant output rate: re-present the previous frame
+    SkipTick        // Variable output rate: emit nothing for this tick
+};
+
+enum class PacingDecision {
+    Wait,           // Tick not due yet
+    Emit,           // A new frame is ready for this tick
+    Duplicate,      // No new frame, re-present the last one
+    Skip            // No new frame and nothing to output
+};
+
+struct FramePacerConfig {
+    double targetFps = 60.0;
+    PacingPolicy policy = PacingPolicy::DuplicateLast;
+    uint32_t maxTimeoutMs = 500;   // Upper bound for AcquireNextFrame waits
+};
+
+// Running mean/stddev plus a bounded sample window for percentiles
+class JitterStats {
+public:
+    void Add(int64_t ns) {
+        m_count++;
+        double x = static_cast<double>(ns);
+        double delta = x - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (x - m_mean);
+        m_min = m_count == 1 ? ns : std::min(m_min, ns);
+        m_max = m_count == 1 ? ns : std::max(m_max, ns);
+        if (m_samples.size() < kWindow) {
+            m_samples.push_back(ns);
+        }
+        else {
+            m_samples[m_next] = ns;
+            m_next = (m_next + 1) % kWindow;
+        }
+    }
+
+    uint64_t Count() const { return m_count; }
+    double MeanMs() const { return m_mean / 1e6; }
+    double StdDevMs() const { return m_count > 1 ? std::sqrt(m_m2 / (m_count - 1)) / 1e6 : 0.0; }
+    double MinMs() const { return m_min / 1e6; }
+    double MaxMs() const { return m_max / 1e6; }
+
+    // Percentile over the most recent kWindow samples
+    double PercentileMs(double p) const {
+        if (m_samples.empty()) return 0.0;
+        std::vector<int64_t> sorted(m_samples);
+        size_t index = static_cast<size_t>(std::min(1.0, std::max(0.0, p / 100.0)) * (sorted.size() - 1));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        return sorted[index] / 1e6;
+    }
+
+private:
+    static const size_t kWindow = 4096;
+    uint64_t m_count = 0;
+    double m_mean = 0.0;
+    double m_m2 = 0.0;
+    int64_t m_min = 0;
+    int64_t m_max = 0;
+    std::vector<int64_t> m_samples;
+    size_t m_next = 0;
+};
+
+struct PacingStats {
+    uint64_t ticks = 0;
+    uint64_t emitted = 0;
+    uint64_t duplicated = 0;
+    uint64_t skipped = 0;
+    uint64_t dropped = 0;       // Arrived but replaced by a newer frame before its tick
+    uint64_t coalesced = 0;     // Presents merged by DXGI (AccumulatedFrames > 1)
+    uint64_t missedTicks = 0;   // Ticks skipped entirely because the loop fell behind
+    JitterStats tickLateness;   // How late each tick was serviced
+    JitterStats outputInterval; // Time between consecutive outputs
+    JitterStats frameAge;       // Tick time minus present time of the frame emitted
+};
+
+class FramePacer {
+public:
+    FramePacer(const FramePacerConfig& config, PacerClock& clock)
+        : m_config(config), m_clock(clock) {
+        m_interval = static_cast<int64_t>(1e9 / std::max(1.0, config.targetFps));
+    }
+
+    // First tick is one interval from now. Called lazily so a pacer can be a global.
+    void Start() {
+        m_nextDeadline = m_clock.NowNs() + m_interval;
+        m_started = true;
+    }
+
+    // Report an acquired frame. A present time of 0 with no accumulated frames is a
+    // pointer-only update and does not count as a new image.
+    void OnFrameArrived(int64_t presentTimeNs, uint32_t accumulatedFrames) {
+        if (presentTimeNs == 0 && accumulatedFrames == 0) return;
+        if (accumulatedFrames > 1) m_stats.coalesced += accumulatedFrames - 1;
+        if (m_pending) m_stats.dropped++;
+        m_pending = true;
+        m_pendingPresentTime = presentTimeNs;
+    }
+
+    // Milliseconds to wait for the next frame before the tick is due
+    uint32_t AcquireTimeoutMs() {
+        if (!m_started) Start();
+        int64_t remaining = m_nextDeadline - m_clock.NowNs();
+        if (remaining <= 0) return 0;
+        int64_t ms = (remaining + 999999) / 1000000;
+        return static_cast<uint32_t>(std::min<int64_t>(ms, m_config.maxTimeoutMs));
+    }
+
+    int64_t NextDeadlineNs() const { return m_nextDeadline; }
+    int64_t IntervalNs() const { return m_interval; }
+
+    // Call after every acquire attempt; returns Wait until the tick is due
+    PacingDecision Poll() {
+        if (!m_started) Start();
+        int64_t now = m_clock.NowNs();
+        if (now < m_nextDeadline) return PacingDecision::Wait;
+
+        int64_t lateness = now - m_nextDeadline;
+        m_stats.ticks++;
+        m_stats.tickLateness.Add(lateness);
+
+        // Fell more than one interval behind: skip the ticks we can no longer honour
+        if (lateness >= m_interval) {
+            int64_t missed = lateness / m_interval;
+            m_stats.missedTicks += missed;
+            m_nextDeadline += missed * m_interval;
+        }
+        m_nextDeadline += m_interval;
+
+        PacingDecision decision;
+        if (m_pending) {
+            decision = PacingDecision::Emit;
+            m_stats.emitted++;
+            m_stats.frameAge.Add(now - m_pendingPresentTime);
+            m_pending = false;
+            m_hasEmitted = true;
+        }
+        else if (m_config.policy == PacingPolicy::DuplicateLast && m_hasEmitted) {
+            decision = PacingDecision::Duplicate;
+            m_stats.duplicated++;
+        }
+        else {
+            decision = PacingDecision::Skip;
+            m_stats.skipped++;
+        }
+
+        if (decision != PacingDecision::Skip) {
+            if (m_lastOutput != 0) m_stats.outputInterval.Add(now - m_lastOutput);
+            m_lastOutput = now;
+        }
+        return decision;
+    }
+
+    const PacingStats& Stats() const { return m_stats; }
+
+private:
+    FramePacerConfig m_config;
+    PacerClock& m_clock;
+    int64_t m_interval;
+    int64_t m_nextDeadline = 0;
+    bool m_started = false;
+    bool m_pending = false;
+    bool m_hasEmitted = false;
+    int64_t m_pendingPresentTime = 0;
+    int64_t m_lastOutput = 0;
+    PacingStats m_stats;
+};
+
+inline void WritePacingStats(std::ostream& out, const PacingStats& stats) {
+    out << "ticks " << stats.ticks << ", emitted " << stats.emitted << ", duplicated " << stats.duplicated
+        << ", skipped " << stats.skipped << ", dropped " << stats.dropped << ", coalesced " << stats.coalesced
+        << ", missed ticks " << stats.missedTicks << "\n";
+    out << "  tick lateness  mean " << stats.tickLateness.MeanMs() << " ms, p99 " << stats.tickLateness.PercentileMs(99)
+        << " ms, max " << stats.tickLateness.MaxMs() << " ms\n";
+    out << "  output period  mean " << stats.outputInterval.MeanMs() << " ms, stddev " << stats.outputInterval.StdDevMs()
+        << " ms, p99 " << stats.outputInterval.PercentileMs(99) << " ms\n";
+    out << "  frame age      mean " << stats.frameAge.MeanMs() << " ms, p99 " << stats.frameAge.PercentileMs(99)
+        << " ms, max " << stats.frameAge.MaxMs() << " ms" << std::endl;
+}
+
+// One entry of a frame-arrival trace (times in nanoseconds)
+struct FrameArrival {
+    int64_t presentTime;
+    uint32_t accumulatedFrames;
+};
+
+// Trace format: one "<presentTimeNs> [accumulatedFrames]" pair per line, '#' comments.
+// Lines that do not parse (or carry trailing junk) are skipped and counted in 'skippedLines'.
+inline bool ReadArrivalTrace(std::istream& in, std::vector<FrameArrival>& trace, size_t* skippedLines = nullptr) {
+    trace.clear();
+    if (skippedLines) *skippedLines = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const char* text = line.c_str();
+        char* end = nullptr;
+        errno = 0;
+        FrameArrival arrival = { std::strtoll(text, &end, 10), 1 };
+        bool ok = end != text && errno == 0;
+        text = end + std::strspn(end, " \t\r");
+        if (ok && *text) {
+            // strtoul would accept "-1" and wrap it, so the count must start with a digit
+            unsigned long frames = 0;
+            end = const_cast<char*>(text);
+            if (std::isdigit(static_cast<unsigned char>(*text))) frames = std::strtoul(text, &end, 10);
+            ok = end != text && errno == 0 && frames <= UINT32_MAX;
+            arrival.accumulatedFrames = static_cast<uint32_t>(frames);
+            text = end + std::strspn(end, " \t\r");
+        }
+        if (!ok || *text) {
+            if (skippedLines) ++*skippedLines;
+            continue;
+        }
+        trace.push_back(arrival);
+    }
+    return !trace.empty();
+}
+
+// Replay a trace through the pacer on a simulated clock. serviceLatencyNs models
+// how long the loop takes to notice a due tick (e.g. a blocking encode).
+inline PacingStats SimulatePacing(const std::vector<FrameArrival>& trace, const FramePacerConfig& config, int64_t serviceLatencyNs = 0) {
+    SimulatedPacerClock clock;
+    clock.SetNs(trace.empty() ? 0 : trace.front().presentTime);
+    FramePacer pacer(config, clock);
+    pacer.Start();
+
+    size_t next = 0;
+    int64_t end = trace.empty() ? 0 : trace.back().presentTime + pacer.IntervalNs();
+    while (clock.NowNs() <= end) {
+        // Advance to whichever comes first: the next arrival or the next tick
+        int64_t tickAt = pacer.NextDeadlineNs() + serviceLatencyNs;
+        if (next < trace.size() && trace[next].presentTime <= tickAt) {
+            clock.SetNs(std::max(clock.NowNs(), trace[next].presentTime));
+            pacer.OnFrameArrived(trace[next].presentTime, trace[next].accumulatedFrames);
+            next++;
+            continue;
+        }
+        clock.SetNs(std::max(clock.NowNs(), tickAt));
+        pacer.Poll();
+    }
+    return pacer.Stats();
+}
@@ -0,0 +1,270 @@
+#pragma once
+// Staged capture pipeline: acquire -> readback -> encode -> write.
+// Each stage runs on its own thread; stages are joined by bounded queues so a
+// slow stage pushes back on the ones before it instead of growing memory.
+// Frame time ends up bounded by the slowest stage rather than the sum of all.
+#include "FrameTrace.h"
+#include "ImageView.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Blocking FIFO with a fixed capacity. Push waits while full (backpressure),
+// Pop waits while empty. Close wakes everyone; Pop drains what is left first.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+    // Returns false if the queue was closed before the item could be added
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_items.size() >= m_capacity) {
+            m_fullWaits++;
+            m_notFull.wait(lock, [this] { return m_items.size() < m_capacity || m_closed; });
+        }
+        if (m_closed) return false;
+        m_items.push_back(std::move(item));
+        if (m_items.size() > m_maxDepth) m_maxDepth = m_items.size();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and empty
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // Non-blocking variant for pollers
+    bool TryPop(T& item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+    size_t Capacity() const { return m_capacity; }
+    size_t MaxDepth() const { std::lock_guard<std::mutex> lock(m_mutex); return m_maxDepth; }
+    uint64_t FullWaits() const { std::lock_guard<std::mutex> lock(m_mutex); return m_fullWaits; }
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_items;
+    size_t m_capacity;
+    size_t m_maxDepth = 0;
+    uint64_t m_fullWaits = 0;
+    bool m_closed = false;
+};
+
+// One frame travelling through the pipeline. Frames are pooled and reused, so
+// buffers keep their capacity from one lap to the next.
+struct PipelineFrame {
+    uint32_t slot = 0;              // Pool index; D3D backends key per-slot staging textures on it
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;          // Capture time, nanoseconds or QPC ticks depending on source
+    uint32_t width = 0;             // Full captured width
+    uint32_t height = 0;
+    uint32_t tileWidth = 0;         // Size of each output tile (a half for the default 2x1 layout)
+    uint32_t tileHeight = 0;
+    std::vector<uint8_t> desktop;   // Full captured frame (CPU sources only)
+    ImageView frameView;            // The one full-frame readback: mapped staging memory or 'desktop'
+    std::vector<ImageView> tileViews;   // One per TileLayout copy, pointing into frameView
+    std::vector<std::vector<uint8_t>> encoded;
+};
+
+// A stage returns false to drop the frame. For the first stage (the source),
+// false means there are no more frames and the pipeline winds down.
+struct PipelineStage {
+    std::string name;
+    std::function<bool(PipelineFrame&)> process;
+};
+
+struct PipelineStageStats {
+    std::string name;
+    uint64_t frames = 0;
+    uint64_t dropped = 0;
+    double busyMs = 0.0;       // Time spent inside process()
+    double starvedMs = 0.0;    // Time waiting for input
+    double blockedMs = 0.0;    // Time waiting for room downstream (backpressure)
+    size_t maxQueueDepth = 0;  // Deepest the input queue got
+};
+
+class FramePipeline {
+public:
+    // slotCount frames circulate; queueDepth bounds each inter-stage queue
+    FramePipeline(std::vector<PipelineStage> stages, size_t slotCount = 4, size_t queueDepth = 2)
+        : m_stages(std::move(stages)), m_slotCount(slotCount ? slotCount : 1) {
+        m_freeFrames.reset(new BoundedQueue<PipelineFrame*>(m_slotCount));
+        for (size_t i = 1; i < m_stages.size(); ++i) {
+            m_queues.emplace_back(new BoundedQueue<PipelineFrame*>(queueDepth));
+        }
+        m_stats.resize(m_stages.size());
+        for (size_t i = 0; i < m_stages.size(); ++i) {
+            m_stats[i].name = m_stages[i].name;
+            m_traceNames.push_back(FrameTrace::Intern(m_stages[i].name));
+        }
+        for (size_t i = 0; i < m_slotCount; ++i) {
+            m_pool.emplace_back(new PipelineFrame());
+            m_pool.back()->slot = static_cast<uint32_t>(i);
+            m_freeFrames->Push(m_pool.back().get());
+        }
+    }
+
+    ~FramePipeline() {
+        Stop();
+        Wait();
+    }
+
+    void Start() {
+        m_start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < m_stages.size(); ++i) {
+            m_threads.emplace_back(&FramePipeline::RunStage, this, i);
+        }
+    }
+
+    // Ask the source to stop; frames already in flight still drain
+    void Stop() { m_stopRequested = true; }
+
+    // For sources that wait inside process() (a poll with a timeout) so they can give up early
+    bool StopRequested() const { return m_stopRequested; }
+
+    void Wait() {
+        for (std::thread& t : m_threads) {
+            if (t.joinable()) t.join();
+        }
+        m_threads.clear();
+        if (m_end == std::chrono::steady_clock::time_point()) {
+            m_end = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Convenience: start, wait for the source to run dry, return stats
+    const std::vector<PipelineStageStats>& Run() {
+        Start();
+        Wait();
+        return Stats();
+    }
+
+    const std::vector<PipelineStageStats>& Stats() {
+        for (size_t i = 1; i < m_stages.size(); ++i) {
+            m_stats[i].maxQueueDepth = m_queues[i - 1]->MaxDepth();
+        }
+        return m_stats;
+    }
+
+    uint64_t CompletedFrames() const { return m_completed; }
+
+    double ElapsedSeconds() const {
+        return std::chrono::duration<double>(m_end - m_start).count();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double MsSince(Clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+    }
+
+    BoundedQueue<PipelineFrame*>& InputOf(size_t stage) {
+        return stage == 0 ? *m_freeFrames : *m_queues[stage - 1];
+    }
+
+    void RunStage(size_t index) {
+        PipelineStageStats& stats = m_stats[index];
+        BoundedQueue<PipelineFrame*>& input = InputOf(index);
+        bool isSource = index == 0;
+        bool isLast = index + 1 == m_stages.size();
+        FrameTrace::SetThreadName("stage " + m_stages[index].name);
+
+        while (true) {
+            if (isSource && m_stopRequested) break;
+
+            PipelineFrame* frame = nullptr;
+            Clock::time_point waitStart = Clock::now();
+            if (!input.Pop(frame)) break;
+            stats.starvedMs += MsSince(waitStart);
+
+            Clock::time_point busyStart = Clock::now();
+            int64_t traceStart = FrameTrace::Enabled() ? FrameTrace::NowNs() : 0;
+            FrameTrace::SetCurrentFrame(frame->frameIndex);
+            bool keep = m_stages[index].process(*frame);
+            stats.busyMs += MsSince(busyStart);
+            if (traceStart && keep) {
+                FrameTrace::Record(m_traceNames[index], frame->frameIndex, traceStart, FrameTrace::NowNs());
+            }
+
+            if (!keep) {
+                if (isSource) {
+                    m_freeFrames->Push(frame);
+                    break;
+                }
+                stats.dropped++;
+                m_freeFrames->Push(frame);
+                continue;
+            }
+            stats.frames++;
+
+            Clock::time_point blockStart = Clock::now();
+            if (isLast) {
+                m_completed++;
+                m_end = Clock::now();
+                m_freeFrames->Push(frame);
+            }
+            else {
+                m_queues[index]->Push(frame);
+            }
+            stats.blockedMs += MsSince(blockStart);
+        }
+
+        // Let the next stage drain and finish
+        if (!isLast) {
+            m_queues[index]->Close();
+        }
+        else {
+            m_freeFrames->Close();
+        }
+    }
+
+    std::vector<PipelineStage> m_stages;
+    size_t m_slotCount;
+    std::vector<std::unique_ptr<PipelineFrame>> m_pool;
+    std::unique_ptr<BoundedQueue<PipelineFrame*>> m_freeFrames;
+    std::vector<std::unique_ptr<BoundedQueue<PipelineFrame*>>> m_queues;
+    std::vector<PipelineStageStats> m_stats;
+    std::vector<const char*> m_traceNames;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stopRequested{ false };
+    std::atomic<uint64_t> m_completed{ 0 };
+    Clock::time_point m_start;
+    Clock::time_point m_end;
+};
@@ -0,0 +1,246 @@
+#pragma once
+// Per-frame stage tracing: begin/end timestamps of acquire, copy, Map, encode, Commit,
+// Present, ... recorded into per-thread ring buffers and dumped on demand as Chrome
+// trace-event JSON (open in chrome://tracing or ui.perfetto.dev).
+// Recording takes no locks: each thread owns its buffer, and a disabled trace costs one
+// relaxed atomic load per scope. Buffers outlive their threads so a dump still sees them.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+struct FrameTraceEvent {
+    const char* name;   // Must outlive the trace: a literal or FrameTrace::Intern()
+    uint64_t frame;
+    int64_t beginNs;
+    int64_t endNs;
+};
+
+// Single-writer ring. The owning thread records; a dump may read concurrently and
+// will see every event except ones being overwritten while it copies (wrap-around).
+// Slots are relaxed atomics checked against the write index afterwards, seqlock style,
+// so a slot the owner rewrites mid-copy is dropped rather than torn.
+class FrameTraceBuffer {
+public:
+    FrameTraceBuffer(uint32_t threadId, size_t capacity)
+        : m_threadId(threadId), m_capacity(capacity ? capacity : 1), m_slots(new Slot[m_capacity]) {}
+
+    void Record(const char* name, uint64_t frame, int64_t beginNs, int64_t endNs) {
+        uint64_t n = m_written.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[n % m_capacity];
+        // A dump that sees any of these stores also sees m_written >= n, so it drops event n - capacity
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.frame.store(frame, std::memory_order_relaxed);
+        slot.beginNs.store(beginNs, std::memory_order_relaxed);
+        slot.endNs.store(endNs, std::memory_order_relaxed);
+        m_written.store(n + 1, std::memory_order_release);
+    }
+
+    // Appends the retained events, oldest first
+    void CopyEvents(std::vector<FrameTraceEvent>& out) const {
+        uint64_t written = m_written.load(std::memory_order_acquire);
+        uint64_t first = written - std::min<uint64_t>(written, m_capacity);
+        size_t start = out.size();
+        for (uint64_t i = first; i < written; ++i) {
+            const Slot& slot = m_slots[i % m_capacity];
+            out.push_back({ slot.name.load(std::memory_order_relaxed), slot.frame.load(std::memory_order_relaxed),
+                            slot.beginNs.load(std::memory_order_relaxed), slot.endNs.load(std::memory_order_relaxed) });
+        }
+        // Events from slots the owner has started to reuse since may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = m_written.load(std::memory_order_relaxed);
+        uint64_t firstIntact = now + 1 > m_capacity ? now + 1 - m_capacity : 0;
+        if (firstIntact > first) {
+            size_t torn = static_cast<size_t>(std::min(firstIntact, written) - first);
+            out.erase(out.begin() + start, out.begin() + start + torn);
+        }
+    }
+
+    uint64_t Written() const { return m_written.load(std::memory_order_acquire); }
+    uint32_t ThreadId() const { return m_threadId; }
+
+    std::string threadName;     // Guarded by FrameTrace's registry mutex
+
+private:
+    struct Slot {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> frame{ 0 };
+        std::atomic<int64_t> beginNs{ 0 };
+        std::atomic<int64_t> endNs{ 0 };
+    };
+
+    uint32_t m_threadId;
+    size_t m_capacity;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<uint64_t> m_written{ 0 };
+};
+
+class FrameTrace {
+public:
+    static void Enable(bool enabled) { State().enabled.store(enabled, std::memory_order_relaxed); }
+    static bool Enabled() { return State().enabled.load(std::memory_order_relaxed); }
+
+    // Events per thread before the oldest are overwritten; applies to threads that record after the call
+    static void SetBufferCapacity(size_t events) { State().capacity = events; }
+
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Frame that scopes on this thread are attributed to
+    static void SetCurrentFrame(uint64_t frame) { CurrentFrameRef() = frame; }
+    static uint64_t CurrentFrame() { return CurrentFrameRef(); }
+
+    static void SetThreadName(const std::string& name) {
+        FrameTraceBuffer& buffer = LocalBuffer();
+        std::lock_guard<std::mutex> lock(State().mutex);
+        buffer.threadName = name;
+    }
+
+    // Stable pointer for names built at runtime (pipeline stage names, output names)
+    static const char* Intern(const std::string& name) {
+        TraceState& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.names.insert(name).first->c_str();
+    }
+
+    static void Record(const char* name, uint64_t frame, int64_t beginNs, int64_t endNs) {
+        LocalBuffer().Record(name, frame, beginNs, endNs);
+    }
+
+    static uint64_t EventCount() {
+        TraceState& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        uint64_t total = 0;
+        for (const std::unique_ptr<FrameTraceBuffer>& buffer : state.buffers) total += buffer->Written();
+        return total;
+    }
+
+    // Chrome trace-event JSON: one complete ("X") event per stage per frame, timestamps
+    // in microseconds relative to the first event, plus thread_name metadata
+    static void WriteChromeTrace(std::ostream& out) {
+        TraceState& state = State();
+        struct ThreadEvents {
+            uint32_t tid;
+            std::string name;       // Copied under the lock; SetThreadName may run during a dump
+            std::vector<FrameTraceEvent> events;
+        };
+        std::vector<ThreadEvents> threads;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            for (const std::unique_ptr<FrameTraceBuffer>& buffer : state.buffers) {
+                threads.push_back({ buffer->ThreadId(), buffer->threadName, std::vector<FrameTraceEvent>() });
+                buffer->CopyEvents(threads.back().events);
+            }
+        }
+
+        int64_t origin = INT64_MAX;
+        for (const ThreadEvents& thread : threads) {
+            for (const FrameTraceEvent& e : thread.events) origin = std::min(origin, e.beginNs);
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        char number[64];
+        for (const ThreadEvents& thread : threads) {
+            uint32_t tid = thread.tid;
+            out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"name\":\"thread_name\",\"args\":{\"name\":\"";
+            WriteEscaped(out, thread.name.empty() ? "thread " + std::to_string(tid) : thread.name);
+            out << "\"}}";
+            first = false;
+            for (const FrameTraceEvent& e : thread.events) {
+                out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"cat\":\"frame\",\"name\":\"";
+                WriteEscaped(out, e.name);
+                snprintf(number, sizeof(number), "%.3f", (e.beginNs - origin) / 1000.0);
+                out << "\",\"ts\":" << number;
+                snprintf(number, sizeof(number), "%.3f", (e.endNs - e.beginNs) / 1000.0);
+                out << ",\"dur\":" << number << ",\"args\":{\"frame\":" << e.frame << "}}";
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    static bool WriteChromeTrace(const std::string& path) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        WriteChromeTrace(out);
+        return static_cast<bool>(out);
+    }
+
+private:
+    struct TraceState {
+        std::atomic<bool> enabled{ false };
+        size_t capacity = 1 << 16;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<FrameTraceBuffer>> buffers;
+        std::set<std::string> names;
+    };
+
+    static TraceState& State() {
+        static TraceState state;
+        return state;
+    }
+
+    static uint64_t& CurrentFrameRef() {
+        thread_local uint64_t frame = 0;
+        return frame;
+    }
+
+    // Registered on first use per thread; the only locked step on the recording path
+    static FrameTraceBuffer& LocalBuffer() {
+        thread_local FrameTraceBuffer* buffer = nullptr;
+        if (!buffer) {
+            TraceState& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.buffers.emplace_back(new FrameTraceBuffer(static_cast<uint32_t>(state.buffers.size() + 1), state.capacity));
+            buffer = state.buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    static void WriteEscaped(std::ostream& out, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+            else out << c;
+        }
+    }
+};
+
+// Records [construction, destruction) as one stage of the current frame
+class FrameTraceScope {
+public:
+    explicit FrameTraceScope(const char* name)
+        : m_name(FrameTrace::Enabled() ? name : nullptr) {
+        if (m_name) {
+            m_frame = FrameTrace::CurrentFrame();
+            m_begin = FrameTrace::NowNs();
+        }
+    }
+
+    FrameTraceScope(const char* name, uint64_t frame)
+        : m_name(FrameTrace::Enabled() ? name : nullptr), m_frame(frame) {
+        if (m_name) m_begin = FrameTrace::NowNs();
+    }
+
+    ~FrameTraceScope() {
+        if (m_name) FrameTrace::Record(m_name, m_frame, m_begin, FrameTrace::NowNs());
+    }
+
+    FrameTraceScope(const FrameTraceScope&) = delete;
+    FrameTraceScope& operator=(const FrameTraceScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_frame = 0;
+    int64_t m_begin = 0;
+};
@@ -0,0 +1,138 @@
+// Measures what FrameTrace costs. Runs the headless capture stages (acquire, split,
+// readback, encode) on a synthetic source with tracing off and on, and checks that the
+// per-frame tracing cost stays under 1% of a 60 fps frame budget. The check uses the
+// median of the traced - untraced frame time over repeated rounds; the cost modelled from
+// the scope microbenchmark is printed for comparison only.
+// Usage: FrameTraceBenchmark [frames] [rounds] [trace.json]
+#include "FrameTrace.h"
+#include "SyntheticFrameSource.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FrameBuffers {
+    std::vector<uint8_t> desktop;
+    std::vector<uint8_t> halves[2];
+    std::vector<uint8_t> readback[2];
+    uint64_t checksum = 0;
+};
+
+// One frame of the sequential capture path, with the same scopes CaptureFrame() records
+void RunFrame(SyntheticFrameSource& source, FrameBuffers& buffers) {
+    SyntheticFrameInfo info;
+    {
+        FrameTraceScope trace("acquire");
+        source.AcquireNextFrame(buffers.desktop, info);
+    }
+    FrameTrace::SetCurrentFrame(info.frameIndex);
+
+    size_t fullPitch = source.RowPitch();
+    size_t halfPitch = fullPitch / 2;
+    for (int h = 0; h < 2; ++h) {
+        FrameTraceScope trace("copy");
+        buffers.halves[h].resize(halfPitch * source.Height());
+        for (uint32_t y = 0; y < source.Height(); ++y) {
+            std::memcpy(buffers.halves[h].data() + y * halfPitch, buffers.desktop.data() + y * fullPitch + h * halfPitch, halfPitch);
+        }
+    }
+    for (int h = 0; h < 2; ++h) {
+        FrameTraceScope trace("map");
+        buffers.readback[h] = buffers.halves[h];
+    }
+    for (int h = 0; h < 2; ++h) {
+        FrameTraceScope trace("encode");
+        const uint64_t* words = reinterpret_cast<const uint64_t*>(buffers.readback[h].data());
+        uint64_t hash = 1469598103934665603ull;
+        for (size_t i = 0; i < buffers.readback[h].size() / 8; ++i) {
+            hash = (hash ^ words[i]) * 1099511628211ull;
+        }
+        FrameTraceScope commit("commit");
+        buffers.checksum += hash;
+    }
+}
+
+double RunFrames(uint64_t frames, bool traced) {
+    FrameTrace::Enable(traced);
+    SyntheticFrameSource source(2560, 1440, SyntheticPattern::ScrollingText, 0.0, frames);
+    FrameBuffers buffers;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < frames; ++i) {
+        RunFrame(source, buffers);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    FrameTrace::Enable(false);
+    return ms / frames;
+}
+
+// Cost of one begin/end pair, measured over many empty scopes
+double ScopeCostNs(bool traced, uint64_t iterations) {
+    FrameTrace::Enable(traced);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        FrameTraceScope trace("empty", i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    FrameTrace::Enable(false);
+    return ns / iterations;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 120;
+    int rounds = argc > 2 ? std::max(1, std::stoi(argv[2])) : 9;
+    std::string tracePath = argc > 3 ? argv[3] : "";
+
+    // Own thread, so its events fill a different ring than the frames below
+    double disabledNs = 0.0, enabledNs = 0.0;
+    std::thread micro([&] {
+        FrameTrace::SetThreadName("scope cost");
+        disabledNs = ScopeCostNs(false, 10000000);
+        enabledNs = ScopeCostNs(true, 10000000);
+    });
+    micro.join();
+    FrameTrace::SetThreadName("capture");
+    std::cout << "Scope cost: " << disabledNs << " ns disabled, " << enabledNs << " ns enabled" << std::endl;
+
+    // Warm up caches and the allocator, then alternate so drift hits both sides; the median
+    // round keeps one disturbed run from deciding the result
+    RunFrames(10, false);
+    std::vector<double> offMs, onMs, overheadMs;
+    uint64_t eventsBefore = 0, eventsAfter = 0;
+    for (int round = 0; round < rounds; ++round) {
+        offMs.push_back(RunFrames(frames, false));
+        eventsBefore = FrameTrace::EventCount();
+        onMs.push_back(RunFrames(frames, true));
+        eventsAfter = FrameTrace::EventCount();
+        overheadMs.push_back(onMs.back() - offMs.back());
+    }
+    auto median = [](std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    };
+
+    double eventsPerFrame = static_cast<double>(eventsAfter - eventsBefore) / frames;
+    double budgetMs = 1000.0 / 60.0;
+    double modelledPercent = eventsPerFrame * enabledNs / 1e6 / budgetMs * 100.0;
+    double measuredPercent = median(overheadMs) / budgetMs * 100.0;
+
+    std::cout << "Frame time (median of " << rounds << " rounds): " << median(offMs) << " ms untraced, " << median(onMs) << " ms traced, "
+              << eventsPerFrame << " events/frame" << std::endl;
+    std::cout << "Overhead at 60 fps: " << measuredPercent << "% of the frame budget measured (median traced - untraced), "
+              << modelledPercent << "% modelled from scope cost" << std::endl;
+
+    if (!tracePath.empty()) {
+        if (FrameTrace::WriteChromeTrace(tracePath)) {
+            std::cout << "Wrote " << tracePath << std::endl;
+        }
+        else {
+            std::cerr << "Failed to write " << tracePath << std::endl;
+        }
+    }
+
+    bool pass = measuredPercent < 1.0;
+    std::cout << (pass ? "PASS" : "FAIL") << ": measured tracing overhead " << (pass ? "under" : "over") << " 1% at 60 fps" << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+// Non-owning view of 32-bit pixels: pointer + row pitch + size. A view into a mapped
+// staging texture or a frame buffer can be cropped to a tile without copying; rows stay
+// at the parent's pitch, so consumers must walk Row(y) instead of assuming tight rows.
+#include <cstddef>
+#include <cstdint>
+
+struct ImageView {
+    const uint8_t* data = nullptr;
+    size_t rowPitch = 0;        // Bytes between row starts; >= width * 4
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    ImageView() = default;
+    ImageView(const uint8_t* pixels, uint32_t w, uint32_t h, size_t pitch)
+        : data(pixels), rowPitch(pitch), width(w), height(h) {}
+
+    static const uint32_t kBytesPerPixel = 4;
+
+    bool Empty() const { return !data || width == 0 || height == 0; }
+    size_t RowBytes() const { return static_cast<size_t>(width) * kBytesPerPixel; }
+    bool Contiguous() const { return rowPitch == RowBytes(); }
+
+    const uint8_t* Row(uint32_t y) const { return data + y * rowPitch; }
+    const uint8_t* Pixel(uint32_t x, uint32_t y) const { return Row(y) + static_cast<size_t>(x) * kBytesPerPixel; }
+
+    // Same memory, narrowed to [x, x + w) x [y, y + h); the caller keeps it inside the parent
+    ImageView Crop(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const {
+        return ImageView(Pixel(x, y), w, h, rowPitch);
+    }
+};
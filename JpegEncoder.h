@@ -0,0 +1,520 @@
+#pragma once
+// Self-contained baseline JPEG encoder for captured frames (one frame of an MJPEG stream).
+// BGRA is converted to full-range BT.601 YUV 4:2:0 as JFIF expects, then transformed with
+// the AAN float DCT, quantized with the IJG tables scaled by quality and coded with the
+// standard Huffman tables. Rows of 16 px MCUs are grouped into strips separated by restart
+// markers; each strip resets the DC predictors, so strips are converted and entropy coded
+// on a ThreadPool independently and simply concatenated. Any JPEG decoder reads the result.
+#include "ImageView.h"
+#include "PixelKernels.h"
+#include "ThreadPool.h"
+#include "YuvConvert.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct JpegWriteOptions {
+    int quality = 85;               // 1-100, as in libjpeg
+    uint32_t stripMcuRows = 0;      // MCU rows per restart strip; 0 picks from the width
+};
+
+namespace JpegDetail {
+
+// Natural (row-major) index of each zigzag position
+const uint8_t kZigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// ITU T.81 Annex K quantization tables, natural order
+const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99
+};
+const uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Annex K.3 Huffman tables: code counts per length 1-16, then symbols
+const uint8_t kDcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const uint8_t kDcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const uint8_t kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const uint8_t kAcLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+const uint8_t kAcLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+const uint8_t kAcChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const uint8_t kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+// Code and length per symbol, from the canonical assignment in Annex C
+struct HuffmanCodes {
+    uint16_t code[256] = {};
+    uint8_t length[256] = {};
+
+    HuffmanCodes(const uint8_t* bits, const uint8_t* values) {
+        uint16_t next = 0;
+        size_t k = 0;
+        for (int len = 1; len <= 16; ++len) {
+            for (int i = 0; i < bits[len - 1]; ++i, ++k) {
+                code[values[k]] = next++;
+                length[values[k]] = static_cast<uint8_t>(len);
+            }
+            next <<= 1;
+        }
+    }
+};
+
+struct HuffmanSet {
+    HuffmanCodes dcLuma{ kDcLumaBits, kDcValues };
+    HuffmanCodes acLuma{ kAcLumaBits, kAcLumaValues };
+    HuffmanCodes dcChroma{ kDcChromaBits, kDcValues };
+    HuffmanCodes acChroma{ kAcChromaBits, kAcChromaValues };
+};
+
+inline const HuffmanSet& StandardHuffman() {
+    static const HuffmanSet set;
+    return set;
+}
+
+// Quantizer at a quality, zigzag order as written to DQT, plus the reciprocal divisors the
+// AAN DCT output is multiplied by (its per-row/column scale folded in)
+struct QuantTable {
+    uint8_t zigzag[64];
+    float scale[64];    // Natural order
+};
+
+inline void BuildQuantTable(const uint8_t* base, int quality, QuantTable& table) {
+    static const float kAanScale[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+    quality = std::min(std::max(quality, 1), 100);
+    int percent = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; ++i) {
+        int q = std::min(std::max((base[kZigzag[i]] * percent + 50) / 100, 1), 255);
+        table.zigzag[i] = static_cast<uint8_t>(q);
+        int n = kZigzag[i];
+        table.scale[n] = 1.0f / (q * kAanScale[n / 8] * kAanScale[n % 8] * 8.0f);
+    }
+}
+
+// Arai-Agui-Nakajima forward DCT over 8 values 'stride' apart, outputs scaled as in jfdctflt
+inline void Fdct8(float* d, size_t stride) {
+    float tmp0 = d[0] + d[stride * 7], tmp7 = d[0] - d[stride * 7];
+    float tmp1 = d[stride] + d[stride * 6], tmp6 = d[stride] - d[stride * 6];
+    float tmp2 = d[stride * 2] + d[stride * 5], tmp5 = d[stride * 2] - d[stride * 5];
+    float tmp3 = d[stride * 3] + d[stride * 4], tmp4 = d[stride * 3] - d[stride * 4];
+
+    float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[stride * 4] = tmp10 - tmp11;
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[stride * 2] = tmp13 + z1;
+    d[stride * 6] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = 0.541196100f * tmp10 + z5;
+    float z4 = 1.306562965f * tmp12 + z5;
+    float z3 = tmp11 * 0.707106781f;
+    float z11 = tmp7 + z3, z13 = tmp7 - z3;
+    d[stride * 5] = z13 + z2;
+    d[stride * 3] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[stride * 7] = z11 - z4;
+}
+
+// Entropy-coded segment writer: MSB-first bits, 0xFF bytes stuffed with 0x00. Bits are
+// drained 32 at a time; only words holding a 0xFF byte take the byte-by-byte path.
+class JpegBitWriter {
+public:
+    explicit JpegBitWriter(std::vector<uint8_t>& out) : m_out(out), m_size(out.size()) {}
+
+    // count <= 32, and bits above 'count' must be clear
+    void Put(uint32_t bits, int count) {
+        m_buffer = (m_buffer << count) | bits;
+        m_count += count;
+        if (m_count >= 32) {
+            m_count -= 32;
+            PutWord(static_cast<uint32_t>(m_buffer >> m_count));
+        }
+    }
+
+    // Pads the last byte with 1 bits, as required before a marker, and trims the output
+    void Flush() {
+        int pad = (8 - m_count % 8) % 8;
+        m_buffer = (m_buffer << pad) | ((1u << pad) - 1);
+        m_count += pad;
+        Reserve();
+        while (m_count >= 8) {
+            m_count -= 8;
+            PutByte(static_cast<uint8_t>(m_buffer >> m_count));
+        }
+        m_out.resize(m_size);
+    }
+
+private:
+    void Reserve() {
+        if (m_size + 16 > m_out.size()) m_out.resize(std::max<size_t>(m_out.size() * 2, 4096));
+    }
+
+    void PutByte(uint8_t byte) {
+        m_out[m_size++] = byte;
+        if (byte == 0xFF) m_out[m_size++] = 0;
+    }
+
+    void PutWord(uint32_t word) {
+        Reserve();
+        uint32_t inverted = ~word;
+        if (((inverted - 0x01010101u) & ~inverted & 0x80808080u) == 0) {   // No 0xFF byte
+            uint8_t* d = m_out.data() + m_size;
+            d[0] = static_cast<uint8_t>(word >> 24);
+            d[1] = static_cast<uint8_t>(word >> 16);
+            d[2] = static_cast<uint8_t>(word >> 8);
+            d[3] = static_cast<uint8_t>(word);
+            m_size += 4;
+            return;
+        }
+        for (int shift = 24; shift >= 0; shift -= 8) PutByte(static_cast<uint8_t>(word >> shift));
+    }
+
+    std::vector<uint8_t>& m_out;
+    size_t m_size;
+    uint64_t m_buffer = 0;
+    int m_count = 0;
+};
+
+// Bits needed for magnitudes 0-2047, the widest a baseline coefficient or DC step can be
+inline int CoefficientSize(uint32_t magnitude) {
+    static const struct Table {
+        uint8_t size[2048];
+        Table() {
+            size[0] = 0;
+            for (uint32_t i = 1; i < 2048; ++i) size[i] = static_cast<uint8_t>(size[i / 2] + 1);
+        }
+    } table;
+    return table.size[std::min<uint32_t>(magnitude, 2047)];
+}
+
+// Huffman code of (run, size) followed by the value's bits, in one Put
+inline void PutCoefficient(JpegBitWriter& bits, const HuffmanCodes& codes, int run, int value) {
+    int size = CoefficientSize(static_cast<uint32_t>(value < 0 ? -value : value));
+    int symbol = (run << 4) | size;
+    uint32_t extra = static_cast<uint32_t>(value < 0 ? value - 1 : value) & ((1u << size) - 1);
+    bits.Put((static_cast<uint32_t>(codes.code[symbol]) << size) | extra, codes.length[symbol] + size);
+}
+
+// 2-D DCT (rows, then columns) and quantization; coefficients come out in natural order
+inline void TransformBlockScalar(float* block, const QuantTable& quant, int* coefficients) {
+    for (int r = 0; r < 8; ++r) Fdct8(block + r * 8, 1);
+    for (int c = 0; c < 8; ++c) Fdct8(block + c, 8);
+    for (int n = 0; n < 64; ++n) {
+        float v = block[n] * quant.scale[n];
+        coefficients[n] = static_cast<int>(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+}
+
+#ifdef PIXEL_KERNELS_X86
+// Fdct8 on eight vectors at once: lane i transforms element i of each vector
+PIXEL_KERNELS_AVX2_TARGET inline void Fdct8Avx2(__m256* d) {
+    __m256 tmp0 = _mm256_add_ps(d[0], d[7]), tmp7 = _mm256_sub_ps(d[0], d[7]);
+    __m256 tmp1 = _mm256_add_ps(d[1], d[6]), tmp6 = _mm256_sub_ps(d[1], d[6]);
+    __m256 tmp2 = _mm256_add_ps(d[2], d[5]), tmp5 = _mm256_sub_ps(d[2], d[5]);
+    __m256 tmp3 = _mm256_add_ps(d[3], d[4]), tmp4 = _mm256_sub_ps(d[3], d[4]);
+
+    __m256 tmp10 = _mm256_add_ps(tmp0, tmp3), tmp13 = _mm256_sub_ps(tmp0, tmp3);
+    __m256 tmp11 = _mm256_add_ps(tmp1, tmp2), tmp12 = _mm256_sub_ps(tmp1, tmp2);
+    d[0] = _mm256_add_ps(tmp10, tmp11);
+    d[4] = _mm256_sub_ps(tmp10, tmp11);
+    __m256 z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), _mm256_set1_ps(0.707106781f));
+    d[2] = _mm256_add_ps(tmp13, z1);
+    d[6] = _mm256_sub_ps(tmp13, z1);
+
+    tmp10 = _mm256_add_ps(tmp4, tmp5);
+    tmp11 = _mm256_add_ps(tmp5, tmp6);
+    tmp12 = _mm256_add_ps(tmp6, tmp7);
+    __m256 z5 = _mm256_mul_ps(_mm256_sub_ps(tmp10, tmp12), _mm256_set1_ps(0.382683433f));
+    __m256 z2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.541196100f), tmp10), z5);
+    __m256 z4 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(1.306562965f), tmp12), z5);
+    __m256 z3 = _mm256_mul_ps(tmp11, _mm256_set1_ps(0.707106781f));
+    __m256 z11 = _mm256_add_ps(tmp7, z3), z13 = _mm256_sub_ps(tmp7, z3);
+    d[5] = _mm256_add_ps(z13, z2);
+    d[3] = _mm256_sub_ps(z13, z2);
+    d[1] = _mm256_add_ps(z11, z4);
+    d[7] = _mm256_sub_ps(z11, z4);
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline void Transpose8x8Avx2(__m256* r) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Same operations in the same order as TransformBlockScalar, so the coefficients match.
+// Transposed, each lane runs one row's DCT; transposed back, one column's.
+PIXEL_KERNELS_AVX2_TARGET inline void TransformBlockAvx2(const float* block, const QuantTable& quant, int* coefficients) {
+    __m256 rows[8];
+    for (int r = 0; r < 8; ++r) rows[r] = _mm256_loadu_ps(block + r * 8);
+    Transpose8x8Avx2(rows);
+    Fdct8Avx2(rows);
+    Transpose8x8Avx2(rows);
+    Fdct8Avx2(rows);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (int r = 0; r < 8; ++r) {
+        __m256 v = _mm256_mul_ps(rows[r], _mm256_loadu_ps(quant.scale + r * 8));
+        v = _mm256_add_ps(v, _mm256_or_ps(_mm256_and_ps(v, sign), half));      // Round half away from zero
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(coefficients + r * 8), _mm256_cvttps_epi32(v));
+    }
+}
+#endif
+
+// Codes one block's coefficients (natural order); returns its DC for prediction
+inline int EncodeCoefficients(JpegBitWriter& bits, const int* coefficients, const HuffmanCodes& dc, const HuffmanCodes& ac, int previousDc) {
+    PutCoefficient(bits, dc, 0, coefficients[0] - previousDc);
+    int run = 0;
+    for (int i = 1; i < 64; ++i) {
+        int value = coefficients[kZigzag[i]];
+        if (value == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            bits.Put(ac.code[0xF0], ac.length[0xF0]);
+            run -= 16;
+        }
+        PutCoefficient(bits, ac, run, std::min(std::max(value, -1023), 1023));
+        run = 0;
+    }
+    if (run) bits.Put(ac.code[0x00], ac.length[0x00]);
+    return coefficients[0];
+}
+
+// Transforms, quantizes and codes one 8x8 block of samples; returns its DC for prediction
+inline int EncodeBlock(JpegBitWriter& bits, float* block, const QuantTable& quant, const HuffmanCodes& dc, const HuffmanCodes& ac,
+                       int previousDc, bool avx2) {
+    int coefficients[64];
+#ifdef PIXEL_KERNELS_X86
+    if (avx2) TransformBlockAvx2(block, quant, coefficients);
+    else TransformBlockScalar(block, quant, coefficients);
+#else
+    (void)avx2;
+    TransformBlockScalar(block, quant, coefficients);
+#endif
+    return EncodeCoefficients(bits, coefficients, dc, ac, previousDc);
+}
+
+// 8x8 samples at (x, y) of a plane, level shifted; past the right/bottom edge the last
+// column/row repeats
+inline void LoadBlock(const uint8_t* plane, size_t pitch, uint32_t width, uint32_t height, uint32_t x, uint32_t y, float* block) {
+    for (uint32_t r = 0; r < 8; ++r) {
+        const uint8_t* row = plane + std::min(y + r, height - 1) * pitch;
+        if (x + 8 <= width) {
+            for (uint32_t c = 0; c < 8; ++c) block[r * 8 + c] = row[x + c] - 128.0f;
+        }
+        else {
+            for (uint32_t c = 0; c < 8; ++c) block[r * 8 + c] = row[std::min(x + c, width - 1)] - 128.0f;
+        }
+    }
+}
+
+struct JpegTables {
+    QuantTable luma;
+    QuantTable chroma;
+};
+
+// MCU rows [firstMcuRow, endMcuRow) of an I420 frame as one entropy-coded segment
+inline void EncodeStrip(const YuvPlanes& planes, uint32_t width, uint32_t height, const JpegTables& tables,
+                        uint32_t firstMcuRow, uint32_t endMcuRow, bool avx2, std::vector<uint8_t>& out) {
+    const HuffmanSet& huffman = StandardHuffman();
+    const uint32_t chromaWidth = YuvChromaWidth(width), chromaHeight = YuvChromaHeight(height);
+    JpegBitWriter bits(out);
+    float block[64];
+    int dcY = 0, dcU = 0, dcV = 0;
+    for (uint32_t my = firstMcuRow; my < endMcuRow; ++my) {
+        for (uint32_t mx = 0; mx * 16 < width; ++mx) {
+            for (uint32_t b = 0; b < 4; ++b) {
+                LoadBlock(planes.y, planes.yPitch, width, height, mx * 16 + (b & 1) * 8, my * 16 + (b >> 1) * 8, block);
+                dcY = EncodeBlock(bits, block, tables.luma, huffman.dcLuma, huffman.acLuma, dcY, avx2);
+            }
+            LoadBlock(planes.u, planes.uPitch, chromaWidth, chromaHeight, mx * 8, my * 8, block);
+            dcU = EncodeBlock(bits, block, tables.chroma, huffman.dcChroma, huffman.acChroma, dcU, avx2);
+            LoadBlock(planes.v, planes.vPitch, chromaWidth, chromaHeight, mx * 8, my * 8, block);
+            dcV = EncodeBlock(bits, block, tables.chroma, huffman.dcChroma, huffman.acChroma, dcV, avx2);
+        }
+    }
+    bits.Flush();
+}
+
+inline void PutMarker(std::vector<uint8_t>& out, uint8_t marker) {
+    out.push_back(0xFF);
+    out.push_back(marker);
+}
+
+inline void PutWord(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void PutHuffmanTable(std::vector<uint8_t>& out, uint8_t classAndId, const uint8_t* bits, const uint8_t* values) {
+    size_t count = 0;
+    for (int i = 0; i < 16; ++i) count += bits[i];
+    out.push_back(classAndId);
+    out.insert(out.end(), bits, bits + 16);
+    out.insert(out.end(), values, values + count);
+}
+
+inline void AppendJpegHeaders(std::vector<uint8_t>& out, uint32_t width, uint32_t height, const JpegTables& tables, uint32_t restartInterval) {
+    static const uint8_t jfif[] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    PutMarker(out, 0xD8);                                   // SOI
+    PutMarker(out, 0xE0);                                   // APP0: JFIF 1.01, no thumbnail
+    PutWord(out, 2 + sizeof(jfif));
+    out.insert(out.end(), jfif, jfif + sizeof(jfif));
+    PutMarker(out, 0xDB);                                   // DQT: 8-bit tables 0 and 1
+    PutWord(out, 2 + 2 * 65);
+    out.push_back(0);
+    out.insert(out.end(), tables.luma.zigzag, tables.luma.zigzag + 64);
+    out.push_back(1);
+    out.insert(out.end(), tables.chroma.zigzag, tables.chroma.zigzag + 64);
+    PutMarker(out, 0xC0);                                   // SOF0: Y 2x2, Cb and Cr 1x1
+    PutWord(out, 8 + 3 * 3);
+    out.push_back(8);
+    PutWord(out, height);
+    PutWord(out, width);
+    out.push_back(3);
+    const uint8_t components[9] = { 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    out.insert(out.end(), components, components + 9);
+    PutMarker(out, 0xC4);                                   // DHT: the four Annex K tables
+    PutWord(out, 2 + 4 * 17 + 12 + 162 + 12 + 162);
+    PutHuffmanTable(out, 0x00, kDcLumaBits, kDcValues);
+    PutHuffmanTable(out, 0x10, kAcLumaBits, kAcLumaValues);
+    PutHuffmanTable(out, 0x01, kDcChromaBits, kDcValues);
+    PutHuffmanTable(out, 0x11, kAcChromaBits, kAcChromaValues);
+    if (restartInterval) {
+        PutMarker(out, 0xDD);                               // DRI
+        PutWord(out, 4);
+        PutWord(out, restartInterval);
+    }
+    PutMarker(out, 0xDA);                                   // SOS: all three components
+    PutWord(out, 6 + 2 * 3);
+    out.push_back(3);
+    const uint8_t scan[9] = { 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+    out.insert(out.end(), scan, scan + 9);
+}
+
+}  // namespace JpegDetail
+
+// Default strip height: enough strips for every core of a big machine without making the
+// restart markers (2 bytes each) or the per-strip bit flush noticeable
+inline uint32_t DefaultJpegStripMcuRows(uint32_t width) {
+    uint32_t mcusPerRow = (width + 15) / 16;
+    return std::max<uint32_t>(1, std::min<uint32_t>(4, 65535 / std::max<uint32_t>(mcusPerRow, 1)));
+}
+
+// Buffers EncodeJpeg() reuses across frames: the YUV frame and each strip's coded bytes
+struct JpegScratch {
+    std::vector<uint8_t> yuv;
+    std::vector<std::vector<uint8_t>> segments;
+};
+
+// Encodes 'image' (BGRA) as a baseline JPEG into 'out'. Strips run on 'pool' when given.
+// An unsupported level falls back to the best one available; every level writes the same bytes.
+inline bool EncodeJpeg(const ImageView& image, std::vector<uint8_t>& out, const JpegWriteOptions& options = JpegWriteOptions(),
+                       ThreadPool* pool = nullptr, JpegScratch* scratch = nullptr, PixelKernelLevel level = BestPixelKernelLevel()) {
+    out.clear();
+    if (image.Empty() || image.width > 65535 || image.height > 65535) return false;
+    if (!PixelKernelLevelSupported(level)) level = BestPixelKernelLevel();
+    const bool avx2 = level == PixelKernelLevel::Avx2;
+    const uint32_t width = image.width, height = image.height;
+    const uint32_t mcusPerRow = (width + 15) / 16, mcuRows = (height + 15) / 16;
+    uint32_t stripRows = options.stripMcuRows ? options.stripMcuRows : DefaultJpegStripMcuRows(width);
+    stripRows = std::max<uint32_t>(1, std::min(stripRows, 65535 / mcusPerRow));
+    const uint32_t strips = (mcuRows + stripRows - 1) / stripRows;
+
+    JpegDetail::JpegTables tables;
+    JpegDetail::BuildQuantTable(JpegDetail::kLumaQuant, options.quality, tables.luma);
+    JpegDetail::BuildQuantTable(JpegDetail::kChromaQuant, options.quality, tables.chroma);
+
+    JpegScratch localScratch;
+    JpegScratch& buffers = scratch ? *scratch : localScratch;
+    buffers.yuv.resize(YuvFrameBytes(width, height));
+    const YuvPlanes planes = PackedYuvPlanes(buffers.yuv.data(), width, height, YuvLayout::I420);
+    YuvOptions yuvOptions;
+    yuvOptions.layout = YuvLayout::I420;
+    yuvOptions.matrix = YuvMatrix::Bt601;
+    yuvOptions.fullRange = true;
+
+    // Each strip converts its own rows (16-row aligned, so whole chroma rows) and codes them
+    std::vector<std::vector<uint8_t>>& segments = buffers.segments;
+    segments.resize(strips);
+    auto encodeStrip = [&](size_t s) {
+        uint32_t firstRow = static_cast<uint32_t>(s) * stripRows * 16;
+        uint32_t rows = std::min(stripRows * 16, height - firstRow);
+        YuvPlanes stripPlanes = planes;
+        stripPlanes.y += static_cast<size_t>(firstRow) * planes.yPitch;
+        stripPlanes.u += static_cast<size_t>(firstRow / 2) * planes.uPitch;
+        stripPlanes.v += static_cast<size_t>(firstRow / 2) * planes.vPitch;
+        ConvertToYuv(image.Crop(0, firstRow, width, rows), stripPlanes, yuvOptions, nullptr, level);
+        segments[s].clear();
+        uint32_t first = static_cast<uint32_t>(s) * stripRows;
+        JpegDetail::EncodeStrip(planes, width, height, tables, first, std::min(first + stripRows, mcuRows), avx2, segments[s]);
+    };
+    if (pool && strips > 1) pool->ParallelFor(strips, encodeStrip);
+    else for (uint32_t s = 0; s < strips; ++s) encodeStrip(s);
+
+    // Blocks past the bottom edge repeat the last row, which the last strip converted
+    // itself, so no strip reads rows another one is still writing
+    size_t total = 700;
+    for (uint32_t s = 0; s < strips; ++s) total += segments[s].size() + 2;
+    out.reserve(total);
+    JpegDetail::AppendJpegHeaders(out, width, height, tables, strips > 1 ? stripRows * mcusPerRow : 0);
+    for (uint32_t s = 0; s < strips; ++s) {
+        if (s > 0) JpegDetail::PutMarker(out, static_cast<uint8_t>(0xD0 + (s - 1) % 8));   // RSTn
+        out.insert(out.end(), segments[s].begin(), segments[s].end());
+    }
+    JpegDetail::PutMarker(out, 0xD9);                       // EOI
+    return true;
+}
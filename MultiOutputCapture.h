@@ -0,0 +1,324 @@
+#pragma once
+// Captures every output of every adapter at once: one source per output, each polled
+// on its own thread. Frames are matched across outputs by present time into composite
+// snapshots, so one snapshot shows all monitors at (nearly) the same moment.
+// Nothing here touches D3D; the DXGI source lives in ScreenRecorderCustom.cpp and
+// MultiOutputHeadless.cpp drives the same code with synthetic outputs.
+#include "FramePacer.h"
+#include "FramePipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where an output sits on the virtual desktop (DXGI_OUTPUT_DESC::DesktopCoordinates)
+struct OutputDesc {
+    std::string name;
+    int32_t left = 0;
+    int32_t top = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+struct OutputFrame {
+    uint32_t output = 0;
+    uint64_t frameIndex = 0;        // Per-output counter
+    int64_t timestampNs = 0;        // Present time; all outputs must share one clock
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;
+    std::shared_ptr<const std::vector<uint8_t>> pixels;  // BGRA; shared so a held frame is free to reuse
+};
+
+enum class OutputPollResult {
+    Frame,  // 'frame' holds a new image
+    Idle,   // Nothing new was presented up to frame.timestampNs
+    End,    // Source is finished
+    Error   // Source failed and will not produce more frames
+};
+
+class OutputFrameSource {
+public:
+    virtual ~OutputFrameSource() = default;
+    virtual const OutputDesc& Desc() const = 0;
+    // Should return within a bounded time (Idle on timeout) so Stop() is honoured
+    virtual OutputPollResult Poll(OutputFrame& frame) = 0;
+};
+
+struct CompositeSnapshot {
+    uint64_t index = 0;
+    int64_t referenceNs = 0;        // Moment the snapshot represents
+    int64_t skewNs = 0;             // Spread of present times among the fresh frames
+    uint32_t freshOutputs = 0;      // Outputs with a new frame; the rest hold their last image
+    std::vector<OutputFrame> frames;    // One per output, indexed by output
+};
+
+struct SnapshotMatcherStats {
+    uint64_t framesIn = 0;
+    uint64_t snapshots = 0;
+    uint64_t coalesced = 0;     // Frames superseded by a newer one from the same output in one window
+    uint64_t held = 0;          // Output slots filled with a previous frame (output was idle)
+    uint64_t unmatched = 0;     // Frames dropped before every output had produced an image
+    JitterStats skew;           // Cross-output spread per snapshot
+};
+
+// Watermark join over per-output frame streams. A window opens at the oldest pending
+// frame and spans 'toleranceNs'; it is closed once every output has reported (a frame
+// or an idle poll) past the window's end, so a late output can no longer land in it.
+// Each output contributes its newest frame inside the window, or holds its last one.
+class SnapshotMatcher {
+public:
+    SnapshotMatcher(size_t outputCount, int64_t toleranceNs)
+        : m_outputs(outputCount), m_tolerance(toleranceNs) {}
+
+    size_t OutputCount() const { return m_outputs.size(); }
+
+    void OnFrame(const OutputFrame& frame) {
+        OutputState& state = m_outputs[frame.output];
+        state.pending.push_back(frame);
+        state.watermark = std::max(state.watermark, frame.timestampNs);
+        m_stats.framesIn++;
+    }
+
+    void OnIdle(uint32_t output, int64_t nowNs) {
+        OutputState& state = m_outputs[output];
+        state.watermark = std::max(state.watermark, nowNs);
+    }
+
+    // An ended output never blocks a window again; it keeps showing its last image
+    void OnEnd(uint32_t output) {
+        m_outputs[output].watermark = INT64_MAX;
+    }
+
+    // Returns true and fills 'snapshot' when the oldest window can be closed
+    bool TryMatch(CompositeSnapshot& snapshot) {
+        while (true) {
+            int64_t reference = INT64_MAX;
+            for (const OutputState& state : m_outputs) {
+                if (!state.pending.empty()) reference = std::min(reference, state.pending.front().timestampNs);
+            }
+            if (reference == INT64_MAX) return false;
+
+            int64_t windowEnd = reference + m_tolerance;
+            for (const OutputState& state : m_outputs) {
+                if (state.watermark < windowEnd) return false;
+            }
+
+            bool complete = true;
+            for (OutputState& state : m_outputs) {
+                uint64_t popped = 0;
+                while (!state.pending.empty() && state.pending.front().timestampNs <= windowEnd) {
+                    state.last = std::move(state.pending.front());
+                    state.pending.pop_front();
+                    state.hasLast = true;
+                    popped++;
+                }
+                state.fresh = popped > 0;
+                if (popped > 1) m_stats.coalesced += popped - 1;
+                if (!state.hasLast) complete = false;
+            }
+
+            // Some output has not shown anything yet; these frames only seed the held images
+            if (!complete) {
+                for (const OutputState& state : m_outputs) {
+                    if (state.fresh) m_stats.unmatched++;
+                }
+                continue;
+            }
+
+            snapshot.index = m_stats.snapshots++;
+            snapshot.referenceNs = reference;
+            snapshot.freshOutputs = 0;
+            snapshot.frames.resize(m_outputs.size());
+            int64_t earliest = INT64_MAX;
+            int64_t latest = INT64_MIN;
+            for (size_t i = 0; i < m_outputs.size(); ++i) {
+                const OutputState& state = m_outputs[i];
+                snapshot.frames[i] = state.last;
+                if (state.fresh) {
+                    snapshot.freshOutputs++;
+                    earliest = std::min(earliest, state.last.timestampNs);
+                    latest = std::max(latest, state.last.timestampNs);
+                }
+                else {
+                    m_stats.held++;
+                }
+            }
+            snapshot.skewNs = latest - earliest;
+            m_stats.skew.Add(snapshot.skewNs);
+            return true;
+        }
+    }
+
+    const SnapshotMatcherStats& Stats() const { return m_stats; }
+
+private:
+    struct OutputState {
+        std::deque<OutputFrame> pending;
+        int64_t watermark = INT64_MIN;
+        OutputFrame last;
+        bool hasLast = false;
+        bool fresh = false;
+    };
+
+    std::vector<OutputState> m_outputs;
+    int64_t m_tolerance;
+    SnapshotMatcherStats m_stats;
+};
+
+struct OutputCaptureStats {
+    std::string name;
+    uint64_t frames = 0;
+    uint64_t idlePolls = 0;
+    bool failed = false;
+};
+
+// Runs one thread per source and hands out matched snapshots in order
+class MultiOutputCapture {
+public:
+    MultiOutputCapture(std::vector<std::unique_ptr<OutputFrameSource>> sources, int64_t toleranceNs, size_t queueDepth = 4)
+        : m_sources(std::move(sources)), m_matcher(m_sources.size(), toleranceNs), m_snapshots(queueDepth) {
+        m_outputStats.resize(m_sources.size());
+        for (size_t i = 0; i < m_sources.size(); ++i) {
+            m_outputStats[i].name = m_sources[i]->Desc().name;
+        }
+    }
+
+    ~MultiOutputCapture() {
+        Stop();
+        Wait();
+    }
+
+    size_t OutputCount() const { return m_sources.size(); }
+    const OutputDesc& Desc(size_t output) const { return m_sources[output]->Desc(); }
+
+    void Start() {
+        m_running = m_sources.size();
+        for (size_t i = 0; i < m_sources.size(); ++i) {
+            m_threads.emplace_back(&MultiOutputCapture::RunOutput, this, static_cast<uint32_t>(i));
+        }
+        if (m_sources.empty()) m_snapshots.Close();
+    }
+
+    // Capture threads finish their current poll and exit; queued snapshots are discarded
+    void Stop() {
+        m_stopRequested = true;
+        m_snapshots.Close();
+    }
+
+    void Wait() {
+        for (std::thread& t : m_threads) {
+            if (t.joinable()) t.join();
+        }
+        m_threads.clear();
+    }
+
+    // Blocks for the next snapshot; false once every source has ended and all are drained
+    bool NextSnapshot(CompositeSnapshot& snapshot) {
+        return m_snapshots.Pop(snapshot);
+    }
+
+    SnapshotMatcherStats MatcherStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_matcher.Stats();
+    }
+
+    std::vector<OutputCaptureStats> OutputStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_outputStats;
+    }
+
+private:
+    void RunOutput(uint32_t output) {
+        OutputFrameSource& source = *m_sources[output];
+        OutputFrame frame;
+        while (!m_stopRequested) {
+            frame.output = output;
+            OutputPollResult result = source.Poll(frame);
+            frame.output = output;
+
+            // Matching and pushing under one lock keeps snapshots in order across threads;
+            // a full queue blocks every capture thread, which is the backpressure we want
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (result == OutputPollResult::Frame) {
+                m_outputStats[output].frames++;
+                m_matcher.OnFrame(frame);
+            }
+            else if (result == OutputPollResult::Idle) {
+                m_outputStats[output].idlePolls++;
+                m_matcher.OnIdle(output, frame.timestampNs);
+            }
+            else {
+                m_outputStats[output].failed = result == OutputPollResult::Error;
+                break;
+            }
+            PushMatched();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_matcher.OnEnd(output);
+        PushMatched();
+        if (--m_running == 0) {
+            m_snapshots.Close();
+        }
+    }
+
+    void PushMatched() {
+        CompositeSnapshot snapshot;
+        while (m_matcher.TryMatch(snapshot)) {
+            if (!m_snapshots.Push(std::move(snapshot))) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<OutputFrameSource>> m_sources;
+    std::mutex m_mutex;
+    SnapshotMatcher m_matcher;
+    std::vector<OutputCaptureStats> m_outputStats;
+    BoundedQueue<CompositeSnapshot> m_snapshots;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stopRequested{ false };
+    size_t m_running = 0;
+};
+
+// Place every output's image at its desktop position in one BGRA buffer.
+// Uncovered areas (outputs of different sizes) are left opaque black.
+inline void ComposeSnapshot(const CompositeSnapshot& snapshot, const std::vector<OutputDesc>& outputs,
+                            std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height) {
+    int32_t minX = INT32_MAX, minY = INT32_MAX, maxX = INT32_MIN, maxY = INT32_MIN;
+    for (const OutputDesc& desc : outputs) {
+        minX = std::min(minX, desc.left);
+        minY = std::min(minY, desc.top);
+        maxX = std::max(maxX, desc.left + static_cast<int32_t>(desc.width));
+        maxY = std::max(maxY, desc.top + static_cast<int32_t>(desc.height));
+    }
+    if (outputs.empty()) {
+        width = height = 0;
+        pixels.clear();
+        return;
+    }
+
+    width = static_cast<uint32_t>(maxX - minX);
+    height = static_cast<uint32_t>(maxY - minY);
+    size_t pitch = static_cast<size_t>(width) * 4;
+    pixels.assign(pitch * height, 0);
+    for (size_t i = 3; i < pixels.size(); i += 4) pixels[i] = 0xFF;
+
+    for (size_t i = 0; i < outputs.size() && i < snapshot.frames.size(); ++i) {
+        const OutputFrame& frame = snapshot.frames[i];
+        if (!frame.pixels) continue;
+        uint32_t copyWidth = std::min(frame.width, outputs[i].width);
+        uint32_t copyHeight = std::min(frame.height, outputs[i].height);
+        size_t x = static_cast<size_t>(outputs[i].left - minX);
+        size_t y = static_cast<size_t>(outputs[i].top - minY);
+        for (uint32_t row = 0; row < copyHeight; ++row) {
+            std::memcpy(pixels.data() + (y + row) * pitch + x * 4, frame.pixels->data() + static_cast<size_t>(row) * frame.rowPitch, static_cast<size_t>(copyWidth) * 4);
+        }
+    }
+}
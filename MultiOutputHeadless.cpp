@@ -0,0 +1,187 @@
+// Drives MultiOutputCapture with synthetic outputs of different sizes and refresh
+// rates, the way ScreenRecorderCustom drives it with one DXGI duplication per output.
+// First replays the outputs through SnapshotMatcher on a simulated clock (deterministic),
+// then runs them for real on one thread each and composes the snapshots.
+// Usage: MultiOutputHeadless [seconds] [toleranceMs]
+#include "MultiOutputCapture.h"
+#include "SyntheticFrameSource.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+struct SyntheticOutputConfig {
+    OutputDesc desc;
+    double fps;                 // Present rate while the output is busy
+    SyntheticPattern pattern;
+    double jitterMs;            // Standard deviation of present times
+};
+
+std::vector<SyntheticOutputConfig> DefaultOutputs() {
+    return {
+        { { "DISPLAY1 2560x1440@144", 0, 0, 2560, 1440 }, 144.0, SyntheticPattern::ScrollingText, 0.3 },
+        { { "DISPLAY2 1920x1080@60", 2560, 180, 1920, 1080 }, 60.0, SyntheticPattern::Noise, 0.5 },
+        { { "DISPLAY3 1280x1024 idle", -1280, 0, 1280, 1024 }, 1.0, SyntheticPattern::Static, 0.0 },
+    };
+}
+
+// Presents on its own schedule; polls time out like AcquireNextFrame(timeoutMs)
+class SyntheticOutputSource : public OutputFrameSource {
+public:
+    SyntheticOutputSource(const SyntheticOutputConfig& config, std::chrono::steady_clock::time_point epoch, uint32_t seed, uint32_t timeoutMs = 16)
+        : m_config(config), m_frames(config.desc.width, config.desc.height, config.pattern), m_epoch(epoch),
+          m_rng(seed), m_jitter(0.0, config.jitterMs * 1e6), m_timeoutNs(timeoutMs * 1000000ll) {
+        m_nextPresent = 0;  // Like a fresh duplication, the first poll returns the current image
+    }
+
+    const OutputDesc& Desc() const override { return m_config.desc; }
+
+    OutputPollResult Poll(OutputFrame& frame) override {
+        int64_t now = NowNs();
+        if (m_nextPresent > now + m_timeoutNs) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(m_timeoutNs));
+            frame.timestampNs = NowNs();
+            return OutputPollResult::Idle;
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<int64_t>(0, m_nextPresent - now)));
+
+        // Reuse the buffer unless a snapshot still holds it
+        if (!m_buffer || m_buffer.use_count() > 1) {
+            m_buffer = std::make_shared<std::vector<uint8_t>>(m_frames.FrameBytes());
+        }
+        m_frames.RenderFrame(m_buffer->data(), m_index);
+        frame.frameIndex = m_index++;
+        frame.timestampNs = m_nextPresent;
+        frame.width = m_frames.Width();
+        frame.height = m_frames.Height();
+        frame.rowPitch = m_frames.RowPitch();
+        frame.pixels = m_buffer;
+        m_nextPresent = NextPresentAfter(m_nextPresent);
+        return OutputPollResult::Frame;
+    }
+
+private:
+    int64_t NowNs() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+    }
+
+    int64_t NextPresentAfter(int64_t t) {
+        int64_t next = t + static_cast<int64_t>(1e9 / m_config.fps + (m_config.jitterMs > 0 ? m_jitter(m_rng) : 0.0));
+        return std::max(next, t + 1);
+    }
+
+    SyntheticOutputConfig m_config;
+    SyntheticFrameSource m_frames;
+    std::chrono::steady_clock::time_point m_epoch;
+    std::mt19937 m_rng;
+    std::normal_distribution<double> m_jitter;
+    int64_t m_timeoutNs;
+    int64_t m_nextPresent;
+    uint64_t m_index = 0;
+    std::shared_ptr<std::vector<uint8_t>> m_buffer;
+};
+
+void PrintMatcherStats(const SnapshotMatcherStats& stats) {
+    std::cout << "  frames in " << stats.framesIn << ", snapshots " << stats.snapshots << ", coalesced " << stats.coalesced
+              << ", held " << stats.held << ", unmatched " << stats.unmatched << std::endl;
+    std::cout << "  skew mean " << stats.skew.MeanMs() << " ms, p99 " << stats.skew.PercentileMs(99)
+              << " ms, max " << stats.skew.MaxMs() << " ms" << std::endl;
+}
+
+// Feed the matcher from per-output timelines in global time order, with idle polls
+// every 16 ms like a real AcquireNextFrame timeout. No threads, same result every run.
+SnapshotMatcherStats SimulateMatching(const std::vector<SyntheticOutputConfig>& outputs, int seconds, int64_t toleranceNs) {
+    struct Event { int64_t time; uint32_t output; bool frame; };
+    std::vector<Event> events;
+    std::mt19937 rng(7);
+    const int64_t end = seconds * 1000000000ll;
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        std::normal_distribution<double> jitter(0.0, outputs[i].jitterMs * 1e6);
+        events.push_back({ 0, i, true });
+        for (int64_t t = 0; t < end;) {
+            t += std::max<int64_t>(1, static_cast<int64_t>(1e9 / outputs[i].fps + (outputs[i].jitterMs > 0 ? jitter(rng) : 0.0)));
+            events.push_back({ t, i, true });
+        }
+        for (int64_t t = 16000000; t < end; t += 16000000) {
+            events.push_back({ t, i, false });
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.time < b.time; });
+
+    SnapshotMatcher matcher(outputs.size(), toleranceNs);
+    CompositeSnapshot snapshot;
+    std::vector<uint64_t> counters(outputs.size(), 0);
+    int64_t lastReference = INT64_MIN;
+    bool ordered = true;
+    auto drain = [&] {
+        while (matcher.TryMatch(snapshot)) {
+            ordered = ordered && snapshot.referenceNs >= lastReference;
+            lastReference = snapshot.referenceNs;
+        }
+    };
+    for (const Event& e : events) {
+        if (e.frame) {
+            OutputFrame frame;
+            frame.output = e.output;
+            frame.frameIndex = counters[e.output]++;
+            frame.timestampNs = e.time;
+            matcher.OnFrame(frame);
+        }
+        else {
+            matcher.OnIdle(e.output, e.time);
+        }
+        drain();
+    }
+    for (uint32_t i = 0; i < outputs.size(); ++i) matcher.OnEnd(i);
+    drain();
+    if (!ordered) std::cout << "  ERROR: snapshots out of order" << std::endl;
+    return matcher.Stats();
+}
+
+int main(int argc, char** argv) {
+    int seconds = argc > 1 ? std::stoi(argv[1]) : 3;
+    int64_t tolerance = static_cast<int64_t>((argc > 2 ? std::stod(argv[2]) : 4.0) * 1e6);
+    std::vector<SyntheticOutputConfig> outputs = DefaultOutputs();
+
+    std::cout << "Simulated " << seconds << " s, " << outputs.size() << " outputs, tolerance " << tolerance / 1e6 << " ms" << std::endl;
+    PrintMatcherStats(SimulateMatching(outputs, seconds, tolerance));
+
+    std::vector<std::unique_ptr<OutputFrameSource>> sources;
+    std::vector<OutputDesc> descs;
+    auto epoch = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        sources.emplace_back(new SyntheticOutputSource(outputs[i], epoch, static_cast<uint32_t>(i + 1)));
+        descs.push_back(outputs[i].desc);
+    }
+
+    MultiOutputCapture capture(std::move(sources), tolerance);
+    capture.Start();
+
+    CompositeSnapshot snapshot;
+    std::vector<uint8_t> composite;
+    uint32_t width = 0, height = 0;
+    uint64_t received = 0;
+    uint64_t lastIndex = 0;
+    bool ordered = true;
+    auto stopAt = epoch + std::chrono::seconds(seconds);
+    while (capture.NextSnapshot(snapshot)) {
+        ordered = ordered && (received == 0 || snapshot.index > lastIndex);
+        lastIndex = snapshot.index;
+        received++;
+        ComposeSnapshot(snapshot, descs, composite, width, height);
+        if (std::chrono::steady_clock::now() >= stopAt) break;
+    }
+    capture.Stop();
+    capture.Wait();
+
+    std::cout << "\nLive " << seconds << " s: " << received << " snapshots composed at " << width << "x" << height << std::endl;
+    for (const OutputCaptureStats& s : capture.OutputStats()) {
+        std::cout << "  " << s.name << ": " << s.frames << " frames, " << s.idlePolls << " idle polls" << std::endl;
+    }
+    PrintMatcherStats(capture.MatcherStats());
+    if (!ordered) {
+        std::cout << "ERROR: snapshots out of order" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Replays a frame-arrival trace through FramePacer on a simulated clock and prints
+// jitter statistics for each policy. No D3D needed.
+// Usage: PacingSimulator [trace.txt] [targetFps] [serviceLatencyMs]
+// Without a trace, a 144 Hz desktop with jitter, bursts and a stall is generated.
+#include "FramePacer.h"
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+std::vector<FrameArrival> GenerateSyntheticArrivals(int seconds) {
+    std::vector<FrameArrival> trace;
+    std::mt19937 rng(42);
+    std::normal_distribution<double> jitter(0.0, 0.4e6);
+    const double interval = 1e9 / 144.0;
+
+    double t = 1e9;
+    for (int i = 0; i < seconds * 144; ++i) {
+        t += interval + jitter(rng);
+        // A half-second stall every 10 seconds, then DXGI reports the backlog as accumulated
+        if (i % 1440 == 700) {
+            t += 0.5e9;
+            trace.push_back({ static_cast<int64_t>(t), 72 });
+            continue;
+        }
+        // Idle desktop stretches with no presents at all
+        if ((i / 144) % 7 == 3) continue;
+        trace.push_back({ static_cast<int64_t>(t), 1 });
+    }
+    return trace;
+}
+
+int main(int argc, char** argv) {
+    std::vector<FrameArrival> trace;
+    if (argc > 1) {
+        std::ifstream in(argv[1]);
+        size_t skipped = 0;
+        if (!in || !ReadArrivalTrace(in, trace, &skipped)) {
+            std::cerr << "Failed to read arrival trace: " << argv[1] << std::endl;
+            return -1;
+        }
+        std::cout << "Loaded " << trace.size() << " arrivals from " << argv[1] << std::endl;
+        if (skipped) std::cerr << "Skipped " << skipped << " malformed lines" << std::endl;
+    }
+    else {
+        trace = GenerateSyntheticArrivals(60);
+        std::cout << "Generated " << trace.size() << " synthetic arrivals" << std::endl;
+    }
+
+    FramePacerConfig config;
+    config.targetFps = argc > 2 ? std::stod(argv[2]) : 60.0;
+    int64_t serviceLatency = argc > 3 ? static_cast<int64_t>(std::stod(argv[3]) * 1e6) : 0;
+
+    config.policy = PacingPolicy::DuplicateLast;
+    std::cout << "\nDuplicateLast @ " << config.targetFps << " fps" << std::endl;
+    WritePacingStats(std::cout, SimulatePacing(trace, config, serviceLatency));
+
+    config.policy = PacingPolicy::SkipTick;
+    std::cout << "\nSkipTick @ " << config.targetFps << " fps" << std::endl;
+    WritePacingStats(std::cout, SimulatePacing(trace, config, serviceLatency));
+    return 0;
+}
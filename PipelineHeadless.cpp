@@ -0,0 +1,130 @@
+// Runs the capture -> readback -> encode -> write pipeline against a
+// synthetic frame source, once sequentially and once pipelined, and prints the
+// throughput of each so the overlap can be measured without a GPU.
+// Usage: PipelineHeadless [frames] [static|scroll|noise|typing|video] [output file or -] [columns rows]
+#include "FramePipeline.h"
+#include "ScreenCodec.h"
+#include "SyntheticFrameSource.h"
+#include "TileLayout.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+std::vector<PipelineStage> BuildStages(SyntheticFrameSource& source, const TileLayout& layout, std::ofstream& output) {
+    std::vector<PipelineStage> stages;
+
+    stages.push_back({ "acquire", [&source, &layout](PipelineFrame& frame) {
+        SyntheticFrameInfo info;
+        if (!source.AcquireNextFrame(frame.desktop, info)) return false;
+        frame.frameIndex = info.frameIndex;
+        frame.timestamp = info.lastPresentTime;
+        frame.width = source.Width();
+        frame.height = source.Height();
+        frame.tileWidth = layout.tileWidth;
+        frame.tileHeight = layout.tileHeight;
+        return true;
+    } });
+
+    // Equivalent of one full-frame CopyResource into staging + Map; the tiles are views
+    // into the mapped frame, so nothing is split or copied on the CPU
+    stages.push_back({ "readback", [&layout](PipelineFrame& frame) {
+        frame.frameView = ImageView(frame.desktop.data(), frame.width, frame.height, static_cast<size_t>(frame.width) * 4);
+        BuildTileViews(frame.frameView, layout, frame.tileViews);
+        return true;
+    } });
+
+    stages.push_back({ "encode", [](PipelineFrame& frame) {
+        frame.encoded.resize(frame.tileViews.size());
+        for (size_t t = 0; t < frame.tileViews.size(); ++t) {
+            frame.encoded[t].clear();
+            EncodeScreenFrame(frame.tileViews[t], frame.encoded[t]);
+        }
+        return true;
+    } });
+
+    stages.push_back({ "write", [&output](PipelineFrame& frame) {
+        if (output.is_open()) {
+            for (const std::vector<uint8_t>& encoded : frame.encoded) {
+                output.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+            }
+        }
+        return true;
+    } });
+
+    return stages;
+}
+
+SyntheticPattern ParsePattern(const std::string& name) {
+    if (name == "static") return SyntheticPattern::Static;
+    if (name == "noise") return SyntheticPattern::Noise;
+    if (name == "typing") return SyntheticPattern::Typing;
+    if (name == "video") return SyntheticPattern::Video;
+    return SyntheticPattern::ScrollingText;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frameCount = argc > 1 ? std::stoull(argv[1]) : 120;
+    SyntheticPattern pattern = ParsePattern(argc > 2 ? argv[2] : "scroll");
+    std::string outputPath = argc > 3 ? argv[3] : "-";
+
+    TileLayoutConfig tileConfig;
+    if (argc > 5) {
+        tileConfig.columns = std::stoul(argv[4]);
+        tileConfig.rows = std::stoul(argv[5]);
+    }
+    TileLayout layout;
+    if (!BuildTileLayout(5120, 1440, tileConfig, layout)) {
+        std::cerr << "Tile layout does not fit a 5120x1440 desktop." << std::endl;
+        return -1;
+    }
+
+    std::ofstream output;
+    if (outputPath != "-") {
+        output.open(outputPath, std::ios::binary);
+        if (!output) {
+            std::cerr << "Failed to open output file: " << outputPath << std::endl;
+            return -1;
+        }
+    }
+
+    // Sequential baseline: every stage back to back on one thread, like CaptureFrame()
+    double sequentialFps = 0.0;
+    {
+        SyntheticFrameSource source(5120, 1440, pattern, 0.0, frameCount);
+        std::vector<PipelineStage> stages = BuildStages(source, layout, output);
+        PipelineFrame frame;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t frames = 0;
+        while (stages[0].process(frame)) {
+            for (size_t i = 1; i < stages.size(); ++i) {
+                stages[i].process(frame);
+            }
+            frames++;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sequentialFps = frames / seconds;
+        std::cout << "Sequential: " << frames << " frames, " << sequentialFps << " fps" << std::endl;
+    }
+
+    // Pipelined: one worker per stage, bounded queues between them
+    SyntheticFrameSource source(5120, 1440, pattern, 0.0, frameCount);
+    FramePipeline pipeline(BuildStages(source, layout, output), 6, 2);
+    const std::vector<PipelineStageStats>& stats = pipeline.Run();
+    double pipelinedFps = pipeline.CompletedFrames() / pipeline.ElapsedSeconds();
+    std::cout << "Pipelined:  " << pipeline.CompletedFrames() << " frames, " << pipelinedFps << " fps ("
+              << pipelinedFps / sequentialFps << "x)" << std::endl;
+
+    std::cout << std::left << std::setw(10) << "stage" << std::right
+              << std::setw(10) << "frames" << std::setw(12) << "ms/frame"
+              << std::setw(12) << "starved" << std::setw(12) << "blocked" << std::setw(10) << "maxQ" << std::endl;
+    for (const PipelineStageStats& s : stats) {
+        std::cout << std::left << std::setw(10) << s.name << std::right
+                  << std::setw(10) << s.frames
+                  << std::setw(12) << std::fixed << std::setprecision(3) << (s.frames ? s.busyMs / s.frames : 0.0)
+                  << std::setw(12) << s.starvedMs
+                  << std::setw(12) << s.blockedMs
+                  << std::setw(10) << s.maxQueueDepth << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+#pragma once
+// Single-pass pixel conversion for readback buffers: optional vertical flip, BGRA <-> RGBA
+// swizzle and alpha drop (32 -> 24 bpp), reading a pitched source row by row.
+// Scalar, SSE2 and AVX2 row kernels; the widest one the CPU supports is picked at runtime,
+// so the same binary runs on any x86-64 machine. All levels produce identical bytes.
+#include "ImageView.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PIXEL_KERNELS_AVX2_TARGET
+#else
+#define PIXEL_KERNELS_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+enum class PixelKernelLevel {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+struct PixelConvertOptions {
+    bool flipVertical = false;  // Destination row y comes from source row height - 1 - y
+    bool swapRedBlue = false;   // BGRA <-> RGBA (the same shuffle both ways)
+    bool dropAlpha = false;     // Write 3 bytes per pixel
+};
+
+inline const char* PixelKernelLevelName(PixelKernelLevel level) {
+    switch (level) {
+    case PixelKernelLevel::Avx2: return "avx2";
+    case PixelKernelLevel::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+inline bool CpuSupportsAvx2() {
+#if defined(PIXEL_KERNELS_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const int osxsaveAndAvx = (1 << 27) | (1 << 28);
+    if ((info[2] & osxsaveAndAvx) != osxsaveAndAvx) return false;
+    if ((_xgetbv(0) & 6) != 6) return false;     // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(PIXEL_KERNELS_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+inline bool PixelKernelLevelSupported(PixelKernelLevel level) {
+    switch (level) {
+    case PixelKernelLevel::Scalar: return true;
+#ifdef PIXEL_KERNELS_X86
+    case PixelKernelLevel::Sse2: return true;      // Baseline on x64 and on /arch:SSE2 x86 builds
+    case PixelKernelLevel::Avx2: {
+        static const bool avx2 = CpuSupportsAvx2();
+        return avx2;
+    }
+#endif
+    default: return false;
+    }
+}
+
+inline PixelKernelLevel BestPixelKernelLevel() {
+    if (PixelKernelLevelSupported(PixelKernelLevel::Avx2)) return PixelKernelLevel::Avx2;
+    if (PixelKernelLevelSupported(PixelKernelLevel::Sse2)) return PixelKernelLevel::Sse2;
+    return PixelKernelLevel::Scalar;
+}
+
+inline size_t ConvertedRowBytes(uint32_t width, const PixelConvertOptions& options) {
+    return static_cast<size_t>(width) * (options.dropAlpha ? 3 : 4);
+}
+
+namespace PixelKernelsDetail {
+
+using RowKernel = void (*)(const uint8_t* source, uint8_t* dest, uint32_t width, uint32_t start);
+
+// Converts pixels [start, width); the SIMD kernels finish their rows with this
+template <bool SwapRedBlue, bool DropAlpha>
+inline void ConvertRowScalar(const uint8_t* source, uint8_t* dest, uint32_t width, uint32_t start) {
+    const size_t outBytes = DropAlpha ? 3 : 4;
+    for (uint32_t x = start; x < width; ++x) {
+        const uint8_t* s = source + static_cast<size_t>(x) * 4;
+        uint8_t* d = dest + x * outBytes;
+        d[0] = SwapRedBlue ? s[2] : s[0];
+        d[1] = s[1];
+        d[2] = SwapRedBlue ? s[0] : s[2];
+        if (!DropAlpha) d[3] = s[3];
+    }
+}
+
+#ifdef PIXEL_KERNELS_X86
+// SSE2 has no byte shuffle: swap the two low-order channels with 32-bit shifts instead
+inline void SwapRedBlueRowSse2(const uint8_t* source, uint8_t* dest, uint32_t width, uint32_t start) {
+    const __m128i alphaGreen = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+    uint32_t x = start;
+    for (; x + 4 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + static_cast<size_t>(x) * 4));
+        __m128i ag = _mm_and_si128(v, alphaGreen);
+        __m128i rb = _mm_andnot_si128(alphaGreen, v);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + static_cast<size_t>(x) * 4), _mm_or_si128(ag, rb));
+    }
+    ConvertRowScalar<true, false>(source, dest, width, x);
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline void SwapRedBlueRowAvx2(const uint8_t* source, uint8_t* dest, uint32_t width, uint32_t start) {
+    const __m256i order = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    uint32_t x = start;
+    for (; x + 8 <= width; x += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + static_cast<size_t>(x) * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + static_cast<size_t>(x) * 4), _mm256_shuffle_epi8(v, order));
+    }
+    ConvertRowScalar<true, false>(source, dest, width, x);
+}
+
+// 8 pixels -> 2 x 12 bytes. Each 16-byte store spills 4 bytes the next one overwrites, so
+// the loop stops while at least 4 bytes of the row remain past the last store.
+template <bool SwapRedBlue>
+PIXEL_KERNELS_AVX2_TARGET inline void DropAlphaRowAvx2(const uint8_t* source, uint8_t* dest, uint32_t width, uint32_t start) {
+    const __m256i order = SwapRedBlue
+        ? _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                           2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+        : _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint32_t x = start;
+    for (; x + 10 <= width; x += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + static_cast<size_t>(x) * 4));
+        __m256i packed = _mm256_shuffle_epi8(v, order);
+        uint8_t* d = dest + static_cast<size_t>(x) * 3;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(packed));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 12), _mm256_extracti128_si256(packed, 1));
+    }
+    ConvertRowScalar<SwapRedBlue, true>(source, dest, width, x);
+}
+#endif
+
+// nullptr means the row is a plain copy
+inline RowKernel SelectRowKernel(PixelKernelLevel level, const PixelConvertOptions& options) {
+    if (!options.swapRedBlue && !options.dropAlpha) return nullptr;
+#ifdef PIXEL_KERNELS_X86
+    if (level == PixelKernelLevel::Avx2) {
+        if (options.dropAlpha) return options.swapRedBlue ? DropAlphaRowAvx2<true> : DropAlphaRowAvx2<false>;
+        return SwapRedBlueRowAvx2;
+    }
+    // SSE2 has no cheap 4 -> 3 byte pack; alpha drop stays scalar at this level
+    if (level == PixelKernelLevel::Sse2 && !options.dropAlpha) return SwapRedBlueRowSse2;
+#endif
+    if (options.dropAlpha) return options.swapRedBlue ? ConvertRowScalar<true, true> : ConvertRowScalar<false, true>;
+    return ConvertRowScalar<true, false>;
+}
+
+}  // namespace PixelKernelsDetail
+
+// Converts 'source' into 'dest' (ConvertedRowBytes() per row, rows destPitch apart).
+// An unsupported level falls back to the best one available.
+inline void ConvertPixels(const ImageView& source, uint8_t* dest, size_t destPitch, const PixelConvertOptions& options,
+                          PixelKernelLevel level = BestPixelKernelLevel()) {
+    if (!PixelKernelLevelSupported(level)) level = BestPixelKernelLevel();
+    PixelKernelsDetail::RowKernel kernel = PixelKernelsDetail::SelectRowKernel(level, options);
+    size_t rowBytes = ConvertedRowBytes(source.width, options);
+    for (uint32_t y = 0; y < source.height; ++y) {
+        const uint8_t* row = source.Row(options.flipVertical ? source.height - 1 - y : y);
+        uint8_t* out = dest + y * destPitch;
+        if (kernel) kernel(row, out, source.width, 0);
+        else std::memcpy(out, row, rowBytes);
+    }
+}
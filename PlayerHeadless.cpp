@@ -0,0 +1,428 @@
+// Replays recordings through RecordingPlayer without a desktop or a GPU.
+// With no inputs it checks itself: a 1280x360 synthetic desktop is recorded as two 640x360
+// halves in every input format (.srec, ScreenCodec stream, .sring, PNG sequence, Y4M, and a
+// .sidx naming the .srec pair), each is played back 2x1 and compared with the desktop it was
+// cut from (exact, Y4M within YUV rounding), re-split 4x1 and sampled up to 960x540 (within
+// 1 of a double-precision bilinear reference), written back out as PNG files and read again,
+// and played at the recorded 60 fps to check pacing. A pair whose halves miss different frames
+// must play lined up by frame number, each half holding its last frame through a gap. Then
+// the .srec pair is played as fast as it decodes. Passes if every check holds and
+// unconstrained playback beats realtime.
+// Usage: PlayerHeadless [--layout CxR] [--size WxH] [--realtime [speed]] [--fps N]
+//                       [--frames N] [--inputs C] [--out png|srec|y4m|bgra|none] [--prefix P] input...
+// where an input is a .srec, .sring, .sidx, .y4m, ScreenCodec stream or "name_frame_{frame}.png"
+#include "RecordingPlayer.h"
+#include "SyntheticFrameSource.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+const double kFps = 60.0;
+const int64_t kTicksPerSecond = 10000000;
+const int64_t kTicksPerFrame = static_cast<int64_t>(kTicksPerSecond / kFps);
+const uint32_t kDesktopWidth = 1280;
+const uint32_t kDesktopHeight = 360;
+const uint64_t kFrames = 48;
+
+// Double-precision D3D11 linear/wrap sample of texel coordinate (x, y) of 'tile', channel k
+double ReferenceSample(const ImageView& tile, double x, double y, int k) {
+    double fx = std::floor(x), fy = std::floor(y);
+    auto wrap = [](int64_t i, uint32_t n) { return static_cast<uint32_t>(((i % n) + n) % n); };
+    uint32_t x0 = wrap(static_cast<int64_t>(fx), tile.width), x1 = wrap(static_cast<int64_t>(fx) + 1, tile.width);
+    uint32_t y0 = wrap(static_cast<int64_t>(fy), tile.height), y1 = wrap(static_cast<int64_t>(fy) + 1, tile.height);
+    double ax = x - fx, ay = y - fy;
+    double top = tile.Pixel(x0, y0)[k] * (1 - ax) + tile.Pixel(x1, y0)[k] * ax;
+    double bottom = tile.Pixel(x0, y1)[k] * (1 - ax) + tile.Pixel(x1, y1)[k] * ax;
+    return top * (1 - ay) + bottom * ay;
+}
+
+// Compares every output tile with the synthetic desktop split the same way
+class CheckSink : public PlayerSink {
+public:
+    CheckSink(const TileLayoutConfig& config, double meanTolerance) : m_config(config), m_meanTolerance(meanTolerance),
+        m_desktop(kDesktopWidth, kDesktopHeight, SyntheticPattern::Video), m_pixels(m_desktop.FrameBytes()) {}
+
+    bool Open(const TileLayout& layout, uint32_t width, uint32_t height) override {
+        m_width = width;
+        m_height = height;
+        m_lastFrame = UINT64_MAX;
+        return BuildTileLayout(kDesktopWidth, kDesktopHeight, m_config, m_layout) && layout.TileCount() == m_layout.TileCount();
+    }
+
+    bool WriteTile(size_t tile, const ImageView& image, const ScreenStreamFrameInfo& info) override {
+        if (info.frameIndex != m_lastFrame) {
+            m_desktop.RenderFrame(m_pixels.data(), info.frameIndex);
+            BuildTileViews(ImageView(m_pixels.data(), kDesktopWidth, kDesktopHeight, m_desktop.RowPitch()), m_layout, m_expected);
+            m_lastFrame = info.frameIndex;
+            m_tilesSeen += m_expected.size();
+        }
+        const ImageView& expected = m_expected[tile];
+        if (image.width != m_width || image.height != m_height) return false;
+        const bool sampled = m_width != expected.width || m_height != expected.height;
+        for (uint32_t y = 0; y < m_height; ++y) {
+            for (uint32_t x = 0; x < m_width; ++x) {
+                for (int k = 0; k < 3; ++k) {
+                    double want = sampled ? ReferenceSample(expected, (x + 0.5) * expected.width / m_width - 0.5,
+                                                            (y + 0.5) * expected.height / m_height - 0.5, k)
+                                          : expected.Pixel(x, y)[k];
+                    double error = std::fabs(image.Pixel(x, y)[k] - want);
+                    m_maxError = std::max(m_maxError, error);
+                    m_errorSum += error;
+                    m_samples++;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool Close() override { return true; }
+
+    // Exact when meanTolerance is 0; sampled output may round either way by 1
+    bool Passed(uint64_t frames, double maxTolerance) const {
+        return m_tilesSeen == frames * m_layout.TileCount() && m_maxError <= maxTolerance && MeanError() <= m_meanTolerance;
+    }
+    double MaxError() const { return m_maxError; }
+    double MeanError() const { return m_samples ? m_errorSum / m_samples : 0.0; }
+
+private:
+    TileLayoutConfig m_config;
+    double m_meanTolerance;
+    SyntheticFrameSource m_desktop;
+    std::vector<uint8_t> m_pixels;
+    TileLayout m_layout;
+    std::vector<ImageView> m_expected;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint64_t m_lastFrame = UINT64_MAX;
+    uint64_t m_tilesSeen = 0;
+    double m_maxError = 0.0;
+    double m_errorSum = 0.0;
+    uint64_t m_samples = 0;
+};
+
+// Records the desktop's two halves in every format the player reads
+bool RecordInputs() {
+    SyntheticFrameSource desktop(kDesktopWidth, kDesktopHeight, SyntheticPattern::Video);
+    std::vector<uint8_t> pixels(desktop.FrameBytes());
+    TileLayout halves;
+    if (!BuildTileLayout(kDesktopWidth, kDesktopHeight, TileLayoutConfig(), halves)) return false;
+    const uint32_t w = halves.tileWidth, h = halves.tileHeight;
+    const char* names[] = { "left", "right" };
+    ScreenRecordingWriter recordings[2];
+    ScreenStreamWriter streams[2];
+    CircularRecordingWriter rings[2];
+    RawVideoSink y4m[2];
+    CircularRecordingOptions ringOptions;
+    ringOptions.fileBytes = 64 << 20;
+    std::vector<RecordingIndexTile> indexTiles(2);
+    for (int t = 0; t < 2; ++t) {
+        std::string name = std::string("play_") + names[t];
+        std::remove((name + ".sring").c_str());     // A ring left by an earlier run would be resumed
+        if (!recordings[t].Open(name + ".srec", w, h) || !streams[t].Open(name + ".scrq", w, h) ||
+            !rings[t].Open(name + ".sring", w, h, ringOptions) || !y4m[t].Open(name + ".y4m", w, h)) {
+            return false;
+        }
+        indexTiles[t].width = w;
+        indexTiles[t].height = h;
+        indexTiles[t].source = name + ".srec";
+    }
+    RecordingIndexWriter index;
+    if (!index.Open("play_session.sidx", indexTiles, kTicksPerSecond, 0, 0)) return false;
+    std::vector<ImageView> views;
+    for (uint64_t i = 0; i < kFrames; ++i) {
+        desktop.RenderFrame(pixels.data(), i);
+        BuildTileViews(ImageView(pixels.data(), kDesktopWidth, kDesktopHeight, desktop.RowPitch()), halves, views);
+        ScreenStreamFrameInfo info;
+        info.frameIndex = i;
+        info.timestamp = static_cast<int64_t>(i) * kTicksPerFrame;
+        for (int t = 0; t < 2; ++t) {
+            std::vector<uint8_t> png;
+            if (!recordings[t].WriteFrame(views[t], info) || !streams[t].WriteFrame(views[t], info) ||
+                !rings[t].WriteFrame(views[t], info) || !y4m[t].WriteFrame(views[t])) {
+                return false;
+            }
+            index.AddRecorded(static_cast<uint16_t>(t), recordings[t].LastFrame());
+            if (!EncodePng(views[t].data, w, h, views[t].rowPitch, png)) return false;
+            std::string path = std::string("play_") + names[t] + "_frame_" + std::to_string(i) + ".png";
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            bool written = file && std::fwrite(png.data(), 1, png.size(), file) == png.size();
+            if (file) std::fclose(file);
+            if (!written) return false;
+        }
+    }
+    for (int t = 0; t < 2; ++t) {
+        if (!recordings[t].Close()) return false;
+        streams[t].Close();
+        rings[t].Close();
+        y4m[t].Close();
+    }
+    return index.Close();
+}
+
+bool OpenInputs(const std::vector<std::string>& paths, std::vector<std::unique_ptr<PlayerSource>>& sources) {
+    sources.clear();
+    for (const std::string& path : paths) {
+        if (!OpenPlayerSources(path, kTicksPerSecond, kFps, sources)) return false;
+    }
+    return true;
+}
+
+// Plays 'paths' through a CheckSink; the halves are put back together and split by 'config'
+bool CheckPlayback(const char* label, const std::vector<std::string>& paths, const TileLayoutConfig& config, uint32_t outW,
+                   uint32_t outH, double maxTolerance, double meanTolerance, ThreadPool& pool) {
+    std::vector<std::unique_ptr<PlayerSource>> sources;
+    PlayerOptions options;
+    options.layout = config;
+    options.outputWidth = outW;
+    options.outputHeight = outH;
+    options.inputColumns = 2;
+    CheckSink sink(config, meanTolerance);
+    PlayerStats stats;
+    bool ok = OpenInputs(paths, sources) && sources.size() == 2 && RecordingPlayer().Play(sources, sink, options, &pool, stats) &&
+              sink.Passed(kFrames, maxTolerance);
+    std::cout << std::left << std::setw(28) << label << (sources.empty() ? "?" : sources[0]->FormatName()) << "  "
+              << stats.frames << " frames, max error " << sink.MaxError() << ", mean " << std::setprecision(3) << sink.MeanError()
+              << "  " << (ok ? "ok" : "WRONG") << std::endl;
+    return ok;
+}
+
+// Compares each half with the frame that half should be showing: the last one it has
+// at or before the frame number played
+class HeldTileSink : public PlayerSink {
+public:
+    HeldTileSink(const TileLayout& halves, std::function<bool(size_t, uint64_t)> present)
+        : m_halves(halves), m_present(present), m_desktop(kDesktopWidth, kDesktopHeight, SyntheticPattern::Video),
+          m_pixels(m_desktop.FrameBytes()) {}
+
+    bool Open(const TileLayout& layout, uint32_t, uint32_t) override { return layout.TileCount() == 2; }
+
+    bool WriteTile(size_t tile, const ImageView& image, const ScreenStreamFrameInfo& info) override {
+        if (tile == 0) m_frames.push_back(info.frameIndex);
+        uint64_t want = info.frameIndex;
+        while (want > 0 && !m_present(tile, want)) want--;
+        m_desktop.RenderFrame(m_pixels.data(), want);
+        std::vector<ImageView> views;
+        BuildTileViews(ImageView(m_pixels.data(), kDesktopWidth, kDesktopHeight, m_desktop.RowPitch()), m_halves, views);
+        for (uint32_t y = 0; y < image.height; ++y) {
+            if (std::memcmp(image.Row(y), views[tile].Row(y), static_cast<size_t>(image.width) * 4) != 0) m_wrongRows++;
+        }
+        return true;
+    }
+
+    bool Close() override { return true; }
+
+    const std::vector<uint64_t>& Frames() const { return m_frames; }
+    uint64_t WrongRows() const { return m_wrongRows; }
+
+private:
+    TileLayout m_halves;
+    std::function<bool(size_t, uint64_t)> m_present;
+    SyntheticFrameSource m_desktop;
+    std::vector<uint8_t> m_pixels;
+    std::vector<uint64_t> m_frames;
+    uint64_t m_wrongRows = 0;
+};
+
+// The right half starts two frames late and misses 10 and 11, the left misses 30 (dropped
+// tile writes). Every frame number from 2 on must come out once, each half showing the last
+// frame it has at or before that number.
+bool CheckDroppedTiles(ThreadPool& pool) {
+    SyntheticFrameSource desktop(kDesktopWidth, kDesktopHeight, SyntheticPattern::Video);
+    std::vector<uint8_t> pixels(desktop.FrameBytes());
+    TileLayout halves;
+    if (!BuildTileLayout(kDesktopWidth, kDesktopHeight, TileLayoutConfig(), halves)) return false;
+    auto present = [](size_t tile, uint64_t i) { return tile == 0 ? i != 30 : i >= 2 && i != 10 && i != 11; };
+    const std::vector<std::string> paths = { "play_gap_left.srec", "play_gap_right.srec" };
+    {
+        ScreenRecordingWriter recordings[2];
+        std::vector<ImageView> views;
+        for (int t = 0; t < 2; ++t) {
+            if (!recordings[t].Open(paths[t], halves.tileWidth, halves.tileHeight)) return false;
+        }
+        for (uint64_t i = 0; i < kFrames; ++i) {
+            desktop.RenderFrame(pixels.data(), i);
+            BuildTileViews(ImageView(pixels.data(), kDesktopWidth, kDesktopHeight, desktop.RowPitch()), halves, views);
+            ScreenStreamFrameInfo info;
+            info.frameIndex = i;
+            info.timestamp = static_cast<int64_t>(i) * kTicksPerFrame;
+            for (int t = 0; t < 2; ++t) {
+                if (present(t, i) && !recordings[t].WriteFrame(views[t], info)) return false;
+            }
+        }
+        for (int t = 0; t < 2; ++t) {
+            if (!recordings[t].Close()) return false;
+        }
+    }
+
+    std::vector<std::unique_ptr<PlayerSource>> sources;
+    PlayerOptions options;
+    options.inputColumns = 2;
+    HeldTileSink sink(halves, present);
+    PlayerStats stats;
+    bool ok = OpenInputs(paths, sources) && RecordingPlayer().Play(sources, sink, options, &pool, stats);
+    ok = ok && sink.WrongRows() == 0 && sink.Frames().size() == kFrames - 2 && stats.heldTiles == 3 && stats.skippedFrames == 2;
+    for (size_t i = 0; ok && i < sink.Frames().size(); ++i) ok = sink.Frames()[i] == i + 2;
+    std::cout << std::left << std::setw(28) << "2x1 with dropped tiles" << stats.frames << " frames, " << stats.heldTiles << " tiles held, "
+              << stats.skippedFrames << " frames skipped, " << sink.WrongRows() << " rows wrong  " << (ok ? "ok" : "WRONG") << std::endl;
+    for (const std::string& path : paths) std::remove(path.c_str());
+    return ok;
+}
+
+// PNG output files read back must hold the re-split desktop
+bool CheckPngOutput(ThreadPool& pool) {
+    std::vector<std::unique_ptr<PlayerSource>> sources;
+    PlayerOptions options;
+    options.layout.columns = 4;
+    options.inputColumns = 2;
+    options.maxFrames = 4;
+    PlayerFileSink files(PlayerOutputFormat::Png, "play_out_", &pool);
+    PlayerStats stats;
+    if (!OpenInputs({ "play_left.srec", "play_right.srec" }, sources) || !RecordingPlayer().Play(sources, files, options, &pool, stats)) {
+        return false;
+    }
+    CheckSink check(options.layout, 0.0);
+    TileLayout layout;
+    BuildTileLayout(kDesktopWidth, kDesktopHeight, options.layout, layout);
+    if (!check.Open(layout, layout.tileWidth, layout.tileHeight)) return false;
+    for (uint64_t i = 0; i < options.maxFrames; ++i) {
+        for (size_t t = 0; t < layout.TileCount(); ++t) {
+            std::vector<uint8_t> pixels;
+            uint32_t w, h;
+            std::string path = "play_out_" + PlayerTileName(layout, t) + "_frame_" + std::to_string(i) + ".png";
+            ScreenStreamFrameInfo info;
+            info.frameIndex = i;
+            if (!ReadPngFile(path, pixels, w, h) || !check.WriteTile(t, ImageView(pixels.data(), w, h, static_cast<size_t>(w) * 4), info)) {
+                return false;
+            }
+        }
+    }
+    return check.Passed(options.maxFrames, 0.0);
+}
+
+int SelfCheck() {
+    ThreadPool pool;
+    if (!RecordInputs()) {
+        std::cout << "FAIL: could not record the inputs" << std::endl;
+        return 1;
+    }
+    TileLayoutConfig halves, quarters;
+    quarters.columns = 4;
+    const std::vector<std::string> srec = { "play_left.srec", "play_right.srec" };
+    bool ok = CheckPlayback("2x1 recording", srec, halves, 0, 0, 0.0, 0.0, pool);
+    ok = CheckPlayback("2x1 stream", { "play_left.scrq", "play_right.scrq" }, halves, 0, 0, 0.0, 0.0, pool) && ok;
+    ok = CheckPlayback("2x1 ring", { "play_left.sring", "play_right.sring" }, halves, 0, 0, 0.0, 0.0, pool) && ok;
+    ok = CheckPlayback("2x1 png sequence", { "play_left_frame_{frame}.png", "play_right_frame_{frame}.png" }, halves, 0, 0, 0.0, 0.0, pool) && ok;
+    ok = CheckPlayback("2x1 session index", { "play_session.sidx" }, halves, 0, 0, 0.0, 0.0, pool) && ok;
+    // 4:2:0 shares chroma between 2x2 pixels, so single pixels may be far off at sharp edges
+    ok = CheckPlayback("2x1 y4m", { "play_left.y4m", "play_right.y4m" }, halves, 0, 0, 255.0, 3.0, pool) && ok;
+    ok = CheckPlayback("4x1 re-split", srec, quarters, 0, 0, 0.0, 0.0, pool) && ok;
+    ok = CheckPlayback("2x1 sampled to 960x540", srec, halves, 960, 540, 1.0, 0.5, pool) && ok;
+    ok = CheckPlayback("4x1 sampled to 200x150", srec, quarters, 200, 150, 1.0, 0.5, pool) && ok;
+    ok = CheckDroppedTiles(pool) && ok;
+    bool png = CheckPngOutput(pool);
+    std::cout << std::left << std::setw(28) << "4x1 png files read back" << (png ? "ok" : "WRONG") << std::endl;
+    ok = ok && png;
+
+    // Recorded pacing: 30 frames at 60 fps are due over 29 / 60 s
+    std::vector<std::unique_ptr<PlayerSource>> sources;
+    PlayerOptions options;
+    options.inputColumns = 2;
+    options.realtime = true;
+    options.maxFrames = 30;
+    PlayerFileSink none(PlayerOutputFormat::None, "");
+    PlayerStats paced;
+    bool pacedOk = OpenInputs(srec, sources) && RecordingPlayer().Play(sources, none, options, &pool, paced) &&
+                   paced.frames == 30 && std::fabs(paced.seconds - 29.0 / kFps) < 0.05;
+    std::cout << std::left << std::setw(28) << "realtime pacing" << std::fixed << std::setprecision(3) << paced.seconds
+              << " s for " << paced.frames << " frames (" << paced.lateFrames << " late, worst " << paced.maxLateMs << " ms)  "
+              << (pacedOk ? "ok" : "WRONG") << std::endl;
+    ok = ok && pacedOk;
+
+    options.realtime = false;
+    options.maxFrames = 0;
+    PlayerStats fast;
+    bool fastOk = OpenInputs(srec, sources) && RecordingPlayer().Play(sources, none, options, &pool, fast) && fast.RealtimeFactor() > 1.0;
+    std::cout << std::left << std::setw(28) << "unconstrained" << std::setprecision(1) << fast.FramesPerSecond() << " fps, "
+              << std::setprecision(2) << fast.RealtimeFactor() << "x realtime (read " << fast.readMs / fast.frames << " ms, render "
+              << fast.renderMs / fast.frames << " ms per frame)" << std::endl;
+    ok = ok && fastOk;
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
+
+bool ParsePair(const std::string& text, char separator, uint32_t& a, uint32_t& b) {
+    size_t at = text.find(separator);
+    if (at == std::string::npos) return false;
+    a = static_cast<uint32_t>(std::stoul(text.substr(0, at)));
+    b = static_cast<uint32_t>(std::stoul(text.substr(at + 1)));
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) return SelfCheck();
+
+    PlayerOptions options;
+    PlayerOutputFormat format = PlayerOutputFormat::None;
+    std::string prefix = "play_";
+    double fps = kFps;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool more = i + 1 < argc;
+        if (arg == "--layout" && more && ParsePair(argv[i + 1], 'x', options.layout.columns, options.layout.rows)) i++;
+        else if (arg == "--size" && more && ParsePair(argv[i + 1], 'x', options.outputWidth, options.outputHeight)) i++;
+        else if (arg == "--realtime") {
+            options.realtime = true;
+            if (more && std::atof(argv[i + 1]) > 0.0) options.speed = std::atof(argv[++i]);
+        }
+        else if (arg == "--prefix" && more) prefix = argv[++i];
+        else if (arg == "--fps" && more) fps = std::atof(argv[++i]);
+        else if (arg == "--frames" && more) options.maxFrames = std::stoull(argv[++i]);
+        else if (arg == "--inputs" && more) options.inputColumns = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--out" && more) {
+            std::string name = argv[++i];
+            if (name == "png") format = PlayerOutputFormat::Png;
+            else if (name == "srec") format = PlayerOutputFormat::Srec;
+            else if (name == "y4m") format = PlayerOutputFormat::Y4m;
+            else if (name == "bgra") format = PlayerOutputFormat::Bgra;
+            else if (name != "none") {
+                std::cerr << "unknown output format " << name << std::endl;
+                return 2;
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "unknown option " << arg << std::endl;
+            return 2;
+        }
+        else inputs.push_back(arg);
+    }
+
+    ThreadPool pool;
+    std::vector<std::unique_ptr<PlayerSource>> sources;
+    for (const std::string& input : inputs) {
+        if (!OpenPlayerSources(input, options.ticksPerSecond, fps, sources)) {
+            std::cerr << "cannot read " << input << std::endl;
+            return 1;
+        }
+    }
+    PlayerFileSink sink(format, prefix, &pool, fps);
+    PlayerStats stats;
+    if (!RecordingPlayer().Play(sources, sink, options, &pool, stats)) {
+        std::cerr << "playback failed after " << stats.frames << " frames" << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1) << stats.frames << " frames in " << stats.seconds << " s: "
+              << stats.FramesPerSecond() << " fps, " << std::setprecision(2) << stats.RealtimeFactor() << "x realtime" << std::endl;
+    if (stats.frames > 0) {
+        std::cout << "per frame: read " << stats.readMs / stats.frames << " ms, render " << stats.renderMs / stats.frames
+                  << " ms, write " << stats.writeMs / stats.frames << " ms" << std::endl;
+    }
+    if (options.realtime) std::cout << stats.lateFrames << " frames late, worst " << stats.maxLateMs << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,323 @@
+#pragma once
+// Self-contained PNG reader, so recorded PNG sequences can be played back without WIC or
+// stb_image. Covers what captures are saved as: 8-bit RGB or RGBA, not interlaced, any row
+// filters, one zlib stream over any number of IDAT chunks with stored, fixed or dynamic
+// Huffman blocks (PngWriter writes fixed ones, WIC and zlib dynamic ones). Huffman codes
+// are decoded through one lookup of up to 15 bits. Output is BGRA at any row pitch.
+#include "PngWriter.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace PngReaderDetail {
+
+// LSB-first bit reader as deflate expects; reading past the end yields zeros, checked once
+class InflateBitReader {
+public:
+    InflateBitReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    uint32_t Peek(unsigned count) {
+        Refill();
+        return static_cast<uint32_t>(m_bits & ((1ull << count) - 1));
+    }
+
+    void Drop(unsigned count) {
+        m_bits >>= count;
+        m_count -= count;
+    }
+
+    uint32_t Bits(unsigned count) {
+        if (count == 0) return 0;
+        uint32_t value = Peek(count);
+        Drop(count);
+        return value;
+    }
+
+    void AlignToByte() { Drop(m_count % 8); }
+
+    // Bytes consumed so far; once past the input, the stream was truncated
+    size_t Consumed() const { return m_position - m_count / 8; }
+    bool Overrun() const { return Consumed() > m_size; }
+
+    // Copies whole bytes straight from the input (stored blocks); must be byte aligned
+    bool CopyBytes(size_t count, std::vector<uint8_t>& out) {
+        // Return bytes already in the bit buffer to the input first
+        m_position -= m_count / 8;
+        m_bits = 0;
+        m_count = 0;
+        if (m_position + count > m_size) return false;
+        out.insert(out.end(), m_data + m_position, m_data + m_position + count);
+        m_position += count;
+        return true;
+    }
+
+private:
+    void Refill() {
+        while (m_count <= 56) {
+            uint64_t byte = m_position < m_size ? m_data[m_position] : 0;
+            m_position++;
+            m_bits |= byte << m_count;
+            m_count += 8;
+        }
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_position = 0;
+    uint64_t m_bits = 0;
+    unsigned m_count = 0;
+};
+
+// Canonical Huffman code as one table indexed by the next maxBits input bits; an entry is
+// symbol << 4 | code length, 0 where no code matches
+class InflateHuffman {
+public:
+    bool Build(const uint8_t* lengths, size_t count) {
+        unsigned counts[16] = {};
+        m_maxBits = 0;
+        for (size_t i = 0; i < count; ++i) {
+            counts[lengths[i]]++;
+            if (lengths[i] > m_maxBits) m_maxBits = lengths[i];
+        }
+        if (m_maxBits == 0) m_maxBits = 1;      // No codes at all (a block with no distances)
+        counts[0] = 0;
+        // Oversubscribed sets are invalid; incomplete ones (one distance code) are allowed
+        int left = 1;
+        for (unsigned len = 1; len < 16; ++len) {
+            left = (left << 1) - static_cast<int>(counts[len]);
+            if (left < 0) return false;
+        }
+        uint32_t next[16] = {};
+        for (unsigned len = 1, code = 0; len < 16; ++len) {
+            code = (code + counts[len - 1]) << 1;
+            next[len] = code;
+        }
+        m_table.assign(size_t(1) << m_maxBits, 0);
+        for (size_t symbol = 0; symbol < count; ++symbol) {
+            unsigned len = lengths[symbol];
+            if (len == 0) continue;
+            uint32_t code = next[len]++;
+            uint32_t reversed = 0;
+            for (unsigned b = 0; b < len; ++b) reversed |= ((code >> b) & 1) << (len - 1 - b);
+            uint16_t entry = static_cast<uint16_t>(symbol << 4 | len);
+            for (uint32_t i = reversed; i < m_table.size(); i += 1u << len) m_table[i] = entry;
+        }
+        return true;
+    }
+
+    // Next symbol, or -1 on a bit pattern no code uses
+    int Decode(InflateBitReader& bits) const {
+        uint16_t entry = m_table[bits.Peek(m_maxBits)];
+        if (entry == 0) return -1;
+        bits.Drop(entry & 15);
+        return entry >> 4;
+    }
+
+private:
+    std::vector<uint16_t> m_table;
+    unsigned m_maxBits = 1;
+};
+
+const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                     1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+inline bool InflateCodes(InflateBitReader& bits, const InflateHuffman& literals, const InflateHuffman& distances, std::vector<uint8_t>& out,
+                         size_t limit) {
+    for (;;) {
+        int symbol = literals.Decode(bits);
+        if (symbol < 0 || bits.Overrun()) return false;
+        if (symbol < 256) {
+            if (out.size() >= limit) return false;
+            out.push_back(static_cast<uint8_t>(symbol));
+            continue;
+        }
+        if (symbol == 256) return true;
+        symbol -= 257;
+        if (symbol >= 29) return false;
+        size_t length = kLengthBase[symbol] + bits.Bits(kLengthExtra[symbol]);
+        int code = distances.Decode(bits);
+        if (code < 0 || code >= 30) return false;
+        size_t distance = kDistanceBase[code] + bits.Bits(kDistanceExtra[code]);
+        if (distance > out.size() || out.size() + length > limit) return false;
+        size_t from = out.size() - distance;
+        if (distance >= length) {
+            out.insert(out.end(), out.begin() + from, out.begin() + from + length);
+        }
+        else {
+            for (size_t i = 0; i < length; ++i) out.push_back(out[from + i]);     // Overlapping run
+        }
+    }
+}
+
+// Raw deflate (RFC 1951) into 'out', which may grow to 'limit' bytes. Returns the input
+// bytes consumed, or 0 on malformed or truncated input.
+inline size_t Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t limit) {
+    InflateBitReader bits(data, size);
+    InflateHuffman literals, distances;
+    bool final = false;
+    while (!final) {
+        final = bits.Bits(1) != 0;
+        uint32_t type = bits.Bits(2);
+        if (type == 0) {
+            bits.AlignToByte();
+            uint32_t length = bits.Bits(16);
+            uint32_t inverse = bits.Bits(16);
+            if ((length ^ 0xFFFF) != inverse || out.size() + length > limit || !bits.CopyBytes(length, out)) return 0;
+        }
+        else if (type == 1) {
+            uint8_t lengths[288 + 30];
+            std::memset(lengths, 8, 144);
+            std::memset(lengths + 144, 9, 112);
+            std::memset(lengths + 256, 7, 24);
+            std::memset(lengths + 280, 8, 8);
+            std::memset(lengths + 288, 5, 30);
+            literals.Build(lengths, 288);
+            distances.Build(lengths + 288, 30);
+            if (!InflateCodes(bits, literals, distances, out, limit)) return 0;
+        }
+        else if (type == 2) {
+            uint32_t literalCount = bits.Bits(5) + 257;
+            uint32_t distanceCount = bits.Bits(5) + 1;
+            uint32_t codeLengthCount = bits.Bits(4) + 4;
+            uint8_t codeLengths[19] = {};
+            for (uint32_t i = 0; i < codeLengthCount; ++i) codeLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(bits.Bits(3));
+            InflateHuffman lengthCode;
+            if (literalCount > 286 || distanceCount > 30 || !lengthCode.Build(codeLengths, 19)) return 0;
+            uint8_t lengths[286 + 30] = {};
+            for (uint32_t i = 0; i < literalCount + distanceCount;) {
+                int symbol = lengthCode.Decode(bits);
+                if (symbol < 0) return 0;
+                if (symbol < 16) {
+                    lengths[i++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+                uint8_t value = 0;
+                uint32_t repeat;
+                if (symbol == 16) {
+                    if (i == 0) return 0;
+                    value = lengths[i - 1];
+                    repeat = 3 + bits.Bits(2);
+                }
+                else if (symbol == 17) {
+                    repeat = 3 + bits.Bits(3);
+                }
+                else {
+                    repeat = 11 + bits.Bits(7);
+                }
+                if (i + repeat > literalCount + distanceCount) return 0;
+                while (repeat--) lengths[i++] = value;
+            }
+            if (lengths[256] == 0 || !literals.Build(lengths, literalCount) || !distances.Build(lengths + literalCount, distanceCount) ||
+                !InflateCodes(bits, literals, distances, out, limit)) {
+                return 0;
+            }
+        }
+        else {
+            return 0;
+        }
+        if (bits.Overrun()) return 0;
+    }
+    bits.AlignToByte();
+    return bits.Consumed();
+}
+
+inline uint32_t LoadBigEndian(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+}  // namespace PngReaderDetail
+
+// Decodes a PNG held in memory into BGRA rows 'pitch' bytes apart ('pixels' is resized to
+// height * pitch; pitch 0 packs them tightly). False on anything it does not handle.
+inline bool DecodePng(const uint8_t* data, size_t size, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height, size_t pitch = 0) {
+    using namespace PngReaderDetail;
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (size < 8 || std::memcmp(data, signature, 8) != 0) return false;
+    uint32_t channels = 0;
+    std::vector<uint8_t> zlib;
+    bool ended = false;
+    width = height = 0;
+    for (size_t at = 8; at + 12 <= size && !ended;) {
+        uint32_t length = LoadBigEndian(data + at);
+        const uint8_t* type = data + at + 4;
+        const uint8_t* chunk = type + 4;
+        if (length > size - at - 12 || Crc32(type, length + 4) != LoadBigEndian(chunk + length)) return false;
+        if (std::memcmp(type, "IHDR", 4) == 0 && length == 13) {
+            width = LoadBigEndian(chunk);
+            height = LoadBigEndian(chunk + 4);
+            // 8-bit, RGB (2) or RGBA (6), deflate, standard filters, not interlaced
+            if (chunk[8] != 8 || (chunk[9] != 2 && chunk[9] != 6) || chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) return false;
+            channels = chunk[9] == 6 ? 4 : 3;
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), chunk, chunk + length);
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+        at += 12 + length;
+    }
+    if (!ended || channels == 0 || width == 0 || height == 0 || width > 1u << 16 || height > 1u << 16) return false;
+
+    // zlib: 32K-window deflate, no preset dictionary, Adler-32 of the scanlines at the end
+    if (zlib.size() < 6 || (zlib[0] & 15) != 8 || (zlib[0] >> 4) > 7 || ((zlib[0] << 8) | zlib[1]) % 31 != 0 || (zlib[1] & 0x20)) return false;
+    const size_t rowBytes = static_cast<size_t>(width) * channels;
+    const size_t expected = (rowBytes + 1) * height;
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve(expected);
+    size_t consumed = Inflate(zlib.data() + 2, zlib.size() - 2, scanlines, expected);
+    if (consumed == 0 || scanlines.size() != expected || 2 + consumed + 4 > zlib.size() ||
+        Adler32(scanlines.data(), scanlines.size()) != LoadBigEndian(zlib.data() + 2 + consumed)) {
+        return false;
+    }
+
+    // Undo the row filters in place, then swizzle to BGRA
+    if (pitch == 0) pitch = static_cast<size_t>(width) * 4;
+    pixels.resize(pitch * height);
+    const uint8_t* prior = nullptr;
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* line = scanlines.data() + y * (rowBytes + 1);
+        uint8_t filter = line[0];
+        uint8_t* row = line + 1;
+        for (size_t i = 0; i < rowBytes; ++i) {
+            int a = i >= channels ? row[i - channels] : 0;
+            int b = prior ? prior[i] : 0;
+            int c = i >= channels && prior ? prior[i - channels] : 0;
+            switch (filter) {
+            case 0: break;
+            case 1: row[i] = static_cast<uint8_t>(row[i] + a); break;
+            case 2: row[i] = static_cast<uint8_t>(row[i] + b); break;
+            case 3: row[i] = static_cast<uint8_t>(row[i] + ((a + b) >> 1)); break;
+            case 4: row[i] = static_cast<uint8_t>(row[i] + PaethPredictor(a, b, c)); break;
+            default: return false;
+            }
+        }
+        uint8_t* out = pixels.data() + y * pitch;
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint8_t* px = row + static_cast<size_t>(x) * channels;
+            out[x * 4] = px[2];
+            out[x * 4 + 1] = px[1];
+            out[x * 4 + 2] = px[0];
+            out[x * 4 + 3] = channels == 4 ? px[3] : 255;
+        }
+        prior = row;
+    }
+    return true;
+}
+
+inline bool ReadPngFile(const std::string& path, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height, size_t pitch = 0) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[1 << 16];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+    std::fclose(file);
+    return DecodePng(bytes.data(), bytes.size(), pixels, width, height, pitch);
+}
@@ -0,0 +1,512 @@
+#pragma once
+// Self-contained PNG writer for captured frames, so encoding can run (and be measured)
+// without WIC or stb_image_write. Compression follows stb_image_write: per-row adaptive
+// filtering, then LZ77 over 3-byte hash chains packed with the fixed Huffman codes.
+// Input is BGRA (desktop duplication) or RGBA at any row pitch; output is 8-bit RGBA.
+// EncodePngParallel() splits the image into row strips and deflates them on a ThreadPool,
+// pigz style, stitching the pieces into one zlib stream.
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+inline uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[i] = c;
+            }
+        }
+    } table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler = 1) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t chunk = size < 5552 ? size : 5552;   // Largest run that cannot overflow 32 bits
+        size -= chunk;
+        for (size_t i = 0; i < chunk; ++i) {
+            a += data[i];
+            b += a;
+        }
+        data += chunk;
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Adler-32 of A followed by B from the checksums of each (B is 'sizeB' bytes long), as zlib's
+// adler32_combine(); lets strips be checksummed in parallel
+inline uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t sizeB) {
+    const uint32_t base = 65521;
+    uint32_t rem = static_cast<uint32_t>(sizeB % base);
+    uint32_t sum1 = adlerA & 0xFFFF;
+    uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(rem) * sum1) % base);
+    sum1 += (adlerB & 0xFFFF) + base - 1;
+    sum2 += ((adlerA >> 16) & 0xFFFF) + ((adlerB >> 16) & 0xFFFF) + base - rem;
+    if (sum1 >= base) sum1 -= base;
+    if (sum1 >= base) sum1 -= base;
+    if (sum2 >= (base << 1)) sum2 -= (base << 1);
+    if (sum2 >= base) sum2 -= base;
+    return (sum2 << 16) | sum1;
+}
+
+// LSB-first bit packer as deflate expects
+class DeflateBitWriter {
+public:
+    explicit DeflateBitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void Put(uint32_t value, int bits) {
+        m_bits |= static_cast<uint64_t>(value) << m_count;
+        m_count += bits;
+        while (m_count >= 8) {
+            m_out.push_back(static_cast<uint8_t>(m_bits));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    // Pad with zero bits to the next byte boundary
+    void AlignToByte() {
+        if (m_count > 0) Put(0, 8 - m_count);
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_bits = 0;
+    int m_count = 0;
+};
+
+// Raw deflate (RFC 1951) with fixed Huffman codes. Reusable: keeps its hash tables.
+class DeflateEncoder {
+public:
+    // maxChain bounds the match search per position; higher compresses better, runs slower
+    explicit DeflateEncoder(uint32_t maxChain = 8)
+        : m_maxChain(maxChain ? maxChain : 1), m_head(kHashSize), m_prev(kWindow) {}
+
+    // Compress data[0, size) as one fixed-Huffman block. The 'historySize' bytes just
+    // before 'data' may be referenced by matches but are not emitted.
+    void Compress(const uint8_t* data, size_t size, size_t historySize, DeflateBitWriter& out, bool finalBlock) {
+        const Tables& t = FixedTables();
+        const uint8_t* base = data - historySize;
+        const size_t end = historySize + size;
+        std::fill(m_head.begin(), m_head.end(), -1);
+
+        for (size_t p = historySize > kWindow ? historySize - kWindow : 0; p + 2 < historySize; ++p) {
+            Insert(base, p);
+        }
+
+        out.Put(finalBlock ? 1 : 0, 1);
+        out.Put(1, 2);  // BTYPE 01: fixed Huffman
+
+        size_t p = historySize;
+        while (p < end) {
+            uint32_t bestLength = 0;
+            uint32_t bestDistance = 0;
+            if (p + kMinMatch <= end) {
+                size_t maxLength = std::min<size_t>(kMaxMatch, end - p);
+                int32_t candidate = m_head[Hash(base + p)];
+                uint32_t chain = m_maxChain;
+                while (candidate >= 0 && chain-- > 0 && p - candidate <= kWindow) {
+                    const uint8_t* a = base + candidate;
+                    const uint8_t* b = base + p;
+                    if (a[bestLength] == b[bestLength] && a[0] == b[0]) {
+                        uint32_t length = 0;
+                        while (length < maxLength && a[length] == b[length]) length++;
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = static_cast<uint32_t>(p - candidate);
+                            if (length == maxLength) break;
+                        }
+                    }
+                    candidate = m_prev[candidate & (kWindow - 1)];
+                }
+            }
+
+            if (bestLength >= kMinMatch) {
+                uint32_t lc = t.lengthCode[bestLength];
+                PutLiteral(out, t, 257 + lc);
+                if (kLengthExtra[lc]) out.Put(bestLength - kLengthBase[lc], kLengthExtra[lc]);
+                uint32_t dc = t.distanceCode[bestDistance <= 256 ? bestDistance - 1 : 256 + ((bestDistance - 1) >> 7)];
+                out.Put(t.distanceBits[dc], 5);
+                if (kDistanceExtra[dc]) out.Put(bestDistance - kDistanceBase[dc], kDistanceExtra[dc]);
+                for (uint32_t i = 0; i < bestLength; ++i, ++p) {
+                    if (p + 2 < end) Insert(base, p);
+                }
+            }
+            else {
+                PutLiteral(out, t, base[p]);
+                if (p + 2 < end) Insert(base, p);
+                p++;
+            }
+        }
+        PutLiteral(out, t, 256);    // End of block
+    }
+
+    // Empty stored block: ends on a byte boundary so independently made pieces can be concatenated
+    static void SyncFlush(DeflateBitWriter& out) {
+        out.Put(0, 3);
+        out.AlignToByte();
+        out.Put(0x0000, 16);
+        out.Put(0xFFFF, 16);
+    }
+
+private:
+    static const size_t kWindow = 32768;
+    static const size_t kHashBits = 15;
+    static const size_t kHashSize = size_t(1) << kHashBits;
+    static const uint32_t kMinMatch = 3;
+    static const uint32_t kMaxMatch = 258;
+
+    static constexpr uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static constexpr uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static constexpr uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static constexpr uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // Huffman codes are sent MSB first, so store them bit-reversed for the LSB-first writer
+    struct Tables {
+        uint16_t literalBits[288];
+        uint8_t literalLength[288];
+        uint8_t distanceBits[30];
+        uint8_t lengthCode[259];
+        uint8_t distanceCode[512];
+
+        static uint32_t Reverse(uint32_t code, int bits) {
+            uint32_t r = 0;
+            for (int i = 0; i < bits; ++i) r |= ((code >> i) & 1) << (bits - 1 - i);
+            return r;
+        }
+
+        Tables() {
+            for (uint32_t s = 0; s < 288; ++s) {
+                uint32_t code, bits;
+                if (s < 144) { code = 0x30 + s; bits = 8; }
+                else if (s < 256) { code = 0x190 + (s - 144); bits = 9; }
+                else if (s < 280) { code = s - 256; bits = 7; }
+                else { code = 0xC0 + (s - 280); bits = 8; }
+                literalBits[s] = static_cast<uint16_t>(Reverse(code, bits));
+                literalLength[s] = static_cast<uint8_t>(bits);
+            }
+            for (uint32_t d = 0; d < 30; ++d) distanceBits[d] = static_cast<uint8_t>(Reverse(d, 5));
+            for (uint32_t c = 0; c < 29; ++c) {
+                uint32_t last = c == 28 ? 258 : kLengthBase[c] + (1u << kLengthExtra[c]) - 1;
+                for (uint32_t l = kLengthBase[c]; l <= last && l <= 258; ++l) lengthCode[l] = static_cast<uint8_t>(c);
+            }
+            lengthCode[258] = 28;   // 258 has its own code even though 227 + 31 also reaches it
+            for (uint32_t c = 0; c < 30; ++c) {
+                uint32_t last = kDistanceBase[c] + (1u << kDistanceExtra[c]) - 1;
+                for (uint32_t d = kDistanceBase[c]; d <= last && d <= 32768; ++d) {
+                    distanceCode[d <= 256 ? d - 1 : 256 + ((d - 1) >> 7)] = static_cast<uint8_t>(c);
+                }
+            }
+        }
+    };
+
+    static const Tables& FixedTables() {
+        static const Tables tables;
+        return tables;
+    }
+
+    static void PutLiteral(DeflateBitWriter& out, const Tables& t, uint32_t symbol) {
+        out.Put(t.literalBits[symbol], t.literalLength[symbol]);
+    }
+
+    static uint32_t Hash(const uint8_t* p) {
+        uint32_t v = static_cast<uint32_t>(p[0]) << 16 | static_cast<uint32_t>(p[1]) << 8 | p[2];
+        return (v * 2654435761u) >> (32 - kHashBits);
+    }
+
+    void Insert(const uint8_t* base, size_t p) {
+        uint32_t h = Hash(base + p);
+        m_prev[p & (kWindow - 1)] = m_head[h];
+        m_head[h] = static_cast<int32_t>(p);
+    }
+
+    uint32_t m_maxChain;
+    std::vector<int32_t> m_head;
+    std::vector<int32_t> m_prev;
+};
+
+enum class PngPixelOrder {
+    Bgra,   // DXGI_FORMAT_B8G8R8A8_UNORM, what desktop duplication hands out
+    Rgba
+};
+
+struct PngWriteOptions {
+    PngPixelOrder order = PngPixelOrder::Bgra;
+    bool adaptiveFilter = true;     // Try all five filters per row (stb behaviour); false = always Paeth
+    uint32_t maxChain = 8;
+};
+
+// Append one length/type/data/CRC chunk
+inline void AppendPngChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size) {
+    uint8_t length[4] = { uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size) };
+    out.insert(out.end(), length, length + 4);
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size) out.insert(out.end(), data, data + size);
+    uint32_t crc = Crc32(out.data() + typeStart, size + 4);
+    uint8_t crcBytes[4] = { uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc) };
+    out.insert(out.end(), crcBytes, crcBytes + 4);
+}
+
+inline void AppendPngHeader(std::vector<uint8_t>& out, uint32_t width, uint32_t height) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), signature, signature + 8);
+    uint8_t ihdr[13] = {
+        uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+        uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+        8, 6, 0, 0, 0   // 8-bit RGBA, deflate, adaptive filtering, no interlace
+    };
+    AppendPngChunk(out, "IHDR", ihdr, sizeof(ihdr));
+}
+
+inline uint8_t PaethPredictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Produce the filtered scanline (filter byte + data) for 'row' given the previous
+// unfiltered row (nullptr for the first). Both rows are RGBA.
+inline void FilterPngRow(const uint8_t* row, const uint8_t* prior, size_t rowBytes, bool adaptive, std::vector<uint8_t>& scratch, uint8_t* out) {
+    auto above = [&](size_t i) -> int { return prior ? prior[i] : 0; };
+    auto filtered = [&](int type, size_t i) -> uint8_t {
+        int a = i >= 4 ? row[i - 4] : 0;
+        int b = above(i);
+        int c = i >= 4 && prior ? prior[i - 4] : 0;
+        switch (type) {
+        case 1: return static_cast<uint8_t>(row[i] - a);
+        case 2: return static_cast<uint8_t>(row[i] - b);
+        case 3: return static_cast<uint8_t>(row[i] - ((a + b) >> 1));
+        case 4: return static_cast<uint8_t>(row[i] - PaethPredictor(a, b, c));
+        default: return row[i];
+        }
+    };
+
+    if (!adaptive) {
+        out[0] = 4;
+        for (size_t i = 0; i < rowBytes; ++i) out[1 + i] = filtered(4, i);
+        return;
+    }
+
+    // Smallest sum of |signed residual| wins, as in libpng's and stb's heuristic
+    scratch.resize(rowBytes);
+    uint64_t bestScore = UINT64_MAX;
+    for (int type = 0; type < 5; ++type) {
+        uint64_t score = 0;
+        for (size_t i = 0; i < rowBytes; ++i) {
+            uint8_t v = filtered(type, i);
+            scratch[i] = v;
+            score += static_cast<uint64_t>(std::abs(static_cast<int8_t>(v)));
+        }
+        if (score < bestScore) {
+            bestScore = score;
+            out[0] = static_cast<uint8_t>(type);
+            std::memcpy(out + 1, scratch.data(), rowBytes);
+        }
+    }
+}
+
+// Convert rows to RGBA and filter them into PNG scanlines (filter byte + pixels per row)
+inline void BuildPngScanlines(const uint8_t* pixels, uint32_t width, uint32_t firstRow, uint32_t rowCount, size_t rowPitch,
+                              const PngWriteOptions& options, std::vector<uint8_t>& scanlines) {
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    scanlines.resize((rowBytes + 1) * rowCount);
+    std::vector<uint8_t> rows[2] = { std::vector<uint8_t>(rowBytes), std::vector<uint8_t>(rowBytes) };
+    std::vector<uint8_t> scratch;
+
+    for (uint32_t r = 0; r < rowCount; ++r) {
+        uint32_t y = firstRow + r;
+        std::vector<uint8_t>& current = rows[y & 1];
+        const uint8_t* source = pixels + static_cast<size_t>(y) * rowPitch;
+        if (options.order == PngPixelOrder::Bgra) {
+            for (size_t i = 0; i < rowBytes; i += 4) {
+                current[i + 0] = source[i + 2];
+                current[i + 1] = source[i + 1];
+                current[i + 2] = source[i + 0];
+                current[i + 3] = source[i + 3];
+            }
+        }
+        else {
+            std::memcpy(current.data(), source, rowBytes);
+        }
+
+        // The row above a strip still filters against the real previous row
+        const uint8_t* prior = nullptr;
+        if (y > 0) {
+            std::vector<uint8_t>& previous = rows[(y - 1) & 1];
+            if (r == 0) {
+                const uint8_t* above = pixels + static_cast<size_t>(y - 1) * rowPitch;
+                if (options.order == PngPixelOrder::Bgra) {
+                    for (size_t i = 0; i < rowBytes; i += 4) {
+                        previous[i + 0] = above[i + 2];
+                        previous[i + 1] = above[i + 1];
+                        previous[i + 2] = above[i + 0];
+                        previous[i + 3] = above[i + 3];
+                    }
+                }
+                else {
+                    std::memcpy(previous.data(), above, rowBytes);
+                }
+            }
+            prior = previous.data();
+        }
+        FilterPngRow(current.data(), prior, rowBytes, options.adaptiveFilter, scratch, scanlines.data() + r * (rowBytes + 1));
+    }
+}
+
+inline bool EncodePng(const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowPitch, std::vector<uint8_t>& out,
+                      const PngWriteOptions& options = PngWriteOptions()) {
+    if (width == 0 || height == 0 || rowPitch < static_cast<size_t>(width) * 4) return false;
+
+    std::vector<uint8_t> scanlines;
+    BuildPngScanlines(pixels, width, 0, height, rowPitch, options, scanlines);
+
+    std::vector<uint8_t> zlib;
+    zlib.reserve(scanlines.size() / 2);
+    zlib.push_back(0x78);   // 32K window, deflate
+    zlib.push_back(0x5E);   // Fast compression level hint; header checksum holds
+    {
+        DeflateBitWriter bits(zlib);
+        DeflateEncoder encoder(options.maxChain);
+        encoder.Compress(scanlines.data(), scanlines.size(), 0, bits, true);
+        bits.AlignToByte();
+    }
+    uint32_t adler = Adler32(scanlines.data(), scanlines.size());
+    uint8_t adlerBytes[4] = { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) };
+    zlib.insert(zlib.end(), adlerBytes, adlerBytes + 4);
+
+    out.clear();
+    AppendPngHeader(out, width, height);
+    AppendPngChunk(out, "IDAT", zlib.data(), zlib.size());
+    AppendPngChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+// Rows per strip when the caller does not choose: about 256 KB of scanlines, as pigz's blocks
+inline uint32_t DefaultPngStripRows(uint32_t width) {
+    size_t rowBytes = static_cast<size_t>(width) * 4 + 1;
+    return static_cast<uint32_t>(std::max<size_t>(256 * 1024 / rowBytes, 1));
+}
+
+// Same PNG as EncodePng() would describe, built strip by strip on 'pool': every strip is
+// filtered, checksummed and deflated independently (matches may reach 32 KB back into the
+// strip before it), ends on a byte boundary with a sync flush, and becomes one IDAT chunk
+// whose CRC its worker computes. The Adler-32s are combined in order at the end.
+inline bool EncodePngParallel(const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowPitch, std::vector<uint8_t>& out,
+                              ThreadPool& pool, const PngWriteOptions& options = PngWriteOptions(), uint32_t stripRows = 0) {
+    if (width == 0 || height == 0 || rowPitch < static_cast<size_t>(width) * 4) return false;
+    if (stripRows == 0) stripRows = DefaultPngStripRows(width);
+    const size_t scanlineBytes = static_cast<size_t>(width) * 4 + 1;
+    const size_t stripCount = (height + stripRows - 1) / stripRows;
+    const size_t historyLimit = 32768;
+
+    struct Strip {
+        std::vector<uint8_t> chunk;     // IDAT length + type + deflate bytes; CRC appended later
+        uint32_t crc = 0;               // Over type + data so far
+        uint32_t adler = 1;
+        size_t scanlineSize = 0;
+    };
+    std::vector<Strip> strips(stripCount);
+
+    // Pass 1: filter every strip into one shared scanline buffer, so pass 2 can use the
+    // previous strip's bytes as deflate history
+    std::vector<uint8_t> scanlines(scanlineBytes * height);
+    pool.ParallelFor(stripCount, [&](size_t i) {
+        uint32_t firstRow = static_cast<uint32_t>(i * stripRows);
+        uint32_t rowCount = std::min(stripRows, height - firstRow);
+        std::vector<uint8_t> filtered;
+        BuildPngScanlines(pixels, width, firstRow, rowCount, rowPitch, options, filtered);
+        std::memcpy(scanlines.data() + firstRow * scanlineBytes, filtered.data(), filtered.size());
+    });
+
+    // Pass 2: deflate and checksum each strip
+    pool.ParallelFor(stripCount, [&](size_t i) {
+        Strip& strip = strips[i];
+        size_t begin = i * stripRows * scanlineBytes;
+        size_t size = std::min<size_t>(stripRows, height - i * stripRows) * scanlineBytes;
+        bool last = i + 1 == stripCount;
+
+        strip.chunk.reserve(size / 2 + 64);
+        strip.chunk.resize(8);          // Length and type are filled in once the size is known
+        std::memcpy(strip.chunk.data() + 4, "IDAT", 4);
+        if (i == 0) {
+            strip.chunk.push_back(0x78);
+            strip.chunk.push_back(0x5E);
+        }
+        {
+            DeflateBitWriter bits(strip.chunk);
+            DeflateEncoder encoder(options.maxChain);
+            encoder.Compress(scanlines.data() + begin, size, std::min(begin, historyLimit), bits, last);
+            if (last) bits.AlignToByte();
+            else DeflateEncoder::SyncFlush(bits);
+        }
+        size_t dataSize = strip.chunk.size() - 8 + (last ? 4 : 0);   // The last one also carries the Adler-32
+        strip.chunk[0] = uint8_t(dataSize >> 24);
+        strip.chunk[1] = uint8_t(dataSize >> 16);
+        strip.chunk[2] = uint8_t(dataSize >> 8);
+        strip.chunk[3] = uint8_t(dataSize);
+        strip.crc = Crc32(strip.chunk.data() + 4, strip.chunk.size() - 4);
+        strip.adler = Adler32(scanlines.data() + begin, size);
+        strip.scanlineSize = size;
+    });
+
+    uint32_t adler = 1;
+    size_t total = 0;
+    for (const Strip& strip : strips) {
+        adler = Adler32Combine(adler, strip.adler, strip.scanlineSize);
+        total += strip.chunk.size() + 8;
+    }
+
+    out.clear();
+    out.reserve(total + 64);
+    AppendPngHeader(out, width, height);
+    for (size_t i = 0; i < stripCount; ++i) {
+        Strip& strip = strips[i];
+        uint32_t crc = strip.crc;
+        if (i + 1 == stripCount) {
+            uint8_t adlerBytes[4] = { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) };
+            strip.chunk.insert(strip.chunk.end(), adlerBytes, adlerBytes + 4);
+            crc = Crc32(adlerBytes, 4, crc);
+        }
+        uint8_t crcBytes[4] = { uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc) };
+        out.insert(out.end(), strip.chunk.begin(), strip.chunk.end());
+        out.insert(out.end(), crcBytes, crcBytes + 4);
+    }
+    AppendPngChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+inline bool WritePngFile(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowPitch,
+                         const PngWriteOptions& options = PngWriteOptions()) {
+    std::vector<uint8_t> png;
+    if (!EncodePng(pixels, width, height, rowPitch, png, options)) return false;
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
+
+inline bool WritePngFileParallel(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, size_t rowPitch,
+                                 ThreadPool& pool, const PngWriteOptions& options = PngWriteOptions()) {
+    std::vector<uint8_t> png;
+    if (!EncodePngParallel(pixels, width, height, rowPitch, png, pool, options)) return false;
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,277 @@
+#pragma once
+// Streams captured frames to external tools as YUV4MPEG2 (I420, what ffmpeg, x264 and most
+// analysers read from a pipe) or as headerless BGRA, to stdout ("-"), a named pipe or a file.
+//   ffmpeg -i left.y4m ...      ffmpeg -f rawvideo -pix_fmt bgra -s WxH -r 60 -i - ...
+// Frames are converted or packed into a small ring of owned buffers. On Linux, when the
+// destination is a pipe, those buffers are vmsplice()d into it: the pipe references the
+// pages instead of copying them, so a 5K frame costs the conversion and nothing else. A
+// buffer is only reused once the pipe can no longer hold any of its bytes (the ring has
+// more slots than the pipe has frames of capacity), and spliced slots are mapped straight
+// from the kernel so that closing the sink cannot hand pages the pipe still holds back to
+// malloc. Files get plain writes; splicing into a file would still copy into the page cache.
+// On Windows, "\\.\pipe\name" connects to a pipe server another tool created.
+#include "ImageView.h"
+#include "ThreadPool.h"
+#include "YuvConvert.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+enum class RawVideoFormat {
+    Y4m,    // "YUV4MPEG2" header, then "FRAME\n" + I420 planes per frame
+    Bgra    // Tightly packed BGRA rows, nothing else
+};
+
+struct RawVideoSinkOptions {
+    RawVideoFormat format = RawVideoFormat::Y4m;
+    double fps = 60.0;
+    YuvMatrix matrix = YuvMatrix::Bt709;
+    bool fullRange = false;
+    bool zeroCopy = true;       // vmsplice into pipes where the platform has it
+};
+
+struct RawVideoSinkStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t splicedBytes = 0;  // Handed over as page references rather than copied
+};
+
+// Frame rate as the rational Y4M wants: integers stay n:1, NTSC rates become n*1000:1001
+inline void RawVideoFrameRate(double fps, uint32_t& numerator, uint32_t& denominator) {
+    if (fps <= 0) fps = 60.0;
+    double rounded = std::floor(fps + 0.5);
+    if (std::fabs(fps - rounded) < 1e-3) {
+        numerator = static_cast<uint32_t>(rounded);
+        denominator = 1;
+        return;
+    }
+    double ntsc = std::floor(fps * 1.001 + 0.5);
+    if (std::fabs(ntsc * 1000.0 / 1001.0 - fps) < 1e-3) {
+        numerator = static_cast<uint32_t>(ntsc) * 1000;
+        denominator = 1001;
+        return;
+    }
+    numerator = static_cast<uint32_t>(std::floor(fps * 1000.0 + 0.5));
+    denominator = 1000;
+}
+
+class RawVideoSink {
+public:
+    ~RawVideoSink() { Close(); }
+
+    // "-" is stdout. Anything else is opened for writing: a file is truncated, a FIFO or
+    // Windows pipe blocks here until a reader is there.
+    bool Open(const std::string& destination, uint32_t width, uint32_t height, const RawVideoSinkOptions& options = RawVideoSinkOptions()) {
+        Close();
+        if (width == 0 || height == 0) return false;
+        if (options.format == RawVideoFormat::Y4m && ((width | height) & 1) != 0) return false;   // 4:2:0 needs even sizes
+        m_width = width;
+        m_height = height;
+        m_options = options;
+        m_stats = RawVideoSinkStats();
+        m_frameBytes = options.format == RawVideoFormat::Y4m ? YuvFrameBytes(width, height) : static_cast<size_t>(width) * height * 4;
+#ifdef _WIN32
+        if (destination == "-") {
+            _setmode(_fileno(stdout), _O_BINARY);
+            m_file = stdout;
+        }
+        else {
+            m_file = std::fopen(destination.c_str(), "wb");
+            m_ownsFile = m_file != nullptr;
+        }
+        if (!m_file) return false;
+#else
+        if (destination == "-") {
+            m_fd = STDOUT_FILENO;
+        }
+        else {
+            m_fd = open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            m_ownsFile = m_fd >= 0;
+        }
+        if (m_fd < 0) return false;
+        struct stat info;
+        m_splice = false;
+#ifdef __linux__
+        m_splice = options.zeroCopy && fstat(m_fd, &info) == 0 && S_ISFIFO(info.st_mode);
+#else
+        (void)info;
+#endif
+#ifdef __linux__
+        if (m_splice) {
+            // Bigger pipes mean fewer wakeups; then enough slots that the pipe cannot still
+            // hold bytes of the slot being refilled
+            fcntl(m_fd, F_SETPIPE_SZ, 1 << 20);
+            long capacity = fcntl(m_fd, F_GETPIPE_SZ);
+            if (capacity <= 0) capacity = 1 << 16;
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            m_slotCount = static_cast<size_t>(capacity) / m_frameBytes + 2;
+            m_splicedSlotBytes = (m_frameBytes + page - 1) / page * page;
+            void* slots = mmap(nullptr, m_splicedSlotBytes * m_slotCount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (slots == MAP_FAILED) {
+                Close();
+                return false;
+            }
+            m_splicedSlots = static_cast<uint8_t*>(slots);
+        }
+#endif
+#endif
+        if (m_slotCount == 0) {
+            m_copySlot.resize(m_frameBytes);
+            m_slotCount = 1;
+        }
+        m_nextSlot = 0;
+
+        if (options.format == RawVideoFormat::Y4m) {
+            uint32_t numerator, denominator;
+            RawVideoFrameRate(options.fps, numerator, denominator);
+            char header[160];
+            int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg XYSCSS=420JPEG XCOLORRANGE=%s\n",
+                                  width, height, numerator, denominator, options.fullRange ? "FULL" : "LIMITED");
+            // Copied, not spliced: the pipe would otherwise reference this stack buffer
+            if (!WriteAll(reinterpret_cast<const uint8_t*>(header), static_cast<size_t>(length), false)) {
+                Close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Converts or packs 'frame' and sends it; blocks while the reader is behind. Conversion
+    // and packing run on 'pool' when given.
+    bool WriteFrame(const ImageView& frame, ThreadPool* pool = nullptr) {
+        if (!IsOpen() || frame.width != m_width || frame.height != m_height) return false;
+        uint8_t* slot = Slot(m_nextSlot);
+        m_nextSlot = (m_nextSlot + 1) % m_slotCount;
+        if (m_options.format == RawVideoFormat::Y4m) {
+            YuvOptions yuv;
+            yuv.layout = YuvLayout::I420;
+            yuv.matrix = m_options.matrix;
+            yuv.fullRange = m_options.fullRange;
+            ConvertToYuv(frame, PackedYuvPlanes(slot, m_width, m_height, YuvLayout::I420), yuv, pool);
+        }
+        else {
+            // The one copy BGRA needs, out of the staging memory the caller will reuse
+            const size_t rowBytes = frame.RowBytes();
+            const uint32_t bandRows = 64;
+            auto packBand = [&](size_t band) {
+                uint32_t end = std::min<uint32_t>(m_height, static_cast<uint32_t>(band + 1) * bandRows);
+                for (uint32_t y = static_cast<uint32_t>(band) * bandRows; y < end; ++y) std::memcpy(slot + y * rowBytes, frame.Row(y), rowBytes);
+            };
+            size_t bands = (m_height + bandRows - 1) / bandRows;
+            if (pool && pool->Concurrency() > 1) pool->ParallelFor(bands, packBand);
+            else for (size_t band = 0; band < bands; ++band) packBand(band);
+        }
+        static const uint8_t kFrameHeader[] = { 'F', 'R', 'A', 'M', 'E', '\n' };
+        bool ok = (m_options.format != RawVideoFormat::Y4m || WriteAll(kFrameHeader, sizeof(kFrameHeader), m_splice))
+            && WriteAll(slot, m_frameBytes, m_splice);
+        if (ok) m_stats.frames++;
+        return ok;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (m_file) {
+            if (m_ownsFile) std::fclose(m_file);
+            else std::fflush(m_file);
+        }
+        m_file = nullptr;
+#else
+        if (m_fd >= 0 && m_ownsFile) close(m_fd);
+        m_fd = -1;
+        // Pages still in the pipe stay referenced there; only our mapping goes
+        if (m_splicedSlots) munmap(m_splicedSlots, m_splicedSlotBytes * m_slotCount);
+        m_splicedSlots = nullptr;
+#endif
+        m_ownsFile = false;
+        m_copySlot.clear();
+        m_copySlot.shrink_to_fit();
+        m_slotCount = 0;
+    }
+
+    bool IsOpen() const {
+#ifdef _WIN32
+        return m_file != nullptr;
+#else
+        return m_fd >= 0;
+#endif
+    }
+
+    bool ZeroCopy() const { return m_splice; }
+    size_t FrameBytes() const { return m_frameBytes; }
+    const RawVideoSinkStats& Stats() const { return m_stats; }
+
+private:
+    uint8_t* Slot(size_t index) {
+#ifndef _WIN32
+        if (m_splicedSlots) return m_splicedSlots + index * m_splicedSlotBytes;
+#endif
+        (void)index;
+        return m_copySlot.data();
+    }
+
+    // 'splice' hands the pages over instead of copying; only for memory that outlives its
+    // time in the pipe
+    bool WriteAll(const uint8_t* data, size_t size, bool splice) {
+#ifdef _WIN32
+        (void)splice;
+        if (std::fwrite(data, 1, size, m_file) != size) return false;
+        m_stats.bytes += size;
+        return true;
+#else
+#ifndef __linux__
+        (void)splice;
+#endif
+        while (size > 0) {
+            ssize_t n;
+#ifdef __linux__
+            if (splice) {
+                struct iovec iov = { const_cast<uint8_t*>(data), size };
+                n = vmsplice(m_fd, &iov, 1, 0);
+                if (n > 0) m_stats.splicedBytes += static_cast<uint64_t>(n);
+            }
+            else
+#endif
+            n = write(m_fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= static_cast<size_t>(n);
+            m_stats.bytes += static_cast<uint64_t>(n);
+        }
+        return true;
+#endif
+    }
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    RawVideoSinkOptions m_options;
+    RawVideoSinkStats m_stats;
+    size_t m_frameBytes = 0;
+    std::vector<uint8_t> m_copySlot;    // Written out before the next frame, so one is enough
+    size_t m_slotCount = 0;
+    size_t m_nextSlot = 0;
+    bool m_splice = false;
+    bool m_ownsFile = false;
+#ifdef _WIN32
+    std::FILE* m_file = nullptr;
+#else
+    int m_fd = -1;
+    uint8_t* m_splicedSlots = nullptr;
+    size_t m_splicedSlotBytes = 0;
+#endif
+};
@@ -0,0 +1,324 @@
+// Checks and times RawVideoSink. A Y4M file is parsed back and compared with ConvertToYuv,
+// BGRA and Y4M streams are read back out of a pipe by another thread while they are written,
+// then 5K frames are pushed through a pipe to a reader that drains them, with vmsplice and
+// with plain writes.
+// Passes if every stream reads back exactly and the writing thread would spend under 1/120 s
+// per 5K BGRA frame with its row packing split over 8 cores; on Linux the pipe must also
+// have taken the zero-copy path.
+// Usage: RawVideoSinkBenchmark [frames]
+#include "RawVideoSink.h"
+#include "SyntheticFrameSource.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+const uint32_t kWidth = 5120;
+const uint32_t kHeight = 2880;
+const double kTargetFps = 120.0;
+const double kTargetCores = 8.0;
+
+// Y4M as RawVideoSink writes it: the header line, then FRAME lines each followed by I420
+bool ParseY4m(const std::vector<uint8_t>& bytes, uint32_t& width, uint32_t& height, std::string& rate, std::vector<std::vector<uint8_t>>& frames) {
+    size_t end = std::find(bytes.begin(), bytes.end(), '\n') - bytes.begin();
+    if (end == bytes.size()) return false;
+    std::istringstream header(std::string(bytes.begin(), bytes.begin() + end));
+    std::string token;
+    header >> token;
+    if (token != "YUV4MPEG2") return false;
+    width = height = 0;
+    while (header >> token) {
+        if (token[0] == 'W') width = std::stoul(token.substr(1));
+        else if (token[0] == 'H') height = std::stoul(token.substr(1));
+        else if (token[0] == 'F') rate = token.substr(1);
+        else if (token[0] == 'C' && token != "C420jpeg") return false;
+    }
+    size_t frameBytes = YuvFrameBytes(width, height);
+    size_t at = end + 1;
+    frames.clear();
+    while (at < bytes.size()) {
+        if (bytes.size() - at < 6 || std::string(bytes.begin() + at, bytes.begin() + at + 6) != "FRAME\n") return false;
+        at += 6;
+        if (bytes.size() - at < frameBytes) return false;
+        frames.emplace_back(bytes.begin() + at, bytes.begin() + at + frameBytes);
+        at += frameBytes;
+    }
+    return width != 0 && height != 0;
+}
+
+std::vector<uint8_t> ExpectedI420(const ImageView& view, const RawVideoSinkOptions& options) {
+    YuvOptions yuv;
+    yuv.layout = YuvLayout::I420;
+    yuv.matrix = options.matrix;
+    yuv.fullRange = options.fullRange;
+    std::vector<uint8_t> out(YuvFrameBytes(view.width, view.height));
+    ConvertToYuv(view, PackedYuvPlanes(out.data(), view.width, view.height, YuvLayout::I420), yuv);
+    return out;
+}
+
+std::vector<uint8_t> PackedBgra(const ImageView& view) {
+    std::vector<uint8_t> out(view.RowBytes() * view.height);
+    for (uint32_t y = 0; y < view.height; ++y) std::memcpy(out.data() + y * view.RowBytes(), view.Row(y), view.RowBytes());
+    return out;
+}
+
+bool VerifyFrameRates() {
+    const struct { double fps; const char* expected; } cases[] = {
+        { 60.0, "60:1" }, { 30.0, "30:1" }, { 59.94, "60000:1001" }, { 29.97, "30000:1001" }, { 23.976, "24000:1001" }, { 12.5, "12500:1000" },
+    };
+    for (const auto& c : cases) {
+        uint32_t numerator, denominator;
+        RawVideoFrameRate(c.fps, numerator, denominator);
+        if (std::to_string(numerator) + ":" + std::to_string(denominator) != c.expected) {
+            std::cerr << c.fps << " fps became " << numerator << ":" << denominator << ", expected " << c.expected << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Renders 'count' frames of a small Typing desktop, cropped to an odd pitch
+void RenderFrames(uint32_t width, uint32_t height, size_t count, std::vector<std::vector<uint8_t>>& storage, std::vector<ImageView>& views) {
+    SyntheticFrameSource source(width + 3, height, SyntheticPattern::Typing);
+    storage.assign(count, std::vector<uint8_t>(source.FrameBytes()));
+    views.clear();
+    for (size_t i = 0; i < count; ++i) {
+        source.RenderFrame(storage[i].data(), i);
+        views.push_back(ImageView(storage[i].data(), width + 3, height, source.RowPitch()).Crop(1, 0, width, height));
+    }
+}
+
+bool VerifyY4mFile() {
+    const uint32_t w = 320, h = 180;
+    std::vector<std::vector<uint8_t>> storage;
+    std::vector<ImageView> views;
+    RenderFrames(w, h, 5, storage, views);
+    RawVideoSinkOptions options;
+    options.fps = 59.94;
+    options.fullRange = true;
+    const char* path = "raw_video_sink_check.y4m";
+    ThreadPool pool(3);
+    {
+        RawVideoSink sink;
+        if (!sink.Open(path, w, h, options)) return false;
+        for (const ImageView& view : views) {
+            if (!sink.WriteFrame(view, &pool)) return false;
+        }
+        if (sink.ZeroCopy()) {
+            std::cerr << "A regular file took the splice path" << std::endl;
+            return false;
+        }
+    }
+    std::vector<uint8_t> bytes;
+    if (std::FILE* file = std::fopen(path, "rb")) {
+        uint8_t buffer[65536];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+        std::fclose(file);
+    }
+    std::remove(path);
+    uint32_t width, height;
+    std::string rate;
+    std::vector<std::vector<uint8_t>> frames;
+    if (!ParseY4m(bytes, width, height, rate, frames) || width != w || height != h || rate != "60000:1001" || frames.size() != views.size()) {
+        std::cerr << "Y4M file header or framing is wrong" << std::endl;
+        return false;
+    }
+    if (std::string(bytes.begin(), bytes.begin() + 80).find("XCOLORRANGE=FULL") == std::string::npos) {
+        std::cerr << "Y4M header does not carry the colour range" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (frames[i] != ExpectedI420(views[i], options)) {
+            std::cerr << "Y4M frame " << i << " differs from ConvertToYuv" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifndef _WIN32
+// Writes 'views' through a pipe while this thread reads everything back
+bool PipeRoundTrip(const std::vector<ImageView>& views, const RawVideoSinkOptions& options, bool& zeroCopy, std::vector<uint8_t>& received) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    bool writerOk = false;
+    std::thread writer([&]() {
+        RawVideoSink sink;
+        // /dev/fd/N opens the pipe's write end again, as a named pipe path would be opened
+        std::string path = "/dev/fd/" + std::to_string(fds[1]);
+        writerOk = sink.Open(path, views[0].width, views[0].height, options);
+        close(fds[1]);
+        for (size_t i = 0; writerOk && i < views.size(); ++i) writerOk = sink.WriteFrame(views[i]);
+        zeroCopy = sink.ZeroCopy();
+    });
+    received.clear();
+    uint8_t buffer[65536];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) received.insert(received.end(), buffer, buffer + n);
+    writer.join();
+    close(fds[0]);
+    return writerOk;
+}
+
+bool VerifyPipes() {
+    // Frames a few times the pipe size, so slots are recycled while the reader lags
+    const uint32_t w = 640, h = 360;
+    std::vector<std::vector<uint8_t>> storage;
+    std::vector<ImageView> views;
+    RenderFrames(w, h, 24, storage, views);
+    for (RawVideoFormat format : { RawVideoFormat::Bgra, RawVideoFormat::Y4m }) {
+        RawVideoSinkOptions options;
+        options.format = format;
+        bool zeroCopy = false;
+        std::vector<uint8_t> received;
+        if (!PipeRoundTrip(views, options, zeroCopy, received)) {
+            std::cerr << "Writing into the pipe failed" << std::endl;
+            return false;
+        }
+#ifdef __linux__
+        if (!zeroCopy) {
+            std::cerr << "The pipe did not take the vmsplice path" << std::endl;
+            return false;
+        }
+#endif
+        if (format == RawVideoFormat::Bgra) {
+            std::vector<uint8_t> expected;
+            for (const ImageView& view : views) {
+                std::vector<uint8_t> frame = PackedBgra(view);
+                expected.insert(expected.end(), frame.begin(), frame.end());
+            }
+            if (received != expected) {
+                std::cerr << "BGRA read from the pipe differs from what was written" << std::endl;
+                return false;
+            }
+        }
+        else {
+            uint32_t width, height;
+            std::string rate;
+            std::vector<std::vector<uint8_t>> frames;
+            if (!ParseY4m(received, width, height, rate, frames) || rate != "60:1" || frames.size() != views.size()) {
+                std::cerr << "Y4M read from the pipe is malformed" << std::endl;
+                return false;
+            }
+            for (size_t i = 0; i < frames.size(); ++i) {
+                if (frames[i] != ExpectedI420(views[i], options)) {
+                    std::cerr << "Y4M frame " << i << " read from the pipe differs" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+struct PipeTiming {
+    double fps = 0.0;           // Wall clock, writer and reader together
+    double writerMs = 0.0;      // CPU time the writing thread spends per frame
+};
+
+double ThreadCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// 5K BGRA pushed through a pipe to a reader that discards it
+PipeTiming TimePipe(const ImageView& view, size_t frames, bool zeroCopy, bool& spliced) {
+    PipeTiming timing;
+    int fds[2];
+    if (pipe(fds) != 0) return timing;
+    std::thread reader([&]() {
+        std::vector<uint8_t> buffer(1 << 20);
+        while (read(fds[0], buffer.data(), buffer.size()) > 0) {}
+    });
+    RawVideoSinkOptions options;
+    options.format = RawVideoFormat::Bgra;
+    options.zeroCopy = zeroCopy;
+    RawVideoSink sink;
+    if (sink.Open("/dev/fd/" + std::to_string(fds[1]), view.width, view.height, options)) {
+        close(fds[1]);
+        fds[1] = -1;
+        spliced = sink.ZeroCopy();
+        for (int i = 0; i < 4; ++i) sink.WriteFrame(view);     // Fault in the slots first
+        auto start = std::chrono::steady_clock::now();
+        double cpuStart = ThreadCpuSeconds();
+        for (size_t i = 0; i < frames; ++i) sink.WriteFrame(view);
+        timing.writerMs = (ThreadCpuSeconds() - cpuStart) * 1000.0 / frames;
+        timing.fps = frames / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sink.Close();
+    }
+    if (fds[1] >= 0) close(fds[1]);
+    reader.join();
+    close(fds[0]);
+    return timing;
+}
+#endif
+
+int main(int argc, char** argv) {
+    size_t frames = argc > 1 ? std::stoul(argv[1]) : 60;
+
+    if (!VerifyFrameRates() || !VerifyY4mFile()) {
+        std::cout << "FAIL: Y4M output is wrong" << std::endl;
+        return 1;
+    }
+    std::cout << "Y4M file reads back identical to ConvertToYuv, frame rates map to the right rationals" << std::endl;
+#ifndef _WIN32
+    if (!VerifyPipes()) {
+        std::cout << "FAIL: pipe output is wrong" << std::endl;
+        return 1;
+    }
+    std::cout << "BGRA and Y4M read back exactly from a pipe" << std::endl;
+
+    SyntheticFrameSource desktop(kWidth, kHeight, SyntheticPattern::ScrollingText);
+    std::vector<uint8_t> frame(desktop.FrameBytes());
+    desktop.RenderFrame(frame.data(), 0);
+    ImageView view(frame.data(), kWidth, kHeight, desktop.RowPitch());
+    const double megabytes = view.RowBytes() * static_cast<double>(kHeight) / (1024.0 * 1024.0);
+
+    bool spliced = false, copied = false;
+    PipeTiming splice = TimePipe(view, frames, true, spliced);
+    PipeTiming copy = TimePipe(view, frames, false, copied);
+    std::cout << kWidth << "x" << kHeight << " BGRA into a pipe, " << frames << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& row : { std::make_pair(spliced ? "vmsplice" : "write", splice), std::make_pair("write", copy) }) {
+        std::cout << "  " << std::left << std::setw(9) << row.first << std::right << std::setw(8) << row.second.fps << " fps "
+                  << std::setw(8) << row.second.fps * megabytes << " MB/s  " << std::setprecision(2) << std::setw(6) << row.second.writerMs
+                  << " ms writer CPU per frame" << std::setprecision(1) << std::endl;
+    }
+    // Of the writer's time, packing rows out of staging memory splits across the worker pool;
+    // handing the pages to the pipe does not. The reader copies every byte out again, but on
+    // the target that runs on a core of its own.
+    double packMs = 0.0;
+    {
+        std::vector<uint8_t> packed(view.RowBytes() * kHeight);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < frames; ++i) {
+            for (uint32_t y = 0; y < kHeight; ++y) std::memcpy(packed.data() + y * view.RowBytes(), view.Row(y), view.RowBytes());
+        }
+        packMs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0 / frames;
+    }
+    double handoffMs = std::max(0.0, splice.writerMs - packMs);
+    double projectedMs = packMs / kTargetCores + handoffMs;
+    double writerFps = 1000.0 / projectedMs;
+    std::cout << std::setprecision(2) << "  pack " << packMs << " ms, pipe hand-off " << handoffMs << " ms (write() copy: "
+              << std::max(0.0, copy.writerMs - packMs) << " ms)" << std::setprecision(1) << std::endl;
+    bool pass = writerFps >= kTargetFps;
+#ifdef __linux__
+    pass = pass && spliced;
+#endif
+    std::cout << (pass ? "PASS" : "FAIL") << ": the writer would sustain " << writerFps << " fps of 5K BGRA into a pipe with packing on "
+              << std::setprecision(0) << kTargetCores << " cores (" << kTargetFps << " needed)" << std::endl;
+    return pass ? 0 : 1;
+#else
+    std::cout << "PASS" << std::endl;
+    return 0;
+#endif
+}
@@ -0,0 +1,439 @@
+#pragma once
+// Session frame index (.sidx). One file per capture session lists every frame of every tile
+// in capture order: which tile it belongs to, its frame number and capture timestamp, where
+// its record starts in that tile's recording, and whether it is a keyframe. Entries are
+// fixed-size and appended as frames are written, so the index of a session that crashed is
+// still whole up to its last frame, and lookups binary-search the file in place: finding
+// "frame 2160000" or "14:32:05 on the right half" in a 10-hour session reads a few dozen
+// entries instead of scanning a directory or a recording.
+//
+// File: 64-byte header { "SIDX", version, tile count, reserved, ticks per second i64, epoch
+// ticks i64, epoch unix ms i64, reserved }, then per tile { width u32, height u32, source
+// name char[56] } naming the tile's file (or, for PNG output, its file pattern with
+// "{frame}" for the frame number) relative to the index, then 32-byte entries { frameIndex
+// u64, timestamp i64, record offset u64, tile u16, flags u16, payload bytes u32 }. Frames
+// are stamped in ticks; the epoch pair maps ticks to wall-clock time.
+// The offset is where the frame starts in that file: its record in a .srec or .tstore, its
+// packet in a video elementary stream, its payload in a .sring (until the ring overwrites
+// it). IndexedRecordingReader decodes .srec sources; the rest go to their own readers.
+#include "AsyncFileWriter.h"
+#include "ScreenRecording.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace RecordingIndexDetail {
+
+const char kMagic[4] = { 'S', 'I', 'D', 'X' };
+const uint32_t kVersion = 1;
+const size_t kHeaderBytes = 64;
+const size_t kTileBytes = 64;
+const size_t kSourceChars = 56;
+const size_t kEntryBytes = 32;
+const uint16_t kFlagKeyframe = 1;
+const uint16_t kFlagImageFile = 2;     // A PNG of its own; the offset is unused
+
+}  // namespace RecordingIndexDetail
+
+struct RecordingIndexEntry {
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;
+    uint64_t offset = 0;            // Of the frame in the tile's file
+    uint16_t tile = 0;
+    bool keyframe = false;
+    bool imageFile = false;
+    uint32_t payloadSize = 0;
+};
+
+struct RecordingIndexTile {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::string source;             // Recording file name, or PNG pattern with "{frame}"
+};
+
+class RecordingIndexWriter {
+public:
+    ~RecordingIndexWriter() { Close(); }
+
+    // epochTicks and epochUnixMs are the same instant on the frame clock and the wall clock
+    bool Open(const std::string& path, const std::vector<RecordingIndexTile>& tiles, int64_t ticksPerSecond, int64_t epochTicks,
+              int64_t epochUnixMs, const AsyncFileWriterOptions& io = AsyncFileWriterOptions()) {
+        using namespace RecordingIndexDetail;
+        Close();
+        if (tiles.empty() || tiles.size() > 0xFFFF || ticksPerSecond <= 0) return false;
+        for (const RecordingIndexTile& tile : tiles) {
+            if (tile.source.empty() || tile.source.size() >= kSourceChars) return false;
+        }
+        if (!m_file.Open(path, io)) return false;
+        m_tiles = static_cast<uint32_t>(tiles.size());
+        m_entries = 0;
+        m_dropped = 0;
+        std::vector<uint8_t> header(kHeaderBytes + tiles.size() * kTileBytes, 0);
+        std::memcpy(header.data(), kMagic, 4);
+        std::memcpy(header.data() + 4, &kVersion, 4);
+        std::memcpy(header.data() + 8, &m_tiles, 4);
+        std::memcpy(header.data() + 16, &ticksPerSecond, 8);
+        std::memcpy(header.data() + 24, &epochTicks, 8);
+        std::memcpy(header.data() + 32, &epochUnixMs, 8);
+        for (size_t t = 0; t < tiles.size(); ++t) {
+            uint8_t* tile = header.data() + kHeaderBytes + t * kTileBytes;
+            std::memcpy(tile, &tiles[t].width, 4);
+            std::memcpy(tile + 4, &tiles[t].height, 4);
+            std::memcpy(tile + 8, tiles[t].source.data(), tiles[t].source.size());
+        }
+        return m_file.Append(header.data(), header.size());
+    }
+
+    // A frame 'tile' just wrote to its recording
+    bool AddRecorded(uint16_t tile, const ScreenRecordingEntry& record) {
+        RecordingIndexEntry entry;
+        entry.frameIndex = record.frameIndex;
+        entry.timestamp = record.timestamp;
+        entry.offset = record.offset;
+        entry.tile = tile;
+        entry.keyframe = record.keyframe;
+        entry.payloadSize = record.payloadSize;
+        return Add(entry);
+    }
+
+    // A frame 'tile' saved as its own image file
+    bool AddImage(uint16_t tile, const ScreenStreamFrameInfo& info) {
+        RecordingIndexEntry entry;
+        entry.frameIndex = info.frameIndex;
+        entry.timestamp = info.timestamp;
+        entry.tile = tile;
+        entry.keyframe = true;
+        entry.imageFile = true;
+        return Add(entry);
+    }
+
+    bool Add(const RecordingIndexEntry& entry) {
+        using namespace RecordingIndexDetail;
+        if (!m_file.IsOpen() || entry.tile >= m_tiles) return false;
+        uint8_t bytes[kEntryBytes];
+        uint16_t flags = (entry.keyframe ? kFlagKeyframe : 0) | (entry.imageFile ? kFlagImageFile : 0);
+        std::memcpy(bytes, &entry.frameIndex, 8);
+        std::memcpy(bytes + 8, &entry.timestamp, 8);
+        std::memcpy(bytes + 16, &entry.offset, 8);
+        std::memcpy(bytes + 24, &entry.tile, 2);
+        std::memcpy(bytes + 26, &flags, 2);
+        std::memcpy(bytes + 28, &entry.payloadSize, 4);
+        // A refused entry only makes that frame unfindable; later ones stay in order
+        if (!m_file.Append(bytes, sizeof(bytes))) {
+            m_dropped++;
+            return false;
+        }
+        m_entries++;
+        return true;
+    }
+
+    bool Close() { return m_file.Close(); }
+
+    bool IsOpen() const { return m_file.IsOpen(); }
+    uint64_t Entries() const { return m_entries; }
+    uint64_t DroppedEntries() const { return m_dropped; }
+    AsyncFileWriterStats WriteStats() const { return m_file.Stats(); }
+
+private:
+    AsyncFileWriter m_file;
+    uint32_t m_tiles = 0;
+    uint64_t m_entries = 0;
+    uint64_t m_dropped = 0;
+};
+
+// Looks frames up in a .sidx without loading it: every search is a binary search over the
+// entries on disk. Entries are in capture order, so frame numbers and timestamps only grow;
+// the tiles of one frame sit next to each other.
+class RecordingIndexReader {
+public:
+    ~RecordingIndexReader() { Close(); }
+
+    bool Open(const std::string& path) {
+        using namespace RecordingIndexDetail;
+        Close();
+        m_file = std::fopen(path.c_str(), "rb");
+        if (!m_file) return false;
+        uint8_t header[kHeaderBytes];
+        uint32_t version = 0, tiles = 0;
+        if (std::fread(header, 1, sizeof(header), m_file) != sizeof(header) || std::memcmp(header, kMagic, 4) != 0) {
+            Close();
+            return false;
+        }
+        std::memcpy(&version, header + 4, 4);
+        std::memcpy(&tiles, header + 8, 4);
+        std::memcpy(&m_ticksPerSecond, header + 16, 8);
+        std::memcpy(&m_epochTicks, header + 24, 8);
+        std::memcpy(&m_epochUnixMs, header + 32, 8);
+        if (version != kVersion || tiles == 0 || tiles > 0xFFFF || m_ticksPerSecond <= 0) {
+            Close();
+            return false;
+        }
+        std::vector<uint8_t> table(tiles * kTileBytes);
+        if (std::fread(table.data(), 1, table.size(), m_file) != table.size()) {
+            Close();
+            return false;
+        }
+        for (uint32_t t = 0; t < tiles; ++t) {
+            const uint8_t* tile = table.data() + t * kTileBytes;
+            RecordingIndexTile info;
+            std::memcpy(&info.width, tile, 4);
+            std::memcpy(&info.height, tile + 4, 4);
+            const char* name = reinterpret_cast<const char*>(tile + 8);
+            info.source.assign(name, strnlen(name, kSourceChars));
+            m_tiles.push_back(info);
+        }
+        m_entriesOffset = kHeaderBytes + table.size();
+        size_t slash = path.find_last_of("/\\");
+        m_directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+        return Refresh();
+    }
+
+    void Close() {
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+        m_tiles.clear();
+        m_count = 0;
+    }
+
+    // Picks up entries appended since Open (the session is still recording); a torn last
+    // entry is left out
+    bool Refresh() {
+        using namespace ScreenRecordingDetail;
+        if (!m_file || !SeekFile(m_file, 0, SEEK_END)) return false;
+        uint64_t size = TellFile(m_file);
+        m_count = size > m_entriesOffset ? (size - m_entriesOffset) / RecordingIndexDetail::kEntryBytes : 0;
+        return true;
+    }
+
+    size_t TileCount() const { return m_tiles.size(); }
+    const RecordingIndexTile& Tile(size_t tile) const { return m_tiles[tile]; }
+    uint64_t EntryCount() const { return m_count; }
+    int64_t TicksPerSecond() const { return m_ticksPerSecond; }
+
+    // Where the tile's frames are, with the index's directory in front
+    std::string SourcePath(size_t tile) const { return m_directory + m_tiles[tile].source; }
+
+    // The PNG that holds an image-file entry
+    std::string ImagePath(const RecordingIndexEntry& entry) const {
+        std::string path = SourcePath(entry.tile);
+        const std::string placeholder = "{frame}";
+        size_t at = path.find(placeholder);
+        if (at != std::string::npos) path.replace(at, placeholder.size(), std::to_string(entry.frameIndex));
+        return path;
+    }
+
+    // Frame-clock ticks of a wall-clock time, and back
+    int64_t TicksAt(int64_t unixMs) const {
+        return m_epochTicks + static_cast<int64_t>(static_cast<double>(unixMs - m_epochUnixMs) * m_ticksPerSecond / 1000.0);
+    }
+    int64_t UnixMsAt(int64_t ticks) const {
+        return m_epochUnixMs + static_cast<int64_t>(static_cast<double>(ticks - m_epochTicks) * 1000.0 / m_ticksPerSecond);
+    }
+
+    bool Entry(uint64_t position, RecordingIndexEntry& entry) {
+        using namespace RecordingIndexDetail;
+        uint8_t bytes[kEntryBytes];
+        if (position >= m_count || !ScreenRecordingDetail::SeekFile(m_file, m_entriesOffset + position * kEntryBytes) ||
+            std::fread(bytes, 1, sizeof(bytes), m_file) != sizeof(bytes)) {
+            return false;
+        }
+        uint16_t flags;
+        std::memcpy(&entry.frameIndex, bytes, 8);
+        std::memcpy(&entry.timestamp, bytes + 8, 8);
+        std::memcpy(&entry.offset, bytes + 16, 8);
+        std::memcpy(&entry.tile, bytes + 24, 2);
+        std::memcpy(&flags, bytes + 26, 2);
+        std::memcpy(&entry.payloadSize, bytes + 28, 4);
+        entry.keyframe = (flags & kFlagKeyframe) != 0;
+        entry.imageFile = (flags & kFlagImageFile) != 0;
+        return true;
+    }
+
+    // The tile's entry for frame number 'frameIndex'; false if it has none
+    bool FindFrame(uint16_t tile, uint64_t frameIndex, RecordingIndexEntry& entry, uint64_t* position = nullptr) {
+        uint64_t at = LowerBound([frameIndex](const RecordingIndexEntry& e) { return e.frameIndex < frameIndex; });
+        for (; at < m_count && Entry(at, entry) && entry.frameIndex == frameIndex; ++at) {
+            if (entry.tile != tile) continue;
+            if (position) *position = at;
+            return true;
+        }
+        return false;
+    }
+
+    // The tile's last frame captured at or before 'timestamp' (frame-clock ticks)
+    bool FindTime(uint16_t tile, int64_t timestamp, RecordingIndexEntry& entry, uint64_t* position = nullptr) {
+        uint64_t at = LowerBound([timestamp](const RecordingIndexEntry& e) { return e.timestamp <= timestamp; });
+        return FindBackward(tile, at, false, entry, position);
+    }
+
+    // The tile's last frame captured at or before a wall-clock time
+    bool FindWallClock(uint16_t tile, int64_t unixMs, RecordingIndexEntry& entry, uint64_t* position = nullptr) {
+        return FindTime(tile, TicksAt(unixMs), entry, position);
+    }
+
+    // The keyframe the tile's entry at 'position' decodes from (itself, if it is one)
+    bool FindKeyframe(uint16_t tile, uint64_t position, RecordingIndexEntry& entry, uint64_t* keyPosition = nullptr) {
+        return FindBackward(tile, position + 1, true, entry, keyPosition);
+    }
+
+private:
+    // First position whose entry fails 'before'
+    template <typename Before>
+    uint64_t LowerBound(Before before) {
+        uint64_t low = 0, high = m_count;
+        RecordingIndexEntry entry;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if (!Entry(middle, entry)) return m_count;
+            if (before(entry)) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+
+    // Last entry of 'tile' before position 'end', optionally a keyframe; entries are read a
+    // block at a time since the tile's may be spread among the others'
+    bool FindBackward(uint16_t tile, uint64_t end, bool keyframe, RecordingIndexEntry& entry, uint64_t* position) {
+        const uint64_t block = 256;
+        end = std::min(end, m_count);
+        while (end > 0) {
+            uint64_t begin = end > block ? end - block : 0;
+            for (uint64_t at = end; at-- > begin;) {
+                if (!Entry(at, entry)) return false;
+                if (entry.tile != tile || (keyframe && !entry.keyframe)) continue;
+                if (position) *position = at;
+                return true;
+            }
+            end = begin;
+        }
+        return false;
+    }
+
+    std::FILE* m_file = nullptr;
+    std::vector<RecordingIndexTile> m_tiles;
+    std::string m_directory;
+    uint64_t m_entriesOffset = 0;
+    uint64_t m_count = 0;
+    int64_t m_ticksPerSecond = 1;
+    int64_t m_epochTicks = 0;
+    int64_t m_epochUnixMs = 0;
+};
+
+// Decodes any indexed frame of a session: the index gives the keyframe's record, one seek
+// lands there, and the tile's records are read in order up to the target. The per-tile
+// .srec indexes are never loaded. The last keyframe decoded per tile is kept, so seeking
+// around within one keyframe group only replays deltas.
+class IndexedRecordingReader {
+public:
+    ~IndexedRecordingReader() { Close(); }
+
+    bool Open(const std::string& indexPath) {
+        Close();
+        if (!m_index.Open(indexPath)) return false;
+        m_tiles.resize(m_index.TileCount());
+        return true;
+    }
+
+    void Close() {
+        for (TileFile& tile : m_tiles) {
+            if (tile.file) std::fclose(tile.file);
+        }
+        m_tiles.clear();
+        m_index.Close();
+    }
+
+    RecordingIndexReader& Index() { return m_index; }
+
+    // Decodes the entry at index 'position' into tightly packed BGRA. Image-file entries are
+    // not decoded here; their file is Index().ImagePath(entry).
+    bool ReadFrame(uint64_t position, std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        using namespace ScreenRecordingDetail;
+        RecordingIndexEntry target, key;
+        if (!m_index.Entry(position, target) || target.imageFile) return false;
+        TileFile* tile = OpenTile(target.tile);
+        if (!tile || !m_index.FindKeyframe(target.tile, position, key)) return false;
+        // Keep decoding from the last frame if the target follows it within the same group
+        bool resume = tile->decoder.HasReference() && key.offset < tile->nextOffset && tile->nextOffset <= target.offset;
+        uint64_t from = resume ? tile->nextOffset : key.offset;
+        if (!resume && tile->keyframe.HasReference() && tile->keyframeOffset == key.offset) {
+            tile->decoder.CopyReference(tile->keyframe);
+            from = tile->keyframeNext;
+        }
+        else if (!resume) {
+            tile->decoder.Reset();
+        }
+        const RecordingIndexTile& size = m_index.Tile(target.tile);
+        pixels.resize(static_cast<size_t>(size.width) * size.height * 4);
+        if (!SeekFile(tile->file, from)) return false;
+        for (uint64_t offset = from; offset <= target.offset;) {
+            uint8_t record[kRecordBytes];
+            uint32_t payloadSize;
+            if (std::fread(record, 1, sizeof(record), tile->file) != sizeof(record)) return Fail(*tile);
+            std::memcpy(&payloadSize, record + 16, 4);
+            tile->payload.resize(payloadSize);
+            if (payloadSize == 0 || std::fread(tile->payload.data(), 1, payloadSize, tile->file) != payloadSize) return Fail(*tile);
+            bool last = offset == target.offset;
+            if (!tile->decoder.Decode(tile->payload.data(), payloadSize, size.width, size.height, last ? pixels.data() : nullptr,
+                                      static_cast<size_t>(size.width) * 4)) {
+                return Fail(*tile);
+            }
+            if (offset == key.offset && !resume) {
+                tile->keyframe.CopyReference(tile->decoder);
+                tile->keyframeOffset = key.offset;
+                tile->keyframeNext = offset + kRecordBytes + payloadSize;
+            }
+            offset += kRecordBytes + payloadSize;
+            tile->nextOffset = offset;
+        }
+        if (from > target.offset) tile->decoder.CopyOut(pixels.data(), static_cast<size_t>(size.width) * 4);    // The kept keyframe itself
+        info.frameIndex = target.frameIndex;
+        info.timestamp = target.timestamp;
+        return true;
+    }
+
+    // Finds and decodes in one go
+    bool ReadFrameNumber(uint16_t tile, uint64_t frameIndex, std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        RecordingIndexEntry entry;
+        uint64_t position;
+        return m_index.FindFrame(tile, frameIndex, entry, &position) && ReadFrame(position, pixels, info);
+    }
+
+    bool ReadFrameAt(uint16_t tile, int64_t timestamp, std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        RecordingIndexEntry entry;
+        uint64_t position;
+        return m_index.FindTime(tile, timestamp, entry, &position) && ReadFrame(position, pixels, info);
+    }
+
+private:
+    struct TileFile {
+        std::FILE* file = nullptr;
+        ScreenDeltaDecoder decoder;
+        uint64_t nextOffset = 0;        // Record after the one the decoder holds
+        ScreenDeltaDecoder keyframe;    // Last keyframe decoded, and where it and the record after it start
+        uint64_t keyframeOffset = 0;
+        uint64_t keyframeNext = 0;
+        std::vector<uint8_t> payload;
+    };
+
+    TileFile* OpenTile(uint16_t tile) {
+        if (tile >= m_tiles.size()) return nullptr;
+        TileFile& t = m_tiles[tile];
+        const std::string path = m_index.SourcePath(tile);
+        if (path.size() < 5 || path.compare(path.size() - 5, 5, ".srec") != 0) return nullptr;     // Not a recording this can decode
+        if (!t.file) t.file = std::fopen(path.c_str(), "rb");
+        return t.file ? &t : nullptr;
+    }
+
+    bool Fail(TileFile& tile) {
+        tile.decoder.Reset();
+        tile.keyframe.Reset();
+        tile.nextOffset = 0;
+        return false;
+    }
+
+    RecordingIndexReader m_index;
+    std::vector<TileFile> m_tiles;
+};
@@ -0,0 +1,271 @@
+// Checks and times RecordingIndex. Two tiles are recorded to .srec files with a session
+// index beside them, plus a tile saved as PNG files; frames looked up by number, by
+// timestamp and by wall-clock time must decode to exactly what was captured, in any order.
+// A torn last entry is left out. Then a 10-hour, two-tile session index (60 fps) is written
+// and random lookups are timed, as is the decode of the worst-placed frame at 2560x1440.
+// Passes if every frame is exact and the slowest lookup in the 10-hour index is under 5 ms.
+// Usage: RecordingIndexBenchmark [lookups]
+#include "RecordingIndex.h"
+#include "SyntheticFrameSource.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+const double kFps = 60.0;
+const int64_t kTicksPerSecond = 10000000;      // QueryPerformanceFrequency's usual 10 MHz
+const int64_t kTicksPerFrame = static_cast<int64_t>(kTicksPerSecond / kFps);
+const int64_t kEpochUnixMs = 1760000000000;     // Tick 0 on the wall clock
+
+struct TileFeed {
+    SyntheticFrameSource source;
+    std::vector<uint8_t> pixels;
+
+    TileFeed(uint32_t width, uint32_t height, SyntheticPattern pattern) : source(width, height, pattern), pixels(source.FrameBytes()) {}
+
+    ImageView Render(uint64_t index) {
+        source.RenderFrame(pixels.data(), index);
+        return ImageView(pixels.data(), source.Width(), source.Height(), source.RowPitch());
+    }
+};
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Records 'frames' frames of two tiles and indexes them (tile 2 as PNG entries only)
+bool RecordSession(std::vector<TileFeed>& feeds, uint64_t frames, uint32_t keyframeInterval) {
+    const char* names[] = { "left_check.srec", "right_check.srec" };
+    std::vector<RecordingIndexTile> tiles;
+    std::vector<std::unique_ptr<ScreenRecordingWriter>> recordings;
+    for (size_t t = 0; t < 2; ++t) {
+        RecordingIndexTile tile;
+        tile.width = feeds[t].source.Width();
+        tile.height = feeds[t].source.Height();
+        tile.source = names[t];
+        tiles.push_back(tile);
+        recordings.emplace_back(new ScreenRecordingWriter());
+        if (!recordings[t]->Open(names[t], tile.width, tile.height, keyframeInterval)) return false;
+    }
+    RecordingIndexTile images;
+    images.width = feeds[0].source.Width();
+    images.height = feeds[0].source.Height();
+    images.source = "tile2_frame_{frame}.png";
+    tiles.push_back(images);
+
+    RecordingIndexWriter index;
+    if (!index.Open("session_check.sidx", tiles, kTicksPerSecond, 0, kEpochUnixMs)) return false;
+    for (uint64_t i = 0; i < frames; ++i) {
+        ScreenStreamFrameInfo info;
+        info.frameIndex = i * 2 + 7;        // Frame numbers need not be dense
+        info.timestamp = static_cast<int64_t>(i) * kTicksPerFrame + 12345;
+        for (uint16_t t = 0; t < 2; ++t) {
+            if (!recordings[t]->WriteFrame(feeds[t].Render(i), info) || !index.AddRecorded(t, recordings[t]->LastFrame())) return false;
+        }
+        if (!index.AddImage(2, info)) return false;
+    }
+    for (auto& recording : recordings) recording->Close();
+    return index.Close() && index.Entries() == frames * 3;
+}
+
+bool Expect(bool condition, const std::string& what) {
+    if (!condition) std::cerr << what << std::endl;
+    return condition;
+}
+
+bool VerifySession() {
+    const uint32_t w = 480, h = 270;
+    const uint64_t frames = 1200;
+    std::vector<TileFeed> feeds;
+    feeds.emplace_back(w, h, SyntheticPattern::Typing);
+    feeds.emplace_back(w, h, SyntheticPattern::ScrollingText);
+    if (!Expect(RecordSession(feeds, frames, 60), "recording the session failed")) return false;
+
+    IndexedRecordingReader reader;
+    if (!Expect(reader.Open("session_check.sidx") && reader.Index().EntryCount() == frames * 3, "index does not open whole")) return false;
+    std::vector<uint8_t> pixels;
+    ScreenStreamFrameInfo info;
+    auto exact = [&](uint16_t tile, uint64_t i) {
+        return info.frameIndex == i * 2 + 7 && std::equal(pixels.begin(), pixels.end(), feeds[tile].Render(i).data);
+    };
+
+    // Random order by frame number, then a forward run that keeps decoding where it was
+    std::mt19937 rng(5);
+    for (int n = 0; n < 300; ++n) {
+        uint16_t tile = static_cast<uint16_t>(rng() % 2);
+        uint64_t i = rng() % frames;
+        if (!Expect(reader.ReadFrameNumber(tile, i * 2 + 7, pixels, info) && exact(tile, i),
+                    "tile " + std::to_string(tile) + " frame " + std::to_string(i) + " does not decode exactly")) {
+            return false;
+        }
+    }
+    for (uint64_t i = 500; i < 700; ++i) {
+        if (!Expect(reader.ReadFrameNumber(1, i * 2 + 7, pixels, info) && exact(1, i), "sequential read of frame " + std::to_string(i) + " is wrong")) {
+            return false;
+        }
+    }
+    if (!Expect(!reader.ReadFrameNumber(0, 8, pixels, info), "a frame number that was never captured was found")) return false;
+
+    // By capture time: between two frames means the earlier one; by wall-clock time likewise
+    RecordingIndexReader& index = reader.Index();
+    for (int n = 0; n < 200; ++n) {
+        uint16_t tile = static_cast<uint16_t>(rng() % 2);
+        uint64_t i = rng() % frames;
+        int64_t t = static_cast<int64_t>(i) * kTicksPerFrame + 12345 + static_cast<int64_t>(rng() % kTicksPerFrame);
+        if (!Expect(reader.ReadFrameAt(tile, t, pixels, info) && exact(tile, i), "lookup by time " + std::to_string(t) + " is wrong")) return false;
+        RecordingIndexEntry entry;
+        int64_t unixMs = index.UnixMsAt(static_cast<int64_t>(i) * kTicksPerFrame + 12345) + 1;
+        if (!Expect(index.FindWallClock(tile, unixMs, entry) && entry.frameIndex == i * 2 + 7 && entry.tile == tile,
+                    "lookup by wall clock " + std::to_string(unixMs) + " is wrong")) {
+            return false;
+        }
+    }
+    RecordingIndexEntry entry;
+    uint64_t position;
+    if (!Expect(!index.FindTime(0, 12344, entry), "a time before the session found a frame")) return false;
+
+    // Image-file entries resolve to their PNG and are not decoded as records
+    if (!Expect(index.FindFrame(2, 107, entry, &position) && entry.imageFile && index.ImagePath(entry) == "tile2_frame_107.png" &&
+                !reader.ReadFrame(position, pixels, info), "PNG entries do not resolve to their file")) {
+        return false;
+    }
+    reader.Close();
+
+    // A crash mid-entry: the torn entry is left out, the rest still searches
+    {
+        std::ifstream in("session_check.sidx", std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        bytes.resize(bytes.size() - 40);
+        std::ofstream out("session_check.sidx", std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    if (!Expect(reader.Open("session_check.sidx") && reader.Index().EntryCount() == frames * 3 - 2 &&
+                reader.ReadFrameNumber(1, (frames - 2) * 2 + 7, pixels, info) && exact(1, frames - 2) &&
+                !reader.ReadFrameNumber(1, (frames - 1) * 2 + 7, pixels, info),
+                "a torn index does not read up to its last whole entry")) {
+        return false;
+    }
+    reader.Close();
+    std::remove("session_check.sidx");
+    std::remove("left_check.srec");
+    std::remove("right_check.srec");
+    std::cout << "Session of " << frames << " frames x 3 tiles: lookups by number, time and wall clock decode exactly, torn tail skipped" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int lookups = argc > 1 ? std::stoi(argv[1]) : 2000;
+    if (!VerifySession()) {
+        std::cout << "FAIL: recording index is wrong" << std::endl;
+        return 1;
+    }
+
+    // A 10-hour, two-tile session at 60 fps, keyframe every 120
+    const uint64_t frames = 10ull * 3600 * 60;
+    const std::string path = "session_10h.sidx";
+    std::vector<RecordingIndexTile> tiles(2);
+    tiles[0].source = "left_0.srec";
+    tiles[1].source = "right_0.srec";
+    auto start = std::chrono::steady_clock::now();
+    {
+        RecordingIndexWriter writer;
+        if (!writer.Open(path, tiles, kTicksPerSecond, 0, kEpochUnixMs)) return 1;
+        uint64_t offsets[2] = { 32, 32 };
+        for (uint64_t i = 0; i < frames; ++i) {
+            for (uint16_t t = 0; t < 2; ++t) {
+                RecordingIndexEntry entry;
+                entry.frameIndex = i;
+                entry.timestamp = static_cast<int64_t>(i) * kTicksPerFrame;
+                entry.offset = offsets[t];
+                entry.tile = t;
+                entry.keyframe = i % 120 == 0;
+                entry.payloadSize = entry.keyframe ? 400000 : 9000;
+                offsets[t] += 20 + entry.payloadSize;
+                writer.Add(entry);
+            }
+        }
+        writer.Close();
+    }
+    double writeMs = MsSince(start);
+
+    RecordingIndexReader index;
+    start = std::chrono::steady_clock::now();
+    if (!index.Open(path) || index.EntryCount() != frames * 2) return 1;
+    double openMs = MsSince(start);
+    std::mt19937_64 rng(11);
+    double slowest = 0.0, total = 0.0;
+    bool found = true;
+    for (int n = 0; n < lookups; ++n) {
+        uint16_t tile = static_cast<uint16_t>(rng() % 2);
+        uint64_t i = rng() % frames;
+        RecordingIndexEntry entry, key;
+        uint64_t position;
+        auto t0 = std::chrono::steady_clock::now();
+        int64_t unixMs = index.UnixMsAt(static_cast<int64_t>(i) * kTicksPerFrame) + 1;
+        bool ok = n % 2 ? index.FindFrame(tile, i, entry, &position) : index.FindWallClock(tile, unixMs, entry, &position);
+        ok = ok && index.FindKeyframe(tile, position, key);
+        double ms = MsSince(t0);
+        found = found && ok && entry.frameIndex == i && entry.tile == tile && key.frameIndex == i / 120 * 120 && key.tile == tile;
+        slowest = std::max(slowest, ms);
+        total += ms;
+    }
+    std::remove(path.c_str());
+    std::cout << std::fixed << std::setprecision(3) << "10-hour index: " << frames * 2 << " entries (" << frames * 2 * 32 / (1024 * 1024)
+              << " MB) written in " << writeMs / 1000.0 << " s, opened in " << openMs << " ms" << std::endl;
+    std::cout << "  " << lookups << " lookups (frame number or wall clock, then its keyframe): mean " << total / lookups << " ms, slowest "
+              << slowest << " ms" << (found ? "" : ", WRONG RESULTS") << std::endl;
+
+    // Decoding the frame just before a keyframe from a fresh reader: its keyframe and the
+    // longest run of deltas after it, the worst case for a seek
+    const uint32_t w = 2560, h = 1440;
+    TileFeed feed(w, h, SyntheticPattern::Typing);
+    {
+        ScreenRecordingWriter recording;
+        RecordingIndexWriter writer;
+        std::vector<RecordingIndexTile> one(1);
+        one[0].width = w;
+        one[0].height = h;
+        one[0].source = "seek_bench.srec";
+        if (!recording.Open("seek_bench.srec", w, h, 120) || !writer.Open("seek_bench.sidx", one, kTicksPerSecond, 0, kEpochUnixMs)) return 1;
+        for (uint64_t i = 0; i < 240; ++i) {
+            ScreenStreamFrameInfo info;
+            info.frameIndex = i;
+            info.timestamp = static_cast<int64_t>(i) * kTicksPerFrame;
+            recording.WriteFrame(feed.Render(i), info);
+            writer.AddRecorded(0, recording.LastFrame());
+        }
+    }
+    IndexedRecordingReader reader;
+    std::vector<uint8_t> pixels;
+    ScreenStreamFrameInfo info;
+    double keyMs = 1e9, worstMs = 1e9, nextMs = 1e9;
+    for (int round = 0; round < 3; ++round) {
+        reader.Open("seek_bench.sidx");
+        start = std::chrono::steady_clock::now();
+        bool ok = reader.ReadFrameNumber(0, 239, pixels, info);
+        worstMs = std::min(worstMs, MsSince(start));
+        found = found && ok && std::equal(pixels.begin(), pixels.end(), feed.Render(239).data);
+        start = std::chrono::steady_clock::now();
+        ok = reader.ReadFrameNumber(0, 120, pixels, info);
+        keyMs = std::min(keyMs, MsSince(start));
+        found = found && ok && std::equal(pixels.begin(), pixels.end(), feed.Render(120).data);
+        reader.ReadFrameNumber(0, 200, pixels, info);
+        start = std::chrono::steady_clock::now();
+        reader.ReadFrameNumber(0, 201, pixels, info);
+        nextMs = std::min(nextMs, MsSince(start));
+        reader.Close();
+    }
+    std::remove("seek_bench.srec");
+    std::remove("seek_bench.sidx");
+    std::cout << "  " << w << "x" << h << " decode: back to the kept keyframe " << keyMs << " ms, next frame " << nextMs << " ms, seek to 119 frames past a keyframe "
+              << worstMs << " ms" << std::endl;
+
+    bool pass = found && slowest < 5.0 && worstMs < 50.0;
+    std::cout << (pass ? "PASS" : "FAIL") << ": frames exact, slowest lookup in a 10-hour index " << slowest << " ms (under 5 ms needed), slowest seek "
+              << worstMs << " ms (under 50 ms needed)" << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,515 @@
+#pragma once
+// Offline player: reads recorded frames back and drives them through the split -> scale ->
+// output path of live capture, so layout and encoder changes can be tried on real captures
+// without a desktop or a GPU. Inputs are PNG sequences ("left_frame_{frame}.png"), .srec
+// recordings, ScreenCodec streams, .sring rings, Y4M files, or a session index (.sidx),
+// which stands for every tile it lists. Several inputs (the halves of one capture) are put
+// back side by side into the desktop they were cut from; that desktop is then split by a
+// TileLayout again, each tile drawn to the output size by SoftwareCompositor as
+// RenderTextures would draw it, and handed to a sink that writes files.
+// Frames play as fast as they decode, or paced by their capture timestamps. Inputs are lined
+// up by frame number: an input that starts later or is missing a frame (a tile whose write
+// was dropped) holds its last frame while the others move on.
+#include "CircularRecording.h"
+#include "PngReader.h"
+#include "RawVideoSink.h"
+#include "RecordingIndex.h"
+#include "ScreenRecording.h"
+#include "SoftwareCompositor.h"
+#include "ThreadPool.h"
+#include "TileLayout.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// One recorded input; frames come out as tightly packed BGRA
+class PlayerSource {
+public:
+    virtual ~PlayerSource() {}
+    virtual const char* FormatName() const = 0;
+    virtual uint32_t Width() const = 0;
+    virtual uint32_t Height() const = 0;
+    virtual bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) = 0;
+};
+
+// Numbered PNG files matching a pattern with "{frame}", in frame order. PNGs carry no
+// capture time, so frame n of the sequence is stamped n * ticksPerFrame.
+class PngSequenceSource : public PlayerSource {
+public:
+    bool Open(const std::string& pattern, int64_t ticksPerFrame) {
+        namespace fs = std::filesystem;
+        const std::string placeholder = "{frame}";
+        size_t at = pattern.find(placeholder);
+        if (at == std::string::npos) return false;
+        fs::path full(pattern);
+        fs::path directory = full.has_parent_path() ? full.parent_path() : fs::path(".");
+        std::string name = full.filename().string();
+        size_t nameAt = name.find(placeholder);
+        if (nameAt == std::string::npos) return false;
+        std::string prefix = name.substr(0, nameAt);
+        std::string suffix = name.substr(nameAt + placeholder.size());
+        std::error_code error;
+        for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+            std::string file = it->path().filename().string();
+            if (file.size() <= prefix.size() + suffix.size() || file.compare(0, prefix.size(), prefix) != 0 ||
+                file.compare(file.size() - suffix.size(), suffix.size(), suffix) != 0) {
+                continue;
+            }
+            std::string digits = file.substr(prefix.size(), file.size() - prefix.size() - suffix.size());
+            if (digits.find_first_not_of("0123456789") != std::string::npos) continue;
+            m_files.emplace_back(std::stoull(digits), it->path().string());
+        }
+        std::sort(m_files.begin(), m_files.end());
+        m_ticksPerFrame = ticksPerFrame;
+        m_next = 0;
+        // The first file gives the size every other one must have
+        std::vector<uint8_t> pixels;
+        return !m_files.empty() && ReadPngFile(m_files[0].second, pixels, m_width, m_height);
+    }
+
+    const char* FormatName() const override { return "png"; }
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+    size_t FrameCount() const { return m_files.size(); }
+
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) override {
+        uint32_t width, height;
+        if (m_next >= m_files.size() || !ReadPngFile(m_files[m_next].second, pixels, width, height) || width != m_width || height != m_height) {
+            return false;
+        }
+        info.frameIndex = m_files[m_next].first;
+        info.timestamp = static_cast<int64_t>(m_next) * m_ticksPerFrame;
+        m_next++;
+        return true;
+    }
+
+private:
+    std::vector<std::pair<uint64_t, std::string>> m_files;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    int64_t m_ticksPerFrame = 0;
+    size_t m_next = 0;
+};
+
+class RecordingSource : public PlayerSource {
+public:
+    bool Open(const std::string& path) { return m_reader.Open(path); }
+    const char* FormatName() const override { return "srec"; }
+    uint32_t Width() const override { return m_reader.Width(); }
+    uint32_t Height() const override { return m_reader.Height(); }
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) override { return m_reader.ReadFrame(pixels, info); }
+
+private:
+    ScreenRecordingReader m_reader;
+};
+
+class ScreenStreamSource : public PlayerSource {
+public:
+    bool Open(const std::string& path) { return m_reader.Open(path); }
+    const char* FormatName() const override { return "stream"; }
+    uint32_t Width() const override { return m_reader.Width(); }
+    uint32_t Height() const override { return m_reader.Height(); }
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) override { return m_reader.ReadFrame(pixels, info); }
+
+private:
+    ScreenStreamReader m_reader;
+};
+
+class RingSource : public PlayerSource {
+public:
+    bool Open(const std::string& path) { return m_reader.Open(path) && m_reader.FrameCount() > 0; }
+    const char* FormatName() const override { return "sring"; }
+    uint32_t Width() const override { return m_reader.Width(); }
+    uint32_t Height() const override { return m_reader.Height(); }
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) override { return m_reader.ReadFrame(pixels, info); }
+
+private:
+    CircularRecordingReader m_reader;
+};
+
+// YUV4MPEG2 4:2:0 as RawVideoSink writes it; converted back with BT.709 coefficients
+// (the sink's default), in the range its XCOLORRANGE names. Frames are stamped from F.
+class Y4mSource : public PlayerSource {
+public:
+    ~Y4mSource() {
+        if (m_file) std::fclose(m_file);
+    }
+
+    bool Open(const std::string& path, int64_t ticksPerSecond) {
+        m_file = std::fopen(path.c_str(), "rb");
+        if (!m_file) return false;
+        std::string header;
+        if (!ReadLine(header) || header.compare(0, 10, "YUV4MPEG2 ") != 0) return false;
+        uint32_t num = 60, den = 1;
+        size_t at = 9;
+        while (at < header.size()) {
+            size_t end = header.find(' ', at + 1);
+            std::string token = header.substr(at + 1, end == std::string::npos ? std::string::npos : end - at - 1);
+            if (!token.empty() && token[0] == 'W') m_width = static_cast<uint32_t>(std::stoul(token.substr(1)));
+            else if (!token.empty() && token[0] == 'H') m_height = static_cast<uint32_t>(std::stoul(token.substr(1)));
+            else if (!token.empty() && token[0] == 'F' && std::sscanf(token.c_str() + 1, "%u:%u", &num, &den) != 2) return false;
+            else if (!token.empty() && token[0] == 'C' && token.compare(0, 4, "C420") != 0) return false;
+            else if (token == "XCOLORRANGE=FULL") m_fullRange = true;
+            at = end == std::string::npos ? header.size() : end;
+        }
+        if (m_width == 0 || m_height == 0 || num == 0 || den == 0) return false;
+        m_ticksPerFrame = static_cast<double>(ticksPerSecond) * den / num;
+        m_planes.resize(YuvFrameBytes(m_width, m_height));
+        return true;
+    }
+
+    const char* FormatName() const override { return "y4m"; }
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) override {
+        std::string line;
+        if (!ReadLine(line) || line.compare(0, 5, "FRAME") != 0 || std::fread(m_planes.data(), 1, m_planes.size(), m_file) != m_planes.size()) {
+            return false;
+        }
+        const uint32_t cw = YuvChromaWidth(m_width);
+        const uint8_t* yPlane = m_planes.data();
+        const uint8_t* uPlane = yPlane + static_cast<size_t>(m_width) * m_height;
+        const uint8_t* vPlane = uPlane + static_cast<size_t>(cw) * YuvChromaHeight(m_height);
+        // BT.709 inverse; limited range scales luma by 255/219 and chroma by 255/224
+        const double ys = m_fullRange ? 1.0 : 255.0 / 219.0, cs = m_fullRange ? 1.0 : 255.0 / 224.0, y0 = m_fullRange ? 0.0 : 16.0;
+        pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+        for (uint32_t y = 0; y < m_height; ++y) {
+            uint8_t* out = pixels.data() + static_cast<size_t>(y) * m_width * 4;
+            for (uint32_t x = 0; x < m_width; ++x) {
+                double l = (yPlane[static_cast<size_t>(y) * m_width + x] - y0) * ys;
+                double u = (uPlane[static_cast<size_t>(y / 2) * cw + x / 2] - 128.0) * cs;
+                double v = (vPlane[static_cast<size_t>(y / 2) * cw + x / 2] - 128.0) * cs;
+                out[x * 4] = Clamp(l + 1.8556 * u);
+                out[x * 4 + 1] = Clamp(l - 0.1873 * u - 0.4681 * v);
+                out[x * 4 + 2] = Clamp(l + 1.5748 * v);
+                out[x * 4 + 3] = 255;
+            }
+        }
+        info.frameIndex = m_next;
+        info.timestamp = static_cast<int64_t>(std::llround(m_next * m_ticksPerFrame));
+        m_next++;
+        return true;
+    }
+
+private:
+    static uint8_t Clamp(double value) { return static_cast<uint8_t>(std::min(255.0, std::max(0.0, std::round(value)))); }
+
+    bool ReadLine(std::string& line) {
+        line.clear();
+        int c;
+        while ((c = std::fgetc(m_file)) != EOF && c != '\n') line.push_back(static_cast<char>(c));
+        return c == '\n';
+    }
+
+    std::FILE* m_file = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    bool m_fullRange = false;
+    double m_ticksPerFrame = 0.0;
+    uint64_t m_next = 0;
+    std::vector<uint8_t> m_planes;
+};
+
+// Opens 'path' by its contents (a PNG pattern by its "{frame}") and appends the source, or
+// one per tile for a session index. ticksPerSecond is the clock recorded timestamps count
+// in; PNG and Y4M frames are stamped on it.
+inline bool OpenPlayerSources(const std::string& path, int64_t ticksPerSecond, double pngFps, std::vector<std::unique_ptr<PlayerSource>>& sources) {
+    if (path.find("{frame}") != std::string::npos) {
+        std::unique_ptr<PngSequenceSource> source(new PngSequenceSource());
+        if (!source->Open(path, static_cast<int64_t>(std::llround(ticksPerSecond / pngFps)))) return false;
+        sources.push_back(std::move(source));
+        return true;
+    }
+    char magic[9] = {};
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    size_t got = std::fread(magic, 1, sizeof(magic), file);
+    std::fclose(file);
+    if (got < 4) return false;
+    if (std::memcmp(magic, RecordingIndexDetail::kMagic, 4) == 0) {
+        RecordingIndexReader index;
+        if (!index.Open(path)) return false;
+        for (size_t t = 0; t < index.TileCount(); ++t) {
+            if (!OpenPlayerSources(index.SourcePath(t), ticksPerSecond, pngFps, sources)) return false;
+        }
+        return true;
+    }
+    std::unique_ptr<PlayerSource> source;
+    if (std::memcmp(magic, ScreenRecordingDetail::kMagic, 4) == 0) {
+        std::unique_ptr<RecordingSource> recording(new RecordingSource());
+        if (recording->Open(path)) source = std::move(recording);
+    }
+    else if (std::memcmp(magic, kScreenStreamMagic, 4) == 0) {
+        std::unique_ptr<ScreenStreamSource> stream(new ScreenStreamSource());
+        if (stream->Open(path)) source = std::move(stream);
+    }
+    else if (std::memcmp(magic, CircularRecordingDetail::kMagic, 4) == 0) {
+        std::unique_ptr<RingSource> ring(new RingSource());
+        if (ring->Open(path)) source = std::move(ring);
+    }
+    else if (got == 9 && std::memcmp(magic, "YUV4MPEG2", 9) == 0) {
+        std::unique_ptr<Y4mSource> y4m(new Y4mSource());
+        if (y4m->Open(path, ticksPerSecond)) source = std::move(y4m);
+    }
+    if (!source) return false;
+    sources.push_back(std::move(source));
+    return true;
+}
+
+// Receives every output tile of every frame
+class PlayerSink {
+public:
+    virtual ~PlayerSink() {}
+    virtual bool Open(const TileLayout& layout, uint32_t width, uint32_t height) = 0;
+    virtual bool WriteTile(size_t tile, const ImageView& image, const ScreenStreamFrameInfo& info) = 0;
+    virtual bool Close() = 0;
+};
+
+enum class PlayerOutputFormat {
+    None,       // Decode and render only, for timing
+    Png,        // <prefix><tile>_frame_<N>.png
+    Srec,       // <prefix><tile>.srec
+    Y4m,        // <prefix><tile>.y4m
+    Bgra        // <prefix><tile>.bgra
+};
+
+// Output names follow the recorder's: left/right for two columns, tileN otherwise
+inline std::string PlayerTileName(const TileLayout& layout, size_t tile) {
+    if (layout.TileCount() == 2 && layout.config.columns == 2) return tile == 0 ? "left" : "right";
+    return "tile" + std::to_string(tile);
+}
+
+class PlayerFileSink : public PlayerSink {
+public:
+    PlayerFileSink(PlayerOutputFormat format, const std::string& prefix, ThreadPool* pool = nullptr, double fps = 60.0)
+        : m_format(format), m_prefix(prefix), m_pool(pool), m_fps(fps) {}
+
+    bool Open(const TileLayout& layout, uint32_t width, uint32_t height) override {
+        Close();
+        for (size_t t = 0; t < layout.TileCount(); ++t) {
+            std::string name = m_prefix + PlayerTileName(layout, t);
+            m_names.push_back(name);
+            if (m_format == PlayerOutputFormat::Srec) {
+                m_recordings.emplace_back(new ScreenRecordingWriter());
+                if (!m_recordings.back()->Open(name + ".srec", width, height)) return false;
+            }
+            else if (m_format == PlayerOutputFormat::Y4m || m_format == PlayerOutputFormat::Bgra) {
+                RawVideoSinkOptions options;
+                options.format = m_format == PlayerOutputFormat::Y4m ? RawVideoFormat::Y4m : RawVideoFormat::Bgra;
+                options.fps = m_fps;
+                m_raw.emplace_back(new RawVideoSink());
+                if (!m_raw.back()->Open(name + (m_format == PlayerOutputFormat::Y4m ? ".y4m" : ".bgra"), width, height, options)) return false;
+            }
+        }
+        return true;
+    }
+
+    bool WriteTile(size_t tile, const ImageView& image, const ScreenStreamFrameInfo& info) override {
+        switch (m_format) {
+        case PlayerOutputFormat::Png: {
+            std::vector<uint8_t> png;
+            bool encoded = m_pool ? EncodePngParallel(image.data, image.width, image.height, image.rowPitch, png, *m_pool)
+                                  : EncodePng(image.data, image.width, image.height, image.rowPitch, png);
+            std::string path = m_names[tile] + "_frame_" + std::to_string(info.frameIndex) + ".png";
+            return encoded && m_pngFiles.Write(path, std::move(png));
+        }
+        case PlayerOutputFormat::Srec: return m_recordings[tile]->WriteFrame(image, info);
+        case PlayerOutputFormat::Y4m:
+        case PlayerOutputFormat::Bgra: return m_raw[tile]->WriteFrame(image, m_pool);
+        default: return true;
+        }
+    }
+
+    bool Close() override {
+        bool ok = true;
+        for (auto& recording : m_recordings) ok = recording->Close() && ok;
+        for (auto& raw : m_raw) raw->Close();
+        m_pngFiles.Drain();
+        ok = ok && m_pngFiles.Failed() == 0 && m_pngFiles.Rejected() == 0;
+        m_recordings.clear();
+        m_raw.clear();
+        m_names.clear();
+        return ok;
+    }
+
+private:
+    PlayerOutputFormat m_format;
+    std::string m_prefix;
+    ThreadPool* m_pool;
+    double m_fps;
+    std::vector<std::string> m_names;
+    std::vector<std::unique_ptr<ScreenRecordingWriter>> m_recordings;
+    std::vector<std::unique_ptr<RawVideoSink>> m_raw;
+    BackgroundFileQueue m_pngFiles;
+};
+
+struct PlayerOptions {
+    TileLayoutConfig layout;            // How the replayed desktop is split
+    uint32_t inputColumns = 0;          // Grid the inputs are put back into; 0 = all side by side
+    uint32_t outputWidth = 0;           // Each tile is sampled to this size; 0 = the tile's own
+    uint32_t outputHeight = 0;
+    bool realtime = false;              // Pace frames by their timestamps
+    double speed = 1.0;                 // Of realtime playback
+    int64_t ticksPerSecond = 10000000;  // Of recorded timestamps (QueryPerformanceFrequency, usually 10 MHz)
+    uint64_t maxFrames = 0;             // 0 = until an input ends
+};
+
+struct PlayerStats {
+    uint64_t frames = 0;
+    double seconds = 0.0;               // Wall time
+    double contentSeconds = 0.0;        // Between the first and last timestamps
+    double readMs = 0.0;                // Decoding inputs and putting the desktop together
+    double renderMs = 0.0;              // Splitting and sampling
+    double writeMs = 0.0;               // Sink
+    uint64_t lateFrames = 0;            // Realtime frames shown more than a frame late
+    double maxLateMs = 0.0;
+    uint64_t heldTiles = 0;             // Inputs that had no frame for a shown frame and repeated their last
+    uint64_t skippedFrames = 0;         // Input frames from before every input had started
+
+    double FramesPerSecond() const { return seconds > 0 ? frames / seconds : 0.0; }
+    double RealtimeFactor() const { return seconds > 0 ? contentSeconds / seconds : 0.0; }
+};
+
+class RecordingPlayer {
+public:
+    // Plays until an input ends; false if the inputs do not fit together or a sink fails
+    bool Play(std::vector<std::unique_ptr<PlayerSource>>& sources, PlayerSink& sink, const PlayerOptions& options, ThreadPool* pool,
+              PlayerStats& stats) {
+        using Clock = std::chrono::steady_clock;
+        stats = PlayerStats();
+        if (sources.empty()) return false;
+        const uint32_t w = sources[0]->Width(), h = sources[0]->Height();
+        for (auto& source : sources) {
+            if (source->Width() != w || source->Height() != h) return false;
+        }
+        const uint32_t columns = options.inputColumns ? options.inputColumns : static_cast<uint32_t>(sources.size());
+        const uint32_t rows = static_cast<uint32_t>((sources.size() + columns - 1) / columns);
+        const uint32_t desktopWidth = w * columns, desktopHeight = h * rows;
+        TileLayout layout;
+        if (!BuildTileLayout(desktopWidth, desktopHeight, options.layout, layout)) return false;
+        const uint32_t outW = options.outputWidth ? options.outputWidth : layout.tileWidth;
+        const uint32_t outH = options.outputHeight ? options.outputHeight : layout.tileHeight;
+        const bool sample = outW != layout.tileWidth || outH != layout.tileHeight;
+        if (!sink.Open(layout, outW, outH)) return false;
+
+        // decoded[s] is the frame input s shows; next[s] the one read ahead of it
+        std::vector<std::vector<uint8_t>> decoded(sources.size()), next(sources.size());
+        std::vector<ScreenStreamFrameInfo> nextInfo(sources.size());
+        std::vector<bool> ready(sources.size(), false), shown(sources.size(), false), fresh(sources.size(), false);
+        std::vector<uint8_t> desktop(sources.size() == 1 ? 0 : static_cast<size_t>(desktopWidth) * desktopHeight * 4);
+        SoftwareCompositor compositor(pool);
+        std::vector<std::vector<uint8_t>> sampled(sample ? layout.TileCount() : 0, std::vector<uint8_t>(static_cast<size_t>(outW) * outH * 4));
+        std::vector<ImageView> tiles;
+        int64_t firstTimestamp = 0, lastTimestamp = 0;
+        const double frameMs = 1000.0 / 60.0;
+        bool ok = true;
+        Clock::time_point start = Clock::now();
+        while (ok && (options.maxFrames == 0 || stats.frames < options.maxFrames)) {
+            Clock::time_point t0 = Clock::now();
+            ScreenStreamFrameInfo info;
+            if (!NextFrame(sources, decoded, next, nextInfo, ready, shown, fresh, info, stats)) break;
+            ImageView frame;
+            if (sources.size() == 1) {
+                frame = ImageView(decoded[0].data(), w, h, static_cast<size_t>(w) * 4);
+            }
+            else {
+                frame = ImageView(desktop.data(), desktopWidth, desktopHeight, static_cast<size_t>(desktopWidth) * 4);
+                for (size_t s = 0; s < sources.size(); ++s) {
+                    if (!fresh[s]) continue;    // Held: its part of the desktop is already there
+                    uint32_t left = static_cast<uint32_t>(s % columns) * w, top = static_cast<uint32_t>(s / columns) * h;
+                    for (uint32_t y = 0; y < h; ++y) {
+                        std::memcpy(desktop.data() + (static_cast<size_t>(top + y) * desktopWidth + left) * 4,
+                                    decoded[s].data() + static_cast<size_t>(y) * w * 4, static_cast<size_t>(w) * 4);
+                    }
+                }
+            }
+            if (stats.frames == 0) firstTimestamp = info.timestamp;
+            lastTimestamp = info.timestamp;
+            Clock::time_point t1 = Clock::now();
+
+            BuildTileViews(frame, layout, tiles);
+            if (sample) {
+                for (size_t t = 0; t < tiles.size(); ++t) {
+                    compositor.DrawFullScreenQuad(tiles[t], sampled[t].data(), outW, outH, static_cast<size_t>(outW) * 4);
+                    tiles[t] = ImageView(sampled[t].data(), outW, outH, static_cast<size_t>(outW) * 4);
+                }
+            }
+            Clock::time_point t2 = Clock::now();
+
+            if (options.realtime) {
+                double due = static_cast<double>(info.timestamp - firstTimestamp) / options.ticksPerSecond / options.speed;
+                Clock::time_point target = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(due));
+                std::this_thread::sleep_until(target);
+                double lateMs = std::chrono::duration<double, std::milli>(Clock::now() - target).count();
+                if (lateMs > frameMs) stats.lateFrames++;
+                stats.maxLateMs = std::max(stats.maxLateMs, lateMs);
+            }
+            Clock::time_point t3 = Clock::now();
+            for (size_t t = 0; t < tiles.size() && ok; ++t) ok = sink.WriteTile(t, tiles[t], info);
+            Clock::time_point t4 = Clock::now();
+
+            stats.frames++;
+            stats.readMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            stats.renderMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+            stats.writeMs += std::chrono::duration<double, std::milli>(t4 - t3).count();
+        }
+        ok = sink.Close() && ok;
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        stats.contentSeconds = static_cast<double>(lastTimestamp - firstTimestamp) / options.ticksPerSecond;
+        return ok;
+    }
+
+private:
+    // Moves every input to the next frame number any of them has. Inputs behind the first
+    // frame all of them reach are read past; an input ahead of the chosen frame keeps
+    // showing its last one. 'fresh' marks the inputs whose frame changed. False once an
+    // input ends.
+    static bool NextFrame(std::vector<std::unique_ptr<PlayerSource>>& sources, std::vector<std::vector<uint8_t>>& decoded,
+                          std::vector<std::vector<uint8_t>>& next, std::vector<ScreenStreamFrameInfo>& nextInfo, std::vector<bool>& ready,
+                          std::vector<bool>& shown, std::vector<bool>& fresh, ScreenStreamFrameInfo& info, PlayerStats& stats) {
+        for (;;) {
+            for (size_t s = 0; s < sources.size(); ++s) {
+                if (!ready[s] && !sources[s]->ReadFrame(next[s], nextInfo[s])) return false;
+                ready[s] = true;
+            }
+            uint64_t target = UINT64_MAX;
+            for (size_t s = 0; s < sources.size(); ++s) target = std::min(target, nextInfo[s].frameIndex);
+            // An input with nothing to show yet cannot hold: drop what the others have before it
+            bool waiting = false;
+            for (size_t s = 0; s < sources.size(); ++s) waiting = waiting || (!shown[s] && nextInfo[s].frameIndex > target);
+            if (waiting) {
+                for (size_t s = 0; s < sources.size(); ++s) {
+                    if (nextInfo[s].frameIndex == target) {
+                        ready[s] = false;
+                        stats.skippedFrames++;
+                    }
+                }
+                continue;
+            }
+            bool first = true;
+            for (size_t s = 0; s < sources.size(); ++s) {
+                fresh[s] = nextInfo[s].frameIndex == target;
+                if (!fresh[s]) {
+                    stats.heldTiles++;
+                    continue;
+                }
+                decoded[s].swap(next[s]);
+                if (first) info = nextInfo[s];
+                first = false;
+                ready[s] = false;
+                shown[s] = true;
+            }
+            return true;
+        }
+    }
+};
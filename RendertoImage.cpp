@@ -6,9 +6,12 @@
 #include <fstream>
 #include <d3dcompiler.h>
 #pragma comment(lib, "d3dcompiler.lib")
-#define _CRT_SECURE_NO_WARNINGS
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"  // Include stb image write for saving as PNG
+#include "FrameArena.h"
+#include "FramePacer.h"
+#include "PixelKernels.h"
+#include "PngWriter.h"
+#include "TileLayout.h"
+#include "ViewCache.h"
 #include <vector>  // For std::vector
 
 
@@ -35,8 +38,22 @@ Microsoft::WRL::ComPtr<ID3D11SamplerState> g_sampler;
 
 
 
-D3D11_BOX leftBox = { 0, 0, 0, 2560, 1440, 1 };  // Adjust resolution as needed
-D3D11_BOX rightBox = { 2560, 0, 0, 5120, 1440, 1 };
+// Views of the left and right textures, kept until a texture is replaced
+D3D11ShaderResourceViewBackend g_srvBackend;
+D3D11ShaderResourceViewCache g_srvCache(g_srvBackend);
+
+// Split layout - left and right halves by default, sized from the captured desktop
+TileLayoutConfig g_tileConfig;
+TileLayoutCache g_tileLayout;
+
+// Output pacing - wait for the next tick instead of spinning on AcquireNextFrame
+QpcPacerClock g_pacerClock;
+FramePacer g_pacer({ 60.0, PacingPolicy::DuplicateLast }, g_pacerClock);
+
+// Back buffer captures - the staging texture and CPU buffer are kept between captures
+FrameArena g_frameArena;
+ComPtr<ID3D11Texture2D> g_captureStagingTexture;
+ThreadPool g_pngPool;                  // Row strips of the PNG are deflated in parallel
 
 //Define vertex data for full screen quad
 struct Vertex {
@@ -143,61 +160,77 @@ void CaptureBackbufferAndSave() {
         return;
     }
 
-    // Create a staging texture to copy the backbuffer content into
+    // Staging texture to copy the backbuffer content into, recreated only when the back buffer changes
     D3D11_TEXTURE2D_DESC desc;
     backBuffer->GetDesc(&desc);
     desc.Usage = D3D11_USAGE_STAGING;
     desc.BindFlags = 0;
     desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;  // Allow CPU access to the texture data
 
-    // Ensure we set the format to one that supports CPU access
-    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;  // Common format for staging textures
-    // You can add a check here if desc.Width or desc.Height is too large
-
-    // Create the staging texture
-    ComPtr<ID3D11Texture2D> stagingTexture;
-    hr = g_device->CreateTexture2D(&desc, nullptr, &stagingTexture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create staging texture! HRESULT: 0x" << std::hex << hr << std::dec << std::endl;
+    // CopyResource needs the staging texture in the back buffer's own format; the
+    // conversion below turns BGRA into the RGBA the PNG writer is given
+    PixelConvertOptions convert;
+    convert.flipVertical = true;
+    if (desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM || desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB) {
+        convert.swapRedBlue = true;
+    }
+    else if (desc.Format != DXGI_FORMAT_R8G8B8A8_UNORM && desc.Format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB) {
+        std::cerr << "Unsupported back buffer format for PNG capture: " << desc.Format << std::endl;
         return;
     }
 
+    D3D11_TEXTURE2D_DESC stagingDesc = {};
+    if (g_captureStagingTexture) {
+        g_captureStagingTexture->GetDesc(&stagingDesc);
+    }
+    if (!g_captureStagingTexture || stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height || stagingDesc.Format != desc.Format) {
+        g_captureStagingTexture.Reset();
+        hr = g_device->CreateTexture2D(&desc, nullptr, &g_captureStagingTexture);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create staging texture! HRESULT: 0x" << std::hex << hr << std::dec << std::endl;
+            return;
+        }
+        g_frameArena.SetFrameBytes(static_cast<size_t>(desc.Width) * desc.Height * 4);
+    }
+    ID3D11Texture2D* stagingTexture = g_captureStagingTexture.Get();
+
     // Copy the backbuffer into the staging texture
-    g_context->CopyResource(stagingTexture.Get(), backBuffer.Get());
+    g_context->CopyResource(stagingTexture, backBuffer.Get());
 
     // Map the staging texture to read the data
     D3D11_MAPPED_SUBRESOURCE mappedData;
-    hr = g_context->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mappedData);
+    hr = g_context->Map(stagingTexture, 0, D3D11_MAP_READ, 0, &mappedData);
     if (FAILED(hr)) {
         std::cerr << "Failed to map staging texture! HRESULT: 0x" << std::hex << hr << std::dec << std::endl;
         return;
     }
 
-    // Access the pixel data in mappedData.pData
-    // Each pixel is 4 bytes (RGBA)
-    unsigned char* pixels = reinterpret_cast<unsigned char*>(mappedData.pData);
-
     // Save the image as PNG
     int width = desc.Width;
     int height = desc.Height;
-    int pitch = mappedData.RowPitch;
 
-    // Create a temporary buffer for the image data (flipping row order if necessary)
-    std::vector<unsigned char> imageData(width * height * 4);
-    for (int y = 0; y < height; ++y) {
-        memcpy(&imageData[y * width * 4], &pixels[(height - y - 1) * pitch], width * 4);
+    // Flip row order and swizzle to RGBA in one SIMD pass into a recycled arena buffer
+    FrameBuffer imageData = g_frameArena.Acquire();
+    if (!imageData) {
+        std::cerr << "Failed to get a frame buffer for the capture!" << std::endl;
+        g_context->Unmap(stagingTexture, 0);
+        return;
     }
+    ImageView pixels(static_cast<const uint8_t*>(mappedData.pData), desc.Width, desc.Height, mappedData.RowPitch);
+    ConvertPixels(pixels, imageData.Data(), static_cast<size_t>(width) * 4, convert);
 
-    // Use stb_image_write to save the image as a PNG
-    if (stbi_write_png("captured_image.png", width, height, 4, imageData.data(), width * 4) == 0) {
+    // The converted copy is all the encoder needs
+    g_context->Unmap(stagingTexture, 0);
+
+    // Deflate row strips on every core and stitch them into one PNG
+    PngWriteOptions png;
+    png.order = PngPixelOrder::Rgba;
+    if (!WritePngFileParallel("captured_image.png", imageData.Data(), width, height, static_cast<size_t>(width) * 4, g_pngPool, png)) {
         std::cerr << "Failed to save image as PNG!" << std::endl;
     }
     else {
         std::cout << "Image saved as 'captured_image.png'" << std::endl;
     }
-
-    // Unmap the staging texture
-    g_context->Unmap(stagingTexture.Get(), 0);
 }
 
 
@@ -292,10 +325,20 @@ void CreateRenderTargetViews() {
 
 
 void CreateSRVs() {
-    // Create Shader Resource Views (SRVs) for the textures
-    g_device->CreateShaderResourceView(g_leftTexture.Get(), nullptr, &g_leftSRV);
-    g_device->CreateShaderResourceView(g_rightTexture.Get(), nullptr, &g_rightSRV);
-    std::cout << "Left and right SRVs created from g_left and right textures!" << std::endl;
+    // Shader Resource Views (SRVs) for the textures come from the cache: made on the first
+    // frame and again only after CaptureFrame replaces a texture
+    g_srvBackend.device = g_device.Get();
+    uint64_t created = g_srvCache.Stats().created;
+    D3D11ShaderResourceViewBackend::View* left = g_srvCache.Get(g_leftTexture.Get());
+    D3D11ShaderResourceViewBackend::View* right = g_srvCache.Get(g_rightTexture.Get());
+    g_leftSRV = left ? *left : nullptr;
+    g_rightSRV = right ? *right : nullptr;
+    if (!left || !right) {
+        std::cerr << "Failed to create SRVs for the left and right textures." << std::endl;
+    }
+    else if (g_srvCache.Stats().created != created) {
+        std::cout << "Left and right SRVs created from g_left and right textures!" << std::endl;
+    }
 }
 
 bool CreateSwapChain(HWND hwnd) {
@@ -556,7 +599,7 @@ bool CaptureFrame() {
     ComPtr<IDXGIResource> desktopResource;
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
 
-    HRESULT hr = g_duplication->AcquireNextFrame(500, &frameInfo, &desktopResource);
+    HRESULT hr = g_duplication->AcquireNextFrame(g_pacer.AcquireTimeoutMs(), &frameInfo, &desktopResource);
     if (FAILED(hr)) {
         if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
             return true; // No new frame
@@ -580,46 +623,44 @@ bool CaptureFrame() {
     D3D11_TEXTURE2D_DESC desc;
     capturedTexture->GetDesc(&desc);
 
-    // Ensure the texture dimensions are even to properly split
-    if (desc.Width % 2 != 0) {
-        desc.Width++;  // Adjust to even width
+    // The left and right swap chains show tiles 0 and 1, so the layout must produce exactly two
+    const TileLayout* layout = g_tileLayout.Get(desc.Width, desc.Height, g_tileConfig);
+    if (!layout || layout->TileCount() != 2) {
+        std::cerr << "Tile layout does not split a " << desc.Width << "x" << desc.Height << " desktop into left and right textures." << std::endl;
+        g_duplication->ReleaseFrame();
+        return false;
     }
 
-    // Create the left and right textures only once (or resize them as needed)
-    if (!g_leftTexture) {
-        // Create the left texture (half the width of the captured frame)
-        desc.Width /= 2;  // Set width to half
-        hr = g_device->CreateTexture2D(&desc, nullptr, &g_leftTexture);
-        if (FAILED(hr)) {
-            std::cerr << "Failed to create left texture. HRESULT: " << std::hex << hr << std::endl;
-            g_duplication->ReleaseFrame();
-            return false;
+    // Create the left and right textures once, and again only if the desktop size changes
+    D3D11_TEXTURE2D_DESC tileDesc = desc;
+    tileDesc.Width = layout->tileWidth;
+    tileDesc.Height = layout->tileHeight;
+    ComPtr<ID3D11Texture2D>* tileTextures[2] = { &g_leftTexture, &g_rightTexture };
+    for (const TileCopy& tile : layout->copies) {
+        ComPtr<ID3D11Texture2D>& texture = *tileTextures[tile.output];
+        if (texture) {
+            D3D11_TEXTURE2D_DESC existing;
+            texture->GetDesc(&existing);
+            if (existing.Width != tileDesc.Width || existing.Height != tileDesc.Height) {
+                g_srvCache.Invalidate(texture.Get());
+                texture.Reset();
+            }
         }
-    }
-    std::cout << "LeftTexture Created successfully" << std::endl;
-
-    if (!g_rightTexture) {
-        // Create the right texture (half the width of the captured frame)
-        desc.Width *= 2;  // Restore full width
-        desc.Width /= 2;  // Set width back to half for right texture
-        hr = g_device->CreateTexture2D(&desc, nullptr, &g_rightTexture);
-        if (FAILED(hr)) {
-            std::cerr << "Failed to create right texture. HRESULT: " << std::hex << hr << std::endl;
-            g_duplication->ReleaseFrame();
-            return false;
+        if (!texture) {
+            hr = g_device->CreateTexture2D(&tileDesc, nullptr, &texture);
+            if (FAILED(hr)) {
+                std::cerr << "Failed to create " << (tile.output == 0 ? "left" : "right") << " texture. HRESULT: " << std::hex << hr << std::endl;
+                g_duplication->ReleaseFrame();
+                return false;
+            }
         }
+
+        // Copy this tile's region of the captured frame
+        D3D11_BOX box = TileSourceBox(tile);
+        g_context->CopySubresourceRegion(texture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &box);
     }
-    std::cout << "RightTexture Created successfully" << std::endl;
-    // Split the captured frame and copy data to left and right textures
-    D3D11_BOX leftBox = { 0, 0, 0, desc.Width, desc.Height, 1 };
-    D3D11_BOX rightBox = { desc.Width, 0, 0, 2 * desc.Width, desc.Height, 1 };
-
-    // Copy the left half to g_leftTexture
-    g_context->CopySubresourceRegion(g_leftTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &leftBox);
-    std::cout << "LeftTexture copied to g_leftTexture successfully" << std::endl;
-    // Copy the right half to g_rightTexture
-    g_context->CopySubresourceRegion(g_rightTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &rightBox);
-    std::cout << "RightTexture copied to g_rightTexture successfully" << std::endl;
+    std::cout << "Frame split into g_leftTexture and g_rightTexture successfully" << std::endl;
+    g_pacer.OnFrameArrived(QpcToNanoseconds(frameInfo.LastPresentTime.QuadPart), frameInfo.AccumulatedFrames);
     g_duplication->ReleaseFrame();
     return true;
 }
@@ -678,6 +719,15 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
             break;
         }
 
+        // Render only when the output tick is due; a duplicate re-presents the textures as they are
+        PacingDecision decision = g_pacer.Poll();
+        if (decision == PacingDecision::Wait || decision == PacingDecision::Skip) {
+            continue;
+        }
+        if (g_pacer.Stats().ticks % 600 == 0) {
+            WritePacingStats(std::cout, g_pacer.Stats());
+        }
+
         CreateSRVs();
         RenderTextures();
     }
@@ -0,0 +1,366 @@
+#pragma once
+// Instant replay: the last N seconds of one tile, delta-encoded and held in memory, written
+// out only when asked. Payloads live in one byte arena allocated at Open and reused as a
+// ring; the frame index is a fixed ring too, so memory never grows after Open. The oldest
+// frames are evicted a whole keyframe group at a time (by age, or early when the arena or
+// index is full), so the buffer always starts on a keyframe and any dump plays from its
+// first frame.
+// Dump() writes an .srec next to the destination and renames it into place, so a reader
+// never sees half a replay. It may run on another thread while frames keep arriving: the
+// frames being dumped are pinned rather than copied, and a frame that would need their
+// space is dropped (the encoder then restarts on a keyframe) instead of waiting.
+// ReplayTrigger turns SIGUSR1 (Ctrl+Break on Windows), a hotkey or an API call into a dump
+// request for the capture loop to pick up.
+#include "ScreenRecording.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#endif
+
+struct ReplayBufferOptions {
+    double seconds = 30.0;                      // Kept behind the newest frame, rounded out to a keyframe
+    size_t capacityBytes = 256 << 20;           // Encoded frames; allocated once at Open
+    size_t maxFrames = 30 * 240;                // Index entries; allocated once at Open
+    uint32_t keyframeInterval = 60;             // Eviction granularity
+    int64_t ticksPerSecond = 1000000000;        // Timestamp units (QPC frequency on Windows)
+    AsyncFileWriterOptions dumpIo;              // Dumps are written through this
+};
+
+struct ReplayBufferStats {
+    uint64_t frames = 0;            // Held now
+    uint64_t keyframes = 0;         // Held now
+    uint64_t bytes = 0;             // Payload bytes held now
+    uint64_t added = 0;
+    uint64_t evicted = 0;
+    uint64_t dropped = 0;           // Larger than the arena, or needed space a dump still held
+    uint64_t dumps = 0;
+    double seconds = 0.0;           // From the oldest held frame to the newest
+    size_t capacityBytes = 0;       // What Open allocated; never changes
+};
+
+class ReplayBuffer {
+public:
+    ReplayBuffer() = default;
+    ReplayBuffer(const ReplayBuffer&) = delete;
+    ReplayBuffer& operator=(const ReplayBuffer&) = delete;
+    ~ReplayBuffer() { WaitForDump(); }
+
+    bool Open(uint32_t width, uint32_t height, const ReplayBufferOptions& options = ReplayBufferOptions()) {
+        WaitForDump();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (options.capacityBytes == 0 || options.maxFrames == 0) return false;
+        m_width = width;
+        m_height = height;
+        m_options = options;
+        m_arena.assign(options.capacityBytes, 0);
+        m_entries.assign(options.maxFrames, Entry());
+        m_encoder.SetKeyframeInterval(options.keyframeInterval);
+        m_encoder.Reset();
+        m_firstSeq = m_count = 0;
+        m_writePos = 0;
+        m_bytes = 0;
+        m_keyframes = 0;
+        m_pinBegin = m_pinEnd = 0;
+        m_dumping = false;
+        m_chainBroken = true;
+        m_stats = ReplayBufferStats();
+        return true;
+    }
+
+    // Encodes one frame into the ring. Only the encode costs anything; nothing touches disk.
+    bool AddFrame(const ImageView& image, const ScreenStreamFrameInfo& info) {
+        if (image.width != m_width || image.height != m_height || m_arena.empty()) return false;
+        if (ChainBroken()) m_encoder.Reset();
+        m_scratch.clear();
+        m_encoder.Encode(image, m_scratch);
+        bool stored = AddEncodedFrame(m_scratch.data(), m_scratch.size(), info);
+        if (!stored) m_encoder.Reset();
+        return stored;
+    }
+
+    // Adds a payload from a ScreenDeltaEncoder run elsewhere. After a drop, deltas are
+    // refused until the next keyframe, since their reference is gone.
+    bool AddEncodedFrame(const uint8_t* payload, size_t size, const ScreenStreamFrameInfo& info) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (size == 0 || m_arena.empty()) return false;
+        bool keyframe = payload[0] == kScreenFrameKey;
+        if (m_chainBroken && !keyframe) return Drop();
+        // Space for the record, a whole group at a time; a delta's own group cannot go
+        size_t offset = 0;
+        while (!Place(size, offset) || m_count == m_entries.size()) {
+            if (m_count == 0 || !EvictGroup()) return Drop();
+            if (m_count == 0 && !keyframe) return Drop();
+        }
+        Entry& entry = m_entries[(m_firstSeq + m_count) % m_entries.size()];
+        entry.offset = offset;
+        entry.size = size;
+        entry.frameIndex = info.frameIndex;
+        entry.timestamp = info.timestamp;
+        entry.keyframe = keyframe;
+        std::memcpy(m_arena.data() + offset, payload, size);
+        m_writePos = offset + size;
+        m_count++;
+        m_bytes += size;
+        if (keyframe) m_keyframes++;
+        m_chainBroken = false;
+        m_stats.added++;
+        TrimToSeconds(info.timestamp);
+        return true;
+    }
+
+    // Writes what is held now to 'path' (.srec); false if nothing is held, a dump is already
+    // running or the file could not be written. Frames added meanwhile are not included.
+    bool Dump(const std::string& path) {
+        uint64_t begin, end;
+        return Pin(begin, end) && WritePinned(path, begin, end);
+    }
+
+    // Dump() on a background thread. The frames held now are pinned before this returns;
+    // false if nothing is held or a dump is still running.
+    bool DumpAsync(const std::string& path) {
+        uint64_t begin, end;
+        if (!Pin(begin, end)) return false;
+        if (m_dumpThread.joinable()) m_dumpThread.join();
+        m_dumpRunning = true;
+        m_dumpThread = std::thread([this, path, begin, end] {
+            m_lastDumpOk = WritePinned(path, begin, end);
+            m_dumpRunning = false;
+        });
+        return true;
+    }
+
+    // Waits for a DumpAsync() to finish; returns its result (true if there was none)
+    bool WaitForDump() {
+        if (m_dumpThread.joinable()) m_dumpThread.join();
+        return m_lastDumpOk;
+    }
+
+    bool DumpRunning() const { return m_dumpRunning; }
+
+    // The frames the last dump wrote, as they sit in its .srec (empty if it failed); for
+    // indexing the dump. Only once WaitForDump() has returned.
+    const std::vector<ScreenRecordingEntry>& LastDump() const { return m_lastDump; }
+
+    ReplayBufferStats Stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ReplayBufferStats stats = m_stats;
+        stats.frames = m_count;
+        stats.keyframes = m_keyframes;
+        stats.bytes = m_bytes;
+        stats.capacityBytes = m_arena.size();
+        if (m_count > 0) {
+            int64_t ticks = Back().timestamp - m_entries[m_firstSeq % m_entries.size()].timestamp;
+            stats.seconds = static_cast<double>(ticks) / m_options.ticksPerSecond;
+        }
+        return stats;
+    }
+
+    // Replaces 'to' with 'from' in one step
+    static bool ReplaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+private:
+    // Marks everything held as being dumped: eviction stops at the first frame not yet written
+    bool Pin(uint64_t& begin, uint64_t& end) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_dumping || m_count == 0) return false;
+        m_dumping = true;
+        begin = m_pinBegin = m_firstSeq;
+        end = m_pinEnd = m_firstSeq + m_count;
+        return true;
+    }
+
+    bool WritePinned(const std::string& path, uint64_t begin, uint64_t end) {
+        const std::string partial = path + ".partial";
+        m_lastDump.clear();
+        ScreenRecordingWriter writer;
+        bool ok = writer.Open(partial, m_width, m_height, m_options.keyframeInterval, m_options.dumpIo);
+        for (uint64_t seq = begin; ok && seq < end; ++seq) {
+            Entry entry;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                entry = m_entries[seq % m_entries.size()];
+            }
+            // Pinned: eviction stops at m_pinBegin, so these bytes stay put while we read them
+            ScreenStreamFrameInfo info;
+            info.frameIndex = entry.frameIndex;
+            info.timestamp = entry.timestamp;
+            ok = writer.WriteEncodedFrame(m_arena.data() + entry.offset, entry.size, info);
+            if (ok) m_lastDump.push_back(writer.LastFrame());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pinBegin = seq + 1;
+        }
+        ok = writer.Close() && ok;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pinBegin = m_pinEnd = 0;
+            m_dumping = false;
+            if (ok) m_stats.dumps++;
+        }
+        if (ok) ok = ReplaceFile(partial, path);
+        if (!ok) {
+            std::remove(partial.c_str());
+            m_lastDump.clear();
+        }
+        return ok;
+    }
+
+    struct Entry {
+        size_t offset = 0;
+        size_t size = 0;
+        uint64_t frameIndex = 0;
+        int64_t timestamp = 0;
+        bool keyframe = false;
+    };
+
+    bool ChainBroken() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_chainBroken;
+    }
+
+    const Entry& Front() const { return m_entries[m_firstSeq % m_entries.size()]; }
+    const Entry& Back() const { return m_entries[(m_firstSeq + m_count - 1) % m_entries.size()]; }
+
+    bool Drop() {
+        m_chainBroken = true;
+        m_stats.dropped++;
+        return false;
+    }
+
+    // Finds room for 'size' bytes after the newest record, wrapping to the arena start;
+    // live records run from the oldest's offset round to m_writePos
+    bool Place(size_t size, size_t& offset) const {
+        const size_t capacity = m_arena.size();
+        if (size > capacity) return false;
+        if (m_count == 0) {
+            offset = 0;
+            return true;
+        }
+        size_t oldest = Front().offset;
+        if (m_writePos > oldest) {
+            if (capacity - m_writePos >= size) {
+                offset = m_writePos;
+                return true;
+            }
+            if (oldest >= size) {
+                offset = 0;
+                return true;
+            }
+            return false;
+        }
+        if (oldest - m_writePos >= size) {
+            offset = m_writePos;
+            return true;
+        }
+        return false;
+    }
+
+    // Drops the oldest keyframe group; false if a dump has it pinned
+    bool EvictGroup() {
+        if (m_count == 0) return false;
+        size_t n = 1;
+        while (n < m_count && !m_entries[(m_firstSeq + n) % m_entries.size()].keyframe) n++;
+        if (m_dumping && m_firstSeq + n > m_pinBegin) return false;
+        for (size_t i = 0; i < n; ++i) {
+            const Entry& entry = Front();
+            m_bytes -= entry.size;
+            if (entry.keyframe) m_keyframes--;
+            m_firstSeq++;
+            m_count--;
+            m_stats.evicted++;
+        }
+        if (m_count == 0) m_writePos = 0;
+        return true;
+    }
+
+    // Evicts groups that lie wholly before the window: the next group must still start at
+    // or before newest - seconds, so at least 'seconds' stay held
+    void TrimToSeconds(int64_t newest) {
+        const int64_t window = static_cast<int64_t>(m_options.seconds * m_options.ticksPerSecond);
+        while (m_count > 1) {
+            size_t n = 1;
+            while (n < m_count && !m_entries[(m_firstSeq + n) % m_entries.size()].keyframe) n++;
+            if (n == m_count) return;      // Only one group
+            if (m_entries[(m_firstSeq + n) % m_entries.size()].timestamp > newest - window) return;
+            if (!EvictGroup()) return;
+        }
+    }
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    ReplayBufferOptions m_options;
+    std::vector<uint8_t> m_arena;
+    std::vector<Entry> m_entries;           // Ring; entry for sequence s is at s % size
+    uint64_t m_firstSeq = 0;
+    size_t m_count = 0;
+    size_t m_writePos = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_keyframes = 0;
+    uint64_t m_pinBegin = 0;                // Sequences [m_pinBegin, m_pinEnd) are being dumped
+    uint64_t m_pinEnd = 0;
+    bool m_dumping = false;
+    bool m_chainBroken = true;              // The next frame stored must be a keyframe
+    ReplayBufferStats m_stats;
+    mutable std::mutex m_mutex;
+    ScreenDeltaEncoder m_encoder;           // Used by AddFrame on the caller's thread
+    std::vector<uint8_t> m_scratch;
+    std::thread m_dumpThread;
+    std::atomic<bool> m_dumpRunning{ false };
+    bool m_lastDumpOk = true;
+    std::vector<ScreenRecordingEntry> m_lastDump;     // Written by the dump thread
+};
+
+// Dump requests from outside the capture loop. Request() is the API; Install() routes
+// SIGUSR1 (Ctrl+Break in a Windows console) to it. The capture loop calls Consume() once a
+// frame, along with a hotkey check of its own.
+class ReplayTrigger {
+public:
+    static void Request() { Flag() = true; }
+    static bool Consume() { return Flag().exchange(false); }
+
+    static bool Install() {
+        Flag();     // Constructed here, not first inside a handler
+#ifdef _WIN32
+        return SetConsoleCtrlHandler(&ReplayTrigger::ConsoleHandler, TRUE) != 0;
+#else
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = &ReplayTrigger::SignalHandler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        return sigaction(SIGUSR1, &action, nullptr) == 0;
+#endif
+    }
+
+private:
+    // Lock-free, so setting it from a signal handler is safe
+    static std::atomic<bool>& Flag() {
+        static std::atomic<bool> flag{ false };
+        return flag;
+    }
+
+#ifdef _WIN32
+    static BOOL WINAPI ConsoleHandler(DWORD type) {
+        if (type != CTRL_BREAK_EVENT) return FALSE;
+        Request();
+        return TRUE;
+    }
+#else
+    static void SignalHandler(int) { Request(); }
+#endif
+};
@@ -0,0 +1,505 @@
+#pragma once
+// Lossless intra-frame codec for BGRA desktop frames, QOI-style with two extra ops for
+// screen content: long runs of the previous pixel and runs copied from the row above
+// (window interiors, unchanged lines between text). Runs are found with word compares
+// instead of per-pixel decisions, so flat desktop regions encode at memory speed.
+// Frames are appended to one stream file per output; see ScreenStreamWriter/Reader.
+//
+// Ops (one tag byte, as in QOI, plus payload):
+//   00iiiiii            INDEX  pixel from the 64-entry hash table
+//   01rrggbb            DIFF   each of r, g, b changed by -2..1 from the previous pixel
+//   10gggggg rrrrbbbb   LUMA   g changed by -32..31, r and b by g + -8..7
+//   11llllll            RUN    previous pixel repeated 1..60 times
+//   0xFC varint         UP     next n pixels equal the row above
+//   0xFD varint         LONG   previous pixel repeated n times
+//   0xFE r g b          RGB    new color, alpha unchanged
+//   0xFF r g b a        RGBA
+// Runs never cross a row end. Run and UP pixels do not enter the hash table.
+#include "ImageView.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ScreenCodecDetail {
+
+const uint8_t kOpIndex = 0x00;
+const uint8_t kOpDiff = 0x40;
+const uint8_t kOpLuma = 0x80;
+const uint8_t kOpRun = 0xC0;
+const uint8_t kOpUp = 0xFC;
+const uint8_t kOpLongRun = 0xFD;
+const uint8_t kOpRgb = 0xFE;
+const uint8_t kOpRgba = 0xFF;
+const uint32_t kMaxShortRun = 60;
+const uint32_t kMinUpRun = 2;      // Shorter matches with the row above cost more than plain ops
+
+// Pixels are little-endian BGRA, so a uint32 reads 0xAARRGGBB
+inline uint32_t Hash(uint32_t px) {
+    uint32_t r = (px >> 16) & 0xFF, g = (px >> 8) & 0xFF, b = px & 0xFF, a = px >> 24;
+    return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+inline uint8_t* PutVarint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+inline bool GetVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint32_t Load(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// Pixels from x while row[x] == value, two at a time
+inline uint32_t MatchRun(const uint8_t* row, uint32_t x, uint32_t width, uint32_t value) {
+    uint32_t start = x;
+    uint64_t pair = (static_cast<uint64_t>(value) << 32) | value;
+    for (; x + 2 <= width; x += 2) {
+        uint64_t v;
+        std::memcpy(&v, row + static_cast<size_t>(x) * 4, 8);
+        if (v != pair) break;
+    }
+    while (x < width && Load(row + static_cast<size_t>(x) * 4) == value) x++;
+    return x - start;
+}
+
+// Pixels from x while row[x] == above[x], eight bytes at a time
+inline uint32_t MatchUp(const uint8_t* row, const uint8_t* above, uint32_t x, uint32_t width) {
+    uint32_t start = x;
+    for (; x + 2 <= width; x += 2) {
+        uint64_t a, b;
+        std::memcpy(&a, row + static_cast<size_t>(x) * 4, 8);
+        std::memcpy(&b, above + static_cast<size_t>(x) * 4, 8);
+        if (a != b) break;
+    }
+    while (x < width && Load(row + static_cast<size_t>(x) * 4) == Load(above + static_cast<size_t>(x) * 4)) x++;
+    return x - start;
+}
+
+inline uint8_t* PutRun(uint8_t* out, uint8_t longOp, uint32_t run) {
+    if (longOp == kOpLongRun && run <= kMaxShortRun) {
+        *out++ = static_cast<uint8_t>(kOpRun | (run - 1));
+        return out;
+    }
+    *out++ = longOp;
+    return PutVarint(out, run);
+}
+
+}  // namespace ScreenCodecDetail
+
+// Worst case is one RGBA op per pixel plus a varint per row
+inline size_t ScreenCodecMaxEncodedSize(uint32_t width, uint32_t height) {
+    return static_cast<size_t>(width) * height * 5 + static_cast<size_t>(height) * 6;
+}
+
+// Appends the encoded frame to 'out'; returns the number of bytes added
+inline size_t EncodeScreenFrame(const ImageView& image, std::vector<uint8_t>& out) {
+    using namespace ScreenCodecDetail;
+    size_t base = out.size();
+    out.resize(base + ScreenCodecMaxEncodedSize(image.width, image.height));
+    uint8_t* o = out.data() + base;
+
+    uint32_t index[64] = {};
+    uint32_t prev = 0xFF000000u;
+    for (uint32_t y = 0; y < image.height; ++y) {
+        const uint8_t* row = image.Row(y);
+        const uint8_t* above = y > 0 ? image.Row(y - 1) : nullptr;
+        uint32_t x = 0;
+        while (x < image.width) {
+            uint32_t px = Load(row + static_cast<size_t>(x) * 4);
+            if (px == prev) {
+                uint32_t run = MatchRun(row, x, image.width, prev);
+                o = PutRun(o, kOpLongRun, run);
+                x += run;
+                continue;
+            }
+            if (above && px == Load(above + static_cast<size_t>(x) * 4)) {
+                uint32_t run = MatchUp(row, above, x, image.width);
+                if (run >= kMinUpRun) {
+                    o = PutRun(o, kOpUp, run);
+                    x += run;
+                    prev = Load(row + static_cast<size_t>(x - 1) * 4);
+                    continue;
+                }
+            }
+
+            uint32_t hash = Hash(px);
+            if (index[hash] == px) {
+                *o++ = static_cast<uint8_t>(kOpIndex | hash);
+            }
+            else {
+                index[hash] = px;
+                if ((px >> 24) == (prev >> 24)) {
+                    int dr = static_cast<int>((px >> 16) & 0xFF) - static_cast<int>((prev >> 16) & 0xFF);
+                    int dg = static_cast<int>((px >> 8) & 0xFF) - static_cast<int>((prev >> 8) & 0xFF);
+                    int db = static_cast<int>(px & 0xFF) - static_cast<int>(prev & 0xFF);
+                    // Wrap to -128..127 like QOI, so differences are modulo 256
+                    dr = static_cast<int8_t>(dr);
+                    dg = static_cast<int8_t>(dg);
+                    db = static_cast<int8_t>(db);
+                    int drg = dr - dg, dbg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        *o++ = static_cast<uint8_t>(kOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                    }
+                    else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        *o++ = static_cast<uint8_t>(kOpLuma | (dg + 32));
+                        *o++ = static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8));
+                    }
+                    else {
+                        *o++ = kOpRgb;
+                        *o++ = static_cast<uint8_t>(px >> 16);
+                        *o++ = static_cast<uint8_t>(px >> 8);
+                        *o++ = static_cast<uint8_t>(px);
+                    }
+                }
+                else {
+                    *o++ = kOpRgba;
+                    *o++ = static_cast<uint8_t>(px >> 16);
+                    *o++ = static_cast<uint8_t>(px >> 8);
+                    *o++ = static_cast<uint8_t>(px);
+                    *o++ = static_cast<uint8_t>(px >> 24);
+                }
+            }
+            prev = px;
+            x++;
+        }
+    }
+
+    size_t written = o - (out.data() + base);
+    out.resize(base + written);
+    return written;
+}
+
+// Decodes into width x height BGRA rows 'pitch' bytes apart. False on malformed input.
+inline bool DecodeScreenFrame(const uint8_t* data, size_t size, uint32_t width, uint32_t height, uint8_t* pixels, size_t pitch) {
+    using namespace ScreenCodecDetail;
+    const uint8_t* in = data;
+    const uint8_t* end = data + size;
+    uint32_t index[64] = {};
+    uint32_t prev = 0xFF000000u;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = pixels + y * pitch;
+        const uint8_t* above = y > 0 ? row - pitch : nullptr;
+        uint32_t x = 0;
+        while (x < width) {
+            if (in >= end) return false;
+            uint8_t op = *in++;
+            uint32_t run = 0;
+            if (op == kOpUp || op == kOpLongRun) {
+                if (!GetVarint(in, end, run) || run == 0 || run > width - x) return false;
+                if (op == kOpUp) {
+                    if (!above) return false;
+                    std::memcpy(row + static_cast<size_t>(x) * 4, above + static_cast<size_t>(x) * 4, static_cast<size_t>(run) * 4);
+                    x += run;
+                    prev = Load(row + static_cast<size_t>(x - 1) * 4);
+                    continue;
+                }
+            }
+            else if ((op & 0xC0) == kOpRun && op < kOpUp) {
+                run = (op & 0x3F) + 1;
+                if (run > width - x) return false;
+            }
+            if (run) {
+                for (uint32_t i = 0; i < run; ++i) std::memcpy(row + static_cast<size_t>(x + i) * 4, &prev, 4);
+                x += run;
+                continue;
+            }
+
+            uint32_t px;
+            if (op == kOpRgb || op == kOpRgba) {
+                size_t need = op == kOpRgb ? 3 : 4;
+                if (static_cast<size_t>(end - in) < need) return false;
+                px = (prev & 0xFF000000u) | (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[1]) << 8) | in[2];
+                if (op == kOpRgba) px = (px & 0x00FFFFFFu) | (static_cast<uint32_t>(in[3]) << 24);
+                in += need;
+                index[Hash(px)] = px;
+            }
+            else if ((op & 0xC0) == kOpIndex) {
+                px = index[op & 0x3F];
+            }
+            else if ((op & 0xC0) == kOpDiff) {
+                uint32_t r = ((prev >> 16) + ((op >> 4) & 3) - 2) & 0xFF;
+                uint32_t g = ((prev >> 8) + ((op >> 2) & 3) - 2) & 0xFF;
+                uint32_t b = (prev + (op & 3) - 2) & 0xFF;
+                px = (prev & 0xFF000000u) | (r << 16) | (g << 8) | b;
+                index[Hash(px)] = px;
+            }
+            else {
+                if (in >= end) return false;
+                uint8_t second = *in++;
+                int dg = (op & 0x3F) - 32;
+                int dr = dg + (second >> 4) - 8;
+                int db = dg + (second & 0x0F) - 8;
+                uint32_t r = (((prev >> 16) & 0xFF) + dr) & 0xFF;
+                uint32_t g = (((prev >> 8) & 0xFF) + dg) & 0xFF;
+                uint32_t b = ((prev & 0xFF) + db) & 0xFF;
+                px = (prev & 0xFF000000u) | (r << 16) | (g << 8) | b;
+                index[Hash(px)] = px;
+            }
+            std::memcpy(row + static_cast<size_t>(x) * 4, &px, 4);
+            prev = px;
+            x++;
+        }
+    }
+    return in == end;
+}
+
+// Decodes a frame and XORs it into 'pixels' instead of storing it, for applying a delta
+// residual to its reference in place. Zero pixels are skipped: rows are only materialised
+// (in 'rows', two rows of scratch) once they hold something other than zero, so a residual
+// that is mostly unchanged screen costs its ops, not a full-frame pass. False on malformed
+// input, after which 'pixels' is partly updated.
+inline bool DecodeScreenFrameXor(const uint8_t* data, size_t size, uint32_t width, uint32_t height, uint8_t* pixels, size_t pitch,
+                                 std::vector<uint8_t>& rows) {
+    using namespace ScreenCodecDetail;
+    const uint8_t* in = data;
+    const uint8_t* end = data + size;
+    uint32_t index[64] = {};
+    uint32_t prev = 0xFF000000u;
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    rows.resize(rowBytes * 2);
+    uint8_t* row = rows.data();
+    uint8_t* above = rows.data() + rowBytes;
+    bool aboveZero = true;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* target = pixels + y * pitch;
+        bool rowZero = true;    // Nothing but zeros so far; 'row' is stale until written
+        auto materialise = [&](uint32_t x) {
+            if (!rowZero) return;
+            std::memset(row, 0, static_cast<size_t>(x) * 4);
+            rowZero = false;
+        };
+        uint32_t x = 0;
+        while (x < width) {
+            if (in >= end) return false;
+            uint8_t op = *in++;
+            uint32_t run = 0;
+            if (op == kOpUp || op == kOpLongRun) {
+                if (!GetVarint(in, end, run) || run == 0 || run > width - x) return false;
+                if (op == kOpUp) {
+                    if (y == 0) return false;
+                    uint8_t* out = row + static_cast<size_t>(x) * 4;
+                    if (aboveZero) {
+                        if (!rowZero) std::memset(out, 0, static_cast<size_t>(run) * 4);
+                        prev = 0;
+                    }
+                    else {
+                        materialise(x);
+                        std::memcpy(out, above + static_cast<size_t>(x) * 4, static_cast<size_t>(run) * 4);
+                        uint8_t* pixel = target + static_cast<size_t>(x) * 4;
+                        for (size_t i = 0; i < static_cast<size_t>(run) * 4; ++i) pixel[i] ^= out[i];
+                        prev = Load(out + static_cast<size_t>(run - 1) * 4);
+                    }
+                    x += run;
+                    continue;
+                }
+            }
+            else if ((op & 0xC0) == kOpRun && op < kOpUp) {
+                run = (op & 0x3F) + 1;
+                if (run > width - x) return false;
+            }
+            if (run) {
+                if (prev == 0) {
+                    if (!rowZero) std::memset(row + static_cast<size_t>(x) * 4, 0, static_cast<size_t>(run) * 4);
+                }
+                else {
+                    materialise(x);
+                    for (uint32_t i = 0; i < run; ++i) {
+                        std::memcpy(row + static_cast<size_t>(x + i) * 4, &prev, 4);
+                        uint32_t px = Load(target + static_cast<size_t>(x + i) * 4) ^ prev;
+                        std::memcpy(target + static_cast<size_t>(x + i) * 4, &px, 4);
+                    }
+                }
+                x += run;
+                continue;
+            }
+
+            uint32_t px;
+            if (op == kOpRgb || op == kOpRgba) {
+                size_t need = op == kOpRgb ? 3 : 4;
+                if (static_cast<size_t>(end - in) < need) return false;
+                px = (prev & 0xFF000000u) | (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[1]) << 8) | in[2];
+                if (op == kOpRgba) px = (px & 0x00FFFFFFu) | (static_cast<uint32_t>(in[3]) << 24);
+                in += need;
+                index[Hash(px)] = px;
+            }
+            else if ((op & 0xC0) == kOpIndex) {
+                px = index[op & 0x3F];
+            }
+            else if ((op & 0xC0) == kOpDiff) {
+                uint32_t r = ((prev >> 16) + ((op >> 4) & 3) - 2) & 0xFF;
+                uint32_t g = ((prev >> 8) + ((op >> 2) & 3) - 2) & 0xFF;
+                uint32_t b = (prev + (op & 3) - 2) & 0xFF;
+                px = (prev & 0xFF000000u) | (r << 16) | (g << 8) | b;
+                index[Hash(px)] = px;
+            }
+            else {
+                if (in >= end) return false;
+                uint8_t second = *in++;
+                int dg = (op & 0x3F) - 32;
+                int dr = dg + (second >> 4) - 8;
+                int db = dg + (second & 0x0F) - 8;
+                uint32_t r = (((prev >> 16) & 0xFF) + dr) & 0xFF;
+                uint32_t g = (((prev >> 8) & 0xFF) + dg) & 0xFF;
+                uint32_t b = ((prev & 0xFF) + db) & 0xFF;
+                px = (prev & 0xFF000000u) | (r << 16) | (g << 8) | b;
+                index[Hash(px)] = px;
+            }
+            if (px != 0 || !rowZero) {
+                materialise(x);
+                std::memcpy(row + static_cast<size_t>(x) * 4, &px, 4);
+                uint32_t out = Load(target + static_cast<size_t>(x) * 4) ^ px;
+                std::memcpy(target + static_cast<size_t>(x) * 4, &out, 4);
+            }
+            prev = px;
+            x++;
+        }
+        std::swap(row, above);
+        aboveZero = rowZero;
+    }
+    return in == end;
+}
+
+// One stream file per output: a 16-byte header, then per frame
+// { frameIndex u64, timestamp i64, payload bytes u32, payload }, all little-endian.
+struct ScreenStreamFrameInfo {
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;
+};
+
+const char kScreenStreamMagic[4] = { 'S', 'C', 'R', 'Q' };
+const uint32_t kScreenStreamVersion = 1;
+
+class ScreenStreamWriter {
+public:
+    ~ScreenStreamWriter() { Close(); }
+
+    bool Open(const std::string& path, uint32_t width, uint32_t height) {
+        Close();
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file) return false;
+        m_width = width;
+        m_height = height;
+        uint8_t header[16];
+        std::memcpy(header, kScreenStreamMagic, 4);
+        std::memcpy(header + 4, &kScreenStreamVersion, 4);
+        std::memcpy(header + 8, &width, 4);
+        std::memcpy(header + 12, &height, 4);
+        return std::fwrite(header, 1, sizeof(header), m_file) == sizeof(header);
+    }
+
+    // Encodes and appends one frame; the view must match the stream's size
+    bool WriteFrame(const ImageView& image, const ScreenStreamFrameInfo& info) {
+        if (!m_file || image.width != m_width || image.height != m_height) return false;
+        m_scratch.clear();
+        EncodeScreenFrame(image, m_scratch);
+        return WriteEncodedFrame(m_scratch.data(), m_scratch.size(), info);
+    }
+
+    // Appends a payload produced by EncodeScreenFrame() elsewhere (an encode thread)
+    bool WriteEncodedFrame(const uint8_t* payload, size_t size, const ScreenStreamFrameInfo& info) {
+        if (!m_file) return false;
+        uint8_t record[20];
+        uint32_t payloadSize = static_cast<uint32_t>(size);
+        std::memcpy(record, &info.frameIndex, 8);
+        std::memcpy(record + 8, &info.timestamp, 8);
+        std::memcpy(record + 16, &payloadSize, 4);
+        bool ok = std::fwrite(record, 1, sizeof(record), m_file) == sizeof(record) &&
+                  std::fwrite(payload, 1, size, m_file) == size;
+        if (ok) {
+            m_frames++;
+            m_bytes += sizeof(record) + size;
+        }
+        return ok;
+    }
+
+    void Close() {
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    bool IsOpen() const { return m_file != nullptr; }
+    uint64_t Frames() const { return m_frames; }
+    uint64_t Bytes() const { return m_bytes; }
+
+private:
+    std::FILE* m_file = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_bytes = 16;
+    std::vector<uint8_t> m_scratch;
+};
+
+class ScreenStreamReader {
+public:
+    ~ScreenStreamReader() { Close(); }
+
+    bool Open(const std::string& path) {
+        Close();
+        m_file = std::fopen(path.c_str(), "rb");
+        if (!m_file) return false;
+        uint8_t header[16];
+        uint32_t version = 0;
+        if (std::fread(header, 1, sizeof(header), m_file) != sizeof(header) || std::memcmp(header, kScreenStreamMagic, 4) != 0) {
+            Close();
+            return false;
+        }
+        std::memcpy(&version, header + 4, 4);
+        std::memcpy(&m_width, header + 8, 4);
+        std::memcpy(&m_height, header + 12, 4);
+        if (version != kScreenStreamVersion) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    // Decodes the next frame into tightly packed BGRA; false at end of stream or on error
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        if (!m_file) return false;
+        uint8_t record[20];
+        if (std::fread(record, 1, sizeof(record), m_file) != sizeof(record)) return false;
+        uint32_t payloadSize;
+        std::memcpy(&info.frameIndex, record, 8);
+        std::memcpy(&info.timestamp, record + 8, 8);
+        std::memcpy(&payloadSize, record + 16, 4);
+        m_payload.resize(payloadSize);
+        if (std::fread(m_payload.data(), 1, payloadSize, m_file) != payloadSize) return false;
+        pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+        return DecodeScreenFrame(m_payload.data(), m_payload.size(), m_width, m_height, pixels.data(), static_cast<size_t>(m_width) * 4);
+    }
+
+    void Close() {
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+
+private:
+    std::FILE* m_file = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<uint8_t> m_payload;
+};
@@ -14,6 +14,7 @@
 #include <chrono>
 #include <thread>
 #include <directxmath.h>
+#include "TileLayout.h"
 
 
 
@@ -38,16 +39,20 @@ ComPtr<ID3D11Texture2D> g_rightStagingTexture;
 ComPtr<ID3D11RenderTargetView> leftRTV; 
 ComPtr<ID3D11RenderTargetView> rightRTV;
 //Global variables continue - Split the captured frame into left and right halves
-D3D11_BOX leftBox = { 0, 0, 0, 2560, 1440, 1 };
-D3D11_BOX rightBox = { 2560, 0, 0, 5120, 1440, 1 }; 
+TileLayoutConfig g_tileConfig;
+TileLayoutCache g_tileLayout;
 
 
 void CopyTextureContent() {
+    // Both halves share one tile size, so each copy covers the whole source texture
+    D3D11_TEXTURE2D_DESC tileDesc;
+    g_leftTexture->GetDesc(&tileDesc);
+
     // Define source region for g_leftTexture (left part)
-    D3D11_BOX leftBox = { 0, 0, 0, 2560, 1440, 1 };
+    D3D11_BOX leftBox = { 0, 0, 0, tileDesc.Width, tileDesc.Height, 1 };
 
     // Define source region for g_rightTexture (right part)
-    D3D11_BOX rightBox = { 2560, 0, 0, 5120, 1440, 1 };
+    D3D11_BOX rightBox = leftBox;
 
     // Copy content from g_leftTexture to g_rightTexture
     g_context->CopySubresourceRegion(
@@ -502,11 +507,19 @@ bool InitializeCaptureResources() {
     }
     std::cout << "Desktop duplication created successfully." << std::endl;
 
-    // Create left and right textures
+    // Create left and right textures, sized from the duplicated desktop
+
+    DXGI_OUTDUPL_DESC duplicationDesc;
+    g_duplication->GetDesc(&duplicationDesc);
+    const TileLayout* layout = g_tileLayout.Get(duplicationDesc.ModeDesc.Width, duplicationDesc.ModeDesc.Height, g_tileConfig);
+    if (!layout || layout->TileCount() != 2) {
+        std::cerr << "Tile layout does not split the desktop into left and right textures." << std::endl;
+        return false;
+    }
 
     D3D11_TEXTURE2D_DESC halfDesc = {};
-    halfDesc.Width = 2560;
-    halfDesc.Height = 1440;
+    halfDesc.Width = layout->tileWidth;
+    halfDesc.Height = layout->tileHeight;
     halfDesc.MipLevels = 1;
     halfDesc.ArraySize = 1;
     halfDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -813,8 +826,19 @@ bool CaptureFrame() {
 
 
 
-    g_context->CopySubresourceRegion(g_leftTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &leftBox);
-    g_context->CopySubresourceRegion(g_rightTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &rightBox);
+    D3D11_TEXTURE2D_DESC capturedDesc;
+    capturedTexture->GetDesc(&capturedDesc);
+    const TileLayout* layout = g_tileLayout.Get(capturedDesc.Width, capturedDesc.Height, g_tileConfig);
+    if (!layout || layout->TileCount() != 2) {
+        std::cerr << "Tile layout does not fit the captured frame." << std::endl;
+        g_duplication->ReleaseFrame();
+        return false;
+    }
+    ID3D11Texture2D* tileTextures[2] = { g_leftTexture.Get(), g_rightTexture.Get() };
+    for (const TileCopy& tile : layout->copies) {
+        D3D11_BOX box = TileSourceBox(tile);
+        g_context->CopySubresourceRegion(tileTextures[tile.output], 0, 0, 0, 0, capturedTexture.Get(), 0, &box);
+    }
 
     std::cout << "Frame split successfully into left and right textures." << std::endl;
 
@@ -4,6 +4,9 @@
 #include <iostream>
 #include <wrl/client.h>
 #include<dxgi1_2.h>
+#include "FramePacer.h"
+#include "FrameTrace.h"
+#include "ViewCache.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -15,6 +18,19 @@ ComPtr<ID3D11RenderTargetView> g_renderTargetView;
 ComPtr<IDXGIOutputDuplication> g_outputDuplication;
 ComPtr<ID3D11RenderTargetView> g_dupRenderTargetView;
 
+// Render target views of the back buffer and duplicated frames, made once per texture;
+// duplication hands out a few surfaces in turn, so the cache keeps room for them
+D3D11RenderTargetViewBackend g_rtvBackend;
+D3D11RenderTargetViewCache g_rtvCache(g_rtvBackend, 8);
+
+// Output pacing - block in AcquireNextFrame until the next tick instead of polling with a 0 ms timeout
+QpcPacerClock g_pacerClock;
+FramePacer g_pacer({ 60.0, PacingPolicy::DuplicateLast }, g_pacerClock);
+
+// Stage tracing - press F9 to write frame_trace.json for chrome://tracing or Perfetto
+bool g_frameTrace = true;
+uint64_t g_frameIndex = 0;
+
 // Create D3D11 device, swap chain, and output duplication
 void CreateDeviceAndSwapChain(HWND hwnd) {
     HRESULT hr = S_OK;
@@ -100,62 +116,84 @@ void CreateRenderTargetView() {
         return;
     }
 
-    // Create render target view (RTV) from the back buffer
-    hr = g_device->CreateRenderTargetView(backBuffer.Get(), nullptr, &g_renderTargetView);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create render target view. HRESULT: " << std::hex << hr << std::endl;
+    // Render target view (RTV) of the back buffer, created on the first call only
+    g_rtvBackend.device = g_device.Get();
+    D3D11RenderTargetViewBackend::View* view = g_rtvCache.Get(backBuffer.Get());
+    if (!view) {
+        std::cerr << "Failed to create render target view." << std::endl;
         return;
     }
+    g_renderTargetView = *view;
 
     // Set the render target view
     g_context->OMSetRenderTargets(1, g_renderTargetView.GetAddressOf(), nullptr);
 }
 
 void CaptureAndPresentFrame(HWND hwnd) {
-    // Get the current frame from the output duplication object
+    // Wait for a new frame, but no longer than the next output tick
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
     ComPtr<IDXGIResource> pDxgiResource;
-    HRESULT hr = g_outputDuplication->AcquireNextFrame(0, &frameInfo, &pDxgiResource);
-    if (FAILED(hr)) {
+    FrameTrace::SetCurrentFrame(g_frameIndex);
+    HRESULT hr;
+    {
+        FrameTraceScope trace("acquire");
+        hr = g_outputDuplication->AcquireNextFrame(g_pacer.AcquireTimeoutMs(), &frameInfo, &pDxgiResource);
+    }
+    if (FAILED(hr) && hr != DXGI_ERROR_WAIT_TIMEOUT) {
         std::cerr << "Failed to acquire next frame from duplication. HRESULT: " << std::hex << hr << std::endl;
         return;
     }
 
-    // Get the texture from the acquired resource
-    ComPtr<ID3D11Texture2D> texture;
-    hr = pDxgiResource.As(&texture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to cast resource to texture. HRESULT: " << std::hex << hr << std::endl;
-        return;
-    }
+    if (SUCCEEDED(hr)) {
+        g_pacer.OnFrameArrived(QpcToNanoseconds(frameInfo.LastPresentTime.QuadPart), frameInfo.AccumulatedFrames);
 
-    // Create a render target view for the texture
-    hr = g_device->CreateRenderTargetView(texture.Get(), nullptr, &g_dupRenderTargetView);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create render target view. HRESULT: " << std::hex << hr << std::endl;
-        return;
-    }
+        // Get the texture from the acquired resource
+        ComPtr<ID3D11Texture2D> texture;
+        hr = pDxgiResource.As(&texture);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to cast resource to texture. HRESULT: " << std::hex << hr << std::endl;
+            return;
+        }
 
-    // Set the render target view (RTV) to the context
-    g_context->OMSetRenderTargets(1, g_dupRenderTargetView.GetAddressOf(), nullptr);
+        // Render target view for the texture, reused while duplication hands out the same surface
+        D3D11RenderTargetViewBackend::View* view = g_rtvCache.Get(texture.Get());
+        if (!view) {
+            std::cerr << "Failed to create render target view." << std::endl;
+            return;
+        }
+        g_dupRenderTargetView = *view;
 
-    // Set up the viewport to match the window size
-    D3D11_VIEWPORT viewport = {};
-    viewport.Width = 800;  // Match the window size
-    viewport.Height = 600;
-    viewport.MinDepth = 0.0f;
-    viewport.MaxDepth = 1.0f;
-    g_context->RSSetViewports(1, &viewport);
+        // Set the render target view (RTV) to the context
+        g_context->OMSetRenderTargets(1, g_dupRenderTargetView.GetAddressOf(), nullptr);
 
-    // Clear the render target to black (optional)
-    float clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };  // Black color
-    g_context->ClearRenderTargetView(g_dupRenderTargetView.Get(), clearColor);
+        // Set up the viewport to match the window size
+        D3D11_VIEWPORT viewport = {};
+        viewport.Width = 800;  // Match the window size
+        viewport.Height = 600;
+        viewport.MinDepth = 0.0f;
+        viewport.MaxDepth = 1.0f;
+        g_context->RSSetViewports(1, &viewport);
 
-    // Present the duplicated texture to the new window
-    g_swapChain->Present(1, 0);
+        // Clear the render target to black (optional)
+        float clearColor[] = { 0.0f, 0.0f, 0.0f, 1.0f };  // Black color
+        g_context->ClearRenderTargetView(g_dupRenderTargetView.Get(), clearColor);
 
-    // Release the frame after processing
-    g_outputDuplication->ReleaseFrame();
+        // Release the frame after processing
+        g_outputDuplication->ReleaseFrame();
+    }
+
+    // Present only on output ticks; a duplicate re-presents what is already in the swap chain
+    PacingDecision decision = g_pacer.Poll();
+    if (decision == PacingDecision::Emit || decision == PacingDecision::Duplicate) {
+        {
+            FrameTraceScope trace("present");
+            g_swapChain->Present(1, 0);
+        }
+        g_frameIndex++;
+        if (g_pacer.Stats().ticks % 600 == 0) {
+            WritePacingStats(std::cout, g_pacer.Stats());
+        }
+    }
 }
 
 void RenderLoop(HWND hwnd) {
@@ -186,8 +224,16 @@ void Cleanup() {
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     switch (uMsg) {
     case WM_SIZE:
-        if (g_swapChain) {
-            // Handle resizing (optional)
+        if (g_swapChain && g_context) {
+            // ResizeBuffers fails while views of the old back buffer are alive
+            g_context->OMSetRenderTargets(0, nullptr, nullptr);
+            g_renderTargetView.Reset();
+            g_dupRenderTargetView.Reset();
+            g_rtvCache.Clear();
+            HRESULT hr = g_swapChain->ResizeBuffers(0, LOWORD(lParam), HIWORD(lParam), DXGI_FORMAT_UNKNOWN, 0);
+            if (FAILED(hr)) {
+                std::cerr << "Failed to resize swap chain buffers. HRESULT: " << std::hex << hr << std::endl;
+            }
         }
         break;
     case WM_DESTROY:
@@ -223,9 +269,18 @@ int main() {
     // Show window
     ShowWindow(hwnd, SW_SHOW);
 
+    FrameTrace::Enable(g_frameTrace);
+    FrameTrace::SetThreadName("render");
+
     // Main loop
     MSG msg = {};
     while (msg.message != WM_QUIT) {
+        // Dump the trace on demand; the buffers keep recording afterwards
+        if (g_frameTrace && (GetAsyncKeyState(VK_F9) & 1)) {
+            if (FrameTrace::WriteChromeTrace("frame_trace.json")) {
+                std::cout << "Wrote frame_trace.json" << std::endl;
+            }
+        }
         if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
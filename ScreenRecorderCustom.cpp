@@ -13,6 +13,25 @@
 #pragma comment(lib, "dxgi.lib")
 #include <chrono>
 #include <thread>
+#include "AsyncFileWriter.h"
+#include "CircularRecording.h"
+#include "DirtyRects.h"
+#include "FramePipeline.h"
+#include "FrameTrace.h"
+#include "MultiOutputCapture.h"
+#include "PngWriter.h"
+#include "RecordingIndex.h"
+#include "RawVideoSink.h"
+#include "ReplayBuffer.h"
+#include "ScreenRecording.h"
+#include "StagingRing.h"
+#include "TileLayout.h"
+#include "TileStore.h"
+#include "ViewCache.h"
+#include "VideoEncoder.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
 
 
 
@@ -40,9 +59,124 @@ ComPtr<ID3D11ShaderResourceView> g_rightTextureSRV;
 ComPtr<ID3D11Texture2D> g_leftStagingTexture;
 ComPtr<ID3D11Texture2D> g_rightStagingTexture;
 
-//Global variables continue - Split the captured frame into left and right halves
-D3D11_BOX leftBox = { 0, 0, 0, 2560, 1440, 1 };
-D3D11_BOX rightBox = { 2560, 0, 0, 5120, 1440, 1 };
+//Global variables continue - Split the captured frame into output tiles
+TileLayoutConfig g_tileConfig;                              // Default 2x1: left and right halves
+TileLayoutCache g_tileLayout;
+std::vector<ComPtr<ID3D11Texture2D>> g_tileTextures;        // g_leftTexture/g_rightTexture alias tiles 0 and 1
+std::vector<ComPtr<ID3D11Texture2D>> g_tileStagingTextures;
+
+// Views of the tile textures and swap chain back buffers, made once instead of every frame
+D3D11ShaderResourceViewBackend g_srvBackend;
+D3D11ShaderResourceViewCache g_srvCache(g_srvBackend);
+D3D11RenderTargetViewBackend g_rtvBackend;
+D3D11RenderTargetViewCache g_rtvCache(g_rtvBackend);
+
+// Incremental capture - after a full frame only dirty/move rects are copied into the tile
+// textures and the readback ring slot, and .srec streams repeat tiles nothing touched
+bool g_incrementalCapture = true;
+bool g_haveBaseFrame = false;          // Tile textures hold a full frame that patches apply to
+bool g_recordRectStream = false;       // Dump rects to rect_stream.txt for DirtyRectReplay
+std::ofstream g_rectStream;
+std::vector<BYTE> g_frameMetadata;     // Scratch buffer for GetFrameMoveRects/GetFrameDirtyRects
+IncrementalStats g_incrementalStats;
+
+// Pipelined capture - acquire, split, readback, encode and write each get their own thread
+bool g_pipelinedCapture = false;
+std::mutex g_contextMutex;             // The immediate context is not thread-safe
+
+// Multi-output capture - every output of every adapter, matched into composite snapshots
+bool g_multiOutputCapture = false;
+int64_t g_snapshotToleranceNs = 4000000;  // Presents this close together count as the same moment
+
+// Stage tracing - per-frame begin/end of every stage, written to frame_trace.json on exit
+bool g_frameTrace = false;
+
+// Asynchronous readback - the whole captured frame is copied into a ring of staging textures
+// and mapped with DO_NOT_WAIT, so frame N is encoded while the copies of N+1.. are in flight.
+// Tiles are read straight out of the mapped frame through strided views.
+bool g_asyncReadback = true;
+size_t g_readbackDepth = 3;
+std::unique_ptr<D3D11ReadbackBackend> g_readbackBackend;
+std::unique_ptr<StagingRing<ID3D11Texture2D*>> g_readbackRing;
+
+// Streaming output - each tile is appended to one <prefix>_<N>.srec recording instead of a
+// PNG per frame; N counts mode changes. Frames are stored as deltas against the previous
+// one, with a keyframe every g_keyframeInterval frames to seek to.
+bool g_streamOutput = true;
+uint32_t g_keyframeInterval = 120;
+std::vector<std::unique_ptr<ScreenRecordingWriter>> g_tileStreams;
+
+// Session index - recordings, tile stores, videos and ring files (session_<N>.sidx), PNG
+// sequences (frames_<N>.sidx) and replay dumps (replay_<N>.sidx), N as in the names of the
+// files they cover, also list every frame with its tile, timestamp and place in the files, so
+// RecordingIndexReader can find a frame by number or wall-clock time without scanning
+bool g_sessionIndex = true;
+RecordingIndexWriter g_recordingIndex;
+std::string g_replayIndexPath;                  // Written once the replay dumps it covers finish
+std::vector<RecordingIndexTile> g_replayIndexTiles;
+std::vector<bool> g_replayIndexDumped;          // Tiles whose dump was started
+
+// PNG output - the built-in encoder deflates row strips on every core; false falls back to WIC
+bool g_parallelPng = true;
+
+// Tile store output - instead of recordings, each tile is cut into g_tileStoreCell px cells
+// and every distinct cell is stored once in <prefix>_<N>.tstore (dashboards, slideshows)
+bool g_tileStoreOutput = false;
+uint32_t g_tileStoreCell = 64;
+std::vector<std::unique_ptr<TileStoreWriter>> g_tileStores;
+
+// Video output - instead of recordings, each tile goes through a VideoEncoder backend into
+// <prefix>_<N>.<ext>. g_videoEncoderSpec picks it: "mjpeg:quality=85" is built in,
+// "x264:bitrate=8000" needs a build with VIDEO_ENCODER_X264 and libx264. MJPEG has no
+// inter-frame coding, so desktop content (text, scrolling) comes out about twice the size
+// of PNGs; it is only the default when x264 is not compiled in.
+struct TileVideoOutput {
+    std::unique_ptr<VideoEncoder> encoder;
+    VideoFileWriter file;
+};
+bool g_videoOutput = false;
+#ifdef VIDEO_ENCODER_X264
+std::string g_videoEncoderSpec = "x264";
+#else
+std::string g_videoEncoderSpec = "mjpeg:quality=85";
+#endif
+std::vector<std::unique_ptr<TileVideoOutput>> g_tileVideos;
+
+// Replay output - instead of recordings, each tile keeps its last g_replaySeconds in a
+// g_replayBytes memory ring and nothing is written until a dump is asked for: the
+// g_replayHotkey, Ctrl+Break in the console, or ReplayTrigger::Request().
+// Each dump becomes <prefix>_replay_<N>.srec.
+bool g_replayOutput = false;
+double g_replaySeconds = 30.0;
+size_t g_replayBytes = 512u << 20;      // Per tile
+int g_replayHotkey = VK_F10;
+std::vector<std::unique_ptr<ReplayBuffer>> g_tileReplays;
+
+// Ring output - instead of recordings, each tile records around the clock into a fixed
+// g_ringBytes file, <prefix>.sring, overwriting its oldest frames. Restarting continues the
+// same file; CircularRecordingReader can map it while capture runs.
+bool g_ringOutput = false;
+uint64_t g_ringBytes = 8ull << 30;      // Per tile
+std::vector<std::unique_ptr<CircularRecordingWriter>> g_tileRings;
+
+// Raw output - alongside whichever output is chosen above, each tile is also streamed as Y4M
+// (or raw BGRA) to g_rawDestination, with "{tile}" replaced by the tile prefix: a file like
+// "{tile}.y4m", or a pipe another tool serves, like "\\.\pipe\{tile}" for
+// ffmpeg -i \\.\pipe\left. Without "{tile}" the whole frame goes to that one destination.
+bool g_rawOutput = false;
+std::string g_rawDestination = "{tile}.y4m";
+RawVideoFormat g_rawFormat = RawVideoFormat::Y4m;
+double g_rawFps = 60.0;
+std::vector<std::unique_ptr<RawVideoSink>> g_rawSinks;
+
+// File output - recordings, stores and videos are appended in large batches written behind
+// the capture thread (io_uring on Linux, a writer thread here); PNGs go to a background
+// queue. A disk that falls g_fileIo.maxQueuedBytes behind costs frames, never capture time.
+AsyncFileWriterOptions g_fileIo;
+BackgroundFileQueue g_pngFiles;
+
+// Worker threads for data-parallel work inside a frame: PNG strips, cell hashing, JPEG strips
+ThreadPool g_workerPool;
 
 void CreateSwapChainForMonitor(
     ComPtr<IDXGIOutput> output,
@@ -52,51 +186,15 @@ void CreateSwapChainForMonitor(
 
 
 
-bool SaveTextureAsPNGStandalone(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D* texture, const wchar_t* filename) {
-    // Get the texture description
-
-    D3D11_TEXTURE2D_DESC desc;
-    texture->GetDesc(&desc);
-
-    // Create a staging texture to copy GPU data to CPU
-    D3D11_TEXTURE2D_DESC stagingDesc = desc;
-    stagingDesc.Usage = D3D11_USAGE_STAGING;
-    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-    stagingDesc.BindFlags = 0;
-
-    ComPtr<ID3D11Texture2D> stagingTexture;
-    HRESULT hr = device->CreateTexture2D(&stagingDesc, nullptr, &stagingTexture);
-
-
-    if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
-        std::cerr << "Device lost. Reason: "
-            << std::hex << g_device->GetDeviceRemovedReason() << std::endl;
-    }
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create staging texture. HRESULT: " << std::hex << hr << std::endl;
-        return false;
-    }
-
-
-    // Copy the data from the source texture to the staging texture
-    context->CopyResource(stagingTexture.Get(), texture);
-
-
-
-    // Map the staging texture to access its data
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-    hr = context->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mappedResource);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to map staging texture. HRESULT: " << std::hex << hr << std::endl;
-        return false;
-    }
+// Encode a block of BGRA pixels (e.g. a mapped staging texture or a sub-rect of one) as PNG into a stream
+bool EncodePixelsAsPNG(IStream* stream, const BYTE* pixels, UINT width, UINT height, UINT rowPitch) {
+    FrameTraceScope trace("encode");
 
     // Initialize WIC
     ComPtr<IWICImagingFactory> wicFactory;
-    hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory));
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory));
     if (FAILED(hr)) {
         std::cerr << "Failed to create WIC factory. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
@@ -105,31 +203,13 @@ bool SaveTextureAsPNGStandalone(ID3D11Device* device, ID3D11DeviceContext* conte
     hr = wicFactory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder);
     if (FAILED(hr)) {
         std::cerr << "Failed to create PNG encoder. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
-        return false;
-    }
-
-    // Create a stream for the output file
-    ComPtr<IWICStream> stream;
-    hr = wicFactory->CreateStream(&stream);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create WIC stream. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
-        return false;
-    }
-
-    hr = stream->InitializeFromFilename(filename, GENERIC_WRITE);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to initialize WIC stream. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
     // Initialize the encoder
-    hr = encoder->Initialize(stream.Get(), WICBitmapEncoderNoCache);
+    hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
     if (FAILED(hr)) {
         std::cerr << "Failed to initialize PNG encoder. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
@@ -138,21 +218,18 @@ bool SaveTextureAsPNGStandalone(ID3D11Device* device, ID3D11DeviceContext* conte
     hr = encoder->CreateNewFrame(&frame, nullptr);
     if (FAILED(hr)) {
         std::cerr << "Failed to create PNG frame. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
     hr = frame->Initialize(nullptr);
     if (FAILED(hr)) {
         std::cerr << "Failed to initialize PNG frame. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
-    hr = frame->SetSize(desc.Width, desc.Height);
+    hr = frame->SetSize(width, height);
     if (FAILED(hr)) {
         std::cerr << "Failed to set PNG frame size. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
@@ -161,41 +238,165 @@ bool SaveTextureAsPNGStandalone(ID3D11Device* device, ID3D11DeviceContext* conte
     hr = frame->SetPixelFormat(&format);
     if (FAILED(hr)) {
         std::cerr << "Failed to set PNG pixel format. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
     // Write the pixel data to the PNG
     hr = frame->WritePixels(
-        desc.Height,
-        mappedResource.RowPitch,
-        mappedResource.RowPitch * desc.Height,
-        static_cast<BYTE*>(mappedResource.pData)
+        height,
+        rowPitch,
+        rowPitch * height,
+        const_cast<BYTE*>(pixels)
     );
     if (FAILED(hr)) {
         std::cerr << "Failed to write PNG pixels. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
+    FrameTraceScope commitTrace("commit");
     hr = frame->Commit();
     if (FAILED(hr)) {
         std::cerr << "Failed to commit PNG frame. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
         return false;
     }
 
     hr = encoder->Commit();
     if (FAILED(hr)) {
         std::cerr << "Failed to commit PNG encoder. HRESULT: " << std::hex << hr << std::endl;
-        context->Unmap(stagingTexture.Get(), 0);
+        return false;
+    }
+
+    return true;
+}
+
+// Encode a block of BGRA pixels as a PNG file
+bool SavePixelsAsPNG(const BYTE* pixels, UINT width, UINT height, UINT rowPitch, const wchar_t* filename) {
+    if (g_parallelPng) {
+        std::vector<uint8_t> png;
+        {
+            FrameTraceScope trace("encode");
+            if (!EncodePngParallel(pixels, width, height, rowPitch, png, g_workerPool)) {
+                std::cerr << "Failed to encode PNG: " << width << "x" << height << std::endl;
+                return false;
+            }
+        }
+        char path[MAX_PATH];
+        snprintf(path, sizeof(path), "%ls", filename);
+        if (!g_pngFiles.Write(path, std::move(png))) {
+            std::wcerr << L"Disk is behind, dropped " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    ComPtr<IWICImagingFactory> wicFactory;
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory));
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create WIC factory. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+
+    // Create a stream for the output file
+    ComPtr<IWICStream> stream;
+    hr = wicFactory->CreateStream(&stream);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create WIC stream. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+
+    hr = stream->InitializeFromFilename(filename, GENERIC_WRITE);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to initialize WIC stream. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+
+    if (!EncodePixelsAsPNG(stream.Get(), pixels, width, height, rowPitch)) {
         return false;
     }
 
     std::cout << "Saved PNG: " << filename << std::endl;
-    context->Unmap(stagingTexture.Get(), 0);
     return true;
 }
+
+// Encode a block of BGRA pixels as PNG into a memory buffer
+bool EncodePixelsAsPNGToMemory(const BYTE* pixels, UINT width, UINT height, UINT rowPitch, std::vector<uint8_t>& out) {
+    if (g_parallelPng) {
+        FrameTraceScope trace("encode");
+        return EncodePngParallel(pixels, width, height, rowPitch, out, g_workerPool);
+    }
+
+    ComPtr<IStream> memoryStream;
+    HRESULT hr = CreateStreamOnHGlobal(nullptr, TRUE, &memoryStream);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create memory stream. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+
+    if (!EncodePixelsAsPNG(memoryStream.Get(), pixels, width, height, rowPitch)) {
+        return false;
+    }
+
+    STATSTG streamStat = {};
+    memoryStream->Stat(&streamStat, STATFLAG_NONAME);
+    out.resize(static_cast<size_t>(streamStat.cbSize.QuadPart));
+
+    LARGE_INTEGER zero = {};
+    memoryStream->Seek(zero, STREAM_SEEK_SET, nullptr);
+    ULONG bytesRead = 0;
+    hr = memoryStream->Read(out.data(), static_cast<ULONG>(out.size()), &bytesRead);
+    if (FAILED(hr) || bytesRead != out.size()) {
+        std::cerr << "Failed to read encoded PNG from memory stream. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SaveTextureAsPNGStandalone(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Texture2D* texture, const wchar_t* filename) {
+    // Get the texture description
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+
+    // Create a staging texture to copy GPU data to CPU
+    D3D11_TEXTURE2D_DESC stagingDesc = desc;
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    stagingDesc.BindFlags = 0;
+
+    ComPtr<ID3D11Texture2D> stagingTexture;
+    HRESULT hr = device->CreateTexture2D(&stagingDesc, nullptr, &stagingTexture);
+
+
+    if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
+        std::cerr << "Device lost. Reason: "
+            << std::hex << g_device->GetDeviceRemovedReason() << std::endl;
+        g_srvCache.Clear();
+        g_rtvCache.Clear();
+    }
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create staging texture. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+
+
+    // Copy the data from the source texture to the staging texture
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    {
+        FrameTraceScope trace("map");
+        context->CopyResource(stagingTexture.Get(), texture);
+
+        // Map the staging texture to access its data
+        hr = context->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mappedResource);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to map staging texture. HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+    }
+
+    bool saved = SavePixelsAsPNG(static_cast<const BYTE*>(mappedResource.pData), desc.Width, desc.Height, mappedResource.RowPitch, filename);
+    context->Unmap(stagingTexture.Get(), 0);
+    return saved;
+}
 // Function to handle window messages (message loop)
 void WindowMessageLoop(HWND hWnd) {
     MSG msg;
@@ -324,6 +525,574 @@ void InitializeShaders() {
 
 
 
+// Create one texture per output tile, sized from the layout
+bool CreateTileTextures(const TileLayout& layout) {
+    D3D11_TEXTURE2D_DESC tileDesc = {};
+    tileDesc.Width = layout.tileWidth;
+    tileDesc.Height = layout.tileHeight;
+    tileDesc.MipLevels = 1;
+    tileDesc.ArraySize = 1;
+    tileDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    tileDesc.SampleDesc.Count = 1;
+    tileDesc.Usage = D3D11_USAGE_DEFAULT;
+    tileDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    for (const ComPtr<ID3D11Texture2D>& texture : g_tileTextures) {
+        g_srvCache.Invalidate(texture.Get());
+    }
+    g_tileTextures.assign(layout.TileCount(), nullptr);
+    for (size_t i = 0; i < g_tileTextures.size(); ++i) {
+        HRESULT hr = g_device->CreateTexture2D(&tileDesc, nullptr, &g_tileTextures[i]);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create texture for tile " << i << ". HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+    }
+
+    g_leftTexture = g_tileTextures[0];
+    g_rightTexture = g_tileTextures.size() > 1 ? g_tileTextures[1] : nullptr;
+    return true;
+}
+
+// True if the tile textures were created for this layout
+bool TileTexturesMatch(const TileLayout& layout) {
+    if (g_tileTextures.size() != layout.TileCount() || !g_tileTextures[0]) {
+        return false;
+    }
+    D3D11_TEXTURE2D_DESC desc;
+    g_tileTextures[0]->GetDesc(&desc);
+    return desc.Width == layout.tileWidth && desc.Height == layout.tileHeight;
+}
+
+// "left"/"right" for the default halves, "tile<N>" for larger walls
+void TileFilePrefix(const TileLayout& layout, size_t tile, wchar_t* prefix, size_t prefixLength) {
+    if (layout.TileCount() == 2 && layout.config.columns == 2) {
+        swprintf(prefix, prefixLength, L"%s", tile == 0 ? L"left" : L"right");
+    }
+    else {
+        swprintf(prefix, prefixLength, L"tile%zu", tile);
+    }
+}
+
+void PrintWriteStats(const AsyncFileWriterStats& stats) {
+    std::cout << "  written " << stats.writtenBytes / (1024.0 * 1024.0) << " MB in " << stats.batches << " batches, "
+        << stats.MegabytesPerSecond() << " MB/s, queue depth max " << stats.maxQueueDepth << ", slowest batch "
+        << stats.maxWriteMs << " ms";
+    if (stats.rejectedAppends) std::cout << ", " << stats.rejectedAppends << " appends refused";
+    std::cout << std::endl;
+}
+
+std::vector<RecordingIndexTile> IndexTiles(const TileLayout& layout, const std::vector<std::string>& sources) {
+    std::vector<RecordingIndexTile> tiles(sources.size());
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        tiles[t].width = layout.tileWidth;
+        tiles[t].height = layout.tileHeight;
+        tiles[t].source = sources[t];
+    }
+    return tiles;
+}
+
+// Frames are stamped with QPC ticks; the index pins the current tick to the wall clock
+bool OpenRecordingIndex(RecordingIndexWriter& index, const char* path, const std::vector<RecordingIndexTile>& tiles) {
+    LARGE_INTEGER frequency, now;
+    FILETIME wallClock;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    GetSystemTimeAsFileTime(&wallClock);
+    ULARGE_INTEGER fileTime;
+    fileTime.LowPart = wallClock.dwLowDateTime;
+    fileTime.HighPart = wallClock.dwHighDateTime;
+    int64_t unixMs = static_cast<int64_t>((fileTime.QuadPart - 116444736000000000ull) / 10000);    // 100 ns since 1601
+    if (!index.Open(path, tiles, frequency.QuadPart, now.QuadPart, unixMs, g_fileIo)) {
+        std::cerr << "Failed to open session index " << path << "; recording without it" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Starts the session index over 'sources' (one file name or PNG pattern per tile)
+void OpenSessionIndex(const TileLayout& layout, const char* path, const std::vector<std::string>& sources) {
+    if (!g_sessionIndex) return;
+    OpenRecordingIndex(g_recordingIndex, path, IndexTiles(layout, sources));
+}
+
+// A frame of an output that is not a .srec: where it starts in the tile's file
+void AddSessionIndexEntry(size_t tile, const ScreenStreamFrameInfo& info, uint64_t offset, uint32_t bytes, bool keyframe) {
+    RecordingIndexEntry entry;
+    entry.frameIndex = info.frameIndex;
+    entry.timestamp = info.timestamp;
+    entry.offset = offset;
+    entry.tile = static_cast<uint16_t>(tile);
+    entry.keyframe = keyframe;
+    entry.payloadSize = bytes;
+    g_recordingIndex.Add(entry);
+}
+
+void CloseSessionIndex() {
+    if (!g_recordingIndex.IsOpen()) return;
+    if (!g_recordingIndex.Close()) std::cerr << "Failed to finish the session index" << std::endl;
+    std::cout << "Session index: " << g_recordingIndex.Entries() << " frames (" << g_recordingIndex.DroppedEntries() << " dropped)" << std::endl;
+}
+
+bool OpenTileStreams(const TileLayout& layout, std::vector<std::unique_ptr<ScreenRecordingWriter>>& streams) {
+    static unsigned generation = 0;
+    streams.clear();
+    std::vector<std::string> sources;
+    for (size_t t = 0; t < layout.TileCount(); ++t) {
+        wchar_t tileName[32];
+        char path[64];
+        TileFilePrefix(layout, t, tileName, 32);
+        snprintf(path, sizeof(path), "%ls_%u.srec", tileName, generation);
+        std::unique_ptr<ScreenRecordingWriter> stream(new ScreenRecordingWriter());
+        if (!stream->Open(path, layout.tileWidth, layout.tileHeight, g_keyframeInterval, g_fileIo)) {
+            std::cerr << "Failed to open recording " << path << std::endl;
+            streams.clear();
+            return false;
+        }
+        streams.push_back(std::move(stream));
+        sources.push_back(path);
+    }
+    char indexPath[64];
+    snprintf(indexPath, sizeof(indexPath), "session_%u.sidx", generation);
+    OpenSessionIndex(layout, indexPath, sources);
+    generation++;
+    return true;
+}
+
+void CloseTileStreams(std::vector<std::unique_ptr<ScreenRecordingWriter>>& streams) {
+    for (size_t t = 0; t < streams.size(); ++t) {
+        if (!streams[t]->Close()) std::cerr << "Failed to write the index of tile " << t << "'s recording" << std::endl;
+        std::cout << "Tile " << t << " recording: " << streams[t]->Frames() << " frames (" << streams[t]->Keyframes()
+            << " keyframes, " << streams[t]->DroppedFrames() << " dropped), " << streams[t]->Bytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+        PrintWriteStats(streams[t]->WriteStats());
+    }
+    streams.clear();
+}
+
+// One tile store per tile; cells are hashed and compressed on the worker pool
+bool OpenTileStores(const TileLayout& layout, std::vector<std::unique_ptr<TileStoreWriter>>& stores) {
+    static unsigned generation = 0;
+    stores.clear();
+    std::vector<std::string> sources;
+    for (size_t t = 0; t < layout.TileCount(); ++t) {
+        wchar_t tileName[32];
+        char path[64];
+        TileFilePrefix(layout, t, tileName, 32);
+        snprintf(path, sizeof(path), "%ls_%u.tstore", tileName, generation);
+        std::unique_ptr<TileStoreWriter> store(new TileStoreWriter());
+        if (!store->Open(path, layout.tileWidth, layout.tileHeight, g_tileStoreCell, &g_workerPool, g_fileIo)) {
+            std::cerr << "Failed to open tile store " << path << std::endl;
+            stores.clear();
+            return false;
+        }
+        stores.push_back(std::move(store));
+        sources.push_back(path);
+    }
+    char indexPath[64];
+    snprintf(indexPath, sizeof(indexPath), "session_%u.sidx", generation);
+    OpenSessionIndex(layout, indexPath, sources);
+    generation++;
+    return true;
+}
+
+void CloseTileStores(std::vector<std::unique_ptr<TileStoreWriter>>& stores) {
+    for (size_t t = 0; t < stores.size(); ++t) {
+        TileStoreStats stats = stores[t]->Stats();
+        if (!stores[t]->Close()) std::cerr << "Failed to close tile " << t << "'s store" << std::endl;
+        std::cout << "Tile " << t << " store: " << stats.frames << " frames (" << stats.droppedFrames << " dropped), " << stats.cells
+            << " distinct cells of " << stats.cellReferences << ", " << stats.bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        PrintWriteStats(stores[t]->WriteStats());
+    }
+    stores.clear();
+}
+
+// One encoder and elementary stream file per tile; mjpeg strips run on the worker pool
+bool OpenTileVideos(const TileLayout& layout, std::vector<std::unique_ptr<TileVideoOutput>>& videos) {
+    static unsigned generation = 0;
+    videos.clear();
+    VideoEncoderConfig config;
+    if (!ParseVideoEncoderSpec(g_videoEncoderSpec, config) || !VideoBackendAvailable(config.backend)) {
+        std::cerr << "Video encoder \"" << g_videoEncoderSpec << "\" is not valid in this build" << std::endl;
+        return false;
+    }
+    if (config.threads == 0) config.pool = &g_workerPool;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    config.ticksPerSecond = frequency.QuadPart;     // Frames are stamped with LastPresentTime
+    std::vector<std::string> sources;
+    for (size_t t = 0; t < layout.TileCount(); ++t) {
+        std::unique_ptr<TileVideoOutput> video(new TileVideoOutput());
+        video->encoder = CreateVideoEncoder(config.backend);
+        wchar_t tileName[32];
+        char path[64];
+        TileFilePrefix(layout, t, tileName, 32);
+        snprintf(path, sizeof(path), "%ls_%u.%s", tileName, generation, video->encoder->FileExtension());
+        VideoFileWriter* file = &video->file;
+        auto sink = [file, t](const VideoPacket& packet) {
+            uint64_t offset = file->Bytes();
+            if (!file->Write(packet)) return false;
+            ScreenStreamFrameInfo info;
+            info.frameIndex = packet.frameIndex;
+            info.timestamp = packet.timestamp;
+            AddSessionIndexEntry(t, info, offset, static_cast<uint32_t>(packet.size), packet.keyframe);
+            return true;
+        };
+        if (!file->Open(path, g_fileIo) || !video->encoder->Open(layout.tileWidth, layout.tileHeight, config, sink)) {
+            std::cerr << "Failed to open " << VideoBackendName(config.backend) << " output " << path << std::endl;
+            videos.clear();
+            return false;
+        }
+        videos.push_back(std::move(video));
+        sources.push_back(path);
+    }
+    char indexPath[64];
+    snprintf(indexPath, sizeof(indexPath), "session_%u.sidx", generation);
+    OpenSessionIndex(layout, indexPath, sources);
+    generation++;
+    return true;
+}
+
+void CloseTileVideos(std::vector<std::unique_ptr<TileVideoOutput>>& videos) {
+    for (size_t t = 0; t < videos.size(); ++t) {
+        TileVideoOutput& video = *videos[t];
+        if (!video.encoder->Flush() || !video.file.Close()) std::cerr << "Failed to finish tile " << t << "'s video" << std::endl;
+        std::cout << "Tile " << t << " " << video.encoder->Name() << " video: " << video.file.Packets() << " frames ("
+            << video.file.Keyframes() << " keyframes, " << video.file.DroppedPackets() << " dropped), "
+            << video.file.Bytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+        PrintWriteStats(video.file.WriteStats());
+    }
+    videos.clear();
+}
+
+// One replay ring per tile; memory is allocated here and never again
+bool OpenTileReplays(const TileLayout& layout, std::vector<std::unique_ptr<ReplayBuffer>>& replays) {
+    replays.clear();
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    ReplayBufferOptions options;
+    options.seconds = g_replaySeconds;
+    options.capacityBytes = g_replayBytes;
+    options.ticksPerSecond = frequency.QuadPart;     // Frames are stamped with LastPresentTime
+    options.dumpIo = g_fileIo;
+    for (size_t t = 0; t < layout.TileCount(); ++t) {
+        std::unique_ptr<ReplayBuffer> replay(new ReplayBuffer());
+        if (!replay->Open(layout.tileWidth, layout.tileHeight, options)) {
+            std::cerr << "Failed to allocate the replay buffer for tile " << t << std::endl;
+            replays.clear();
+            return false;
+        }
+        replays.push_back(std::move(replay));
+    }
+    ReplayTrigger::Install();
+    std::cout << "Replay: keeping " << g_replaySeconds << " s per tile, dump with F10 or Ctrl+Break" << std::endl;
+    return true;
+}
+
+// Writes replay_<N>.sidx once every dump it covers has finished; 'wait' blocks for them
+void FinishReplayIndex(bool wait) {
+    if (g_replayIndexPath.empty()) return;
+    std::vector<RecordingIndexEntry> entries;
+    for (size_t t = 0; t < g_tileReplays.size(); ++t) {
+        if (!wait && g_tileReplays[t]->DumpRunning()) return;
+    }
+    for (size_t t = 0; t < g_tileReplays.size(); ++t) {
+        if (!g_tileReplays[t]->WaitForDump() || !g_replayIndexDumped[t]) continue;
+        for (const ScreenRecordingEntry& frame : g_tileReplays[t]->LastDump()) {
+            RecordingIndexEntry entry;
+            entry.frameIndex = frame.frameIndex;
+            entry.timestamp = frame.timestamp;
+            entry.offset = frame.offset;
+            entry.tile = static_cast<uint16_t>(t);
+            entry.keyframe = frame.keyframe;
+            entry.payloadSize = frame.payloadSize;
+            entries.push_back(entry);
+        }
+    }
+    // Capture order, with the tiles of one frame next to each other
+    std::stable_sort(entries.begin(), entries.end(), [](const RecordingIndexEntry& a, const RecordingIndexEntry& b) {
+        return a.frameIndex < b.frameIndex;
+    });
+    RecordingIndexWriter index;
+    if (!entries.empty() && OpenRecordingIndex(index, g_replayIndexPath.c_str(), g_replayIndexTiles)) {
+        for (const RecordingIndexEntry& entry : entries) index.Add(entry);
+        if (!index.Close()) std::cerr << "Failed to finish " << g_replayIndexPath << std::endl;
+    }
+    g_replayIndexPath.clear();
+}
+
+// Starts a background dump of every tile if one was asked for since the last frame
+void PollReplayDump(const TileLayout& layout) {
+    static unsigned generation = 0;
+    static bool hotkeyDown = false;
+    bool down = (GetAsyncKeyState(g_replayHotkey) & 0x8000) != 0;
+    bool requested = ReplayTrigger::Consume() || (down && !hotkeyDown);
+    hotkeyDown = down;
+    FinishReplayIndex(false);
+    if (!requested || g_tileReplays.empty()) return;
+    if (!g_replayIndexPath.empty()) {
+        std::cerr << "Replay dump skipped: the last one is still running" << std::endl;
+        return;
+    }
+    std::vector<std::string> sources;
+    g_replayIndexDumped.assign(g_tileReplays.size(), false);
+    for (size_t t = 0; t < g_tileReplays.size(); ++t) {
+        wchar_t tileName[32];
+        char path[64];
+        TileFilePrefix(layout, t, tileName, 32);
+        snprintf(path, sizeof(path), "%ls_replay_%u.srec", tileName, generation);
+        g_replayIndexDumped[t] = g_tileReplays[t]->DumpAsync(path);
+        if (!g_replayIndexDumped[t]) std::cerr << "Replay dump of tile " << t << " skipped: one is still running" << std::endl;
+        else std::cout << "Dumping replay to " << path << std::endl;
+        sources.push_back(path);
+    }
+    if (g_sessionIndex) {
+        char indexPath[64];
+        snprintf(indexPath, sizeof(indexPath), "replay_%u.sidx", generation);
+        g_replayIndexPath = indexPath;
+        g_replayIndexTiles = IndexTiles(layout, sources);
+    }
+    generation++;
+}
+
+void CloseTileReplays(std::vector<std::unique_ptr<ReplayBuffer>>& replays) {
+    FinishReplayIndex(true);
+    for (size_t t = 0; t < replays.size(); ++t) {
+        if (!replays[t]->WaitForDump()) std::cerr << "Tile " << t << "'s last replay dump failed" << std::endl;
+        ReplayBufferStats stats = replays[t]->Stats();
+        std::cout << "Tile " << t << " replay: " << stats.frames << " frames (" << stats.seconds << " s, "
+            << stats.bytes / (1024.0 * 1024.0) << " of " << stats.capacityBytes / (1024.0 * 1024.0) << " MB) held, "
+            << stats.dumps << " dumps, " << stats.dropped << " dropped" << std::endl;
+    }
+    replays.clear();
+}
+
+// One ring file per tile, sized now so recording never grows or replaces it
+bool OpenTileRings(const TileLayout& layout, std::vector<std::unique_ptr<CircularRecordingWriter>>& rings) {
+    static unsigned generation = 0;
+    rings.clear();
+    std::vector<std::string> sources;
+    CircularRecordingOptions options;
+    options.fileBytes = g_ringBytes;
+    for (size_t t = 0; t < layout.TileCount(); ++t) {
+        wchar_t tileName[32];
+        char path[64];
+        TileFilePrefix(layout, t, tileName, 32);
+        snprintf(path, sizeof(path), "%ls.sring", tileName);
+        std::unique_ptr<CircularRecordingWriter> ring(new CircularRecordingWriter());
+        if (!ring->Open(path, layout.tileWidth, layout.tileHeight, options)) {
+            std::cerr << "Failed to map ring file " << path << std::endl;
+            rings.clear();
+            return false;
+        }
+        CircularRecordingStats stats = ring->Stats();
+        std::cout << (stats.resumed ? "Continuing " : "Created ") << path << " (" << stats.fileBytes / (1024.0 * 1024.0) << " MB, "
+            << stats.frames << " frames held)" << std::endl;
+        rings.push_back(std::move(ring));
+        sources.push_back(path);
+    }
+    char indexPath[64];
+    snprintf(indexPath, sizeof(indexPath), "session_%u.sidx", generation);
+    OpenSessionIndex(layout, indexPath, sources);
+    generation++;
+    return true;
+}
+
+void CloseTileRings(std::vector<std::unique_ptr<CircularRecordingWriter>>& rings) {
+    for (size_t t = 0; t < rings.size(); ++t) {
+        CircularRecordingStats stats = rings[t]->Stats();
+        std::cout << "Tile " << t << " ring: " << stats.frames << " frames (" << stats.bytes / (1024.0 * 1024.0) << " MB) held, "
+            << stats.added << " added, " << stats.evicted << " overwritten, " << stats.dropped << " dropped, " << stats.laps << " laps" << std::endl;
+        rings[t]->Close();
+    }
+    rings.clear();
+}
+
+// One raw sink per tile, or a single full-frame sink when the destination names no tile.
+// Opening a pipe waits for its reader to connect.
+bool OpenRawSinks(const TileLayout& layout, uint32_t frameWidth, uint32_t frameHeight, std::vector<std::unique_ptr<RawVideoSink>>& sinks) {
+    sinks.clear();
+    RawVideoSinkOptions options;
+    options.format = g_rawFormat;
+    options.fps = g_rawFps;
+    const std::string placeholder = "{tile}";
+    size_t at = g_rawDestination.find(placeholder);
+    size_t count = at == std::string::npos ? 1 : layout.TileCount();
+    for (size_t t = 0; t < count; ++t) {
+        std::string destination = g_rawDestination;
+        uint32_t width = frameWidth;
+        uint32_t height = frameHeight;
+        if (at != std::string::npos) {
+            wchar_t tileName[32];
+            char name[32];
+            TileFilePrefix(layout, t, tileName, 32);
+            snprintf(name, sizeof(name), "%ls", tileName);
+            destination.replace(at, placeholder.size(), name);
+            width = layout.tileWidth;
+            height = layout.tileHeight;
+        }
+        std::unique_ptr<RawVideoSink> sink(new RawVideoSink());
+        if (!sink->Open(destination, width, height, options)) {
+            std::cerr << "Failed to open raw output " << destination << std::endl;
+            sinks.clear();
+            return false;
+        }
+        sinks.push_back(std::move(sink));
+    }
+    return true;
+}
+
+void CloseRawSinks(std::vector<std::unique_ptr<RawVideoSink>>& sinks) {
+    for (size_t t = 0; t < sinks.size(); ++t) {
+        const RawVideoSinkStats& stats = sinks[t]->Stats();
+        std::cout << "Raw output " << t << ": " << stats.frames << " frames, " << stats.bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        sinks[t]->Close();
+    }
+    sinks.clear();
+}
+
+// Receives one tile of each finished readback; the ring keeps one per enabled output.
+// 'unchanged' is set when the dirty rects show the tile is the same as in the last frame.
+typedef std::function<void(size_t tile, const ImageView& view, const ScreenStreamFrameInfo& info, bool unchanged)> TileFrameOutput;
+
+// Whether any of the rects (desktop coordinates) lands in tile t
+bool TileTouched(const TileLayout& layout, size_t t, const std::vector<DirtyRect>& rects) {
+    for (const TileCopy& copy : layout.copies) {
+        if (copy.output != t) continue;
+        const DirtyRect region = { (int32_t)copy.left, (int32_t)copy.top, (int32_t)copy.right, (int32_t)copy.bottom };
+        for (const DirtyRect& r : rects) {
+            if (!RectIsEmpty(RectIntersection(r, region))) return true;
+        }
+    }
+    return false;
+}
+
+// Full-frame staging ring; each finished copy goes to the tile rings, tile replays, tile videos, tile stores or tile recordings, or is
+// written as one <prefix>_frame_<N>.png per tile, and to the raw sinks when they are on
+bool CreateReadbackRing(const D3D11_TEXTURE2D_DESC& capturedDesc, const TileLayout& layout) {
+    g_readbackRing.reset();
+    g_readbackBackend.reset(new D3D11ReadbackBackend(g_device.Get(), g_context.Get()));
+    HRESULT hr = g_readbackBackend->CreateSlots(g_readbackDepth, capturedDesc);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create readback ring. HRESULT: " << std::hex << hr << std::endl;
+        g_readbackBackend.reset();
+        return false;
+    }
+    std::vector<TileFrameOutput> outputs;
+    bool opened = true;
+    if (g_ringOutput) {
+        opened = OpenTileRings(layout, g_tileRings);
+        outputs.push_back([](size_t t, const ImageView& view, const ScreenStreamFrameInfo& info, bool) {
+            FrameTraceScope trace("encode");
+            if (g_tileRings[t]->WriteFrame(view, info)) g_recordingIndex.AddRecorded(static_cast<uint16_t>(t), g_tileRings[t]->LastFrame());
+        });
+    }
+    else if (g_replayOutput) {
+        opened = OpenTileReplays(layout, g_tileReplays);
+        outputs.push_back([](size_t t, const ImageView& view, const ScreenStreamFrameInfo& info, bool) {
+            FrameTraceScope trace("encode");
+            g_tileReplays[t]->AddFrame(view, info);
+        });
+    }
+    else if (g_videoOutput) {
+        opened = OpenTileVideos(layout, g_tileVideos);
+        outputs.push_back([](size_t t, const ImageView& view, const ScreenStreamFrameInfo& info, bool) {
+            FrameTraceScope trace("encode");
+            g_tileVideos[t]->encoder->Encode(view, info);
+        });
+    }
+    else if (g_tileStoreOutput) {
+        opened = OpenTileStores(layout, g_tileStores);
+        outputs.push_back([](size_t t, const ImageView& view, const ScreenStreamFrameInfo& info, bool) {
+            FrameTraceScope trace("encode");
+            TileStoreWriter& store = *g_tileStores[t];
+            if (store.AddFrame(view, info)) AddSessionIndexEntry(t, info, store.LastFrameOffset(), store.LastFrameBytes(), store.Stats().frames == 1);
+        });
+    }
+    else if (g_streamOutput) {
+        opened = OpenTileStreams(layout, g_tileStreams);
+        outputs.push_back([](size_t t, const ImageView& view, const ScreenStreamFrameInfo& info, bool unchanged) {
+            FrameTraceScope trace("encode");
+            ScreenRecordingWriter& stream = *g_tileStreams[t];
+            bool written = unchanged && stream.CanRepeatFrame() ? stream.WriteRepeatedFrame(info) : stream.WriteFrame(view, info);
+            if (written) g_recordingIndex.AddRecorded(static_cast<uint16_t>(t), stream.LastFrame());
+        });
+    }
+    else {
+        static unsigned generation = 0;
+        std::vector<std::string> sources;
+        for (size_t t = 0; t < layout.TileCount(); ++t) {
+            wchar_t tileName[32];
+            char pattern[64];
+            TileFilePrefix(layout, t, tileName, 32);
+            snprintf(pattern, sizeof(pattern), "%ls_frame_{frame}.png", tileName);
+            sources.push_back(pattern);
+        }
+        char indexPath[64];
+        snprintf(indexPath, sizeof(indexPath), "frames_%u.sidx", generation++);
+        OpenSessionIndex(layout, indexPath, sources);
+        outputs.push_back([layout](size_t t, const ImageView& view, const ScreenStreamFrameInfo& info, bool) {
+            wchar_t tileName[32];
+            wchar_t filename[128];
+            TileFilePrefix(layout, t, tileName, 32);
+            swprintf_s(filename, L"%s_frame_%llu.png", tileName, static_cast<unsigned long long>(info.frameIndex));
+            if (SavePixelsAsPNG(view.data, view.width, view.height, static_cast<UINT>(view.rowPitch), filename)) {
+                g_recordingIndex.AddImage(static_cast<uint16_t>(t), info);
+            }
+        });
+    }
+    if (opened && g_rawOutput) {
+        opened = OpenRawSinks(layout, capturedDesc.Width, capturedDesc.Height, g_rawSinks);
+        // A single sink named without {tile} takes the whole frame instead, below
+        if (g_rawSinks.size() == layout.TileCount()) {
+            outputs.push_back([](size_t t, const ImageView& view, const ScreenStreamFrameInfo&, bool) {
+                FrameTraceScope trace("stream");
+                g_rawSinks[t]->WriteFrame(view, &g_workerPool);
+            });
+        }
+    }
+    if (!opened) {
+        g_readbackBackend.reset();
+        return false;
+    }
+
+    g_readbackRing.reset(new StagingRing<ID3D11Texture2D*>(*g_readbackBackend, [layout, outputs](const MappedFrame& frame) {
+        const ImageView frameView(frame.data, frame.width, frame.height, frame.rowPitch);
+        ScreenStreamFrameInfo info;
+        info.frameIndex = frame.frameIndex;
+        info.timestamp = frame.timestamp;
+        std::vector<ImageView> tileViews;
+        BuildTileViews(frameView, layout, tileViews);
+        if (g_rawSinks.size() == 1 && tileViews.size() != 1) {
+            FrameTraceScope trace("stream");
+            g_rawSinks[0]->WriteFrame(frameView, &g_workerPool);
+        }
+        PollReplayDump(layout);
+        for (size_t t = 0; t < tileViews.size(); ++t) {
+            const bool unchanged = frame.changed && !TileTouched(layout, t, *frame.changed);
+            for (const TileFrameOutput& output : outputs) output(t, tileViews[t], info, unchanged);
+        }
+    }));
+    return true;
+}
+
+// Writes out every readback still in flight, then drops the ring and closes the outputs
+void ReleaseReadbackRing() {
+    g_readbackRing.reset();     // The ring flushes on destruction
+    g_readbackBackend.reset();
+    CloseTileStreams(g_tileStreams);
+    CloseTileStores(g_tileStores);
+    CloseTileVideos(g_tileVideos);     // Flushing may still index packets
+    CloseTileReplays(g_tileReplays);
+    CloseTileRings(g_tileRings);
+    CloseSessionIndex();
+    CloseRawSinks(g_rawSinks);
+    g_pngFiles.Drain();
+    if (g_pngFiles.Written() || g_pngFiles.Rejected()) {
+        std::cout << "PNG files: " << g_pngFiles.Written() << " written, " << g_pngFiles.Failed() << " failed, "
+            << g_pngFiles.Rejected() << " dropped, queue depth max " << g_pngFiles.MaxDepth() << std::endl;
+    }
+}
+
 bool InitializeCaptureResources() {
     HRESULT hr;
 
@@ -384,27 +1153,17 @@ bool InitializeCaptureResources() {
     }
     std::cout << "Desktop duplication created successfully." << std::endl;
 
-    // Create left and right textures
-
-    D3D11_TEXTURE2D_DESC halfDesc = {};
-    halfDesc.Width = 2560;
-    halfDesc.Height = 1440;
-    halfDesc.MipLevels = 1;
-    halfDesc.ArraySize = 1;
-    halfDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-    halfDesc.SampleDesc.Count = 1;
-    halfDesc.Usage = D3D11_USAGE_DEFAULT;
-    halfDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-
-    hr = g_device->CreateTexture2D(&halfDesc, nullptr, &g_leftTexture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create left texture. HRESULT: " << std::hex << hr << std::endl;
+    // Lay out the output tiles over the duplicated desktop and create one texture per tile
+    DXGI_OUTDUPL_DESC duplicationDesc;
+    g_duplication->GetDesc(&duplicationDesc);
+    const TileLayout* layout = g_tileLayout.Get(duplicationDesc.ModeDesc.Width, duplicationDesc.ModeDesc.Height, g_tileConfig);
+    if (!layout) {
+        std::cerr << "Tile layout " << g_tileConfig.columns << "x" << g_tileConfig.rows << " does not fit a "
+            << duplicationDesc.ModeDesc.Width << "x" << duplicationDesc.ModeDesc.Height << " desktop." << std::endl;
         return false;
     }
 
-    hr = g_device->CreateTexture2D(&halfDesc, nullptr, &g_rightTexture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create right texture. HRESULT: " << std::hex << hr << std::endl;
+    if (!CreateTileTextures(*layout)) {
         return false;
     }
 
@@ -422,24 +1181,24 @@ struct Vertex {
 void InitializeStagingTextures() {
     HRESULT hr;
     D3D11_TEXTURE2D_DESC desc = {};
-    g_leftTexture->GetDesc(&desc);
+    g_tileTextures[0]->GetDesc(&desc);
 
-    // Create the staging texture for the left texture
+    // One CPU-readable copy per tile texture
     D3D11_TEXTURE2D_DESC stagingDesc = desc;
     stagingDesc.Usage = D3D11_USAGE_STAGING;
     stagingDesc.BindFlags = 0;
     stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
-    hr = g_device->CreateTexture2D(&stagingDesc, nullptr, &g_leftStagingTexture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create left staging texture. HRESULT: " << std::hex << hr << std::endl;
+    g_tileStagingTextures.assign(g_tileTextures.size(), nullptr);
+    for (size_t i = 0; i < g_tileStagingTextures.size(); ++i) {
+        hr = g_device->CreateTexture2D(&stagingDesc, nullptr, &g_tileStagingTextures[i]);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create staging texture for tile " << i << ". HRESULT: " << std::hex << hr << std::endl;
+        }
     }
 
-    // Create the staging texture for the right texture
-    hr = g_device->CreateTexture2D(&stagingDesc, nullptr, &g_rightStagingTexture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create right staging texture. HRESULT: " << std::hex << hr << std::endl;
-    }
+    g_leftStagingTexture = g_tileStagingTextures[0];
+    g_rightStagingTexture = g_tileStagingTextures.size() > 1 ? g_tileStagingTextures[1] : nullptr;
 
     std::cout << "Created Staging Textures " << std::endl;
 }
@@ -477,23 +1236,27 @@ void CreateFullScreenQuad() {
 
 
 void CreateShaderResourceViews() {
-    HRESULT hr;
+    g_srvBackend.device = g_device.Get();
+    uint64_t created = g_srvCache.Stats().created;
 
     // Left texture
-    hr = g_device->CreateShaderResourceView(g_leftTexture.Get(), nullptr, &g_leftTextureSRV);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create SRV for left texture. HRESULT: " << std::hex << hr << std::endl;
+    D3D11ShaderResourceViewBackend::View* view = g_srvCache.Get(g_leftTexture.Get());
+    g_leftTextureSRV = view ? *view : nullptr;
+    if (!view) {
+        std::cerr << "Failed to create SRV for left texture." << std::endl;
     }
-    else {
+    else if (g_srvCache.Stats().created != created) {
         std::cout << "Shader resource view created for left texture." << std::endl;
     }
 
     // Right texture
-    hr = g_device->CreateShaderResourceView(g_rightTexture.Get(), nullptr, &g_rightTextureSRV);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create SRV for right texture. HRESULT: " << std::hex << hr << std::endl;
+    created = g_srvCache.Stats().created;
+    view = g_srvCache.Get(g_rightTexture.Get());
+    g_rightTextureSRV = view ? *view : nullptr;
+    if (!view) {
+        std::cerr << "Failed to create SRV for right texture." << std::endl;
     }
-    else {
+    else if (g_srvCache.Stats().created != created) {
         std::cout << "Shader resource view created for right texture." << std::endl;
     }
 }
@@ -646,19 +1409,21 @@ void RenderToMonitors(ComPtr<IDXGISwapChain> leftSwapChain, ComPtr<IDXGISwapChai
 
 
 
+    // Buffer 0 is the same texture every frame, so each swap chain's view is made once
+    g_rtvBackend.device = g_device.Get();
+
     // Render the left texture
     ComPtr<ID3D11Texture2D> leftBackBuffer;
     hr = leftSwapChain->GetBuffer(0, IID_PPV_ARGS(&leftBackBuffer));
     if (SUCCEEDED(hr)) {
-        ComPtr<ID3D11RenderTargetView> leftRTV;
-        hr = g_device->CreateRenderTargetView(leftBackBuffer.Get(), nullptr, &leftRTV);
-        if (SUCCEEDED(hr)) {
+        D3D11RenderTargetViewBackend::View* leftRTV = g_rtvCache.Get(leftBackBuffer.Get());
+        if (leftRTV) {
             // Set the render target view for the left swap chain
-            g_context->OMSetRenderTargets(1, leftRTV.GetAddressOf(), nullptr);
+            g_context->OMSetRenderTargets(1, leftRTV->GetAddressOf(), nullptr);
 
             // Optional: clear the render target before drawing
             const float clearColor[4] = { 0.2f, 0.2f, 0.2f, 1.0f }; // Gray
-            g_context->ClearRenderTargetView(leftRTV.Get(), clearColor);
+            g_context->ClearRenderTargetView(leftRTV->Get(), clearColor);
 
             // Additional rendering steps (binding shaders, drawing, etc.)
             // g_context->Draw(...);
@@ -668,7 +1433,7 @@ void RenderToMonitors(ComPtr<IDXGISwapChain> leftSwapChain, ComPtr<IDXGISwapChai
             std::cout << "Left texture presented." << std::endl;
         }
         else {
-            std::cerr << "Failed to create Render Target View for Left texture. HRESULT: " << std::hex << hr << std::endl;
+            std::cerr << "Failed to create Render Target View for Left texture." << std::endl;
         }
     }
     else {
@@ -679,15 +1444,14 @@ void RenderToMonitors(ComPtr<IDXGISwapChain> leftSwapChain, ComPtr<IDXGISwapChai
     ComPtr<ID3D11Texture2D> rightBackBuffer;
     hr = rightSwapChain->GetBuffer(0, IID_PPV_ARGS(&rightBackBuffer));
     if (SUCCEEDED(hr)) {
-        ComPtr<ID3D11RenderTargetView> rightRTV;
-        hr = g_device->CreateRenderTargetView(rightBackBuffer.Get(), nullptr, &rightRTV);
-        if (SUCCEEDED(hr)) {
+        D3D11RenderTargetViewBackend::View* rightRTV = g_rtvCache.Get(rightBackBuffer.Get());
+        if (rightRTV) {
             // Set the render target view for the right swap chain
-            g_context->OMSetRenderTargets(1, rightRTV.GetAddressOf(), nullptr);
+            g_context->OMSetRenderTargets(1, rightRTV->GetAddressOf(), nullptr);
 
             // Optional: clear the render target before drawing
             const float clearColor[4] = { 0.2f, 0.2f, 0.2f, 1.0f }; // Gray
-            g_context->ClearRenderTargetView(rightRTV.Get(), clearColor);
+            g_context->ClearRenderTargetView(rightRTV->Get(), clearColor);
 
             // Additional rendering steps (binding shaders, drawing, etc.)
             // g_context->Draw(...);
@@ -697,7 +1461,7 @@ void RenderToMonitors(ComPtr<IDXGISwapChain> leftSwapChain, ComPtr<IDXGISwapChai
             std::cout << "Right texture presented." << std::endl;
         }
         else {
-            std::cerr << "Failed to create Render Target View for Right texture. HRESULT: " << std::hex << hr << std::endl;
+            std::cerr << "Failed to create Render Target View for Right texture." << std::endl;
         }
     }
     else {
@@ -712,11 +1476,59 @@ void RenderToMonitors(ComPtr<IDXGISwapChain> leftSwapChain, ComPtr<IDXGISwapChai
 
 
 
+// Fetch the move and dirty rects that came with the last acquired frame
+bool GetFrameUpdateRects(const DXGI_OUTDUPL_FRAME_INFO& frameInfo, std::vector<DirtyRect>& dirtyRects, std::vector<MoveRect>& moveRects) {
+    dirtyRects.clear();
+    moveRects.clear();
+
+    // Pointer-only updates carry no metadata; nothing on the desktop changed
+    if (frameInfo.TotalMetadataBufferSize == 0) {
+        return true;
+    }
+
+    if (g_frameMetadata.size() < frameInfo.TotalMetadataBufferSize) {
+        g_frameMetadata.resize(frameInfo.TotalMetadataBufferSize);
+    }
+    UINT bufferSize = static_cast<UINT>(g_frameMetadata.size());
+
+    // Move rects go first in the buffer, dirty rects follow
+    UINT moveBytes = 0;
+    DXGI_OUTDUPL_MOVE_RECT* moves = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(g_frameMetadata.data());
+    HRESULT hr = g_duplication->GetFrameMoveRects(bufferSize, moves, &moveBytes);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to get frame move rects. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+    for (UINT i = 0; i < moveBytes / sizeof(DXGI_OUTDUPL_MOVE_RECT); ++i) {
+        const RECT& dest = moves[i].DestinationRect;
+        moveRects.push_back({ moves[i].SourcePoint.x, moves[i].SourcePoint.y, { dest.left, dest.top, dest.right, dest.bottom } });
+    }
+
+    UINT dirtyBytes = 0;
+    RECT* dirty = reinterpret_cast<RECT*>(g_frameMetadata.data() + moveBytes);
+    hr = g_duplication->GetFrameDirtyRects(bufferSize - moveBytes, dirty, &dirtyBytes);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to get frame dirty rects. HRESULT: " << std::hex << hr << std::endl;
+        return false;
+    }
+    for (UINT i = 0; i < dirtyBytes / sizeof(RECT); ++i) {
+        dirtyRects.push_back({ dirty[i].left, dirty[i].top, dirty[i].right, dirty[i].bottom });
+    }
+    return true;
+}
+
 // Function to capture a frame
 bool CaptureFrame() {
+    static int frameIndex = 0;
+    FrameTrace::SetCurrentFrame(frameIndex);
+
     ComPtr<IDXGIResource> desktopResource;
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
-    HRESULT hr = g_duplication->AcquireNextFrame(500, &frameInfo, &desktopResource);
+    HRESULT hr;
+    {
+        FrameTraceScope trace("acquire");
+        hr = g_duplication->AcquireNextFrame(500, &frameInfo, &desktopResource);
+    }
     if (FAILED(hr)) {
         if (hr == DXGI_ERROR_WAIT_TIMEOUT) return true; // No new frame
         std::cerr << "Failed to acquire next frame. HRESULT: " << std::hex << hr << std::endl;
@@ -732,33 +1544,518 @@ bool CaptureFrame() {
         return false;
     }
 
+    // The plan is only rebuilt when the desktop size changes
+    D3D11_TEXTURE2D_DESC capturedDesc;
+    capturedTexture->GetDesc(&capturedDesc);
+    const TileLayout* layout = g_tileLayout.Get(capturedDesc.Width, capturedDesc.Height, g_tileConfig);
+    if (!layout) {
+        std::cerr << "Tile layout does not fit the captured " << capturedDesc.Width << "x" << capturedDesc.Height << " frame." << std::endl;
+        g_duplication->ReleaseFrame();
+        return false;
+    }
 
+    // Desktop mode changed: recreate the tile textures and start again from a full frame
+    if (!TileTexturesMatch(*layout)) {
+        ReleaseReadbackRing();
+        if (!CreateTileTextures(*layout)) {
+            g_duplication->ReleaseFrame();
+            return false;
+        }
+        g_haveBaseFrame = false;
+    }
 
-    g_context->CopySubresourceRegion(g_leftTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &leftBox);
-    g_context->CopySubresourceRegion(g_rightTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &rightBox);
+    // Once the tile textures hold a full frame, only what changed is copied; the readback
+    // ring gets the same rects so it can patch its slot instead of copying the whole frame
+    static std::vector<DirtyRect> dirtyRects;
+    static std::vector<MoveRect> moveRects;
+    static std::vector<DirtyRect> tileRegions;
+    static std::vector<std::vector<DirtyRect>> tileUpdates;
+    static std::vector<std::vector<DirtyRect>> frameUpdates;
+    const std::vector<DirtyRect>* changed = nullptr;
+    if (g_incrementalCapture && g_haveBaseFrame && GetFrameUpdateRects(frameInfo, dirtyRects, moveRects)) {
+        if (g_rectStream.is_open()) {
+            RectFrame recorded;
+            recorded.frameIndex = frameIndex;
+            recorded.dirtyRects = dirtyRects;
+            recorded.moveRects = moveRects;
+            WriteRectFrame(g_rectStream, recorded);
+        }
 
-    std::cout << "Frame split successfully into left and right textures." << std::endl;
+        tileRegions.clear();
+        for (const TileCopy& tile : layout->copies) {
+            tileRegions.push_back({ (int32_t)tile.left, (int32_t)tile.top, (int32_t)tile.right, (int32_t)tile.bottom });
+        }
+        PlanIncrementalCopy(dirtyRects, moveRects, tileRegions.data(), tileRegions.size(), tileUpdates);
+        AccumulateIncrementalStats(g_incrementalStats, tileRegions.data(), tileRegions.size(), tileUpdates);
+
+        const DirtyRect desktop = { 0, 0, (int32_t)capturedDesc.Width, (int32_t)capturedDesc.Height };
+        PlanIncrementalCopy(dirtyRects, moveRects, &desktop, 1, frameUpdates);
+        changed = &frameUpdates[0];
+
+        FrameTraceScope trace("copy");
+        for (const TileCopy& tile : layout->copies) {
+            for (const DirtyRect& r : tileUpdates[tile.output]) {
+                D3D11_BOX box = { tile.left + r.left, tile.top + r.top, 0, tile.left + r.right, tile.top + r.bottom, 1 };
+                g_context->CopySubresourceRegion(g_tileTextures[tile.output].Get(), 0, r.left, r.top, 0, capturedTexture.Get(), 0, &box);
+            }
+        }
+    }
+    else {
+        FrameTraceScope trace("copy");
+        for (const TileCopy& tile : layout->copies) {
+            D3D11_BOX box = TileSourceBox(tile);
+            g_context->CopySubresourceRegion(g_tileTextures[tile.output].Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &box);
+        }
+        g_haveBaseFrame = g_incrementalCapture;
+    }
+
+    // One readback of the whole frame, queued before the duplication surface is released;
+    // PNGs are written from tile views into it as the copy lands
+    bool queued = false;
+    if (g_readbackRing || CreateReadbackRing(capturedDesc, *layout)) {
+        FrameTraceScope trace("map");
+        queued = g_readbackRing->Submit(capturedTexture.Get(), frameIndex, frameInfo.LastPresentTime.QuadPart, changed);
+    }
 
     g_duplication->ReleaseFrame();
 
-    // Save left and right textures as PNG files
+    if (!queued) {
+        std::cerr << "Failed to queue readback of frame " << frameIndex << std::endl;
+    }
+    else if (!g_asyncReadback) {
+        g_readbackRing->Flush();
+    }
 
-    // Commenting out image creation for now
+    frameIndex++;
 
-    static int frameIndex = 0;
-    wchar_t leftFilename[128];
-    wchar_t rightFilename[128];
-    swprintf_s(leftFilename, L"left_frame_%d.png", frameIndex);
-    swprintf_s(rightFilename, L"right_frame_%d.png", frameIndex);
 
-    SaveTextureAsPNGStandalone(g_device.Get(), g_context.Get(), g_leftTexture.Get(), leftFilename);
-    SaveTextureAsPNGStandalone(g_device.Get(), g_context.Get(), g_rightTexture.Get(), rightFilename);
 
-    frameIndex++;
 
+    return true;
+}
+
+// GPU resources owned by one pipeline slot, so frames in flight never share a texture
+struct PipelineSlotResources {
+    ComPtr<ID3D11Texture2D> staging;    // Full captured frame; tiles are views into its mapping
+    bool mapped = false;                // Stays mapped until the slot comes round again
+};
+
+// Run capture as a staged pipeline instead of doing every step back to back in CaptureFrame
+bool RunCapturePipeline(uint64_t frameCount, size_t slotCount = 4, size_t queueDepth = 2) {
+    DXGI_OUTDUPL_DESC duplicationDesc;
+    g_duplication->GetDesc(&duplicationDesc);
+    const TileLayout* layout = g_tileLayout.Get(duplicationDesc.ModeDesc.Width, duplicationDesc.ModeDesc.Height, g_tileConfig);
+    if (!layout) {
+        std::cerr << "Tile layout does not fit the duplicated desktop." << std::endl;
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC stagingDesc = {};
+    stagingDesc.Width = layout->sourceWidth;
+    stagingDesc.Height = layout->sourceHeight;
+    stagingDesc.MipLevels = 1;
+    stagingDesc.ArraySize = 1;
+    stagingDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    stagingDesc.SampleDesc.Count = 1;
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
+    std::vector<PipelineSlotResources> slots(slotCount);
+    for (PipelineSlotResources& slot : slots) {
+        HRESULT hr = g_device->CreateTexture2D(&stagingDesc, nullptr, &slot.staging);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create pipeline staging texture. HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+    }
 
+    uint64_t acquired = 0;
+    FramePipeline* running = nullptr;   // Set before the stages start
+
+    std::vector<PipelineStage> stages;
+
+    // Hold the duplication frame only as long as it takes to queue a GPU copy. An idle
+    // desktop times out every 500 ms, and a stop request ends the wait there.
+    stages.push_back({ "acquire", [&](PipelineFrame& frame) {
+        if (acquired >= frameCount) return false;
+        while (true) {
+            ComPtr<IDXGIResource> desktopResource;
+            DXGI_OUTDUPL_FRAME_INFO frameInfo;
+            HRESULT hr = g_duplication->AcquireNextFrame(500, &frameInfo, &desktopResource);
+            if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
+                if (running->StopRequested()) return false;
+                continue;
+            }
+            if (FAILED(hr)) {
+                std::cerr << "Failed to acquire next frame. HRESULT: " << std::hex << hr << std::endl;
+                return false;
+            }
+
+            ComPtr<ID3D11Texture2D> capturedTexture;
+            hr = desktopResource.As(&capturedTexture);
+            if (SUCCEEDED(hr)) {
+                PipelineSlotResources& slot = slots[frame.slot];
+                std::lock_guard<std::mutex> lock(g_contextMutex);
+                if (slot.mapped) {
+                    g_context->Unmap(slot.staging.Get(), 0);
+                    slot.mapped = false;
+                }
+                g_context->CopyResource(slot.staging.Get(), capturedTexture.Get());
+                g_context->Flush();     // Submit the copy now; readback only polls for it
+            }
+            g_duplication->ReleaseFrame();
+            if (FAILED(hr)) {
+                std::cerr << "Failed to get captured texture. HRESULT: " << std::hex << hr << std::endl;
+                return false;
+            }
 
+            frame.frameIndex = acquired++;
+            frame.timestamp = frameInfo.LastPresentTime.QuadPart;
+            frame.width = layout->sourceWidth;
+            frame.height = layout->sourceHeight;
+            frame.tileWidth = layout->tileWidth;
+            frame.tileHeight = layout->tileHeight;
+            return true;
+        }
+    } });
+
+    // One Map of the whole frame; encode reads the tiles straight out of the mapping. The map
+    // is polled with DO_NOT_WAIT and the context lock dropped between polls, so the acquire
+    // stage can queue the next copy while this one is still on the GPU.
+    stages.push_back({ "readback", [&](PipelineFrame& frame) {
+        PipelineSlotResources& slot = slots[frame.slot];
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        HRESULT hr;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(g_contextMutex);
+                hr = g_context->Map(slot.staging.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedResource);
+                if (SUCCEEDED(hr)) slot.mapped = true;
+            }
+            if (hr != DXGI_ERROR_WAS_STILL_DRAWING) break;
+            if (running->StopRequested()) return false;
+            std::this_thread::yield();
+        }
+        if (FAILED(hr)) {
+            std::cerr << "Failed to map pipeline staging texture. HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+        frame.frameView = ImageView(static_cast<const uint8_t*>(mappedResource.pData), frame.width, frame.height, mappedResource.RowPitch);
+        BuildTileViews(frame.frameView, *layout, frame.tileViews);
+        return true;
+    } });
+
+    std::vector<std::unique_ptr<ScreenRecordingWriter>> streams;
+    if (g_streamOutput && !OpenTileStreams(*layout, streams)) {
+        return false;
+    }
+    // Frames reach the encode stage in order, so it can own the per-tile delta state.
+    // The write stage sets restartDeltas when it drops a frame the encoders have already
+    // taken as their reference.
+    std::vector<ScreenDeltaEncoder> deltaEncoders(streams.size(), ScreenDeltaEncoder(g_keyframeInterval));
+    std::atomic<bool> restartDeltas{ false };
+    bool awaitingKeyframes = false;     // Write stage only
+
+    stages.push_back({ "encode", [&](PipelineFrame& frame) {
+        frame.encoded.resize(frame.tileViews.size());
+        if (!streams.empty()) {
+            if (restartDeltas.exchange(false)) {
+                for (ScreenDeltaEncoder& encoder : deltaEncoders) encoder.Reset();
+            }
+            for (size_t t = 0; t < frame.tileViews.size(); ++t) {
+                frame.encoded[t].clear();
+                deltaEncoders[t].Encode(frame.tileViews[t], frame.encoded[t]);
+            }
+            return true;
+        }
+
+        static thread_local bool comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+        if (!comInitialized) return false;
+        for (size_t t = 0; t < frame.tileViews.size(); ++t) {
+            const ImageView& view = frame.tileViews[t];
+            if (!EncodePixelsAsPNGToMemory(view.data, view.width, view.height, static_cast<UINT>(view.rowPitch), frame.encoded[t])) {
+                return false;
+            }
+        }
+        return true;
+    } });
+
+    stages.push_back({ "write", [&](PipelineFrame& frame) {
+        if (!streams.empty()) {
+            ScreenStreamFrameInfo info;
+            info.frameIndex = frame.frameIndex;
+            info.timestamp = frame.timestamp;
+            // Every tile takes the frame or none does, so the recordings stay in step. Deltas
+            // encoded against a dropped frame are dropped too, until all tiles are keyframes again.
+            bool fits = true;
+            bool keyframes = true;
+            for (size_t t = 0; t < frame.encoded.size(); ++t) {
+                fits = fits && streams[t]->CanWriteEncodedFrame(frame.encoded[t].size());
+                keyframes = keyframes && !frame.encoded[t].empty() && frame.encoded[t][0] == kScreenFrameKey;
+            }
+            if (keyframes) awaitingKeyframes = false;
+            if (!fits || awaitingKeyframes) {
+                for (size_t t = 0; t < frame.encoded.size(); ++t) streams[t]->DropFrame();
+                if (!awaitingKeyframes) {
+                    std::cerr << "Dropped frame " << frame.frameIndex << ": the tile recordings are not keeping up" << std::endl;
+                    awaitingKeyframes = true;
+                    restartDeltas = true;
+                }
+                return false;
+            }
+            bool written = true;
+            for (size_t t = 0; t < frame.encoded.size(); ++t) {
+                if (!streams[t]->WriteEncodedFrame(frame.encoded[t].data(), frame.encoded[t].size(), info)) {
+                    std::cerr << "Failed to append frame " << frame.frameIndex << " to tile recording " << t << std::endl;
+                    written = false;
+                    continue;
+                }
+                g_recordingIndex.AddRecorded(static_cast<uint16_t>(t), streams[t]->LastFrame());
+            }
+            if (!written) {
+                awaitingKeyframes = true;
+                restartDeltas = true;
+            }
+            return written;
+        }
+        for (size_t t = 0; t < frame.encoded.size(); ++t) {
+            wchar_t tileName[32];
+            wchar_t filename[128];
+            TileFilePrefix(*layout, t, tileName, 32);
+            swprintf_s(filename, L"%s_frame_%llu.png", tileName, static_cast<unsigned long long>(frame.frameIndex));
+            std::ofstream file(filename, std::ios::binary);
+            if (!file) {
+                std::wcerr << L"Failed to open " << filename << L" for writing." << std::endl;
+                return false;
+            }
+            file.write(reinterpret_cast<const char*>(frame.encoded[t].data()), frame.encoded[t].size());
+        }
+        return true;
+    } });
+
+    FramePipeline pipeline(std::move(stages), slotCount, queueDepth);
+    running = &pipeline;
+    const std::vector<PipelineStageStats>& stats = pipeline.Run();
+    for (PipelineSlotResources& slot : slots) {
+        if (slot.mapped) g_context->Unmap(slot.staging.Get(), 0);
+    }
+    CloseTileStreams(streams);
+    CloseSessionIndex();
+
+    std::cout << "Pipeline wrote " << pipeline.CompletedFrames() << " frames at "
+        << pipeline.CompletedFrames() / pipeline.ElapsedSeconds() << " fps" << std::endl;
+    for (const PipelineStageStats& stage : stats) {
+        std::cout << "  " << stage.name << ": " << (stage.frames ? stage.busyMs / stage.frames : 0.0)
+            << " ms/frame, blocked " << stage.blockedMs << " ms, dropped " << stage.dropped << std::endl;
+    }
+    return true;
+}
+
+// One desktop duplication on its own device, read back to CPU memory each frame.
+// Each output gets a device on the adapter it is attached to, so no context is shared.
+class DxgiOutputSource : public OutputFrameSource {
+public:
+    DxgiOutputSource(ComPtr<IDXGIAdapter1> adapter, ComPtr<IDXGIOutput> output, uint32_t timeoutMs = 16)
+        : m_adapter(adapter), m_output(output), m_timeoutMs(timeoutMs) {}
+
+    bool Initialize() {
+        DXGI_OUTPUT_DESC outputDesc;
+        HRESULT hr = m_output->GetDesc(&outputDesc);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get output description. HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+        char name[64];
+        WideCharToMultiByte(CP_UTF8, 0, outputDesc.DeviceName, -1, name, sizeof(name), nullptr, nullptr);
+        m_desc.name = name;
+        m_desc.left = outputDesc.DesktopCoordinates.left;
+        m_desc.top = outputDesc.DesktopCoordinates.top;
+        m_desc.width = outputDesc.DesktopCoordinates.right - outputDesc.DesktopCoordinates.left;
+        m_desc.height = outputDesc.DesktopCoordinates.bottom - outputDesc.DesktopCoordinates.top;
+
+        // An explicit adapter requires D3D_DRIVER_TYPE_UNKNOWN
+        hr = D3D11CreateDevice(m_adapter.Get(), D3D_DRIVER_TYPE_UNKNOWN, nullptr, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+            nullptr, 0, D3D11_SDK_VERSION, &m_device, nullptr, &m_context);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create D3D11 device for " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+
+        ComPtr<IDXGIOutput1> output1;
+        hr = m_output.As(&output1);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get IDXGIOutput1 for " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+        hr = output1->DuplicateOutput(m_device.Get(), &m_duplication);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to duplicate " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+
+        DXGI_OUTDUPL_DESC duplicationDesc;
+        m_duplication->GetDesc(&duplicationDesc);
+        D3D11_TEXTURE2D_DESC stagingDesc = {};
+        stagingDesc.Width = duplicationDesc.ModeDesc.Width;
+        stagingDesc.Height = duplicationDesc.ModeDesc.Height;
+        stagingDesc.MipLevels = 1;
+        stagingDesc.ArraySize = 1;
+        stagingDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        stagingDesc.SampleDesc.Count = 1;
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        hr = m_device->CreateTexture2D(&stagingDesc, nullptr, &m_staging);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create staging texture for " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return false;
+        }
+        m_width = stagingDesc.Width;
+        m_height = stagingDesc.Height;
+        return true;
+    }
+
+    const OutputDesc& Desc() const override { return m_desc; }
+
+    OutputPollResult Poll(OutputFrame& frame) override {
+        ComPtr<IDXGIResource> desktopResource;
+        DXGI_OUTDUPL_FRAME_INFO frameInfo;
+        HRESULT hr = m_duplication->AcquireNextFrame(m_timeoutMs, &frameInfo, &desktopResource);
+        if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
+            frame.timestampNs = m_clock.NowNs();
+            return OutputPollResult::Idle;
+        }
+        if (FAILED(hr)) {
+            std::cerr << "Failed to acquire next frame on " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return OutputPollResult::Error;
+        }
+
+        // Pointer-only updates carry no new image
+        if (frameInfo.LastPresentTime.QuadPart == 0) {
+            m_duplication->ReleaseFrame();
+            frame.timestampNs = m_clock.NowNs();
+            return OutputPollResult::Idle;
+        }
+
+        ComPtr<ID3D11Texture2D> capturedTexture;
+        hr = desktopResource.As(&capturedTexture);
+        if (SUCCEEDED(hr)) {
+            m_context->CopyResource(m_staging.Get(), capturedTexture.Get());
+        }
+        m_duplication->ReleaseFrame();
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get captured texture on " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return OutputPollResult::Error;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        hr = m_context->Map(m_staging.Get(), 0, D3D11_MAP_READ, 0, &mappedResource);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to map staging texture on " << m_desc.name << ". HRESULT: " << std::hex << hr << std::endl;
+            return OutputPollResult::Error;
+        }
+
+        // Reuse the buffer unless a snapshot still holds it
+        size_t rowPitch = static_cast<size_t>(m_width) * 4;
+        if (!m_buffer || m_buffer.use_count() > 1) {
+            m_buffer = std::make_shared<std::vector<uint8_t>>(rowPitch * m_height);
+        }
+        const BYTE* source = static_cast<const BYTE*>(mappedResource.pData);
+        for (UINT y = 0; y < m_height; ++y) {
+            memcpy(m_buffer->data() + y * rowPitch, source + y * mappedResource.RowPitch, rowPitch);
+        }
+        m_context->Unmap(m_staging.Get(), 0);
+
+        frame.frameIndex = m_frameIndex++;
+        frame.timestampNs = QpcToNanoseconds(frameInfo.LastPresentTime.QuadPart);
+        frame.width = m_width;
+        frame.height = m_height;
+        frame.rowPitch = static_cast<uint32_t>(rowPitch);
+        frame.pixels = m_buffer;
+        return OutputPollResult::Frame;
+    }
+
+private:
+    ComPtr<IDXGIAdapter1> m_adapter;
+    ComPtr<IDXGIOutput> m_output;
+    ComPtr<ID3D11Device> m_device;
+    ComPtr<ID3D11DeviceContext> m_context;
+    ComPtr<IDXGIOutputDuplication> m_duplication;
+    ComPtr<ID3D11Texture2D> m_staging;
+    std::shared_ptr<std::vector<uint8_t>> m_buffer;
+    QpcPacerClock m_clock;              // Same clock as LastPresentTime, for idle watermarks
+    OutputDesc m_desc;
+    UINT m_width = 0;
+    UINT m_height = 0;
+    uint32_t m_timeoutMs;
+    uint64_t m_frameIndex = 0;
+};
+
+// Every desktop-attached output of every adapter, not just EnumOutputs(0) of the first
+std::vector<std::unique_ptr<OutputFrameSource>> CreateAllOutputSources() {
+    std::vector<std::unique_ptr<OutputFrameSource>> sources;
+    ComPtr<IDXGIFactory1> factory;
+    HRESULT hr = CreateDXGIFactory1(__uuidof(IDXGIFactory1), reinterpret_cast<void**>(factory.GetAddressOf()));
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create DXGI factory. HRESULT: " << std::hex << hr << std::endl;
+        return sources;
+    }
+
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT a = 0; factory->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; ++a) {
+        ComPtr<IDXGIOutput> output;
+        for (UINT o = 0; adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; ++o) {
+            DXGI_OUTPUT_DESC outputDesc;
+            if (FAILED(output->GetDesc(&outputDesc)) || !outputDesc.AttachedToDesktop) continue;
+
+            std::unique_ptr<DxgiOutputSource> source(new DxgiOutputSource(adapter, output));
+            if (source->Initialize()) {
+                std::cout << "Capturing " << source->Desc().name << " (adapter " << a << ", output " << o << ") "
+                    << source->Desc().width << "x" << source->Desc().height << std::endl;
+                sources.push_back(std::move(source));
+            }
+        }
+    }
+    return sources;
+}
+
+// Capture all outputs concurrently and save each matched snapshot as one composite PNG
+bool RunMultiOutputCapture(uint64_t snapshotCount) {
+    std::vector<std::unique_ptr<OutputFrameSource>> sources = CreateAllOutputSources();
+    if (sources.empty()) {
+        std::cerr << "No outputs could be duplicated." << std::endl;
+        return false;
+    }
+
+    std::vector<OutputDesc> outputs;
+    for (const std::unique_ptr<OutputFrameSource>& source : sources) {
+        outputs.push_back(source->Desc());
+    }
+
+    MultiOutputCapture capture(std::move(sources), g_snapshotToleranceNs);
+    capture.Start();
+
+    CompositeSnapshot snapshot;
+    std::vector<uint8_t> composite;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t saved = 0;
+    while (saved < snapshotCount && capture.NextSnapshot(snapshot)) {
+        ComposeSnapshot(snapshot, outputs, composite, width, height);
+        wchar_t filename[128];
+        swprintf_s(filename, L"snapshot_%llu.png", static_cast<unsigned long long>(snapshot.index));
+        SavePixelsAsPNG(composite.data(), width, height, width * 4, filename);
+        saved++;
+    }
+    capture.Stop();
+    capture.Wait();
+
+    for (const OutputCaptureStats& output : capture.OutputStats()) {
+        std::cout << output.name << ": " << output.frames << " frames, " << output.idlePolls << " idle polls"
+            << (output.failed ? ", failed" : "") << std::endl;
+    }
+    SnapshotMatcherStats stats = capture.MatcherStats();
+    std::cout << "Snapshots: " << stats.snapshots << ", held " << stats.held << ", coalesced " << stats.coalesced
+        << ", skew mean " << stats.skew.MeanMs() << " ms, max " << stats.skew.MaxMs() << " ms" << std::endl;
     return true;
 }
 
@@ -777,7 +2074,24 @@ int main() {
 
 
     InitializeCaptureResources();
-    CaptureFrame();
+    FrameTrace::Enable(g_frameTrace);
+    FrameTrace::SetThreadName("main");
+    if (g_incrementalCapture && g_recordRectStream) {
+        g_rectStream.open("rect_stream.txt");
+    }
+    if (g_multiOutputCapture) {
+        RunMultiOutputCapture(600);
+    }
+    else if (g_pipelinedCapture) {
+        RunCapturePipeline(600);
+    }
+    else {
+        CaptureFrame();
+        ReleaseReadbackRing();
+    }
+    if (g_frameTrace && FrameTrace::WriteChromeTrace("frame_trace.json")) {
+        std::cout << "Wrote frame_trace.json (" << FrameTrace::EventCount() << " events)" << std::endl;
+    }
    
 
     //InitializeShaders();
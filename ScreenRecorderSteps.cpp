@@ -6,6 +6,9 @@
 #include <fstream>
 #include <d3dcompiler.h>
 #pragma comment(lib, "d3dcompiler.lib")
+#include "FramePacer.h"
+#include "TileLayout.h"
+#include "ViewCache.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -29,8 +32,17 @@ Microsoft::WRL::ComPtr<ID3D11SamplerState> g_sampler;
 
 
 
-D3D11_BOX leftBox = { 0, 0, 0, 2560, 1440, 1 };  // Adjust resolution as needed
-D3D11_BOX rightBox = { 2560, 0, 0, 5120, 1440, 1 };
+// Views of the left and right textures, kept until a texture is replaced
+D3D11ShaderResourceViewBackend g_srvBackend;
+D3D11ShaderResourceViewCache g_srvCache(g_srvBackend);
+
+// Split layout - left and right halves by default, sized from the captured desktop
+TileLayoutConfig g_tileConfig;
+TileLayoutCache g_tileLayout;
+
+// Output pacing - wait for the next tick instead of spinning on AcquireNextFrame
+QpcPacerClock g_pacerClock;
+FramePacer g_pacer({ 60.0, PacingPolicy::DuplicateLast }, g_pacerClock);
 
 //Define vertex data for full screen quad
 struct Vertex {
@@ -149,10 +161,20 @@ void CreateRenderTargetViews() {
 
 
 void CreateSRVs() {
-    // Create Shader Resource Views (SRVs) for the textures
-    g_device->CreateShaderResourceView(g_leftTexture.Get(), nullptr, &g_leftSRV);
-    g_device->CreateShaderResourceView(g_rightTexture.Get(), nullptr, &g_rightSRV);
-    std::cout << "Left and right SRVs created from g_left and right textures!" << std::endl;
+    // Shader Resource Views (SRVs) for the textures come from the cache: made on the first
+    // frame and again only after CaptureFrame replaces a texture
+    g_srvBackend.device = g_device.Get();
+    uint64_t created = g_srvCache.Stats().created;
+    D3D11ShaderResourceViewBackend::View* left = g_srvCache.Get(g_leftTexture.Get());
+    D3D11ShaderResourceViewBackend::View* right = g_srvCache.Get(g_rightTexture.Get());
+    g_leftSRV = left ? *left : nullptr;
+    g_rightSRV = right ? *right : nullptr;
+    if (!left || !right) {
+        std::cerr << "Failed to create SRVs for the left and right textures." << std::endl;
+    }
+    else if (g_srvCache.Stats().created != created) {
+        std::cout << "Left and right SRVs created from g_left and right textures!" << std::endl;
+    }
 }
 
 bool CreateSwapChain(HWND hwnd) {
@@ -413,7 +435,7 @@ bool CaptureFrame() {
     ComPtr<IDXGIResource> desktopResource;
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
 
-    HRESULT hr = g_duplication->AcquireNextFrame(500, &frameInfo, &desktopResource);
+    HRESULT hr = g_duplication->AcquireNextFrame(g_pacer.AcquireTimeoutMs(), &frameInfo, &desktopResource);
     if (FAILED(hr)) {
         if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
             return true; // No new frame
@@ -437,46 +459,44 @@ bool CaptureFrame() {
     D3D11_TEXTURE2D_DESC desc;
     capturedTexture->GetDesc(&desc);
 
-    // Ensure the texture dimensions are even to properly split
-    if (desc.Width % 2 != 0) {
-        desc.Width++;  // Adjust to even width
+    // The left and right swap chains show tiles 0 and 1, so the layout must produce exactly two
+    const TileLayout* layout = g_tileLayout.Get(desc.Width, desc.Height, g_tileConfig);
+    if (!layout || layout->TileCount() != 2) {
+        std::cerr << "Tile layout does not split a " << desc.Width << "x" << desc.Height << " desktop into left and right textures." << std::endl;
+        g_duplication->ReleaseFrame();
+        return false;
     }
 
-    // Create the left and right textures only once (or resize them as needed)
-    if (!g_leftTexture) {
-        // Create the left texture (half the width of the captured frame)
-        desc.Width /= 2;  // Set width to half
-        hr = g_device->CreateTexture2D(&desc, nullptr, &g_leftTexture);
-        if (FAILED(hr)) {
-            std::cerr << "Failed to create left texture. HRESULT: " << std::hex << hr << std::endl;
-            g_duplication->ReleaseFrame();
-            return false;
+    // Create the left and right textures once, and again only if the desktop size changes
+    D3D11_TEXTURE2D_DESC tileDesc = desc;
+    tileDesc.Width = layout->tileWidth;
+    tileDesc.Height = layout->tileHeight;
+    ComPtr<ID3D11Texture2D>* tileTextures[2] = { &g_leftTexture, &g_rightTexture };
+    for (const TileCopy& tile : layout->copies) {
+        ComPtr<ID3D11Texture2D>& texture = *tileTextures[tile.output];
+        if (texture) {
+            D3D11_TEXTURE2D_DESC existing;
+            texture->GetDesc(&existing);
+            if (existing.Width != tileDesc.Width || existing.Height != tileDesc.Height) {
+                g_srvCache.Invalidate(texture.Get());
+                texture.Reset();
+            }
         }
-    }
-    std::cout << "LeftTexture Created successfully" << std::endl;
-
-    if (!g_rightTexture) {
-        // Create the right texture (half the width of the captured frame)
-        desc.Width *= 2;  // Restore full width
-        desc.Width /= 2;  // Set width back to half for right texture
-        hr = g_device->CreateTexture2D(&desc, nullptr, &g_rightTexture);
-        if (FAILED(hr)) {
-            std::cerr << "Failed to create right texture. HRESULT: " << std::hex << hr << std::endl;
-            g_duplication->ReleaseFrame();
-            return false;
+        if (!texture) {
+            hr = g_device->CreateTexture2D(&tileDesc, nullptr, &texture);
+            if (FAILED(hr)) {
+                std::cerr << "Failed to create " << (tile.output == 0 ? "left" : "right") << " texture. HRESULT: " << std::hex << hr << std::endl;
+                g_duplication->ReleaseFrame();
+                return false;
+            }
         }
+
+        // Copy this tile's region of the captured frame
+        D3D11_BOX box = TileSourceBox(tile);
+        g_context->CopySubresourceRegion(texture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &box);
     }
-    std::cout << "RightTexture Created successfully" << std::endl;
-    // Split the captured frame and copy data to left and right textures
-    D3D11_BOX leftBox = { 0, 0, 0, desc.Width, desc.Height, 1 };
-    D3D11_BOX rightBox = { desc.Width, 0, 0, 2 * desc.Width, desc.Height, 1 };
-
-    // Copy the left half to g_leftTexture
-    g_context->CopySubresourceRegion(g_leftTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &leftBox);
-    std::cout << "LeftTexture copied to g_leftTexture successfully" << std::endl;
-    // Copy the right half to g_rightTexture
-    g_context->CopySubresourceRegion(g_rightTexture.Get(), 0, 0, 0, 0, capturedTexture.Get(), 0, &rightBox);
-    std::cout << "RightTexture copied to g_rightTexture successfully" << std::endl;
+    std::cout << "Frame split into g_leftTexture and g_rightTexture successfully" << std::endl;
+    g_pacer.OnFrameArrived(QpcToNanoseconds(frameInfo.LastPresentTime.QuadPart), frameInfo.AccumulatedFrames);
     g_duplication->ReleaseFrame();
     return true;
 }
@@ -529,6 +549,15 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
             std::cerr << "Error capturing frame." << std::endl;
             break;
         }
+
+        // Render only when the output tick is due; a duplicate re-presents the textures as they are
+        PacingDecision decision = g_pacer.Poll();
+        if (decision == PacingDecision::Wait || decision == PacingDecision::Skip) {
+            continue;
+        }
+        if (g_pacer.Stats().ticks % 600 == 0) {
+            WritePacingStats(std::cout, g_pacer.Stats());
+        }
         CreateSRVs();
         RenderTextures();
     }
@@ -0,0 +1,611 @@
+#pragma once
+// Inter-frame recordings (.srec). Consecutive desktop frames are nearly identical, so most
+// frames are stored as the XOR against the previous frame (shifted, if the content
+// scrolled): unchanged pixels become zero and the screen codec collapses them into runs. A keyframe every N frames (and the first)
+// is coded on its own so playback can start there. Records are only ever appended; the
+// frame index is written when the file is closed, and rebuilt by scanning if it is missing.
+//
+// File: 32-byte header { "SREC", version, width, height, keyframe interval, reserved },
+// records as in ScreenCodec streams { frameIndex u64, timestamp i64, payload bytes u32 },
+// and on Close the index { offset u64, frameIndex u64, timestamp i64, payload bytes u32,
+// flags u32 } per frame followed by { index offset u64, entry count u32, "SRIX" }.
+// Payloads start with a frame type byte; deltas then carry the vertical shift of the
+// reference (zigzag varint). The rest is an EncodeScreenFrame() image.
+// The writer appends through an AsyncFileWriter, so recording never waits on the disk.
+#include "AsyncFileWriter.h"
+#include "ScreenCodec.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+const uint8_t kScreenFrameKey = 0;     // Payload is the frame itself
+const uint8_t kScreenFrameDelta = 1;   // Payload is the frame XOR the previous one
+
+namespace ScreenRecordingDetail {
+
+// Row fingerprint for scroll detection; four lanes keep the multiplies independent
+inline uint64_t RowHash(const uint8_t* row, size_t bytes) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h[4] = { k, k ^ 1, k ^ 2, k ^ 3 };
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t w;
+            std::memcpy(&w, row + i + lane * 8, 8);
+            h[lane] = (h[lane] ^ w) * 0xFF51AFD7ED558CCDull;
+        }
+    }
+    for (; i < bytes; ++i) h[0] = (h[0] ^ row[i]) * 0xC4CEB9FE1A85EC53ull;
+    uint64_t r = h[0] ^ (h[1] >> 17) ^ (h[2] << 23) ^ (h[3] >> 31);
+    return r ^ (r >> 29);
+}
+
+// residual = frame ^ (reference row y + shift, or zero outside the reference)
+inline void XorRows(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t bytes) {
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        x ^= y;
+        std::memcpy(out + i, &x, 8);
+    }
+    for (; i < bytes; ++i) out[i] = a[i] ^ b[i];
+}
+
+inline uint32_t ZigZag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+inline int32_t UnZigZag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+}  // namespace ScreenRecordingDetail
+
+// Turns a sequence of same-sized frames into key/delta payloads. A delta is taken against
+// the previous frame shifted vertically when that matches more rows (scrolled documents,
+// terminals), and a frame whose delta would outgrow the last keyframe becomes a keyframe.
+class ScreenDeltaEncoder {
+public:
+    explicit ScreenDeltaEncoder(uint32_t keyframeInterval = 120) : m_keyframeInterval(keyframeInterval) {}
+
+    // 0 or 1 makes every frame a keyframe
+    void SetKeyframeInterval(uint32_t interval) { m_keyframeInterval = interval; }
+
+    // The next frame becomes a keyframe
+    void Reset() { m_sinceKeyframe = 0; m_hasReference = false; }
+
+    // Vertical shift of the last delta frame, for stats
+    int32_t LastShift() const { return m_lastShift; }
+
+    // Whether EncodeRepeat can stand in for the next frame: there is a reference and no keyframe is due
+    bool CanRepeat() const { return m_hasReference && m_keyframeInterval > 1 && m_sinceKeyframe < m_keyframeInterval; }
+
+    // Appends a delta that repeats the last frame, for callers that know nothing changed
+    // (dirty rects) and want to skip hashing and coding the pixels. Only when CanRepeat().
+    void EncodeRepeat(std::vector<uint8_t>& out) {
+        using namespace ScreenRecordingDetail;
+        if (m_repeat.empty()) {
+            // An all-zero residual with no shift; coded once per frame size
+            const size_t rowBytes = static_cast<size_t>(m_width) * 4;
+            std::fill(m_residual.begin(), m_residual.end(), 0);
+            m_repeat.push_back(kScreenFrameDelta);
+            uint8_t varint[5];
+            m_repeat.insert(m_repeat.end(), varint, ScreenCodecDetail::PutVarint(varint, ZigZag(0)));
+            EncodeScreenFrame(ImageView(m_residual.data(), m_width, m_height, rowBytes), m_repeat);
+        }
+        out.insert(out.end(), m_repeat.begin(), m_repeat.end());
+        m_lastShift = 0;
+        m_sinceKeyframe++;
+    }
+
+    // Appends one payload to 'out'; returns true if it is a keyframe
+    bool Encode(const ImageView& image, std::vector<uint8_t>& out) {
+        using namespace ScreenRecordingDetail;
+        const size_t rowBytes = image.RowBytes();
+        if (image.width != m_width || image.height != m_height) {
+            m_width = image.width;
+            m_height = image.height;
+            m_reference.assign(rowBytes * image.height, 0);
+            m_residual.assign(m_reference.size(), 0);
+            m_referenceHashes.assign(image.height, 0);
+            m_repeat.clear();
+            m_hasReference = false;
+        }
+        m_hashes.resize(image.height);
+        for (uint32_t y = 0; y < image.height; ++y) m_hashes[y] = RowHash(image.Row(y), rowBytes);
+
+        bool key = !m_hasReference || m_keyframeInterval <= 1 || m_sinceKeyframe >= m_keyframeInterval;
+        size_t base = out.size();
+        if (!key) {
+            int32_t shift = DetectShift();
+            for (uint32_t y = 0; y < image.height; ++y) {
+                int64_t source = static_cast<int64_t>(y) + shift;
+                uint8_t* residual = m_residual.data() + y * rowBytes;
+                if (source >= 0 && source < image.height) XorRows(image.Row(y), m_reference.data() + source * rowBytes, residual, rowBytes);
+                else std::memcpy(residual, image.Row(y), rowBytes);
+            }
+            out.push_back(kScreenFrameDelta);
+            uint8_t varint[5];
+            out.insert(out.end(), varint, ScreenCodecDetail::PutVarint(varint, ZigZag(shift)));
+            size_t size = EncodeScreenFrame(ImageView(m_residual.data(), image.width, image.height, rowBytes), out);
+            if (size > m_lastKeyframeBytes) {
+                out.resize(base);   // Scene change: the frame alone is cheaper
+                key = true;
+            }
+            else {
+                m_lastShift = shift;
+                m_sinceKeyframe++;
+            }
+        }
+        if (key) {
+            out.push_back(kScreenFrameKey);
+            m_lastKeyframeBytes = EncodeScreenFrame(image, out);
+            m_sinceKeyframe = 1;
+            m_lastShift = 0;
+        }
+
+        for (uint32_t y = 0; y < image.height; ++y) std::memcpy(m_reference.data() + y * rowBytes, image.Row(y), rowBytes);
+        m_referenceHashes.swap(m_hashes);
+        m_hasReference = true;
+        return key;
+    }
+
+private:
+    // Shift s such that frame row y best matches reference row y + s. Distinct changed rows
+    // vote through a hash lookup into the reference; the winner must beat no shift at all.
+    int32_t DetectShift() {
+        const uint32_t height = m_height;
+        uint32_t unchanged = 0;
+        for (uint32_t y = 0; y < height; ++y) unchanged += m_hashes[y] == m_referenceHashes[y];
+        if (unchanged == height || height < 2) return 0;
+
+        m_sortedRows.clear();
+        for (uint32_t y = 0; y < height; ++y) {
+            if (y > 0 && m_referenceHashes[y] == m_referenceHashes[y - 1]) continue;   // Blank runs say nothing
+            m_sortedRows.push_back(std::make_pair(m_referenceHashes[y], y));
+        }
+        std::sort(m_sortedRows.begin(), m_sortedRows.end());
+
+        m_votes.assign(static_cast<size_t>(height) * 2, 0);
+        for (uint32_t y = 0; y < height; ++y) {
+            uint64_t h = m_hashes[y];
+            if (h == m_referenceHashes[y] || (y > 0 && h == m_hashes[y - 1])) continue;
+            auto match = std::lower_bound(m_sortedRows.begin(), m_sortedRows.end(), std::make_pair(h, uint32_t(0)));
+            if (match == m_sortedRows.end() || match->first != h) continue;
+            if (match + 1 != m_sortedRows.end() && (match + 1)->first == h) continue;   // Ambiguous
+            m_votes[static_cast<size_t>(match->second) + height - y]++;
+        }
+        size_t best = std::max_element(m_votes.begin(), m_votes.end()) - m_votes.begin();
+        if (m_votes[best] == 0) return 0;
+        int32_t shift = static_cast<int32_t>(best) - static_cast<int32_t>(height);
+
+        uint32_t shiftedMatches = 0;
+        for (uint32_t y = 0; y < height; ++y) {
+            int64_t source = static_cast<int64_t>(y) + shift;
+            if (source >= 0 && source < height && m_hashes[y] == m_referenceHashes[source]) shiftedMatches++;
+        }
+        return shiftedMatches > unchanged ? shift : 0;
+    }
+
+    uint32_t m_keyframeInterval;
+    uint32_t m_sinceKeyframe = 0;
+    bool m_hasReference = false;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    size_t m_lastKeyframeBytes = 0;
+    int32_t m_lastShift = 0;
+    std::vector<uint8_t> m_reference;
+    std::vector<uint8_t> m_residual;
+    std::vector<uint64_t> m_hashes;
+    std::vector<uint64_t> m_referenceHashes;
+    std::vector<std::pair<uint64_t, uint32_t>> m_sortedRows;
+    std::vector<uint32_t> m_votes;
+    std::vector<uint8_t> m_repeat;     // EncodeRepeat's payload
+};
+
+// Reverses ScreenDeltaEncoder; delta payloads need the frame before them decoded first
+class ScreenDeltaDecoder {
+public:
+    void Reset() { m_hasReference = false; }
+    bool HasReference() const { return m_hasReference; }
+
+    // Continues from the frame 'other' last decoded, e.g. a keyframe kept aside for seeking
+    void CopyReference(const ScreenDeltaDecoder& other) {
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_reference = other.m_reference;
+        m_hasReference = other.m_hasReference;
+    }
+
+    // Decodes one payload into 'pixels' (rows 'pitch' apart); pixels == nullptr only advances
+    // the reference, for seeking. False on malformed input or a delta without a reference.
+    bool Decode(const uint8_t* data, size_t size, uint32_t width, uint32_t height, uint8_t* pixels, size_t pitch) {
+        if (size < 1) return false;
+        const size_t rowBytes = static_cast<size_t>(width) * 4;
+        if (width != m_width || height != m_height) {
+            m_width = width;
+            m_height = height;
+            m_reference.assign(rowBytes * height, 0);
+            m_hasReference = false;
+        }
+
+        if (data[0] == kScreenFrameKey) {
+            m_hasReference = false;
+            if (!DecodeScreenFrame(data + 1, size - 1, width, height, m_reference.data(), rowBytes)) return false;
+        }
+        else if (data[0] == kScreenFrameDelta && m_hasReference) {
+            const uint8_t* in = data + 1;
+            uint32_t zigzag = 0;
+            if (!ScreenCodecDetail::GetVarint(in, data + size, zigzag)) return false;
+            int32_t shift = ScreenRecordingDetail::UnZigZag(zigzag);
+            if (shift == 0) {
+                // The usual case: applied in place, so unchanged rows cost nothing
+                m_hasReference = false;
+                if (!DecodeScreenFrameXor(in, size - (in - data), width, height, m_reference.data(), rowBytes, m_rows)) return false;
+                m_hasReference = true;
+                if (pixels) CopyOut(pixels, pitch);
+                return true;
+            }
+            m_residual.resize(m_reference.size());
+            if (!DecodeScreenFrame(in, size - (in - data), width, height, m_residual.data(), rowBytes)) return false;
+            // Rows shifted in from outside the reference were stored as they are
+            for (uint32_t y = 0; y < height; ++y) {
+                int64_t source = static_cast<int64_t>(y) + shift;
+                if (source < 0 || source >= height) continue;
+                uint8_t* row = m_residual.data() + y * rowBytes;
+                ScreenRecordingDetail::XorRows(row, m_reference.data() + source * rowBytes, row, rowBytes);
+            }
+            m_reference.swap(m_residual);
+        }
+        else {
+            return false;
+        }
+        m_hasReference = true;
+        if (pixels) CopyOut(pixels, pitch);
+        return true;
+    }
+
+    // Writes the last decoded frame out again
+    void CopyOut(uint8_t* pixels, size_t pitch) const {
+        const size_t rowBytes = static_cast<size_t>(m_width) * 4;
+        for (uint32_t y = 0; y < m_height; ++y) std::memcpy(pixels + y * pitch, m_reference.data() + y * rowBytes, rowBytes);
+    }
+
+private:
+
+    bool m_hasReference = false;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<uint8_t> m_reference;
+    std::vector<uint8_t> m_residual;
+    std::vector<uint8_t> m_rows;       // DecodeScreenFrameXor's scratch
+};
+
+namespace ScreenRecordingDetail {
+
+const char kMagic[4] = { 'S', 'R', 'E', 'C' };
+const char kIndexMagic[4] = { 'S', 'R', 'I', 'X' };
+const uint32_t kVersion = 1;
+const size_t kHeaderBytes = 32;
+const size_t kRecordBytes = 20;
+const size_t kIndexEntryBytes = 32;
+const size_t kTrailerBytes = 16;
+const uint32_t kFlagKeyframe = 1;
+
+// Recordings pass 4 GB; plain fseek/ftell are 32-bit on Windows
+inline bool SeekFile(std::FILE* file, uint64_t offset, int origin = SEEK_SET) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), origin) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
+
+inline uint64_t TellFile(std::FILE* file) {
+#ifdef _WIN32
+    return static_cast<uint64_t>(_ftelli64(file));
+#else
+    return static_cast<uint64_t>(ftello(file));
+#endif
+}
+
+}  // namespace ScreenRecordingDetail
+
+struct ScreenRecordingEntry {
+    uint64_t offset = 0;        // Of the record header
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;
+    uint32_t payloadSize = 0;
+    bool keyframe = false;
+};
+
+class ScreenRecordingWriter {
+public:
+    ~ScreenRecordingWriter() { Close(); }
+
+    bool Open(const std::string& path, uint32_t width, uint32_t height, uint32_t keyframeInterval = 120,
+              const AsyncFileWriterOptions& io = AsyncFileWriterOptions()) {
+        using namespace ScreenRecordingDetail;
+        Close();
+        if (!m_file.Open(path, io)) return false;
+        m_width = width;
+        m_height = height;
+        m_encoder.SetKeyframeInterval(keyframeInterval);
+        m_encoder.Reset();
+        m_index.clear();
+        m_keyframes = 0;
+        m_dropped = 0;
+        uint8_t header[kHeaderBytes] = {};
+        std::memcpy(header, kMagic, 4);
+        std::memcpy(header + 4, &kVersion, 4);
+        std::memcpy(header + 8, &width, 4);
+        std::memcpy(header + 12, &height, 4);
+        std::memcpy(header + 16, &keyframeInterval, 4);
+        m_bytes = kHeaderBytes;
+        return m_file.Append(header, sizeof(header));
+    }
+
+    // Delta-encodes and appends one frame; the view must match the recording's size
+    bool WriteFrame(const ImageView& image, const ScreenStreamFrameInfo& info) {
+        if (!m_file.IsOpen() || image.width != m_width || image.height != m_height) return false;
+        m_scratch.clear();
+        m_encoder.Encode(image, m_scratch);
+        return WriteEncodedFrame(m_scratch.data(), m_scratch.size(), info);
+    }
+
+    // Appends a frame identical to the last one written without looking at its pixels (the
+    // capture's dirty rects said nothing in this tile changed). Only when CanRepeatFrame();
+    // otherwise the frame has to go through WriteFrame, as when a keyframe is due.
+    bool CanRepeatFrame() const { return m_file.IsOpen() && m_encoder.CanRepeat(); }
+    bool WriteRepeatedFrame(const ScreenStreamFrameInfo& info) {
+        m_scratch.clear();
+        m_encoder.EncodeRepeat(m_scratch);
+        return WriteEncodedFrame(m_scratch.data(), m_scratch.size(), info);
+    }
+
+    // Appends a payload from a ScreenDeltaEncoder run elsewhere (an encode thread); frames
+    // must arrive in the order they were encoded. A frame the writer cannot queue (the disk
+    // is that far behind) is dropped whole and breaks the deltas after it: WriteFrame's
+    // encoder restarts with a keyframe, and callers encoding elsewhere should do the same.
+    bool WriteEncodedFrame(const uint8_t* payload, size_t size, const ScreenStreamFrameInfo& info) {
+        using namespace ScreenRecordingDetail;
+        if (!m_file.IsOpen() || size == 0) return false;
+        uint8_t record[kRecordBytes];
+        uint32_t payloadSize = static_cast<uint32_t>(size);
+        std::memcpy(record, &info.frameIndex, 8);
+        std::memcpy(record + 8, &info.timestamp, 8);
+        std::memcpy(record + 16, &payloadSize, 4);
+        if (!m_file.CanAppend(sizeof(record) + size) || !m_file.Append(record, sizeof(record)) || !m_file.Append(payload, size)) {
+            m_encoder.Reset();
+            m_dropped++;
+            return false;
+        }
+
+        ScreenRecordingEntry entry;
+        entry.offset = m_bytes;
+        entry.frameIndex = info.frameIndex;
+        entry.timestamp = info.timestamp;
+        entry.payloadSize = payloadSize;
+        entry.keyframe = payload[0] == kScreenFrameKey;
+        m_index.push_back(entry);
+        if (entry.keyframe) m_keyframes++;
+        m_bytes += sizeof(record) + size;
+        return true;
+    }
+
+    // Whether WriteEncodedFrame would queue a payload of 'size' bytes now. Only the disk
+    // catching up changes the answer, so a caller writing several recordings in step can
+    // check them all first and drop a frame from every one of them rather than from some.
+    bool CanWriteEncodedFrame(size_t size) const {
+        return m_file.CanAppend(ScreenRecordingDetail::kRecordBytes + size);
+    }
+
+    // Counts a frame the caller chose not to write; its encoder must restart with a keyframe
+    void DropFrame() {
+        m_encoder.Reset();
+        m_dropped++;
+    }
+
+    // Appends the frame index; a recording closed without it is still readable
+    bool Close() {
+        using namespace ScreenRecordingDetail;
+        if (!m_file.IsOpen()) return true;
+        uint64_t indexOffset = m_bytes;
+        bool ok = true;
+        for (const ScreenRecordingEntry& e : m_index) {
+            uint8_t entry[kIndexEntryBytes];
+            uint32_t flags = e.keyframe ? kFlagKeyframe : 0;
+            std::memcpy(entry, &e.offset, 8);
+            std::memcpy(entry + 8, &e.frameIndex, 8);
+            std::memcpy(entry + 16, &e.timestamp, 8);
+            std::memcpy(entry + 24, &e.payloadSize, 4);
+            std::memcpy(entry + 28, &flags, 4);
+            ok = ok && m_file.Append(entry, sizeof(entry));
+        }
+        uint8_t trailer[kTrailerBytes];
+        uint32_t count = static_cast<uint32_t>(m_index.size());
+        std::memcpy(trailer, &indexOffset, 8);
+        std::memcpy(trailer + 8, &count, 4);
+        std::memcpy(trailer + 12, kIndexMagic, 4);
+        ok = ok && m_file.Append(trailer, sizeof(trailer));
+        if (ok) m_bytes += m_index.size() * kIndexEntryBytes + kTrailerBytes;
+        ok = m_file.Close() && ok;
+        return ok;
+    }
+
+    bool IsOpen() const { return m_file.IsOpen(); }
+    uint64_t Frames() const { return m_index.size(); }
+    const ScreenRecordingEntry& LastFrame() const { return m_index.back(); }     // After a WriteFrame that returned true
+    uint64_t Keyframes() const { return m_keyframes; }
+    uint64_t Bytes() const { return m_bytes; }
+    uint64_t DroppedFrames() const { return m_dropped; }
+    AsyncFileWriterStats WriteStats() const { return m_file.Stats(); }
+
+private:
+    AsyncFileWriter m_file;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_keyframes = 0;
+    uint64_t m_dropped = 0;
+    ScreenDeltaEncoder m_encoder;
+    std::vector<ScreenRecordingEntry> m_index;
+    std::vector<uint8_t> m_scratch;
+};
+
+class ScreenRecordingReader {
+public:
+    ~ScreenRecordingReader() { Close(); }
+
+    bool Open(const std::string& path) {
+        using namespace ScreenRecordingDetail;
+        Close();
+        m_file = std::fopen(path.c_str(), "rb");
+        if (!m_file) return false;
+        uint8_t header[kHeaderBytes];
+        uint32_t version = 0;
+        if (std::fread(header, 1, sizeof(header), m_file) != sizeof(header) || std::memcmp(header, kMagic, 4) != 0) {
+            Close();
+            return false;
+        }
+        std::memcpy(&version, header + 4, 4);
+        std::memcpy(&m_width, header + 8, 4);
+        std::memcpy(&m_height, header + 12, 4);
+        std::memcpy(&m_keyframeInterval, header + 16, 4);
+        if (version != kVersion || !(LoadIndex() || ScanIndex())) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+        m_index.clear();
+        m_next = 0;
+        m_decoder.Reset();
+        m_indexRecovered = false;
+    }
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t KeyframeInterval() const { return m_keyframeInterval; }
+    size_t FrameCount() const { return m_index.size(); }
+    const ScreenRecordingEntry& Entry(size_t position) const { return m_index[position]; }
+    size_t Position() const { return m_next; }
+    bool IndexRecovered() const { return m_indexRecovered; }   // No index on disk; records were scanned
+
+    // Decodes the next frame into tightly packed BGRA; false at the end or on error
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        if (!m_file || m_next >= m_index.size()) return false;
+        const ScreenRecordingEntry& entry = m_index[m_next];
+        pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+        if (!DecodeEntry(entry, pixels.data())) return false;
+        info.frameIndex = entry.frameIndex;
+        info.timestamp = entry.timestamp;
+        m_next++;
+        return true;
+    }
+
+    // Positions the reader so the next ReadFrame() returns frame 'position' (0-based within
+    // the file): decoding restarts at the keyframe at or before it
+    bool Seek(size_t position) {
+        if (!m_file || position > m_index.size()) return false;
+        if (position == m_next) return true;
+        size_t key = position < m_index.size() ? position : m_index.size() - 1;
+        while (key > 0 && !m_index[key].keyframe) key--;
+        // Keep going from where we are if that is closer than the keyframe
+        size_t start = (m_next <= position && m_next > key && m_decoder.HasReference()) ? m_next : key;
+        if (start == key) m_decoder.Reset();
+        for (size_t i = start; i < position; ++i) {
+            if (!DecodeEntry(m_index[i], nullptr)) return false;
+        }
+        m_next = position;
+        return true;
+    }
+
+private:
+    bool DecodeEntry(const ScreenRecordingEntry& entry, uint8_t* pixels) {
+        using namespace ScreenRecordingDetail;
+        m_payload.resize(entry.payloadSize);
+        if (!SeekFile(m_file, entry.offset + kRecordBytes) ||
+            std::fread(m_payload.data(), 1, entry.payloadSize, m_file) != entry.payloadSize) {
+            m_decoder.Reset();
+            return false;
+        }
+        if (m_decoder.Decode(m_payload.data(), m_payload.size(), m_width, m_height, pixels, static_cast<size_t>(m_width) * 4)) return true;
+        m_decoder.Reset();      // The reference is stale now; the next seek restarts at a keyframe
+        return false;
+    }
+
+    bool LoadIndex() {
+        using namespace ScreenRecordingDetail;
+        if (!SeekFile(m_file, 0, SEEK_END)) return false;
+        uint64_t fileSize = TellFile(m_file);
+        if (fileSize < kHeaderBytes + kTrailerBytes) return false;
+        uint8_t trailer[kTrailerBytes];
+        if (!SeekFile(m_file, fileSize - kTrailerBytes) || std::fread(trailer, 1, sizeof(trailer), m_file) != sizeof(trailer)) return false;
+        uint64_t indexOffset;
+        uint32_t count;
+        std::memcpy(&indexOffset, trailer, 8);
+        std::memcpy(&count, trailer + 8, 4);
+        if (std::memcmp(trailer + 12, kIndexMagic, 4) != 0 || indexOffset + static_cast<uint64_t>(count) * kIndexEntryBytes + kTrailerBytes != fileSize) {
+            return false;
+        }
+
+        std::vector<uint8_t> raw(static_cast<size_t>(count) * kIndexEntryBytes);
+        if (!SeekFile(m_file, indexOffset) || std::fread(raw.data(), 1, raw.size(), m_file) != raw.size()) return false;
+        m_index.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t* e = raw.data() + static_cast<size_t>(i) * kIndexEntryBytes;
+            uint32_t flags;
+            std::memcpy(&m_index[i].offset, e, 8);
+            std::memcpy(&m_index[i].frameIndex, e + 8, 8);
+            std::memcpy(&m_index[i].timestamp, e + 16, 8);
+            std::memcpy(&m_index[i].payloadSize, e + 24, 4);
+            std::memcpy(&flags, e + 28, 4);
+            m_index[i].keyframe = (flags & kFlagKeyframe) != 0;
+        }
+        return true;
+    }
+
+    // Walks the records of a recording that was never closed; a torn last record is dropped
+    bool ScanIndex() {
+        using namespace ScreenRecordingDetail;
+        m_index.clear();
+        if (!SeekFile(m_file, 0, SEEK_END)) return false;
+        uint64_t fileSize = TellFile(m_file);
+        uint64_t offset = kHeaderBytes;
+        while (offset + kRecordBytes + 1 <= fileSize) {
+            uint8_t record[kRecordBytes];
+            uint8_t type = 0;
+            if (!SeekFile(m_file, offset) || std::fread(record, 1, sizeof(record), m_file) != sizeof(record) ||
+                std::fread(&type, 1, 1, m_file) != 1) {
+                break;
+            }
+            ScreenRecordingEntry entry;
+            entry.offset = offset;
+            std::memcpy(&entry.frameIndex, record, 8);
+            std::memcpy(&entry.timestamp, record + 8, 8);
+            std::memcpy(&entry.payloadSize, record + 16, 4);
+            entry.keyframe = type == kScreenFrameKey;
+            if (entry.payloadSize == 0 || offset + kRecordBytes + entry.payloadSize > fileSize) break;
+            m_index.push_back(entry);
+            offset += kRecordBytes + entry.payloadSize;
+        }
+        m_indexRecovered = true;
+        return true;
+    }
+
+    std::FILE* m_file = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_keyframeInterval = 0;
+    std::vector<ScreenRecordingEntry> m_index;
+    size_t m_next = 0;
+    bool m_indexRecovered = false;
+    ScreenDeltaDecoder m_decoder;
+    std::vector<uint8_t> m_payload;
+};
@@ -0,0 +1,330 @@
+#pragma once
+// CPU stand-in for the RenderTextures path: each tile is drawn onto its output the way
+// Draw(4, 0) of the full-screen quad with PixelShader.hlsl does it, so presentation can be
+// run and profiled without a D3D11 device. Output pixel (x, y) is shaded at its centre,
+// texCoord = ((x + 0.5) / W, (y + 0.5) / H), and sampled like the recorders' sampler state:
+// linear filtering with wrap addressing, at texel (u * w - 0.5, v * h - 0.5) with 8-bit
+// subtexel weights as D3D11 hardware filters. Same-size draws are plain copies.
+// Scalar and AVX2 row kernels are picked at runtime like PixelKernels and produce identical
+// bytes; SSE2 runs scalar. Bands of output rows can be spread over a ThreadPool.
+// Outputs stand in for swap chains: a back buffer to draw into, and Present() to hand it to
+// memory (double-buffered) or to a file (PNG sequence, Y4M or raw BGRA).
+#include "AsyncFileWriter.h"
+#include "ImageView.h"
+#include "PixelKernels.h"
+#include "PngWriter.h"
+#include "RawVideoSink.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A tightly packed BGRA image owned by an output
+class CompositorSurface {
+public:
+    void Resize(uint32_t width, uint32_t height) {
+        m_width = width;
+        m_height = height;
+        m_pixels.resize(static_cast<size_t>(width) * height * 4);
+    }
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    size_t Pitch() const { return static_cast<size_t>(m_width) * 4; }
+    uint8_t* Data() { return m_pixels.data(); }
+    ImageView View() const { return ImageView(m_pixels.data(), m_width, m_height, Pitch()); }
+    void Swap(CompositorSurface& other) {
+        m_pixels.swap(other.m_pixels);
+        std::swap(m_width, other.m_width);
+        std::swap(m_height, other.m_height);
+    }
+
+private:
+    std::vector<uint8_t> m_pixels;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+};
+
+// One presentation target, sized like the monitor its swap chain would cover
+class CompositorOutput {
+public:
+    virtual ~CompositorOutput() {}
+    CompositorSurface& BackBuffer() { return m_backBuffer; }
+    // Hands the back buffer on once the frame has been drawn into it
+    virtual bool Present(uint64_t frame) = 0;
+
+protected:
+    CompositorSurface m_backBuffer;
+};
+
+// Keeps the last presented frame in memory; presenting swaps buffers, nothing is copied
+class MemoryCompositorOutput : public CompositorOutput {
+public:
+    MemoryCompositorOutput(uint32_t width, uint32_t height) {
+        m_backBuffer.Resize(width, height);
+        m_front.Resize(width, height);
+    }
+
+    bool Present(uint64_t frame) override {
+        m_front.Swap(m_backBuffer);
+        m_frame = frame;
+        m_presented++;
+        return true;
+    }
+
+    ImageView Front() const { return m_front.View(); }
+    uint64_t FrontFrame() const { return m_frame; }
+    uint64_t Presented() const { return m_presented; }
+
+private:
+    CompositorSurface m_front;
+    uint64_t m_frame = 0;
+    uint64_t m_presented = 0;
+};
+
+enum class CompositorFileFormat {
+    Png,    // <path>_frame_<N>.png, encoded on the pool and written in the background
+    Y4m,    // <path>.y4m
+    Bgra    // <path>.bgra
+};
+
+class FileCompositorOutput : public CompositorOutput {
+public:
+    FileCompositorOutput(uint32_t width, uint32_t height, ThreadPool* pool = nullptr) : m_pool(pool) { m_backBuffer.Resize(width, height); }
+    ~FileCompositorOutput() { Close(); }
+
+    // 'path' has no extension; the format adds it
+    bool Open(const std::string& path, CompositorFileFormat format, double fps = 60.0) {
+        Close();
+        m_path = path;
+        m_format = format;
+        if (format == CompositorFileFormat::Png) return true;
+        RawVideoSinkOptions options;
+        options.format = format == CompositorFileFormat::Y4m ? RawVideoFormat::Y4m : RawVideoFormat::Bgra;
+        options.fps = fps;
+        return m_video.Open(path + (format == CompositorFileFormat::Y4m ? ".y4m" : ".bgra"), m_backBuffer.Width(), m_backBuffer.Height(), options);
+    }
+
+    bool Present(uint64_t frame) override {
+        const ImageView image = m_backBuffer.View();
+        if (m_format != CompositorFileFormat::Png) return m_video.WriteFrame(image, m_pool);
+        std::vector<uint8_t> png;
+        bool encoded = m_pool ? EncodePngParallel(image.data, image.width, image.height, image.rowPitch, png, *m_pool)
+                              : EncodePng(image.data, image.width, image.height, image.rowPitch, png);
+        return encoded && m_pngFiles.Write(m_path + "_frame_" + std::to_string(frame) + ".png", std::move(png));
+    }
+
+    // False if any PNG could not be written
+    bool Close() {
+        m_video.Close();
+        m_pngFiles.Drain();
+        return m_pngFiles.Failed() == 0 && m_pngFiles.Rejected() == 0;
+    }
+
+private:
+    ThreadPool* m_pool;
+    std::string m_path;
+    CompositorFileFormat m_format = CompositorFileFormat::Png;
+    RawVideoSink m_video;
+    BackgroundFileQueue m_pngFiles;
+};
+
+namespace SoftwareCompositorDetail {
+
+// The two texels a shaded coordinate falls between and the 8-bit weight of the second
+struct SampleTap {
+    uint32_t first;
+    uint32_t second;
+    uint32_t weight;
+};
+
+inline SampleTap MakeTap(uint32_t output, uint32_t outSize, uint32_t inSize) {
+    double position = (output + 0.5) * inSize / outSize - 0.5;
+    double base = std::floor(position);
+    int64_t first = static_cast<int64_t>(base);
+    uint32_t weight = static_cast<uint32_t>(std::lround((position - base) * 256.0));
+    if (weight == 256) {
+        first++;
+        weight = 0;
+    }
+    auto wrap = [inSize](int64_t i) { return static_cast<uint32_t>(((i % inSize) + inSize) % inSize); };
+    return { wrap(first), wrap(first + 1), weight };
+}
+
+// Column taps for one source/output width pair, laid out for the row kernels
+struct ColumnTaps {
+    uint32_t inWidth = 0;
+    uint32_t outWidth = 0;
+    std::vector<int32_t> first;         // Source pixel per output pixel
+    std::vector<int32_t> second;
+    std::vector<uint32_t> weights;      // Of 'second', repeated for each of the 4 channels
+
+    void Build(uint32_t in, uint32_t out) {
+        if (in == inWidth && out == outWidth) return;
+        inWidth = in;
+        outWidth = out;
+        first.resize(out);
+        second.resize(out);
+        weights.resize(static_cast<size_t>(out) * 4);
+        for (uint32_t x = 0; x < out; ++x) {
+            SampleTap tap = MakeTap(x, out, in);
+            first[x] = static_cast<int32_t>(tap.first);
+            second[x] = static_cast<int32_t>(tap.second);
+            for (int k = 0; k < 4; ++k) weights[x * 4 + k] = tap.weight;
+        }
+    }
+};
+
+// Vertical pass over the whole source row: blend[i] = top * (256 - w) + bottom * w (<= 65280)
+inline void BlendRowsScalar(const uint8_t* top, const uint8_t* bottom, uint32_t weight, uint16_t* blend, uint32_t count, uint32_t start) {
+    for (uint32_t i = start; i < count; ++i) blend[i] = static_cast<uint16_t>(top[i] * (256 - weight) + bottom[i] * weight);
+}
+
+// Horizontal pass: (left * (256 - w) + right * w + 32768) >> 16 for each channel
+inline void SampleRowScalar(const uint16_t* blend, const ColumnTaps& taps, uint8_t* out, uint32_t start) {
+    for (uint32_t x = start; x < taps.outWidth; ++x) {
+        const uint16_t* a = blend + static_cast<size_t>(taps.first[x]) * 4;
+        const uint16_t* b = blend + static_cast<size_t>(taps.second[x]) * 4;
+        const uint32_t w = taps.weights[x * 4];
+        for (int k = 0; k < 4; ++k) out[x * 4 + k] = static_cast<uint8_t>((a[k] * (256 - w) + b[k] * w + 32768) >> 16);
+    }
+}
+
+#ifdef PIXEL_KERNELS_X86
+PIXEL_KERNELS_AVX2_TARGET inline void BlendRowsAvx2(const uint8_t* top, const uint8_t* bottom, uint32_t weight, uint16_t* blend, uint32_t count) {
+    const __m256i topWeight = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i bottomWeight = _mm256_set1_epi16(static_cast<short>(weight));
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i t = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i)));
+        // Both products and their sum fit in 16 unsigned bits, so the low halves are exact
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(t, topWeight), _mm256_mullo_epi16(b, bottomWeight));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(blend + i), sum);
+    }
+    BlendRowsScalar(top, bottom, weight, blend, count, i);
+}
+
+// Four output pixels per step: one 64-bit gather fetches a blended pixel (4 x u16) each
+PIXEL_KERNELS_AVX2_TARGET inline void SampleRowAvx2(const uint16_t* blend, const ColumnTaps& taps, uint8_t* out) {
+    const long long* pixels = reinterpret_cast<const long long*>(blend);
+    const __m256i full = _mm256_set1_epi32(256);
+    const __m256i round = _mm256_set1_epi32(32768);
+    uint32_t x = 0;
+    for (; x + 4 <= taps.outWidth; x += 4) {
+        __m256i a = _mm256_i32gather_epi64(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps.first.data() + x)), 8);
+        __m256i b = _mm256_i32gather_epi64(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps.second.data() + x)), 8);
+        __m256i w01 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps.weights.data() + x * 4));
+        __m256i w23 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps.weights.data() + x * 4 + 8));
+        __m256i a01 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(a));
+        __m256i a23 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(a, 1));
+        __m256i b01 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(b));
+        __m256i b23 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(b, 1));
+        __m256i r01 = _mm256_add_epi32(_mm256_mullo_epi32(a01, _mm256_sub_epi32(full, w01)), _mm256_mullo_epi32(b01, w01));
+        __m256i r23 = _mm256_add_epi32(_mm256_mullo_epi32(a23, _mm256_sub_epi32(full, w23)), _mm256_mullo_epi32(b23, w23));
+        r01 = _mm256_srli_epi32(_mm256_add_epi32(r01, round), 16);
+        r23 = _mm256_srli_epi32(_mm256_add_epi32(r23, round), 16);
+        // Packing works within 128-bit lanes: pixels come out 0, 2, 1, 3 and are put back in order
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(r01, r23), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + static_cast<size_t>(x) * 4), bytes);
+    }
+    SampleRowScalar(blend, taps, out, x);
+}
+#endif
+
+}  // namespace SoftwareCompositorDetail
+
+struct CompositorStats {
+    uint64_t frames = 0;
+    uint64_t draws = 0;
+    uint64_t copies = 0;        // Draws at the source size, done as row copies
+    double drawMs = 0.0;
+    double presentMs = 0.0;
+};
+
+class SoftwareCompositor {
+public:
+    // An unsupported level falls back to the best one available
+    explicit SoftwareCompositor(ThreadPool* pool = nullptr, PixelKernelLevel level = BestPixelKernelLevel(), uint32_t bandRows = 32)
+        : m_pool(pool), m_level(PixelKernelLevelSupported(level) ? level : BestPixelKernelLevel()), m_bandRows(std::max<uint32_t>(bandRows, 1)) {}
+
+    PixelKernelLevel Level() const { return m_level; }
+
+    // Draw(4, 0) of the full-screen quad with 'source' bound at t0, into a width x height target
+    void DrawFullScreenQuad(const ImageView& source, uint8_t* target, uint32_t width, uint32_t height, size_t pitch) {
+        using namespace SoftwareCompositorDetail;
+        if (source.Empty() || width == 0 || height == 0) return;
+        m_stats.draws++;
+        const uint32_t bands = (height + m_bandRows - 1) / m_bandRows;
+        if (width == source.width && height == source.height) {
+            // Every sample lands on a texel centre with zero weight
+            m_stats.copies++;
+            auto copy = [&](size_t band) {
+                uint32_t end = std::min(height, static_cast<uint32_t>(band + 1) * m_bandRows);
+                for (uint32_t y = static_cast<uint32_t>(band) * m_bandRows; y < end; ++y) std::memcpy(target + y * pitch, source.Row(y), source.RowBytes());
+            };
+            if (m_pool) m_pool->ParallelFor(bands, copy);
+            else for (uint32_t b = 0; b < bands; ++b) copy(b);
+            return;
+        }
+
+        m_columns.Build(source.width, width);
+        if (m_blend.size() < bands) m_blend.resize(bands);
+        const uint32_t count = source.width * 4;
+        const PixelKernelLevel level = m_level;
+        auto draw = [&](size_t band) {
+            std::vector<uint16_t>& blend = m_blend[band];
+            blend.resize(count);
+            uint32_t end = std::min(height, static_cast<uint32_t>(band + 1) * m_bandRows);
+            for (uint32_t y = static_cast<uint32_t>(band) * m_bandRows; y < end; ++y) {
+                SampleTap row = MakeTap(y, height, source.height);
+                uint8_t* out = target + y * pitch;
+#ifdef PIXEL_KERNELS_X86
+                if (level == PixelKernelLevel::Avx2) {
+                    BlendRowsAvx2(source.Row(row.first), source.Row(row.second), row.weight, blend.data(), count);
+                    SampleRowAvx2(blend.data(), m_columns, out);
+                    continue;
+                }
+#endif
+                BlendRowsScalar(source.Row(row.first), source.Row(row.second), row.weight, blend.data(), count, 0);
+                SampleRowScalar(blend.data(), m_columns, out, 0);
+            }
+        };
+        if (m_pool) m_pool->ParallelFor(bands, draw);
+        else for (uint32_t b = 0; b < bands; ++b) draw(b);
+    }
+
+    // One frame: tile i is drawn over the whole back buffer of output i, then every output
+    // presents. False if the counts differ or an output fails to present.
+    bool Compose(const std::vector<ImageView>& tiles, const std::vector<CompositorOutput*>& outputs, uint64_t frame) {
+        if (tiles.size() != outputs.size()) return false;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            CompositorSurface& backBuffer = outputs[i]->BackBuffer();
+            DrawFullScreenQuad(tiles[i], backBuffer.Data(), backBuffer.Width(), backBuffer.Height(), backBuffer.Pitch());
+        }
+        auto drawn = std::chrono::steady_clock::now();
+        bool ok = true;
+        for (CompositorOutput* output : outputs) ok = output->Present(frame) && ok;
+        m_stats.frames++;
+        m_stats.drawMs += std::chrono::duration<double, std::milli>(drawn - start).count();
+        m_stats.presentMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawn).count();
+        return ok;
+    }
+
+    const CompositorStats& Stats() const { return m_stats; }
+
+private:
+    ThreadPool* m_pool;
+    PixelKernelLevel m_level;
+    uint32_t m_bandRows;
+    SoftwareCompositorDetail::ColumnTaps m_columns;
+    std::vector<std::vector<uint16_t>> m_blend;     // Vertical pass of the current row, per band
+    CompositorStats m_stats;
+};
@@ -0,0 +1,370 @@
+#pragma once
+// N-deep ring of pre-allocated staging buffers for GPU -> CPU readback.
+// Frame N is copied into a free slot and left alone; later submits poll the oldest
+// slots with do-not-wait maps, so frame N is read while N+1..N+k are still copying.
+// Only when every slot is in flight does the ring block on (or drop) a frame.
+// Submits that say what changed since the last one (dirty and move rects) copy only those
+// rects into a slot, on top of the frame the slot already holds.
+// The backend is an interface: D3D11 staging textures on Windows, CPU mock for tests.
+#include "DirtyRects.h"
+#include "FramePacer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// A mapped slot as the consumer sees it; valid only during the delivery callback
+struct MappedFrame {
+    const uint8_t* data = nullptr;
+    size_t rowPitch = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;
+    const std::vector<DirtyRect>* changed = nullptr;    // What differs from the last delivered frame; nullptr = unknown
+};
+
+enum class MapResult {
+    Ready,          // Mapped; read it, then Unmap
+    StillDrawing,   // Copy not finished (DXGI_ERROR_WAS_STILL_DRAWING)
+    Failed
+};
+
+template <typename Source>
+class ReadbackBackend {
+public:
+    virtual ~ReadbackBackend() = default;
+    virtual size_t SlotCount() const = 0;
+    // Start copying 'source' into 'slot'; must not wait for the copy to finish
+    virtual bool QueueCopy(size_t slot, Source source) = 0;
+    // Copy only 'regions' of 'source' into 'slot' and keep the rest of what it holds;
+    // backends that cannot do that copy everything
+    virtual bool QueueCopyRegions(size_t slot, Source source, const std::vector<DirtyRect>& regions) {
+        (void)regions;
+        return QueueCopy(slot, source);
+    }
+    // wait == false must return StillDrawing instead of blocking
+    virtual MapResult Map(size_t slot, bool wait, MappedFrame& mapped) = 0;
+    virtual void Unmap(size_t slot) = 0;
+};
+
+enum class RingFullPolicy {
+    WaitOldest,     // Block on the oldest copy so no frame is lost
+    DropNewest      // Keep the CPU moving; the new frame is not read back
+};
+
+struct StagingRingStats {
+    uint64_t submitted = 0;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t failed = 0;
+    uint64_t stillDrawing = 0;  // Do-not-wait maps that found the copy unfinished
+    uint64_t blockingMaps = 0;  // Maps that had to wait (ring full or Flush)
+    uint64_t partialCopies = 0; // Submits that copied only the rects changed since the slot's frame
+    size_t maxInFlight = 0;
+    JitterStats submitToDeliver;    // Wall time from Submit to the delivery callback
+};
+
+template <typename Source>
+class StagingRing {
+public:
+    using DeliverFunction = std::function<void(const MappedFrame&)>;
+
+    StagingRing(ReadbackBackend<Source>& backend, DeliverFunction deliver, RingFullPolicy policy = RingFullPolicy::WaitOldest)
+        : m_backend(backend), m_deliver(std::move(deliver)), m_policy(policy), m_slots(backend.SlotCount()) {}
+
+    ~StagingRing() { Flush(); }
+
+    // Returns false if the frame was dropped or the copy could not be queued. 'changed' lists
+    // the rects that differ from the frame given to the previous Submit, dropped or not;
+    // nullptr means unknown, and the whole frame is copied.
+    bool Submit(Source source, uint64_t frameIndex, int64_t timestamp = 0, const std::vector<DirtyRect>* changed = nullptr) {
+        Poll();
+        const uint64_t sequence = ++m_sequence;
+        m_history.push_back({ sequence, changed != nullptr, changed ? *changed : std::vector<DirtyRect>() });
+        while (m_history.size() > std::max<size_t>(16, m_slots.size() * 4)) m_history.pop_front();
+        if (m_inFlight == m_slots.size()) {
+            if (m_policy == RingFullPolicy::DropNewest || m_slots.empty()) {
+                m_stats.dropped++;
+                return false;
+            }
+            DeliverOldest(true);
+        }
+
+        size_t slot = (m_oldest + m_inFlight) % m_slots.size();
+        SlotInfo& info = m_slots[slot];
+        bool partial = changed && info.holdsFrame && CollectChanges(info.sequence, sequence, m_regions);
+        if (!(partial ? m_backend.QueueCopyRegions(slot, source, m_regions) : m_backend.QueueCopy(slot, source))) {
+            info.holdsFrame = false;
+            m_stats.failed++;
+            return false;
+        }
+        if (partial) m_stats.partialCopies++;
+        info.frameIndex = frameIndex;
+        info.timestamp = timestamp;
+        info.submittedNs = NowNs();
+        info.sequence = sequence;
+        info.holdsFrame = true;
+        info.changesKnown = m_lastQueued != 0 && CollectChanges(m_lastQueued, sequence, info.changed);
+        m_lastQueued = sequence;
+        m_inFlight++;
+        m_stats.submitted++;
+        m_stats.maxInFlight = std::max(m_stats.maxInFlight, m_inFlight);
+        return true;
+    }
+
+    // Deliver every finished copy, oldest first, without blocking. Delivery stays in
+    // submit order: an unfinished older copy holds back newer ones.
+    size_t Poll() {
+        size_t delivered = 0;
+        while (m_inFlight > 0 && DeliverOldest(false)) delivered++;
+        return delivered;
+    }
+
+    // Block until everything in flight has been delivered
+    void Flush() {
+        while (m_inFlight > 0) DeliverOldest(true);
+    }
+
+    size_t InFlight() const { return m_inFlight; }
+    const StagingRingStats& Stats() const { return m_stats; }
+
+private:
+    struct SlotInfo {
+        uint64_t frameIndex = 0;
+        int64_t timestamp = 0;
+        int64_t submittedNs = 0;
+        uint64_t sequence = 0;              // Submit that the slot's pixels are a copy of
+        bool holdsFrame = false;            // False until a copy lands, or after one fails
+        bool changesKnown = false;
+        std::vector<DirtyRect> changed;     // Against the frame queued before this one
+    };
+
+    // What Submit was told since the submit numbered 'after', up to 'last'; false if any
+    // of it was unknown or has aged out
+    bool CollectChanges(uint64_t after, uint64_t last, std::vector<DirtyRect>& rects) const {
+        rects.clear();
+        if (m_history.empty() || m_history.front().sequence > after + 1) return false;
+        for (const ChangeRecord& record : m_history) {
+            if (record.sequence <= after || record.sequence > last) continue;
+            if (!record.known) return false;
+            rects.insert(rects.end(), record.rects.begin(), record.rects.end());
+        }
+        MergeRects(rects);
+        return true;
+    }
+
+    struct ChangeRecord {
+        uint64_t sequence;
+        bool known;
+        std::vector<DirtyRect> rects;
+    };
+
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool DeliverOldest(bool wait) {
+        MappedFrame mapped;
+        MapResult result = m_backend.Map(m_oldest, wait, mapped);
+        if (result == MapResult::StillDrawing) {
+            m_stats.stillDrawing++;
+            return false;
+        }
+        if (wait) m_stats.blockingMaps++;
+
+        SlotInfo& info = m_slots[m_oldest];
+        if (result == MapResult::Ready) {
+            mapped.frameIndex = info.frameIndex;
+            mapped.timestamp = info.timestamp;
+            // After a lost frame the consumer's last frame is older than what 'changed' is against
+            mapped.changed = info.changesKnown && !m_lostDelivery ? &info.changed : nullptr;
+            m_deliver(mapped);
+            m_backend.Unmap(m_oldest);
+            m_lostDelivery = false;
+            m_stats.delivered++;
+            m_stats.submitToDeliver.Add(NowNs() - info.submittedNs);
+        }
+        else {
+            info.holdsFrame = false;
+            m_lostDelivery = true;
+            m_stats.failed++;
+        }
+        m_oldest = (m_oldest + 1) % m_slots.size();
+        m_inFlight--;
+        return true;
+    }
+
+    ReadbackBackend<Source>& m_backend;
+    DeliverFunction m_deliver;
+    RingFullPolicy m_policy;
+    std::vector<SlotInfo> m_slots;
+    size_t m_oldest = 0;
+    size_t m_inFlight = 0;
+    uint64_t m_sequence = 0;            // Submit calls so far
+    uint64_t m_lastQueued = 0;          // Sequence of the last frame whose copy was queued
+    bool m_lostDelivery = false;
+    std::deque<ChangeRecord> m_history; // Change lists of the latest submits
+    std::vector<DirtyRect> m_regions;
+    StagingRingStats m_stats;
+};
+
+// CPU stand-in for a GPU copy queue. Copies run one after another and each takes
+// copyLatencyNs on the given clock; a waiting Map advances a simulated clock to the
+// copy's completion, so stalls show up as clock time instead of real sleeps.
+class MockReadbackBackend : public ReadbackBackend<const uint8_t*> {
+public:
+    MockReadbackBackend(size_t slotCount, uint32_t width, uint32_t height, size_t rowPitch, SimulatedPacerClock& clock, int64_t copyLatencyNs)
+        : m_width(width), m_height(height), m_rowPitch(rowPitch), m_clock(clock), m_copyLatency(copyLatencyNs), m_slots(slotCount) {
+        for (Slot& slot : m_slots) slot.pixels.resize(rowPitch * height);
+    }
+
+    size_t SlotCount() const override { return m_slots.size(); }
+
+    bool QueueCopy(size_t slot, const uint8_t* source) override {
+        Slot& s = m_slots[slot];
+        if (s.mapped) return false;     // D3D would reject copying into a mapped resource too
+        std::memcpy(s.pixels.data(), source, s.pixels.size());
+        m_queueTail = std::max(m_queueTail, m_clock.NowNs()) + m_copyLatency;
+        s.readyNs = m_queueTail;
+        m_copiedBytes += s.pixels.size();
+        return true;
+    }
+
+    bool QueueCopyRegions(size_t slot, const uint8_t* source, const std::vector<DirtyRect>& regions) override {
+        Slot& s = m_slots[slot];
+        if (s.mapped) return false;
+        const DirtyRect bounds = { 0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height) };
+        for (const DirtyRect& region : regions) {
+            DirtyRect r = RectIntersection(region, bounds);
+            if (RectIsEmpty(r)) continue;
+            for (int32_t y = r.top; y < r.bottom; ++y) {
+                size_t offset = y * m_rowPitch + static_cast<size_t>(r.left) * 4;
+                std::memcpy(s.pixels.data() + offset, source + offset, static_cast<size_t>(r.right - r.left) * 4);
+            }
+            m_copiedBytes += static_cast<uint64_t>(RectArea(r)) * 4;
+        }
+        m_queueTail = std::max(m_queueTail, m_clock.NowNs()) + m_copyLatency;
+        s.readyNs = m_queueTail;
+        return true;
+    }
+
+    MapResult Map(size_t slot, bool wait, MappedFrame& mapped) override {
+        Slot& s = m_slots[slot];
+        int64_t now = m_clock.NowNs();
+        if (now < s.readyNs) {
+            if (!wait) return MapResult::StillDrawing;
+            m_stallNs += s.readyNs - now;
+            m_clock.SetNs(s.readyNs);
+        }
+        s.mapped = true;
+        mapped.data = s.pixels.data();
+        mapped.rowPitch = m_rowPitch;
+        mapped.width = m_width;
+        mapped.height = m_height;
+        return MapResult::Ready;
+    }
+
+    void Unmap(size_t slot) override { m_slots[slot].mapped = false; }
+
+    // Total clock time spent blocked in waiting maps
+    int64_t StallNs() const { return m_stallNs; }
+    // Pixel bytes moved by copies, full and partial
+    uint64_t CopiedBytes() const { return m_copiedBytes; }
+
+private:
+    struct Slot {
+        std::vector<uint8_t> pixels;
+        int64_t readyNs = 0;
+        bool mapped = false;
+    };
+
+    uint32_t m_width;
+    uint32_t m_height;
+    size_t m_rowPitch;
+    SimulatedPacerClock& m_clock;
+    int64_t m_copyLatency;
+    int64_t m_queueTail = 0;
+    int64_t m_stallNs = 0;
+    uint64_t m_copiedBytes = 0;
+    std::vector<Slot> m_slots;
+};
+
+#ifdef __d3d11_h__
+#include <wrl/client.h>
+
+// Staging textures created once at the capture size; maps use D3D11_MAP_FLAG_DO_NOT_WAIT
+class D3D11ReadbackBackend : public ReadbackBackend<ID3D11Texture2D*> {
+public:
+    D3D11ReadbackBackend(ID3D11Device* device, ID3D11DeviceContext* context)
+        : m_device(device), m_context(context) {}
+
+    // Creates slotCount staging textures matching 'desc' (only size and format are used)
+    HRESULT CreateSlots(size_t slotCount, const D3D11_TEXTURE2D_DESC& desc) {
+        D3D11_TEXTURE2D_DESC stagingDesc = {};
+        stagingDesc.Width = desc.Width;
+        stagingDesc.Height = desc.Height;
+        stagingDesc.MipLevels = 1;
+        stagingDesc.ArraySize = 1;
+        stagingDesc.Format = desc.Format;
+        stagingDesc.SampleDesc.Count = 1;
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+        m_slots.clear();
+        m_slots.resize(slotCount);
+        for (Microsoft::WRL::ComPtr<ID3D11Texture2D>& slot : m_slots) {
+            HRESULT hr = m_device->CreateTexture2D(&stagingDesc, nullptr, &slot);
+            if (FAILED(hr)) {
+                m_slots.clear();
+                return hr;
+            }
+        }
+        m_width = desc.Width;
+        m_height = desc.Height;
+        return S_OK;
+    }
+
+    size_t SlotCount() const override { return m_slots.size(); }
+
+    bool QueueCopy(size_t slot, ID3D11Texture2D* source) override {
+        m_context->CopyResource(m_slots[slot].Get(), source);
+        return true;
+    }
+
+    bool QueueCopyRegions(size_t slot, ID3D11Texture2D* source, const std::vector<DirtyRect>& regions) override {
+        const DirtyRect bounds = { 0, 0, static_cast<int32_t>(m_width), static_cast<int32_t>(m_height) };
+        for (const DirtyRect& region : regions) {
+            DirtyRect r = RectIntersection(region, bounds);
+            if (RectIsEmpty(r)) continue;
+            D3D11_BOX box = { static_cast<UINT>(r.left), static_cast<UINT>(r.top), 0, static_cast<UINT>(r.right), static_cast<UINT>(r.bottom), 1 };
+            m_context->CopySubresourceRegion(m_slots[slot].Get(), 0, box.left, box.top, 0, source, 0, &box);
+        }
+        return true;
+    }
+
+    MapResult Map(size_t slot, bool wait, MappedFrame& mapped) override {
+        D3D11_MAPPED_SUBRESOURCE resource;
+        HRESULT hr = m_context->Map(m_slots[slot].Get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &resource);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING) return MapResult::StillDrawing;
+        if (FAILED(hr)) return MapResult::Failed;
+        mapped.data = static_cast<const uint8_t*>(resource.pData);
+        mapped.rowPitch = resource.RowPitch;
+        mapped.width = m_width;
+        mapped.height = m_height;
+        return MapResult::Ready;
+    }
+
+    void Unmap(size_t slot) override { m_context->Unmap(m_slots[slot].Get(), 0); }
+
+private:
+    ID3D11Device* m_device;
+    ID3D11DeviceContext* m_context;
+    std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> m_slots;
+    UINT m_width = 0;
+    UINT m_height = 0;
+};
+#endif
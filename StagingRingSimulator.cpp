@@ -0,0 +1,170 @@
+// Runs the staging ring against the CPU mock backend on a simulated clock and compares
+// ring depths with the old copy-then-blocking-Map readback. Each frame is stamped with
+// its index, so every delivery is checked for order and content.
+// Then frames change only inside a few random rects and are submitted with them: each
+// slot must receive just the rects changed since the frame it holds, every delivery must
+// still match its frame exactly (also when the ring drops frames), and the rects handed to
+// the consumer must cover everything that differs from the frame delivered before.
+// Usage: StagingRingSimulator [frames] [copyLatencyMs] [encodeMs] [fps]
+#include "StagingRing.h"
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+
+struct ReadbackRun {
+    std::string name;
+    uint64_t delivered = 0;
+    uint64_t late = 0;          // Frames whose readback + encode overran the frame interval
+    uint64_t corrupt = 0;
+    double stallMsPerFrame = 0.0;
+    double fps = 0.0;
+    StagingRingStats stats;
+};
+
+// depth 0 = copy and wait for the Map every frame, as SaveTextureAsPNGStandalone() did
+ReadbackRun SimulateReadback(size_t depth, uint64_t frames, int64_t copyLatency, int64_t encodeCost, double targetFps) {
+    const uint32_t width = 64, height = 16;
+    const size_t rowPitch = width * 4 + 64;
+    const int64_t interval = static_cast<int64_t>(1e9 / targetFps);
+
+    SimulatedPacerClock clock;
+    MockReadbackBackend backend(depth ? depth : 1, width, height, rowPitch, clock, copyLatency);
+    ReadbackRun run;
+    run.name = depth ? "ring " + std::to_string(depth) : "blocking";
+
+    uint64_t expected = 0;
+    StagingRing<const uint8_t*> ring(backend, [&](const MappedFrame& frame) {
+        uint64_t stamp;
+        std::memcpy(&stamp, frame.data + frame.rowPitch * (frame.height - 1), sizeof(stamp));
+        if (stamp != frame.frameIndex || frame.frameIndex != expected) run.corrupt++;
+        expected = frame.frameIndex + 1;
+        run.delivered++;
+        clock.AdvanceNs(encodeCost);
+    });
+
+    std::vector<uint8_t> surface(rowPitch * height, 0);
+    for (uint64_t i = 0; i < frames; ++i) {
+        int64_t tick = static_cast<int64_t>(i) * interval;
+        clock.SetNs(std::max(clock.NowNs(), tick));
+        std::memcpy(surface.data() + rowPitch * (height - 1), &i, sizeof(i));
+
+        ring.Submit(surface.data(), i, tick);
+        if (depth == 0) ring.Flush();
+        if (clock.NowNs() > tick + interval) run.late++;
+    }
+    ring.Flush();
+
+    run.stats = ring.Stats();
+    run.stallMsPerFrame = backend.StallNs() / 1e6 / frames;
+    run.fps = frames / (clock.NowNs() / 1e9);
+    return run;
+}
+
+struct PartialRun {
+    uint64_t delivered = 0;
+    uint64_t wrong = 0;         // Deliveries that differ from their frame
+    uint64_t uncovered = 0;     // Changed pixels missing from the rects given to the consumer
+    uint64_t unknown = 0;       // Deliveries without change rects
+    double copiedShare = 0.0;   // Bytes copied against full-frame copies of every queued frame
+    StagingRingStats stats;
+};
+
+PartialRun SimulatePartialReadback(size_t depth, RingFullPolicy policy, uint64_t frames, int64_t copyLatency, int64_t encodeCost) {
+    const uint32_t width = 320, height = 180;
+    const size_t rowPitch = width * 4 + 32;
+    SimulatedPacerClock clock;
+    MockReadbackBackend backend(depth, width, height, rowPitch, clock, copyLatency);
+    PartialRun run;
+    std::map<uint64_t, std::vector<uint8_t>> submitted;     // Frames still owed a delivery
+    std::vector<uint8_t> previous;
+
+    StagingRing<const uint8_t*> ring(backend, [&](const MappedFrame& frame) {
+        std::vector<uint8_t>& expected = submitted[frame.frameIndex];
+        if (std::memcmp(frame.data, expected.data(), expected.size()) != 0) run.wrong++;
+        if (!frame.changed) run.unknown++;
+        else if (!previous.empty()) {
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    if (std::memcmp(&expected[y * rowPitch + x * 4], &previous[y * rowPitch + x * 4], 4) == 0) continue;
+                    bool covered = false;
+                    for (const DirtyRect& r : *frame.changed) covered = covered || (int32_t(x) >= r.left && int32_t(x) < r.right && int32_t(y) >= r.top && int32_t(y) < r.bottom);
+                    run.uncovered += !covered;
+                }
+            }
+        }
+        previous = expected;
+        submitted.erase(submitted.begin(), submitted.upper_bound(frame.frameIndex));
+        run.delivered++;
+        clock.AdvanceNs(encodeCost);
+    }, policy);
+
+    std::mt19937 rng(7);
+    std::vector<uint8_t> surface(rowPitch * height);
+    for (uint8_t& b : surface) b = static_cast<uint8_t>(rng());
+    std::vector<DirtyRect> changed;
+    for (uint64_t i = 0; i < frames; ++i) {
+        clock.SetNs(std::max(clock.NowNs(), static_cast<int64_t>(i) * 16666667));
+        changed.clear();
+        for (uint32_t n = rng() % 4; n > 0; --n) {
+            int32_t left = rng() % width, top = rng() % height;
+            DirtyRect r = { left, top, std::min<int32_t>(width, left + 1 + rng() % 40), std::min<int32_t>(height, top + 1 + rng() % 24) };
+            for (int32_t y = r.top; y < r.bottom; ++y) {
+                for (int32_t x = r.left * 4; x < r.right * 4; ++x) surface[y * rowPitch + x] = static_cast<uint8_t>(rng());
+            }
+            changed.push_back(r);
+        }
+        submitted[i] = surface;
+        // Every 50th frame has no rects, as after a mode change
+        ring.Submit(surface.data(), i, 0, i % 50 == 49 ? nullptr : &changed);
+    }
+    ring.Flush();
+    run.stats = ring.Stats();
+    run.copiedShare = static_cast<double>(backend.CopiedBytes()) / (static_cast<double>(rowPitch * height) * (run.stats.submitted ? run.stats.submitted : 1));
+    return run;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 600;
+    int64_t copyLatency = static_cast<int64_t>((argc > 2 ? std::stod(argv[2]) : 12.0) * 1e6);
+    int64_t encodeCost = static_cast<int64_t>((argc > 3 ? std::stod(argv[3]) : 8.0) * 1e6);
+    double targetFps = argc > 4 ? std::stod(argv[4]) : 60.0;
+
+    std::cout << frames << " frames @ " << targetFps << " fps, copy latency " << copyLatency / 1e6
+              << " ms, encode " << encodeCost / 1e6 << " ms" << std::endl;
+    std::cout << std::left << std::setw(10) << "readback" << std::right << std::setw(10) << "stall ms"
+              << std::setw(8) << "late" << std::setw(10) << "fps" << std::setw(10) << "polls"
+              << std::setw(10) << "blocked" << std::setw(10) << "inflight" << std::setw(10) << "corrupt" << std::endl;
+
+    bool ok = true;
+    const size_t depths[] = { 0, 1, 2, 3, 4 };
+    for (size_t depth : depths) {
+        ReadbackRun run = SimulateReadback(depth, frames, copyLatency, encodeCost, targetFps);
+        std::cout << std::left << std::setw(10) << run.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << run.stallMsPerFrame << std::setw(8) << run.late
+                  << std::setprecision(1) << std::setw(10) << run.fps
+                  << std::setw(10) << run.stats.stillDrawing << std::setw(10) << run.stats.blockingMaps
+                  << std::setw(10) << run.stats.maxInFlight << std::setw(10) << run.corrupt << std::endl;
+        if (run.corrupt || run.delivered != frames) {
+            std::cerr << run.name << ": delivered " << run.delivered << " of " << frames << ", " << run.corrupt << " out of order or corrupt" << std::endl;
+            ok = false;
+        }
+    }
+
+    std::cout << std::left << std::setw(18) << "partial copies" << std::right << std::setw(10) << "delivered" << std::setw(9) << "dropped"
+              << std::setw(9) << "partial" << std::setw(9) << "copied" << std::setw(9) << "wrong" << std::setw(11) << "uncovered" << std::endl;
+    for (RingFullPolicy policy : { RingFullPolicy::WaitOldest, RingFullPolicy::DropNewest }) {
+        for (size_t depth : { 1, 3 }) {
+            PartialRun run = SimulatePartialReadback(depth, policy, frames, copyLatency, encodeCost);
+            std::string name = std::string(policy == RingFullPolicy::WaitOldest ? "wait" : "drop") + ", ring " + std::to_string(depth);
+            std::cout << std::left << std::setw(18) << name << std::right << std::setw(10) << run.delivered << std::setw(9) << run.stats.dropped
+                      << std::setw(9) << run.stats.partialCopies << std::setw(8) << std::setprecision(1) << run.copiedShare * 100.0 << "%"
+                      << std::setw(9) << run.wrong << std::setw(11) << run.uncovered << std::endl;
+            // Besides the rect-less submits, only the first delivery lacks a frame to compare with
+            if (run.wrong || run.uncovered || run.stats.partialCopies == 0 || run.unknown > frames / 50 + 1 || run.copiedShare > 0.5) ok = false;
+        }
+    }
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#pragma once
+// Synthetic stand-in for IDXGIOutputDuplication so the capture path can run headless.
+// Produces BGRA desktops with a few content types that stress encoders differently.
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+enum class SyntheticPattern {
+    Static,         // Nothing changes between frames
+    ScrollingText,  // Text-like rows scrolling up a few pixels per frame
+    Noise,          // Video-like content, every pixel changes every frame
+    Typing,         // Static page; a few glyphs appear per frame at a blinking caret
+    Video           // Full-screen playback: smooth moving shapes with a little sensor grain
+};
+
+// Mirrors the parts of DXGI_OUTDUPL_FRAME_INFO the recorder uses
+struct SyntheticFrameInfo {
+    uint64_t frameIndex = 0;
+    int64_t lastPresentTime = 0;   // Nanoseconds on the source clock
+    uint32_t accumulatedFrames = 0;
+};
+
+class SyntheticFrameSource {
+public:
+    // fps == 0 hands out frames as fast as they are asked for
+    SyntheticFrameSource(uint32_t width, uint32_t height, SyntheticPattern pattern, double fps = 0.0, uint64_t frameCount = 0)
+        : m_width(width), m_height(height), m_pattern(pattern), m_frameCount(frameCount) {
+        m_interval = fps > 0.0 ? std::chrono::nanoseconds(static_cast<int64_t>(1e9 / fps)) : std::chrono::nanoseconds(0);
+        m_base.resize(static_cast<size_t>(width) * height * 4);
+        FillTextLike(m_base.data());
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t RowPitch() const { return m_width * 4; }
+    size_t FrameBytes() const { return m_base.size(); }
+
+    // Fills pixels (rowPitch = width * 4) with the next frame. Returns false once
+    // frameCount frames have been handed out (frameCount == 0 means endless).
+    bool AcquireNextFrame(uint8_t* pixels, SyntheticFrameInfo& info) {
+        if (m_frameCount != 0 && m_next >= m_frameCount) {
+            return false;
+        }
+
+        if (m_interval.count() > 0) {
+            std::this_thread::sleep_until(m_start + m_interval * m_next);
+        }
+
+        RenderFrame(pixels, m_next);
+        info.frameIndex = m_next;
+        info.lastPresentTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+        info.accumulatedFrames = 1;
+        m_next++;
+        return true;
+    }
+
+    bool AcquireNextFrame(std::vector<uint8_t>& pixels, SyntheticFrameInfo& info) {
+        if (pixels.size() < m_base.size()) {
+            pixels.resize(m_base.size());
+        }
+        return AcquireNextFrame(pixels.data(), info);
+    }
+
+    // Render frame n without pacing, for benchmarks that want exact content
+    void RenderFrame(uint8_t* pixels, uint64_t n) {
+        const size_t pitch = RowPitch();
+        switch (m_pattern) {
+        case SyntheticPattern::Static:
+            std::memcpy(pixels, m_base.data(), m_base.size());
+            break;
+        case SyntheticPattern::ScrollingText: {
+            uint32_t offset = static_cast<uint32_t>((n * 3) % m_height);
+            for (uint32_t y = 0; y < m_height; ++y) {
+                std::memcpy(pixels + y * pitch, m_base.data() + ((y + offset) % m_height) * pitch, pitch);
+            }
+            break;
+        }
+        case SyntheticPattern::Typing: {
+            // One glyph every other frame into a 4-line box that starts over when full
+            std::memcpy(pixels, m_base.data(), m_base.size());
+            const uint32_t columns = m_width / 8 > 2 ? m_width / 8 - 2 : 1;
+            const uint32_t lines = m_height / 16 > 4 ? 4 : 1;
+            uint64_t typed = (n / 2) % (static_cast<uint64_t>(columns) * lines);
+            for (uint64_t c = 0; c <= typed; ++c) {
+                uint32_t x0 = 8 + static_cast<uint32_t>(c % columns) * 8;
+                uint32_t y0 = static_cast<uint32_t>(c / columns) * 16;
+                bool caret = c == typed;
+                if (caret && (n / 30) % 2) break;   // Caret blinks every half second at 60 Hz
+                uint32_t glyph = static_cast<uint32_t>(c * 2654435761u);
+                for (uint32_t y = y0 + 3; y <= y0 + 12 && y < m_height; ++y) {
+                    for (uint32_t x = x0; x < x0 + (caret ? 2 : 6) && x < m_width; ++x) {
+                        bool ink = caret || ((glyph >> ((y + x) % 16)) & 1);
+                        uint8_t* p = pixels + y * pitch + static_cast<size_t>(x) * 4;
+                        p[0] = ink ? 0x30 : 0xFF;
+                        p[1] = ink ? 0x20 : 0xFF;
+                        p[2] = ink ? 0x10 : 0xFF;
+                    }
+                }
+            }
+            break;
+        }
+        case SyntheticPattern::Video: {
+            // Sum of drifting row and column waves per channel, plus +-3 of hashed grain
+            std::vector<float> columnWave(static_cast<size_t>(m_width) * 3), rowWave(static_cast<size_t>(m_height) * 3);
+            for (uint32_t x = 0; x < m_width; ++x) {
+                for (int c = 0; c < 3; ++c) columnWave[x * 3 + c] = 60.0f * std::sin(x / (90.0f + 25 * c) + n * 0.04f * (c + 1));
+            }
+            for (uint32_t y = 0; y < m_height; ++y) {
+                for (int c = 0; c < 3; ++c) rowWave[y * 3 + c] = 128.0f + 50.0f * std::cos(y / (70.0f + 20 * c) - n * 0.03f * (3 - c));
+            }
+            uint32_t grain = static_cast<uint32_t>(n * 0x9E3779B9u) | 1;
+            for (uint32_t y = 0; y < m_height; ++y) {
+                uint8_t* row = pixels + y * pitch;
+                for (uint32_t x = 0; x < m_width; ++x) {
+                    grain ^= grain << 13;
+                    grain ^= grain >> 17;
+                    grain ^= grain << 5;
+                    for (int c = 0; c < 3; ++c) {
+                        int v = static_cast<int>(rowWave[y * 3 + c] + columnWave[x * 3 + c]) + static_cast<int>((grain >> (c * 8)) % 7) - 3;
+                        row[x * 4 + c] = static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v);
+                    }
+                    row[x * 4 + 3] = 0xFF;
+                }
+            }
+            break;
+        }
+        case SyntheticPattern::Noise: {
+            uint64_t state = 0x9E3779B97F4A7C15ull ^ (n + 1) * 0xBF58476D1CE4E5B9ull;
+            uint64_t* out = reinterpret_cast<uint64_t*>(pixels);
+            size_t words = m_base.size() / 8;
+            for (size_t i = 0; i < words; ++i) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                out[i] = state | 0xFF000000FF000000ull; // Keep alpha opaque
+            }
+            break;
+        }
+        }
+    }
+
+private:
+    // White background with 16 px text lines made of dark glyph-sized blobs
+    void FillTextLike(uint8_t* pixels) {
+        uint32_t seed = 12345;
+        for (uint32_t y = 0; y < m_height; ++y) {
+            uint8_t* row = pixels + static_cast<size_t>(y) * RowPitch();
+            uint32_t line = y / 16;
+            uint32_t inLine = y % 16;
+            for (uint32_t x = 0; x < m_width; ++x) {
+                uint32_t glyph = x / 8;
+                seed = (line * 7919u + glyph * 104729u) ^ 0x5bd1e995u;
+                seed ^= seed >> 13;
+                seed *= 0x2c1b3c6du;
+                bool ink = inLine >= 3 && inLine <= 12 && (x % 8) < 6 && ((seed >> ((inLine + x) % 16)) & 1) && (line % 5 != 4);
+                uint8_t value = ink ? 0x20 : 0xF0;
+                row[x * 4 + 0] = value;
+                row[x * 4 + 1] = value;
+                row[x * 4 + 2] = ink ? 0x20 : 0xF4;
+                row[x * 4 + 3] = 0xFF;
+            }
+        }
+    }
+
+    uint32_t m_width;
+    uint32_t m_height;
+    SyntheticPattern m_pattern;
+    uint64_t m_frameCount;
+    uint64_t m_next = 0;
+    std::chrono::nanoseconds m_interval;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<uint8_t> m_base;
+};
@@ -0,0 +1,121 @@
+#pragma once
+// Fixed set of worker threads for data-parallel work inside one frame (strip encoding,
+// hashing, colour conversion). ParallelFor() hands out indices from a shared counter, so
+// uneven items balance themselves; the calling thread works too and returns when every
+// index is done. One pool can be shared; calls from several threads simply queue.
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // 0 threads = one per hardware thread, counting the caller
+    explicit ThreadPool(size_t threads = 0) {
+        if (threads == 0) threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for (size_t i = 1; i < threads; ++i) {
+            m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& t : m_workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that run ParallelFor() bodies, the caller included
+    size_t Concurrency() const { return m_workers.size() + 1; }
+
+    // Calls body(i) once for every i in [0, count); returns when all calls have finished.
+    // Bodies must not throw.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+        if (count == 0) return;
+        if (count == 1 || m_workers.empty()) {
+            for (size_t i = 0; i < count; ++i) body(i);
+            return;
+        }
+
+        Batch batch(count, body);
+        size_t helpers = std::min(count - 1, m_workers.size());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < helpers; ++i) m_queue.push_back(&batch);
+        }
+        if (helpers == 1) m_wake.notify_one();
+        else m_wake.notify_all();
+
+        batch.Work();
+
+        // Helpers still queued for this batch have nothing left to do; drop them
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), &batch), m_queue.end());
+        }
+        std::unique_lock<std::mutex> lock(batch.mutex);
+        batch.finished.wait(lock, [&batch] { return batch.done == batch.count && batch.active == 0; });
+    }
+
+private:
+    struct Batch {
+        Batch(size_t n, const std::function<void(size_t)>& f) : count(n), body(f) {}
+
+        void Work() {
+            size_t finishedHere = 0;
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                body(i);
+                finishedHere++;
+            }
+            if (finishedHere) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done += finishedHere;
+                if (done == count) finished.notify_all();
+            }
+        }
+
+        const size_t count;
+        const std::function<void(size_t)>& body;
+        std::atomic<size_t> next{ 0 };
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t done = 0;        // Guarded by 'mutex'
+        size_t active = 0;      // Workers inside Work(); the batch lives on the caller's stack
+    };
+
+    void WorkerLoop() {
+        for (;;) {
+            Batch* batch = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty()) return;
+                batch = m_queue.front();
+                m_queue.pop_front();
+                // Registered while m_mutex is held, so the caller cannot miss it after dequeuing
+                std::lock_guard<std::mutex> batchLock(batch->mutex);
+                batch->active++;
+            }
+            batch->Work();
+            std::lock_guard<std::mutex> batchLock(batch->mutex);
+            batch->active--;
+            batch->finished.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Batch*> m_queue;
+    bool m_stopping = false;
+};
@@ -0,0 +1,134 @@
+#pragma once
+// Turns the captured desktop size into a grid of output regions (2x1 halves, 2x2 or
+// 3x1 video walls, ...) with optional bezel compensation or overlap between tiles.
+// The copy plan is built once per layout; the per-frame path only walks 'copies'.
+#include "ImageView.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TileLayoutConfig {
+    uint32_t columns = 2;
+    uint32_t rows = 1;
+    uint32_t bezelX = 0;    // Source pixels hidden behind the bezel between neighbouring columns
+    uint32_t bezelY = 0;    // Same between neighbouring rows
+    uint32_t overlapX = 0;  // Source pixels shown on both neighbouring columns (edge blending)
+    uint32_t overlapY = 0;
+};
+
+inline bool operator==(const TileLayoutConfig& a, const TileLayoutConfig& b) {
+    return a.columns == b.columns && a.rows == b.rows && a.bezelX == b.bezelX && a.bezelY == b.bezelY &&
+           a.overlapX == b.overlapX && a.overlapY == b.overlapY;
+}
+
+inline bool operator!=(const TileLayoutConfig& a, const TileLayoutConfig& b) {
+    return !(a == b);
+}
+
+// One output region; copied to (0, 0) of that output's texture
+struct TileCopy {
+    uint32_t output;    // Row-major tile index
+    uint32_t column;
+    uint32_t row;
+    uint32_t left;      // Source region in the captured texture
+    uint32_t top;
+    uint32_t right;
+    uint32_t bottom;
+};
+
+struct TileLayout {
+    TileLayoutConfig config;
+    uint32_t sourceWidth = 0;
+    uint32_t sourceHeight = 0;
+    uint32_t tileWidth = 0;
+    uint32_t tileHeight = 0;
+    std::vector<TileCopy> copies;
+
+    size_t TileCount() const { return copies.size(); }
+};
+
+// Size one axis: n tiles of equal size separated by 'spacing' (negative = overlap).
+// Leftover pixels that do not divide evenly are left uncaptured on the far edge.
+inline bool SizeTileAxis(uint32_t sourceSize, uint32_t count, int64_t spacing, uint32_t& tileSize) {
+    if (count == 0) return false;
+    int64_t usable = static_cast<int64_t>(sourceSize) - static_cast<int64_t>(count - 1) * spacing;
+    if (usable <= 0) return false;
+    int64_t size = usable / count;
+    if (size <= 0 || size > sourceSize || (spacing < 0 && -spacing >= size)) return false;
+    tileSize = static_cast<uint32_t>(size);
+    return true;
+}
+
+inline bool BuildTileLayout(uint32_t sourceWidth, uint32_t sourceHeight, const TileLayoutConfig& config, TileLayout& layout) {
+    int64_t spacingX = static_cast<int64_t>(config.bezelX) - config.overlapX;
+    int64_t spacingY = static_cast<int64_t>(config.bezelY) - config.overlapY;
+
+    uint32_t tileWidth = 0;
+    uint32_t tileHeight = 0;
+    if (!SizeTileAxis(sourceWidth, config.columns, spacingX, tileWidth) ||
+        !SizeTileAxis(sourceHeight, config.rows, spacingY, tileHeight)) {
+        return false;
+    }
+
+    layout.config = config;
+    layout.sourceWidth = sourceWidth;
+    layout.sourceHeight = sourceHeight;
+    layout.tileWidth = tileWidth;
+    layout.tileHeight = tileHeight;
+    layout.copies.clear();
+    layout.copies.reserve(static_cast<size_t>(config.columns) * config.rows);
+
+    for (uint32_t row = 0; row < config.rows; ++row) {
+        uint32_t top = static_cast<uint32_t>(row * (tileHeight + spacingY));
+        for (uint32_t column = 0; column < config.columns; ++column) {
+            uint32_t left = static_cast<uint32_t>(column * (tileWidth + spacingX));
+            TileCopy copy;
+            copy.output = row * config.columns + column;
+            copy.column = column;
+            copy.row = row;
+            copy.left = left;
+            copy.top = top;
+            copy.right = left + tileWidth;
+            copy.bottom = top + tileHeight;
+            layout.copies.push_back(copy);
+        }
+    }
+    return true;
+}
+
+// Keeps the current plan and rebuilds it only when the captured size or config changes
+class TileLayoutCache {
+public:
+    // Returns nullptr if the config cannot be laid out on this source size
+    const TileLayout* Get(uint32_t sourceWidth, uint32_t sourceHeight, const TileLayoutConfig& config) {
+        if (m_valid && m_layout.sourceWidth == sourceWidth && m_layout.sourceHeight == sourceHeight && m_layout.config == config) {
+            return &m_layout;
+        }
+        m_valid = BuildTileLayout(sourceWidth, sourceHeight, config, m_layout);
+        m_rebuilds++;
+        return m_valid ? &m_layout : nullptr;
+    }
+
+    void Invalidate() { m_valid = false; }
+    uint64_t Rebuilds() const { return m_rebuilds; }
+
+private:
+    TileLayout m_layout;
+    bool m_valid = false;
+    uint64_t m_rebuilds = 0;
+};
+
+// One view per output tile into the full frame, indexed by TileCopy::output. No pixels
+// move: after a single full-frame readback every consumer reads its tile in place.
+inline void BuildTileViews(const ImageView& frame, const TileLayout& layout, std::vector<ImageView>& views) {
+    views.resize(layout.TileCount());
+    for (const TileCopy& copy : layout.copies) {
+        views[copy.output] = frame.Crop(copy.left, copy.top, copy.right - copy.left, copy.bottom - copy.top);
+    }
+}
+
+#ifdef __d3d11_h__
+inline D3D11_BOX TileSourceBox(const TileCopy& copy) {
+    return { copy.left, copy.top, 0, copy.right, copy.bottom, 1 };
+}
+#endif
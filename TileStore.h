@@ -0,0 +1,565 @@
+#pragma once
+// Content-addressed tile store. Each captured tile (a half, by default) is cut into square
+// cells (64x64 by default); every cell gets a 128-bit fingerprint, and a cell whose
+// fingerprint has been seen before, in this frame or any earlier one, is referenced instead
+// of stored again. Frames become lists of cell ids, run-coded against the previous frame,
+// so windows that flip between a few states (dashboards, slideshows) stop costing disk.
+//
+// The fingerprint is an XXH3-style 512-bit multiply-accumulate over the cell's rows, with
+// scalar and AVX2 kernels that produce identical digests. Cells are hashed, and new cells
+// compressed with the screen codec, in parallel on a ThreadPool.
+//
+// File (.tstore): 24-byte header { "TSTR", version, width, height, cell size, reserved },
+// then records. 'C' { id u32, digest lo u64, hi u64, width u16, height u16, bytes u32,
+// screen codec payload } adds a cell; 'F' { frameIndex u64, timestamp i64, bytes u32,
+// payload } is a frame: repeated (unchanged run varint, new count varint, new ids varint).
+// A cell record always precedes the first frame that uses it. Records are appended through an
+// AsyncFileWriter; a frame is queued whole or not at all.
+#include "AsyncFileWriter.h"
+#include "ImageView.h"
+#include "PixelKernels.h"
+#include "ScreenCodec.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+struct TileDigest {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(const TileDigest& other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const TileDigest& other) const { return !(*this == other); }
+};
+
+struct TileDigestHasher {
+    size_t operator()(const TileDigest& digest) const { return static_cast<size_t>(digest.lo); }
+};
+
+namespace TileHashDetail {
+
+const size_t kStripeBytes = 64;
+const size_t kStripesPerBlock = 16;    // Accumulators are scrambled after every block
+const uint64_t kPrime32 = 0x9E3779B1u;
+const uint64_t kPrime64a = 0x9E3779B185EBCA87ull;
+const uint64_t kPrime64b = 0xC2B2AE3D27D4EB4Full;
+
+// 192 bytes of key material, as XXH3's secret: stripe n reads words n % 16 .. n % 16 + 7
+struct Secret {
+    uint64_t words[24];
+    Secret() {
+        uint64_t state = 0x243F6A8885A308D3ull;     // Digits of pi; any fixed seed will do
+        for (uint64_t& w : words) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            w = z ^ (z >> 31);
+        }
+    }
+};
+
+inline const Secret& GetSecret() {
+    static const Secret secret;
+    return secret;
+}
+
+inline uint64_t Load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint64_t MulFold64(uint64_t a, uint64_t b) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#elif defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t aLo = a & 0xFFFFFFFFu, aHi = a >> 32, bLo = b & 0xFFFFFFFFu, bHi = b >> 32;
+    uint64_t lolo = aLo * bLo, hilo = aHi * bLo, lohi = aLo * bHi, hihi = aHi * bHi;
+    uint64_t cross = (lolo >> 32) + (hilo & 0xFFFFFFFFu) + lohi;
+    uint64_t high = hihi + (hilo >> 32) + (cross >> 32);
+    uint64_t low = (cross << 32) | (lolo & 0xFFFFFFFFu);
+    return low ^ high;
+#endif
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    return h ^ (h >> 32);
+}
+
+// Stripes one row feeds in: whole 64-byte stripes, the last one zero-padded
+inline size_t RowStripes(size_t rowBytes) { return (rowBytes + kStripeBytes - 1) / kStripeBytes; }
+
+inline void AccumulateStripeScalar(uint64_t acc[8], const uint8_t* stripe, const uint64_t* key) {
+    for (int i = 0; i < 8; ++i) {
+        uint64_t data = Load64(stripe + i * 8);
+        uint64_t keyed = data ^ key[i];
+        acc[i ^ 1] += data;
+        acc[i] += (keyed & 0xFFFFFFFFu) * (keyed >> 32);
+    }
+}
+
+inline void ScrambleScalar(uint64_t acc[8], const uint64_t* key) {
+    for (int i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * kPrime32;
+    }
+}
+
+inline void HashRowsScalar(const ImageView& cell, uint64_t acc[8]) {
+    const uint64_t* secret = GetSecret().words;
+    const size_t rowBytes = cell.RowBytes();
+    const size_t fullStripes = rowBytes / kStripeBytes;
+    size_t stripe = 0;
+    uint8_t padded[kStripeBytes];
+    for (uint32_t y = 0; y < cell.height; ++y) {
+        const uint8_t* row = cell.Row(y);
+        for (size_t s = 0; s < RowStripes(rowBytes); ++s, ++stripe) {
+            const uint8_t* data = row + s * kStripeBytes;
+            if (s == fullStripes) {
+                std::memset(padded, 0, sizeof(padded));
+                std::memcpy(padded, data, rowBytes - s * kStripeBytes);
+                data = padded;
+            }
+            AccumulateStripeScalar(acc, data, secret + stripe % kStripesPerBlock);
+            if (stripe % kStripesPerBlock == kStripesPerBlock - 1) ScrambleScalar(acc, secret + 16);
+        }
+    }
+}
+
+#ifdef PIXEL_KERNELS_X86
+PIXEL_KERNELS_AVX2_TARGET inline __m256i AccumulateAvx2(__m256i acc, __m256i data, __m256i key) {
+    __m256i keyed = _mm256_xor_si256(data, key);
+    __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+    __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));   // acc[i ^ 1] += data[i]
+    return _mm256_add_epi64(acc, _mm256_add_epi64(product, swapped));
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline __m256i ScrambleAvx2(__m256i acc, __m256i key) {
+    const __m256i prime = _mm256_set1_epi64x(static_cast<long long>(kPrime32));
+    acc = _mm256_xor_si256(_mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47)), key);
+    // 64 x 32-bit multiply from two 32 x 32 products
+    __m256i low = _mm256_mul_epu32(acc, prime);
+    __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(acc, 32), prime);
+    return _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline void HashRowsAvx2(const ImageView& cell, uint64_t acc[8]) {
+    const uint64_t* secret = GetSecret().words;
+    const size_t rowBytes = cell.RowBytes();
+    const size_t fullStripes = rowBytes / kStripeBytes;
+    __m256i acc0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    __m256i acc1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4));
+    const __m256i scrambleKey0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 16));
+    const __m256i scrambleKey1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 20));
+    alignas(32) uint8_t padded[kStripeBytes];
+
+    size_t stripe = 0;
+    for (uint32_t y = 0; y < cell.height; ++y) {
+        const uint8_t* row = cell.Row(y);
+        for (size_t s = 0; s < RowStripes(rowBytes); ++s, ++stripe) {
+            const uint8_t* data = row + s * kStripeBytes;
+            if (s == fullStripes) {
+                std::memset(padded, 0, sizeof(padded));
+                std::memcpy(padded, data, rowBytes - s * kStripeBytes);
+                data = padded;
+            }
+            const uint64_t* key = secret + stripe % kStripesPerBlock;
+            acc0 = AccumulateAvx2(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key)));
+            acc1 = AccumulateAvx2(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + 4)));
+            if (stripe % kStripesPerBlock == kStripesPerBlock - 1) {
+                acc0 = ScrambleAvx2(acc0, scrambleKey0);
+                acc1 = ScrambleAvx2(acc1, scrambleKey1);
+            }
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), acc0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4), acc1);
+}
+#endif
+
+inline uint64_t MergeAccumulators(const uint64_t acc[8], const uint64_t* key, uint64_t start) {
+    uint64_t result = start;
+    for (int i = 0; i < 4; ++i) result += MulFold64(acc[2 * i] ^ key[2 * i], acc[2 * i + 1] ^ key[2 * i + 1]);
+    return Avalanche(result);
+}
+
+}  // namespace TileHashDetail
+
+// Fingerprint of a cell's pixels (its size is mixed in, so a 32x64 and a 64x32 cell with
+// the same bytes differ). Every level returns the same digest.
+inline TileDigest HashTile(const ImageView& cell, PixelKernelLevel level = BestPixelKernelLevel()) {
+    using namespace TileHashDetail;
+    uint64_t acc[8] = { kPrime32, kPrime64a, kPrime64b, 0x165667B19E3779F9ull,
+                        0x85EBCA77C2B2AE63ull, 0x27D4EB2F165667C5ull, kPrime64a ^ kPrime64b, 0x61C8864E7A143579ull };
+#ifdef PIXEL_KERNELS_X86
+    if (level == PixelKernelLevel::Avx2 && PixelKernelLevelSupported(level)) HashRowsAvx2(cell, acc);
+    else HashRowsScalar(cell, acc);
+#else
+    (void)level;
+    HashRowsScalar(cell, acc);
+#endif
+    const uint64_t* secret = GetSecret().words;
+    uint64_t shape = (static_cast<uint64_t>(cell.width) << 32) | cell.height;
+    TileDigest digest;
+    digest.lo = MergeAccumulators(acc, secret + 3, shape * kPrime64a);
+    digest.hi = MergeAccumulators(acc, secret + 11, ~(shape * kPrime64b));
+    return digest;
+}
+
+// Cell grid over a width x height image; the last column and row may be narrower
+struct TileGrid {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t cellSize = 64;
+    uint32_t columns = 0;
+    uint32_t rows = 0;
+
+    TileGrid() = default;
+    TileGrid(uint32_t w, uint32_t h, uint32_t cell)
+        : width(w), height(h), cellSize(cell ? cell : 64),
+          columns((w + cellSize - 1) / cellSize), rows((h + cellSize - 1) / cellSize) {}
+
+    size_t CellCount() const { return static_cast<size_t>(columns) * rows; }
+
+    ImageView Cell(const ImageView& image, size_t index) const {
+        uint32_t x = static_cast<uint32_t>(index % columns) * cellSize;
+        uint32_t y = static_cast<uint32_t>(index / columns) * cellSize;
+        return image.Crop(x, y, std::min(cellSize, width - x), std::min(cellSize, height - y));
+    }
+};
+
+// Digests of every cell of 'image', one grid row per ParallelFor item
+inline void HashTileGrid(const ImageView& image, const TileGrid& grid, std::vector<TileDigest>& digests, ThreadPool* pool,
+                         PixelKernelLevel level = BestPixelKernelLevel()) {
+    digests.resize(grid.CellCount());
+    auto hashRow = [&](size_t row) {
+        for (size_t c = row * grid.columns; c < (row + 1) * grid.columns; ++c) digests[c] = HashTile(grid.Cell(image, c), level);
+    };
+    if (pool) pool->ParallelFor(grid.rows, hashRow);
+    else for (size_t row = 0; row < grid.rows; ++row) hashRow(row);
+}
+
+struct TileFrameStats {
+    size_t cells = 0;
+    size_t unchanged = 0;       // Same cell as the previous frame at this position
+    size_t reused = 0;          // Changed, but already in the store
+    size_t added = 0;           // New cells written
+    size_t bytes = 0;           // Written for this frame, cell and frame records
+};
+
+struct TileStoreStats {
+    uint64_t frames = 0;
+    uint64_t cells = 0;         // Distinct cells stored
+    uint64_t cellReferences = 0;
+    uint64_t bytes = 0;         // File size so far
+    uint64_t droppedFrames = 0; // Refused by the writer while the disk was behind
+};
+
+namespace TileStoreDetail {
+
+const char kMagic[4] = { 'T', 'S', 'T', 'R' };
+const uint32_t kVersion = 1;
+const size_t kHeaderBytes = 24;
+const uint8_t kCellRecord = 'C';
+const uint8_t kFrameRecord = 'F';
+const uint32_t kNoCell = 0xFFFFFFFFu;
+
+// (unchanged run, new count, new ids...) against the previous frame's ids
+inline void PutFrameIds(const std::vector<uint32_t>& ids, const std::vector<uint32_t>& previous, std::vector<uint8_t>& out) {
+    size_t i = 0;
+    uint8_t varint[5];
+    while (i < ids.size()) {
+        size_t same = i;
+        while (same < ids.size() && ids[same] == previous[same]) same++;
+        size_t changed = same;
+        while (changed < ids.size() && ids[changed] != previous[changed]) changed++;
+        out.insert(out.end(), varint, ScreenCodecDetail::PutVarint(varint, static_cast<uint32_t>(same - i)));
+        out.insert(out.end(), varint, ScreenCodecDetail::PutVarint(varint, static_cast<uint32_t>(changed - same)));
+        for (size_t c = same; c < changed; ++c) out.insert(out.end(), varint, ScreenCodecDetail::PutVarint(varint, ids[c]));
+        i = changed;
+    }
+}
+
+inline bool GetFrameIds(const uint8_t* data, size_t size, std::vector<uint32_t>& ids) {
+    const uint8_t* in = data;
+    const uint8_t* end = data + size;
+    size_t i = 0;
+    while (in < end) {
+        uint32_t same, changed;
+        if (!ScreenCodecDetail::GetVarint(in, end, same) || !ScreenCodecDetail::GetVarint(in, end, changed)) return false;
+        if (same > ids.size() - i || changed > ids.size() - i - same) return false;
+        i += same;
+        for (uint32_t c = 0; c < changed; ++c, ++i) {
+            if (!ScreenCodecDetail::GetVarint(in, end, ids[i])) return false;
+        }
+    }
+    return i == ids.size();
+}
+
+}  // namespace TileStoreDetail
+
+// Writes one .tstore per captured tile. Not thread-safe; AddFrame() uses 'pool' internally.
+class TileStoreWriter {
+public:
+    ~TileStoreWriter() { Close(); }
+
+    bool Open(const std::string& path, uint32_t width, uint32_t height, uint32_t cellSize = 64, ThreadPool* pool = nullptr,
+              const AsyncFileWriterOptions& io = AsyncFileWriterOptions()) {
+        using namespace TileStoreDetail;
+        Close();
+        if (!m_file.Open(path, io)) return false;
+        m_grid = TileGrid(width, height, cellSize);
+        m_pool = pool;
+        m_cells.clear();
+        m_previousDigests.clear();
+        m_previousIds.assign(m_grid.CellCount(), kNoCell);
+        m_stats = TileStoreStats();
+        uint8_t header[kHeaderBytes] = {};
+        std::memcpy(header, kMagic, 4);
+        std::memcpy(header + 4, &kVersion, 4);
+        std::memcpy(header + 8, &width, 4);
+        std::memcpy(header + 12, &height, 4);
+        std::memcpy(header + 16, &m_grid.cellSize, 4);
+        m_stats.bytes = kHeaderBytes;
+        return m_file.Append(header, sizeof(header));
+    }
+
+    bool AddFrame(const ImageView& image, const ScreenStreamFrameInfo& info, TileFrameStats* frameStats = nullptr) {
+        using namespace TileStoreDetail;
+        if (!m_file.IsOpen() || image.width != m_grid.width || image.height != m_grid.height) return false;
+        TileFrameStats stats;
+        stats.cells = m_grid.CellCount();
+        uint64_t startBytes = m_stats.bytes;
+
+        HashTileGrid(image, m_grid, m_digests, m_pool);
+
+        // Resolve ids on this thread; cells new to the store are queued for encoding
+        m_ids.resize(stats.cells);
+        m_newCells.clear();
+        for (size_t c = 0; c < stats.cells; ++c) {
+            if (!m_previousDigests.empty() && m_digests[c] == m_previousDigests[c]) {
+                m_ids[c] = m_previousIds[c];
+                stats.unchanged++;
+                continue;
+            }
+            auto found = m_cells.find(m_digests[c]);
+            if (found != m_cells.end()) {
+                m_ids[c] = found->second;
+                stats.reused++;
+                continue;
+            }
+            uint32_t id = static_cast<uint32_t>(m_cells.size());
+            m_cells.emplace(m_digests[c], id);
+            m_ids[c] = id;
+            m_newCells.push_back(c);
+        }
+        stats.added = m_newCells.size();
+
+        m_encoded.resize(std::max(m_encoded.size(), m_newCells.size()));
+        auto encodeCell = [&](size_t i) {
+            m_encoded[i].clear();
+            EncodeScreenFrame(m_grid.Cell(image, m_newCells[i]), m_encoded[i]);
+        };
+        if (m_pool) m_pool->ParallelFor(m_newCells.size(), encodeCell);
+        else for (size_t i = 0; i < m_newCells.size(); ++i) encodeCell(i);
+
+        m_frameIds.clear();
+        PutFrameIds(m_ids, m_previousIds, m_frameIds);
+
+        // All of the frame or none of it: a dropped frame forgets the cells it introduced
+        size_t frameBytes = 21 + m_frameIds.size();
+        for (size_t i = 0; i < m_newCells.size(); ++i) frameBytes += 29 + m_encoded[i].size();
+        if (!m_file.CanAppend(frameBytes)) {
+            for (size_t c : m_newCells) m_cells.erase(m_digests[c]);
+            m_stats.droppedFrames++;
+            return false;
+        }
+
+        bool ok = true;
+        for (size_t i = 0; i < m_newCells.size() && ok; ++i) {
+            size_t c = m_newCells[i];
+            ImageView cell = m_grid.Cell(image, c);
+            uint8_t record[29];
+            uint16_t w = static_cast<uint16_t>(cell.width), h = static_cast<uint16_t>(cell.height);
+            uint32_t size = static_cast<uint32_t>(m_encoded[i].size());
+            record[0] = kCellRecord;
+            std::memcpy(record + 1, &m_ids[c], 4);
+            std::memcpy(record + 5, &m_digests[c].lo, 8);
+            std::memcpy(record + 13, &m_digests[c].hi, 8);
+            std::memcpy(record + 21, &w, 2);
+            std::memcpy(record + 23, &h, 2);
+            std::memcpy(record + 25, &size, 4);
+            ok = m_file.Append(record, sizeof(record)) && m_file.Append(m_encoded[i].data(), size);
+            m_stats.bytes += sizeof(record) + size;
+        }
+
+        uint8_t record[21];
+        uint32_t size = static_cast<uint32_t>(m_frameIds.size());
+        m_lastFrameOffset = m_stats.bytes;
+        m_lastFrameBytes = size;
+        record[0] = kFrameRecord;
+        std::memcpy(record + 1, &info.frameIndex, 8);
+        std::memcpy(record + 9, &info.timestamp, 8);
+        std::memcpy(record + 17, &size, 4);
+        ok = ok && m_file.Append(record, sizeof(record)) && (size == 0 || m_file.Append(m_frameIds.data(), size));
+        m_stats.bytes += sizeof(record) + size;
+
+        m_previousDigests.swap(m_digests);
+        m_previousIds.swap(m_ids);
+        m_stats.frames++;
+        m_stats.cells = m_cells.size();
+        m_stats.cellReferences += stats.cells;
+        stats.bytes = static_cast<size_t>(m_stats.bytes - startBytes);
+        if (frameStats) *frameStats = stats;
+        return ok;
+    }
+
+    bool Close() {
+        return m_file.Close();
+    }
+
+    bool IsOpen() const { return m_file.IsOpen(); }
+    const TileGrid& Grid() const { return m_grid; }
+    TileStoreStats Stats() const { return m_stats; }
+    AsyncFileWriterStats WriteStats() const { return m_file.Stats(); }
+
+    // Where the last frame's 'F' record starts and its id bytes, after an AddFrame that
+    // returned true. Only a store's first frame decodes on its own: later ones are run-coded
+    // against the frame before and may use any cell stored so far.
+    uint64_t LastFrameOffset() const { return m_lastFrameOffset; }
+    uint32_t LastFrameBytes() const { return m_lastFrameBytes; }
+
+private:
+    AsyncFileWriter m_file;
+    ThreadPool* m_pool = nullptr;
+    TileGrid m_grid;
+    TileStoreStats m_stats;
+    std::unordered_map<TileDigest, uint32_t, TileDigestHasher> m_cells;
+    std::vector<TileDigest> m_digests;
+    std::vector<TileDigest> m_previousDigests;
+    std::vector<uint32_t> m_ids;
+    std::vector<uint32_t> m_previousIds;
+    std::vector<size_t> m_newCells;
+    std::vector<std::vector<uint8_t>> m_encoded;
+    std::vector<uint8_t> m_frameIds;
+    uint64_t m_lastFrameOffset = 0;
+    uint32_t m_lastFrameBytes = 0;
+};
+
+// Plays a .tstore back frame by frame. Cells are decoded once and kept, so memory grows
+// with the number of distinct cells, which is the point of the store.
+class TileStoreReader {
+public:
+    ~TileStoreReader() { Close(); }
+
+    bool Open(const std::string& path) {
+        using namespace TileStoreDetail;
+        Close();
+        m_file = std::fopen(path.c_str(), "rb");
+        if (!m_file) return false;
+        uint8_t header[kHeaderBytes];
+        uint32_t version = 0, width = 0, height = 0, cellSize = 0;
+        if (std::fread(header, 1, sizeof(header), m_file) != sizeof(header) || std::memcmp(header, kMagic, 4) != 0) {
+            Close();
+            return false;
+        }
+        std::memcpy(&version, header + 4, 4);
+        std::memcpy(&width, header + 8, 4);
+        std::memcpy(&height, header + 12, 4);
+        std::memcpy(&cellSize, header + 16, 4);
+        if (version != kVersion || cellSize == 0) {
+            Close();
+            return false;
+        }
+        m_grid = TileGrid(width, height, cellSize);
+        m_ids.assign(m_grid.CellCount(), kNoCell);
+        return true;
+    }
+
+    void Close() {
+        if (m_file) std::fclose(m_file);
+        m_file = nullptr;
+        m_cells.clear();
+    }
+
+    uint32_t Width() const { return m_grid.width; }
+    uint32_t Height() const { return m_grid.height; }
+    size_t CellsLoaded() const { return m_cells.size(); }
+
+    // Decodes the next frame into tightly packed BGRA; false at the end or on error
+    bool ReadFrame(std::vector<uint8_t>& pixels, ScreenStreamFrameInfo& info) {
+        using namespace TileStoreDetail;
+        if (!m_file) return false;
+        for (;;) {
+            uint8_t type;
+            if (std::fread(&type, 1, 1, m_file) != 1) return false;
+            if (type == kCellRecord) {
+                if (!ReadCell()) return false;
+                continue;
+            }
+            if (type != kFrameRecord) return false;
+            uint8_t record[20];
+            uint32_t size;
+            if (std::fread(record, 1, sizeof(record), m_file) != sizeof(record)) return false;
+            std::memcpy(&info.frameIndex, record, 8);
+            std::memcpy(&info.timestamp, record + 8, 8);
+            std::memcpy(&size, record + 16, 4);
+            m_payload.resize(size);
+            if (std::fread(m_payload.data(), 1, size, m_file) != size || !GetFrameIds(m_payload.data(), size, m_ids)) return false;
+            break;
+        }
+
+        const size_t pitch = static_cast<size_t>(m_grid.width) * 4;
+        pixels.resize(pitch * m_grid.height);
+        ImageView frame(pixels.data(), m_grid.width, m_grid.height, pitch);
+        for (size_t c = 0; c < m_ids.size(); ++c) {
+            if (m_ids[c] >= m_cells.size()) return false;
+            const std::vector<uint8_t>& cell = m_cells[m_ids[c]];
+            ImageView target = m_grid.Cell(frame, c);
+            if (cell.size() != target.RowBytes() * target.height) return false;
+            for (uint32_t y = 0; y < target.height; ++y) {
+                std::memcpy(const_cast<uint8_t*>(target.Row(y)), cell.data() + y * target.RowBytes(), target.RowBytes());
+            }
+        }
+        return true;
+    }
+
+private:
+    bool ReadCell() {
+        uint8_t record[28];
+        if (std::fread(record, 1, sizeof(record), m_file) != sizeof(record)) return false;
+        uint32_t id, size;
+        uint16_t w, h;
+        std::memcpy(&id, record, 4);
+        std::memcpy(&w, record + 20, 2);
+        std::memcpy(&h, record + 22, 2);
+        std::memcpy(&size, record + 24, 4);
+        if (id != m_cells.size()) return false;     // Ids are handed out in order
+        m_payload.resize(size);
+        if (std::fread(m_payload.data(), 1, size, m_file) != size) return false;
+        m_cells.emplace_back(static_cast<size_t>(w) * h * 4);
+        return DecodeScreenFrame(m_payload.data(), size, w, h, m_cells.back().data(), static_cast<size_t>(w) * 4);
+    }
+
+    std::FILE* m_file = nullptr;
+    TileGrid m_grid;
+    std::vector<uint32_t> m_ids;
+    std::vector<std::vector<uint8_t>> m_cells;
+    std::vector<uint8_t> m_payload;
+};
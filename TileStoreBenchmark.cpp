@@ -0,0 +1,177 @@
+// Benchmarks cell hashing and the content-addressed tile store on synthetic 2560x1440
+// halves. First checks that the scalar and AVX2 hashes agree on odd cell shapes and
+// pitches and that a single flipped bit changes the digest; then times hashing a half at
+// each level, single-threaded and on the pool; then records a "dashboard" that cycles
+// through a few screens into a .tstore, plays it back, and compares sizes with the
+// intra-only screen codec. Passes if every check holds and, once each screen has been
+// seen, the store grows by less than 1% of what storing the frames intra-only would cost.
+// Usage: TileStoreBenchmark [frames] [screens] [holdFrames] [cellSize] [threads]
+#include "ScreenCodec.h"
+#include "SyntheticFrameSource.h"
+#include "TileStore.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+const uint32_t kWidth = 2560;
+const uint32_t kHeight = 1440;
+
+bool VerifyTileHash() {
+    std::mt19937 rng(3);
+    const PixelKernelLevel levels[] = { PixelKernelLevel::Scalar, PixelKernelLevel::Avx2 };
+    size_t cases = 0;
+    for (uint32_t w : { 1u, 3u, 15u, 16u, 17u, 33u, 64u }) {
+        for (uint32_t h : { 1u, 2u, 17u, 64u }) {
+            size_t pitch = static_cast<size_t>(w) * 4 + (rng() % 3) * 4;
+            std::vector<uint8_t> pixels(pitch * h);
+            for (uint8_t& b : pixels) b = static_cast<uint8_t>(rng());
+            ImageView cell(pixels.data(), w, h, pitch);
+            TileDigest reference = HashTile(cell, PixelKernelLevel::Scalar);
+            for (PixelKernelLevel level : levels) {
+                if (!PixelKernelLevelSupported(level)) continue;
+                cases++;
+                if (HashTile(cell, level) != reference) {
+                    std::cerr << "Cell hash differs at " << PixelKernelLevelName(level) << " for " << w << "x" << h << std::endl;
+                    return false;
+                }
+            }
+            // Any single bit of the cell must matter; bytes in the row padding must not
+            size_t byte = (rng() % h) * pitch + rng() % (static_cast<size_t>(w) * 4);
+            uint8_t bit = static_cast<uint8_t>(1u << (rng() % 8));
+            pixels[byte] ^= bit;
+            bool seen = HashTile(cell) != reference;
+            pixels[byte] ^= bit;
+            if (!seen) {
+                std::cerr << "Flipped bit not seen by the cell hash at " << w << "x" << h << std::endl;
+                return false;
+            }
+            if (pitch > static_cast<size_t>(w) * 4) {
+                pixels[pitch - 1] ^= 0xFF;
+                seen = HashTile(cell) != reference;
+                pixels[pitch - 1] ^= 0xFF;
+                if (seen) {
+                    std::cerr << "Row padding leaked into the cell hash at " << w << "x" << h << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    std::cout << "Cell hash identical across levels in " << cases << " cases" << std::endl;
+    return true;
+}
+
+double HashGBps(const ImageView& frame, const TileGrid& grid, ThreadPool* pool, PixelKernelLevel level) {
+    std::vector<TileDigest> digests;
+    HashTileGrid(frame, grid, digests, pool, level);
+    const int runs = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) HashTileGrid(frame, grid, digests, pool, level);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(frame.RowBytes()) * frame.height * runs / seconds / 1e9;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 600;
+    uint32_t screens = argc > 2 ? std::stoul(argv[2]) : 4;
+    uint32_t hold = argc > 3 ? std::stoul(argv[3]) : 30;
+    uint32_t cellSize = argc > 4 ? std::stoul(argv[4]) : 64;
+    size_t threads = argc > 5 ? std::stoul(argv[5]) : 0;
+    if (screens == 0) screens = 1;
+    if (hold == 0) hold = 1;
+
+    if (!VerifyTileHash()) return 1;
+
+    ThreadPool pool(threads);
+    TileGrid grid(kWidth, kHeight, cellSize);
+
+    // The dashboard: a few distinct screens, each with a live caret or counter area
+    SyntheticFrameSource scroll(kWidth, kHeight, SyntheticPattern::ScrollingText);
+    SyntheticFrameSource typing(kWidth, kHeight, SyntheticPattern::Typing);
+    std::vector<std::vector<uint8_t>> screenPixels(screens, std::vector<uint8_t>(scroll.FrameBytes()));
+    for (uint32_t s = 0; s < screens; ++s) scroll.RenderFrame(screenPixels[s].data(), s * 97);
+    std::vector<uint8_t> frame(scroll.FrameBytes());
+    std::vector<uint8_t> typed(typing.FrameBytes());
+    auto renderFrame = [&](uint64_t i) {
+        std::memcpy(frame.data(), screenPixels[(i / hold) % screens].data(), frame.size());
+        // The top band animates like a clock or ticker: take it from the typing pattern
+        typing.RenderFrame(typed.data(), i);
+        std::memcpy(frame.data(), typed.data(), static_cast<size_t>(kWidth) * 4 * 64);
+    };
+
+    ImageView view(frame.data(), kWidth, kHeight, static_cast<size_t>(kWidth) * 4);
+    renderFrame(0);
+    std::cout << kWidth << "x" << kHeight << " half, " << cellSize << " px cells (" << grid.CellCount() << "), "
+              << pool.Concurrency() << " threads" << std::endl;
+    std::cout << "Hash scalar:        " << std::fixed << std::setprecision(2) << HashGBps(view, grid, nullptr, PixelKernelLevel::Scalar) << " GB/s" << std::endl;
+    if (PixelKernelLevelSupported(PixelKernelLevel::Avx2)) {
+        std::cout << "Hash avx2:          " << HashGBps(view, grid, nullptr, PixelKernelLevel::Avx2) << " GB/s" << std::endl;
+    }
+    std::cout << "Hash best, pooled:  " << HashGBps(view, grid, &pool, BestPixelKernelLevel()) << " GB/s" << std::endl;
+
+    const std::string path = "tilestore_benchmark.tstore";
+    TileStoreWriter writer;
+    if (!writer.Open(path, kWidth, kHeight, cellSize, &pool)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return 1;
+    }
+    uint64_t intraBytes = 0;
+    uint64_t bytesAfterFirstCycle = 0;
+    uint64_t intraAfterFirstCycle = 0;
+    const uint64_t firstCycle = static_cast<uint64_t>(screens) * hold;
+    double addMs = 0.0;
+    std::vector<uint8_t> encoded;
+    for (uint64_t i = 0; i < frames; ++i) {
+        renderFrame(i);
+        ScreenStreamFrameInfo info;
+        info.frameIndex = i;
+        info.timestamp = static_cast<int64_t>(i * 1e9 / 60.0);
+        auto start = std::chrono::steady_clock::now();
+        if (!writer.AddFrame(view, info)) {
+            std::cerr << "Failed to add frame " << i << std::endl;
+            return 1;
+        }
+        addMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        encoded.clear();
+        intraBytes += EncodeScreenFrame(view, encoded) + 20;
+        if (i + 1 == firstCycle) {
+            bytesAfterFirstCycle = writer.Stats().bytes;
+            intraAfterFirstCycle = intraBytes;
+        }
+    }
+    TileStoreStats stats = writer.Stats();
+    writer.Close();
+
+    TileStoreReader reader;
+    bool playback = reader.Open(path);
+    std::vector<uint8_t> decoded;
+    ScreenStreamFrameInfo info;
+    uint64_t played = 0;
+    while (playback && played < frames) {
+        renderFrame(played);
+        playback = reader.ReadFrame(decoded, info) && info.frameIndex == played && decoded == frame;
+        if (playback) played++;
+    }
+    playback = playback && !reader.ReadFrame(decoded, info);
+    reader.Close();
+    std::remove(path.c_str());
+
+    std::cout << frames << " frames of " << screens << " screens held " << hold << " frames each:" << std::endl;
+    std::cout << "  tile store:  " << stats.bytes / 1e6 << " MB, " << stats.cells << " distinct cells, "
+              << addMs / frames << " ms/frame" << std::endl;
+    std::cout << "  intra codec: " << intraBytes / 1e6 << " MB (" << static_cast<double>(intraBytes) / stats.bytes << "x larger)" << std::endl;
+    std::cout << "  playback:    " << (playback ? "exact" : "MISMATCH at frame " + std::to_string(played)) << std::endl;
+
+    bool pass = playback;
+    if (frames > firstCycle) {
+        double growth = static_cast<double>(stats.bytes - bytesAfterFirstCycle);
+        double intraGrowth = static_cast<double>(intraBytes - intraAfterFirstCycle);
+        std::cout << "  after the first cycle the store grew " << growth / 1e3 << " KB vs " << intraGrowth / 1e6
+                  << " MB intra (" << std::setprecision(3) << 100.0 * growth / intraGrowth << "%)" << std::endl;
+        pass = pass && growth < 0.01 * intraGrowth;
+    }
+    std::cout << (pass ? "PASS" : "FAIL") << ": revisited screens " << (pass ? "cost" : "do not cost")
+              << " almost nothing in the tile store" << std::endl;
+    return pass ? 0 : 1;
+}
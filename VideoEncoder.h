@@ -0,0 +1,337 @@
+#pragma once
+// Video encoder backends for captured tiles. A VideoEncoder takes BGRA views of one tile
+// (a half, by default) and hands compressed packets to a sink; what the packets are is up
+// to the backend, and FileExtension() names the elementary stream they form when appended
+// to a file, which players open directly (ffplay -f mjpeg, ffplay x.h264).
+//   mjpeg - built in, every frame a JPEG whose restart strips are coded on a ThreadPool.
+//           Suits camera-like video; on desktop content it stores about twice what PNGs
+//           do, so screens belong in .srec recordings or x264
+//   x264  - libx264 (NV12, BT.709 limited), compiled in when VIDEO_ENCODER_X264 is defined
+//           and libx264 is linked
+// Backend, quality or bitrate and threading are runtime options, parsed from a spec string
+// such as "mjpeg:quality=80,threads=8" or "x264:bitrate=8000".
+#include "AsyncFileWriter.h"
+#include "ImageView.h"
+#include "JpegEncoder.h"
+#include "ScreenCodec.h"
+#include "ThreadPool.h"
+#include "YuvConvert.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef VIDEO_ENCODER_X264
+extern "C" {
+#include <x264.h>
+}
+#endif
+
+enum class VideoBackend {
+    Mjpeg,
+    X264
+};
+
+struct VideoEncoderConfig {
+    VideoBackend backend = VideoBackend::Mjpeg;
+    int quality = 85;                   // 1-100; x264 maps it to a CRF when bitrateKbps is 0
+    uint32_t bitrateKbps = 0;           // x264 average bitrate
+    uint32_t threads = 0;               // 0 = one per hardware thread
+    double fps = 60.0;                  // Nominal rate, for rate control
+    int64_t ticksPerSecond = 1000000000;    // Unit of ScreenStreamFrameInfo::timestamp (QPC frequency in the recorder)
+    uint32_t keyframeInterval = 120;    // x264 GOP length; every MJPEG frame is a keyframe
+    ThreadPool* pool = nullptr;         // Shared workers for mjpeg; otherwise it owns 'threads'
+};
+
+struct VideoPacket {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint64_t frameIndex = 0;
+    int64_t timestamp = 0;
+    bool keyframe = false;
+};
+
+// Returns false to report a write failure back through Encode()/Flush()
+using VideoPacketSink = std::function<bool(const VideoPacket&)>;
+
+class VideoEncoder {
+public:
+    virtual ~VideoEncoder() = default;
+
+    virtual const char* Name() const = 0;
+    virtual const char* FileExtension() const = 0;
+    virtual bool Open(uint32_t width, uint32_t height, const VideoEncoderConfig& config, VideoPacketSink sink) = 0;
+    // Packets may come out later than their frame (encoder lookahead); Flush() drains them
+    virtual bool Encode(const ImageView& frame, const ScreenStreamFrameInfo& info) = 0;
+    virtual bool Flush() { return true; }
+};
+
+inline const char* VideoBackendName(VideoBackend backend) {
+    return backend == VideoBackend::X264 ? "x264" : "mjpeg";
+}
+
+inline bool VideoBackendAvailable(VideoBackend backend) {
+#ifdef VIDEO_ENCODER_X264
+    if (backend == VideoBackend::X264) return true;
+#endif
+    return backend == VideoBackend::Mjpeg;
+}
+
+// "<backend>[:key=value,...]" with keys quality, bitrate (kbps), threads, fps, keyint.
+// Unknown backends or keys fail; a backend that is not compiled in parses but is not available.
+inline bool ParseVideoEncoderSpec(const std::string& spec, VideoEncoderConfig& config) {
+    size_t colon = spec.find(':');
+    std::string backend = spec.substr(0, colon);
+    if (backend == "mjpeg") config.backend = VideoBackend::Mjpeg;
+    else if (backend == "x264") config.backend = VideoBackend::X264;
+    else return false;
+    size_t pos = colon == std::string::npos ? spec.size() : colon + 1;
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string item = spec.substr(pos, end - pos);
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = item.substr(0, eq);
+        const char* value = item.c_str() + eq + 1;
+        char* parsed = nullptr;
+        double number = std::strtod(value, &parsed);
+        if (parsed == value || *parsed != '\0' || number < 0) return false;
+        if (key == "quality") config.quality = static_cast<int>(number);
+        else if (key == "bitrate") config.bitrateKbps = static_cast<uint32_t>(number);
+        else if (key == "threads") config.threads = static_cast<uint32_t>(number);
+        else if (key == "fps") config.fps = number;
+        else if (key == "keyint") config.keyframeInterval = static_cast<uint32_t>(number);
+        else return false;
+        pos = end + 1;
+    }
+    return true;
+}
+
+class MjpegVideoEncoder : public VideoEncoder {
+public:
+    const char* Name() const override { return "mjpeg"; }
+    const char* FileExtension() const override { return "mjpeg"; }
+
+    bool Open(uint32_t width, uint32_t height, const VideoEncoderConfig& config, VideoPacketSink sink) override {
+        if (width == 0 || height == 0 || width > 65535 || height > 65535 || !sink) return false;
+        m_width = width;
+        m_height = height;
+        m_options.quality = config.quality;
+        m_sink = std::move(sink);
+        m_pool = config.pool;
+        if (!m_pool) {
+            m_ownPool.reset(new ThreadPool(config.threads));
+            m_pool = m_ownPool.get();
+        }
+        return true;
+    }
+
+    bool Encode(const ImageView& frame, const ScreenStreamFrameInfo& info) override {
+        if (!m_sink || frame.width != m_width || frame.height != m_height) return false;
+        if (!EncodeJpeg(frame, m_jpeg, m_options, m_pool, &m_scratch)) return false;
+        VideoPacket packet;
+        packet.data = m_jpeg.data();
+        packet.size = m_jpeg.size();
+        packet.frameIndex = info.frameIndex;
+        packet.timestamp = info.timestamp;
+        packet.keyframe = true;
+        return m_sink(packet);
+    }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    JpegWriteOptions m_options;
+    VideoPacketSink m_sink;
+    ThreadPool* m_pool = nullptr;
+    std::unique_ptr<ThreadPool> m_ownPool;
+    std::vector<uint8_t> m_jpeg;
+    JpegScratch m_scratch;
+};
+
+#ifdef VIDEO_ENCODER_X264
+// Annex B H.264 with headers repeated on every keyframe, so a cut stream still plays.
+// Timestamps arrive in config.ticksPerSecond units and are rescaled to the microsecond
+// timebase x264 runs on, and back on the way out; the frame index rides along in the
+// picture's opaque.
+class X264VideoEncoder : public VideoEncoder {
+public:
+    ~X264VideoEncoder() override { Close(); }
+
+    const char* Name() const override { return "x264"; }
+    const char* FileExtension() const override { return "h264"; }
+
+    bool Open(uint32_t width, uint32_t height, const VideoEncoderConfig& config, VideoPacketSink sink) override {
+        Close();
+        if (width == 0 || height == 0 || ((width | height) & 1) != 0 || !sink) return false;
+        x264_param_t param;
+        if (x264_param_default_preset(&param, "veryfast", nullptr) < 0) return false;
+        param.i_threads = config.threads ? static_cast<int>(config.threads) : X264_THREADS_AUTO;
+        param.i_width = static_cast<int>(width);
+        param.i_height = static_cast<int>(height);
+        param.i_csp = X264_CSP_NV12;
+        param.vui.i_colorprim = 1;      // BT.709, as converted below
+        param.vui.i_transfer = 1;
+        param.vui.i_colmatrix = 1;
+        param.vui.b_fullrange = 0;
+        param.i_fps_num = static_cast<uint32_t>(config.fps * 1000.0 + 0.5);
+        param.i_fps_den = 1000;
+        param.b_vfr_input = 1;
+        param.i_timebase_num = 1;
+        param.i_timebase_den = kTimebase;
+        param.i_keyint_max = config.keyframeInterval ? static_cast<int>(config.keyframeInterval) : X264_KEYINT_MAX_INFINITE;
+        param.b_repeat_headers = 1;
+        param.b_annexb = 1;
+        if (config.bitrateKbps) {
+            param.rc.i_rc_method = X264_RC_ABR;
+            param.rc.i_bitrate = static_cast<int>(config.bitrateKbps);
+            param.rc.i_vbv_max_bitrate = static_cast<int>(config.bitrateKbps);
+            param.rc.i_vbv_buffer_size = static_cast<int>(config.bitrateKbps);
+        }
+        else {
+            param.rc.i_rc_method = X264_RC_CRF;
+            param.rc.f_rf_constant = static_cast<float>(12.0 + (100 - std::min(std::max(config.quality, 1), 100)) * 0.4);
+        }
+        if (x264_param_apply_profile(&param, "high") < 0) return false;
+        m_encoder = x264_encoder_open(&param);
+        if (!m_encoder) return false;
+        if (x264_picture_alloc(&m_picture, X264_CSP_NV12, param.i_width, param.i_height) < 0) {
+            x264_encoder_close(m_encoder);
+            m_encoder = nullptr;
+            return false;
+        }
+        m_pictureAllocated = true;
+        m_width = width;
+        m_height = height;
+        m_sink = std::move(sink);
+        m_pool = config.pool;
+        m_ticksPerSecond = config.ticksPerSecond > 0 ? config.ticksPerSecond : 1000000000;
+        return true;
+    }
+
+    bool Encode(const ImageView& frame, const ScreenStreamFrameInfo& info) override {
+        if (!m_encoder || frame.width != m_width || frame.height != m_height) return false;
+        YuvPlanes planes;
+        planes.y = m_picture.img.plane[0];
+        planes.yPitch = static_cast<size_t>(m_picture.img.i_stride[0]);
+        planes.u = m_picture.img.plane[1];
+        planes.uPitch = static_cast<size_t>(m_picture.img.i_stride[1]);
+        YuvOptions options;
+        options.layout = YuvLayout::Nv12;
+        options.matrix = YuvMatrix::Bt709;
+        ConvertToYuv(frame, planes, options, m_pool);
+        m_picture.i_pts = Rescale(info.timestamp, m_ticksPerSecond, kTimebase);
+        m_picture.i_type = X264_TYPE_AUTO;
+        m_picture.opaque = reinterpret_cast<void*>(static_cast<uintptr_t>(info.frameIndex));
+        return EncodePicture(&m_picture);
+    }
+
+    bool Flush() override {
+        while (m_encoder && x264_encoder_delayed_frames(m_encoder) > 0) {
+            if (!EncodePicture(nullptr)) return false;
+        }
+        return true;
+    }
+
+private:
+    static const int64_t kTimebase = 1000000;
+
+    // value * to / from without overflowing on QPC counts (~1e14 after a few months of uptime)
+    static int64_t Rescale(int64_t value, int64_t from, int64_t to) {
+        return value / from * to + value % from * to / from;
+    }
+
+    bool EncodePicture(x264_picture_t* input) {
+        x264_nal_t* nals = nullptr;
+        int nalCount = 0;
+        x264_picture_t output;
+        int size = x264_encoder_encode(m_encoder, &nals, &nalCount, input, &output);
+        if (size < 0) return false;
+        if (size == 0) return true;
+        VideoPacket packet;
+        packet.data = nals[0].p_payload;        // The NALs of one picture are contiguous
+        packet.size = static_cast<size_t>(size);
+        packet.frameIndex = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(output.opaque));
+        packet.timestamp = Rescale(output.i_pts, kTimebase, m_ticksPerSecond);
+        packet.keyframe = output.b_keyframe != 0;
+        return m_sink(packet);
+    }
+
+    void Close() {
+        if (m_pictureAllocated) x264_picture_clean(&m_picture);
+        m_pictureAllocated = false;
+        if (m_encoder) x264_encoder_close(m_encoder);
+        m_encoder = nullptr;
+    }
+
+    x264_t* m_encoder = nullptr;
+    x264_picture_t m_picture;
+    bool m_pictureAllocated = false;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    VideoPacketSink m_sink;
+    ThreadPool* m_pool = nullptr;
+    int64_t m_ticksPerSecond = 1000000000;
+};
+#endif
+
+// nullptr when the backend is not compiled into this build
+inline std::unique_ptr<VideoEncoder> CreateVideoEncoder(VideoBackend backend) {
+    switch (backend) {
+    case VideoBackend::Mjpeg: return std::unique_ptr<VideoEncoder>(new MjpegVideoEncoder());
+#ifdef VIDEO_ENCODER_X264
+    case VideoBackend::X264: return std::unique_ptr<VideoEncoder>(new X264VideoEncoder());
+#endif
+    default: return nullptr;
+    }
+}
+
+// Packets appended to one file: the elementary stream named by FileExtension(). Writes go
+// through an AsyncFileWriter; a packet it refuses is dropped whole (MJPEG frames stand alone;
+// an H.264 stream recovers at the next keyframe).
+class VideoFileWriter {
+public:
+    ~VideoFileWriter() { Close(); }
+
+    bool Open(const std::string& path, const AsyncFileWriterOptions& io = AsyncFileWriterOptions()) {
+        Close();
+        m_packets = 0;
+        m_keyframes = 0;
+        m_bytes = 0;
+        m_dropped = 0;
+        return m_file.Open(path, io);
+    }
+
+    bool Write(const VideoPacket& packet) {
+        if (!m_file.IsOpen()) return false;
+        if (!m_file.Append(packet.data, packet.size)) {
+            m_dropped++;
+            return false;
+        }
+        m_packets++;
+        if (packet.keyframe) m_keyframes++;
+        m_bytes += packet.size;
+        return true;
+    }
+
+    bool Close() {
+        return m_file.Close();
+    }
+
+    uint64_t Packets() const { return m_packets; }
+    uint64_t Keyframes() const { return m_keyframes; }
+    uint64_t Bytes() const { return m_bytes; }
+    uint64_t DroppedPackets() const { return m_dropped; }
+    AsyncFileWriterStats WriteStats() const { return m_file.Stats(); }
+
+private:
+    AsyncFileWriter m_file;
+    uint64_t m_packets = 0;
+    uint64_t m_keyframes = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_dropped = 0;
+};
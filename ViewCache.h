@@ -0,0 +1,202 @@
+#pragma once
+// Shader resource and render target views created once per texture instead of every frame.
+// A view is keyed by the texture it looks at and the description it was made with (none
+// means the texture's own format, as with a null desc in D3D11); later lookups hand back
+// the same view. Views are dropped only when their texture is resized or replaced
+// (Invalidate, before the texture or swap chain buffers go) or the device is lost (Clear).
+// A cached view keeps its texture alive, so a new texture can never land on a stale key.
+// The backend is a policy: D3D11 SRVs and RTVs on Windows, a counting mock for tests.
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct ViewCacheStats {
+    uint64_t lookups = 0;
+    uint64_t created = 0;       // Views the backend was asked to make
+    uint64_t failed = 0;        // Of those, creations that failed (not cached; retried next lookup)
+    uint64_t invalidated = 0;   // Dropped by Invalidate or Clear
+    uint64_t evicted = 0;       // Dropped to stay within capacity
+};
+
+// Backend requirements:
+//   typedef ... Resource;   // Identity of a texture, compared by value (a raw pointer)
+//   typedef ... Desc;       // Trivially copyable view description, compared bytewise
+//   typedef ... View;       // Owns a reference to a created view
+//   bool CreateView(Resource resource, const Desc* desc, View& view);
+template <typename Backend>
+class ViewCache {
+public:
+    typedef typename Backend::Resource Resource;
+    typedef typename Backend::Desc Desc;
+    typedef typename Backend::View View;
+    static_assert(std::is_trivially_copyable<Desc>::value, "view descriptions are compared bytewise");
+
+    // capacity bounds how many views stay cached; the least recently used goes first.
+    // Textures handed out by desktop duplication rotate, so their views would otherwise pile up.
+    explicit ViewCache(Backend& backend, size_t capacity = 16) : m_backend(backend), m_capacity(std::max<size_t>(capacity, 1)) {}
+
+    // The view of 'resource' as 'desc' describes it (nullptr = the texture's own format),
+    // created on first use. Returns nullptr if the backend cannot create it. The pointer
+    // stays valid until the view is invalidated, cleared or evicted.
+    // Descriptions are compared as bytes, so zero them before filling them in.
+    View* Get(Resource resource, const Desc* desc = nullptr) {
+        m_stats.lookups++;
+        m_useCounter++;
+        for (std::unique_ptr<Entry>& entry : m_entries) {
+            if (entry->resource == resource && entry->hasDesc == (desc != nullptr) &&
+                (!desc || std::memcmp(&entry->desc, desc, sizeof(Desc)) == 0)) {
+                entry->lastUse = m_useCounter;
+                return &entry->view;
+            }
+        }
+
+        std::unique_ptr<Entry> entry(new Entry());
+        entry->resource = resource;
+        entry->hasDesc = desc != nullptr;
+        if (desc) std::memcpy(&entry->desc, desc, sizeof(Desc));
+        entry->lastUse = m_useCounter;
+        m_stats.created++;
+        if (!m_backend.CreateView(resource, desc, entry->view)) {
+            m_stats.failed++;
+            return nullptr;
+        }
+        if (m_entries.size() >= m_capacity) {
+            auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const std::unique_ptr<Entry>& a, const std::unique_ptr<Entry>& b) {
+                return a->lastUse < b->lastUse;
+            });
+            m_entries.erase(oldest);
+            m_stats.evicted++;
+        }
+        m_entries.push_back(std::move(entry));
+        return &m_entries.back()->view;
+    }
+
+    // Drops every view of 'resource'; call before it is released or resized (a swap chain's
+    // ResizeBuffers fails while views of its buffers are alive)
+    void Invalidate(Resource resource) {
+        size_t before = m_entries.size();
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                       [resource](const std::unique_ptr<Entry>& entry) { return entry->resource == resource; }),
+                        m_entries.end());
+        m_stats.invalidated += before - m_entries.size();
+    }
+
+    // Drops everything; call on device loss, before the backend is pointed at the new device
+    void Clear() {
+        m_stats.invalidated += m_entries.size();
+        m_entries.clear();
+    }
+
+    size_t Size() const { return m_entries.size(); }
+    const ViewCacheStats& Stats() const { return m_stats; }
+
+private:
+    struct Entry {
+        Resource resource = Resource();
+        Desc desc = Desc();         // Zeroed when no description was given
+        bool hasDesc = false;
+        uint64_t lastUse = 0;
+        View view;
+    };
+
+    Backend& m_backend;
+    size_t m_capacity;
+    std::vector<std::unique_ptr<Entry>> m_entries;    // Heap entries keep returned pointers stable
+    uint64_t m_useCounter = 0;
+    ViewCacheStats m_stats;
+};
+
+// Stand-in device for tests: textures are plain objects, a view records what it was made
+// from and holds its texture, and every creation is counted
+struct MockTexture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t format = 0;
+};
+
+struct MockViewDesc {
+    uint32_t format = 0;
+    uint32_t mipLevel = 0;
+};
+
+struct MockView {
+    std::shared_ptr<MockTexture> texture;
+    MockViewDesc desc;
+    uint64_t serial = 0;        // Creation order, so tests can tell a cached view from a new one
+};
+
+class MockViewBackend {
+public:
+    typedef MockTexture* Resource;
+    typedef MockViewDesc Desc;
+    typedef std::shared_ptr<MockView> View;
+
+    // Textures the device knows about; views of anything else fail, as on a lost device
+    void AddTexture(const std::shared_ptr<MockTexture>& texture) { m_textures.push_back(texture); }
+    void RemoveTexture(MockTexture* texture) {
+        m_textures.erase(std::remove_if(m_textures.begin(), m_textures.end(),
+                                        [texture](const std::shared_ptr<MockTexture>& t) { return t.get() == texture; }),
+                         m_textures.end());
+    }
+    void Lose() { m_textures.clear(); }
+
+    bool CreateView(MockTexture* resource, const MockViewDesc* desc, std::shared_ptr<MockView>& view) {
+        m_creations++;
+        for (const std::shared_ptr<MockTexture>& texture : m_textures) {
+            if (texture.get() != resource) continue;
+            view = std::make_shared<MockView>();
+            view->texture = texture;
+            view->desc.format = desc ? desc->format : texture->format;
+            view->desc.mipLevel = desc ? desc->mipLevel : 0;
+            view->serial = m_creations;
+            return true;
+        }
+        return false;
+    }
+
+    uint64_t Creations() const { return m_creations; }
+
+private:
+    std::vector<std::shared_ptr<MockTexture>> m_textures;
+    uint64_t m_creations = 0;
+};
+
+#ifdef __d3d11_h__
+#include <wrl/client.h>
+
+class D3D11ShaderResourceViewBackend {
+public:
+    typedef ID3D11Resource* Resource;
+    typedef D3D11_SHADER_RESOURCE_VIEW_DESC Desc;
+    typedef Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> View;
+
+    explicit D3D11ShaderResourceViewBackend(ID3D11Device* device = nullptr) : device(device) {}
+
+    bool CreateView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, View& view) {
+        return device && SUCCEEDED(device->CreateShaderResourceView(resource, desc, &view));
+    }
+
+    ID3D11Device* device;
+};
+
+class D3D11RenderTargetViewBackend {
+public:
+    typedef ID3D11Resource* Resource;
+    typedef D3D11_RENDER_TARGET_VIEW_DESC Desc;
+    typedef Microsoft::WRL::ComPtr<ID3D11RenderTargetView> View;
+
+    explicit D3D11RenderTargetViewBackend(ID3D11Device* device = nullptr) : device(device) {}
+
+    bool CreateView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, View& view) {
+        return device && SUCCEEDED(device->CreateRenderTargetView(resource, desc, &view));
+    }
+
+    ID3D11Device* device;
+};
+
+typedef ViewCache<D3D11ShaderResourceViewBackend> D3D11ShaderResourceViewCache;
+typedef ViewCache<D3D11RenderTargetViewBackend> D3D11RenderTargetViewCache;
+#endif
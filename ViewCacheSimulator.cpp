@@ -0,0 +1,164 @@
+// Runs ViewCache against the counting mock device through the render loops that used to
+// create views every frame, and checks that views are made once per texture and again
+// only when a texture is replaced, a swap chain is resized or the device is lost:
+//   - two tile textures sampled every frame (RendertoImage / ScreenRecorderSteps CreateSRVs)
+//   - the desktop changing size mid-run, which replaces both tile textures
+//   - a back buffer RTV per frame plus duplication surfaces handed out in turn (ScreenRecorder2)
+//   - distinct view descriptions of one texture, a failed creation, and device loss
+// Then the lookup cost is timed against a mock creation.
+// Usage: ViewCacheSimulator [frames]
+#include "ViewCache.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+struct Check {
+    int failures = 0;
+
+    void Expect(bool condition, const std::string& what) {
+        std::cout << std::left << std::setw(72) << what << (condition ? "ok" : "WRONG") << std::endl;
+        if (!condition) failures++;
+    }
+};
+
+std::shared_ptr<MockTexture> MakeTexture(MockViewBackend& device, uint32_t width, uint32_t height, uint32_t format = 87) {
+    std::shared_ptr<MockTexture> texture = std::make_shared<MockTexture>();
+    texture->width = width;
+    texture->height = height;
+    texture->format = format;
+    device.AddTexture(texture);
+    return texture;
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::stoull(argv[1]) : 600;
+    Check check;
+
+    // Split loop: both halves sampled every frame; the desktop changes size halfway through
+    {
+        MockViewBackend device;
+        ViewCache<MockViewBackend> cache(device);
+        std::shared_ptr<MockTexture> left = MakeTexture(device, 960, 1080), right = MakeTexture(device, 960, 1080);
+        uint64_t firstSerial = 0;
+        bool stable = true;
+        for (uint64_t i = 0; i < frames; ++i) {
+            if (i == frames / 2) {
+                // CaptureFrame recreates the tiles: invalidate, then release and replace
+                for (std::shared_ptr<MockTexture>* texture : { &left, &right }) {
+                    cache.Invalidate(texture->get());
+                    device.RemoveTexture(texture->get());
+                    *texture = MakeTexture(device, 1280, 1440);
+                }
+            }
+            std::shared_ptr<MockView>* leftView = cache.Get(left.get());
+            std::shared_ptr<MockView>* rightView = cache.Get(right.get());
+            if (!leftView || !rightView || (*leftView)->texture != left || (*rightView)->texture != right) stable = false;
+            else if (i == 0) firstSerial = (*leftView)->serial;
+            else if (i < frames / 2 && (*leftView)->serial != firstSerial) stable = false;
+        }
+        check.Expect(stable, "split loop: every lookup returns a view of the current texture");
+        check.Expect(device.Creations() == 4, "split loop: " + std::to_string(frames) + " frames, one resize -> " +
+                     std::to_string(device.Creations()) + " SRVs (want 4)");
+        check.Expect(cache.Size() == 2 && cache.Stats().invalidated == 2, "split loop: replaced textures leave the cache");
+    }
+
+    // Presenting loop: one back buffer RTV, duplication rotating through three surfaces
+    {
+        MockViewBackend device;
+        ViewCache<MockViewBackend> cache(device, 8);
+        std::shared_ptr<MockTexture> backBuffer = MakeTexture(device, 800, 600);
+        std::shared_ptr<MockTexture> surfaces[3] = { MakeTexture(device, 2560, 1440), MakeTexture(device, 2560, 1440),
+                                                     MakeTexture(device, 2560, 1440) };
+        for (uint64_t i = 0; i < frames; ++i) {
+            cache.Get(backBuffer.get());
+            cache.Get(surfaces[i % 3].get());
+        }
+        check.Expect(device.Creations() == 4, "present loop: back buffer + 3 rotating surfaces -> " +
+                     std::to_string(device.Creations()) + " RTVs (want 4)");
+
+        // WM_SIZE: views of the old back buffer must all be gone before ResizeBuffers
+        std::weak_ptr<MockTexture> oldBuffer = backBuffer;
+        cache.Clear();
+        device.RemoveTexture(backBuffer.get());
+        backBuffer.reset();
+        check.Expect(oldBuffer.expired(), "resize: clearing releases the old back buffer");
+        backBuffer = MakeTexture(device, 1024, 768);
+        for (uint64_t i = 0; i < 10; ++i) cache.Get(backBuffer.get());
+        check.Expect(device.Creations() == 5, "resize: one new RTV for the resized back buffer");
+    }
+
+    // Capacity: more live textures than slots evicts the least recently used
+    {
+        MockViewBackend device;
+        ViewCache<MockViewBackend> cache(device, 4);
+        std::shared_ptr<MockTexture> hot = MakeTexture(device, 64, 64);
+        std::vector<std::shared_ptr<MockTexture>> cold;
+        for (int i = 0; i < 10; ++i) cold.push_back(MakeTexture(device, 64, 64));
+        for (int i = 0; i < 10; ++i) {
+            cache.Get(hot.get());
+            cache.Get(cold[i].get());
+        }
+        check.Expect(cache.Size() == 4 && cache.Stats().evicted == 7 && device.Creations() == 11,
+                     "capacity: 11 textures through 4 slots, the hot one never recreated");
+    }
+
+    // Descriptions, failures and device loss
+    {
+        MockViewBackend device;
+        ViewCache<MockViewBackend> cache(device);
+        std::shared_ptr<MockTexture> texture = MakeTexture(device, 256, 256, 28);
+        MockViewDesc srgb;
+        srgb.format = 29;
+        MockViewDesc mip1;
+        mip1.format = 28;
+        mip1.mipLevel = 1;
+        std::shared_ptr<MockView>* plain = cache.Get(texture.get());
+        std::shared_ptr<MockView>* asSrgb = cache.Get(texture.get(), &srgb);
+        std::shared_ptr<MockView>* asMip = cache.Get(texture.get(), &mip1);
+        bool distinct = plain && asSrgb && asMip && (*plain)->desc.format == 28 && (*asSrgb)->desc.format == 29 && (*asMip)->desc.mipLevel == 1;
+        MockViewDesc srgbAgain;
+        srgbAgain.format = 29;
+        std::shared_ptr<MockView>* again = cache.Get(texture.get(), &srgbAgain);
+        check.Expect(distinct && device.Creations() == 3 && again && (*again)->desc.format == 29 && cache.Get(texture.get()),
+                     "descriptions: one view per distinct description, equal ones shared");
+
+        MockTexture foreign;
+        uint64_t before = device.Creations();
+        bool failedTwice = !cache.Get(&foreign) && !cache.Get(&foreign);
+        check.Expect(failedTwice && device.Creations() == before + 2 && cache.Stats().failed == 2,
+                     "failure: failed creations are not cached and are retried");
+
+        device.Lose();
+        cache.Clear();
+        check.Expect(!cache.Get(texture.get()), "device loss: nothing is served from the lost device");
+        device.AddTexture(texture);
+        before = device.Creations();
+        check.Expect(cache.Get(texture.get()) && device.Creations() == before + 1, "device loss: views are recreated on the new device");
+    }
+
+    // Lookup cost against a creation on the mock (a real CreateShaderResourceView is far slower)
+    {
+        MockViewBackend device;
+        ViewCache<MockViewBackend> cache(device);
+        std::shared_ptr<MockTexture> left = MakeTexture(device, 960, 1080), right = MakeTexture(device, 960, 1080);
+        const uint64_t lookups = 2000000;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t serials = 0;
+        for (uint64_t i = 0; i < lookups; ++i) serials += (*cache.Get(i & 1 ? right.get() : left.get()))->serial;
+        double cachedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+        start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < lookups / 10; ++i) {
+            std::shared_ptr<MockView> view;
+            device.CreateView(left.get(), nullptr, view);
+            serials += view->serial;
+        }
+        double createNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (lookups / 10);
+        std::cout << std::fixed << std::setprecision(1) << "cached lookup " << cachedNs << " ns, mock creation " << createNs
+                  << " ns (checksum " << serials % 10 << ")" << std::endl;
+    }
+
+    std::cout << (check.failures == 0 ? "PASS" : "FAIL") << std::endl;
+    return check.failures == 0 ? 0 : 1;
+}
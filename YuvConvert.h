@@ -0,0 +1,298 @@
+#pragma once
+// BGRA -> YUV 4:2:0 for video-style consumers: NV12 (Y plane + interleaved UV plane) or
+// I420 (Y, U, V planes), BT.601 or BT.709 coefficients, limited (16-235/240) or full range.
+// Chroma is taken from the average of each 2x2 block; odd edges reuse the last column/row.
+// Q15 fixed point with scalar and AVX2 row kernels picked at runtime like PixelKernels; both
+// produce identical bytes and stay within 1 LSB of the exact (double) conversion. Bands of
+// rows can be spread over a ThreadPool.
+#include "ImageView.h"
+#include "PixelKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class YuvLayout {
+    Nv12,
+    I420
+};
+
+enum class YuvMatrix {
+    Bt601,
+    Bt709
+};
+
+struct YuvOptions {
+    YuvLayout layout = YuvLayout::Nv12;
+    YuvMatrix matrix = YuvMatrix::Bt709;
+    bool fullRange = false;     // false: Y 16-235, UV 16-240
+};
+
+inline const char* YuvLayoutName(YuvLayout layout) {
+    return layout == YuvLayout::Nv12 ? "nv12" : "i420";
+}
+
+// Destination planes. NV12 uses u as the interleaved UV plane and ignores v.
+struct YuvPlanes {
+    uint8_t* y = nullptr;
+    uint8_t* u = nullptr;
+    uint8_t* v = nullptr;
+    size_t yPitch = 0;
+    size_t uPitch = 0;
+    size_t vPitch = 0;
+};
+
+inline uint32_t YuvChromaWidth(uint32_t width) { return (width + 1) / 2; }
+inline uint32_t YuvChromaHeight(uint32_t height) { return (height + 1) / 2; }
+
+// Bytes of a tightly packed frame: Y, then UV (NV12) or U then V (I420)
+inline size_t YuvFrameBytes(uint32_t width, uint32_t height) {
+    return static_cast<size_t>(width) * height + static_cast<size_t>(YuvChromaWidth(width)) * YuvChromaHeight(height) * 2;
+}
+
+// Planes of a tightly packed frame in 'buffer' (YuvFrameBytes() long)
+inline YuvPlanes PackedYuvPlanes(uint8_t* buffer, uint32_t width, uint32_t height, YuvLayout layout) {
+    YuvPlanes planes;
+    const uint32_t chromaWidth = YuvChromaWidth(width);
+    const size_t chromaPlane = static_cast<size_t>(chromaWidth) * YuvChromaHeight(height);
+    planes.y = buffer;
+    planes.yPitch = width;
+    planes.u = buffer + static_cast<size_t>(width) * height;
+    if (layout == YuvLayout::Nv12) {
+        planes.uPitch = static_cast<size_t>(chromaWidth) * 2;
+    }
+    else {
+        planes.uPitch = chromaWidth;
+        planes.v = planes.u + chromaPlane;
+        planes.vPitch = chromaWidth;
+    }
+    return planes;
+}
+
+namespace YuvConvertDetail {
+
+const int kShift = 15;
+
+// Row coefficients for B, G, R (the order of the BGRA bytes) and the constant term
+struct YuvCoefficients {
+    double y[3], u[3], v[3];
+    double yOffset;
+    int32_t yQ[3], uQ[3], vQ[3];
+};
+
+inline YuvCoefficients MakeCoefficients(YuvMatrix matrix, bool fullRange) {
+    const double kr = matrix == YuvMatrix::Bt709 ? 0.2126 : 0.299;
+    const double kb = matrix == YuvMatrix::Bt709 ? 0.0722 : 0.114;
+    const double kg = 1.0 - kr - kb;
+    const double yScale = fullRange ? 1.0 : 219.0 / 255.0;
+    const double cScale = fullRange ? 1.0 : 224.0 / 255.0;
+    YuvCoefficients c;
+    c.yOffset = fullRange ? 0.0 : 16.0;
+    c.y[0] = kb * yScale;
+    c.y[1] = kg * yScale;
+    c.y[2] = kr * yScale;
+    c.u[0] = 0.5 * cScale;
+    c.u[1] = -kg / (2.0 * (1.0 - kb)) * cScale;
+    c.u[2] = -kr / (2.0 * (1.0 - kb)) * cScale;
+    c.v[0] = -kb / (2.0 * (1.0 - kr)) * cScale;
+    c.v[1] = -kg / (2.0 * (1.0 - kr)) * cScale;
+    c.v[2] = 0.5 * cScale;
+    for (int i = 0; i < 3; ++i) {
+        c.yQ[i] = static_cast<int32_t>(std::lround(c.y[i] * (1 << kShift)));
+        c.uQ[i] = static_cast<int32_t>(std::lround(c.u[i] * (1 << kShift)));
+        c.vQ[i] = static_cast<int32_t>(std::lround(c.v[i] * (1 << kShift)));
+    }
+    // Chroma rows sum to zero, so every grey lands exactly on 128
+    c.uQ[1] = -c.uQ[0] - c.uQ[2];
+    c.vQ[1] = -c.vQ[0] - c.vQ[2];
+    return c;
+}
+
+inline uint8_t ClampByte(int32_t value) {
+    return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// One luma row from pixels [start, width)
+inline void LumaRowScalar(const uint8_t* source, uint8_t* y, uint32_t width, uint32_t start, const YuvCoefficients& c) {
+    const int32_t round = (static_cast<int32_t>(c.yOffset) << kShift) + (1 << (kShift - 1));
+    for (uint32_t x = start; x < width; ++x) {
+        const uint8_t* p = source + static_cast<size_t>(x) * 4;
+        y[x] = ClampByte((c.yQ[0] * p[0] + c.yQ[1] * p[1] + c.yQ[2] * p[2] + round) >> kShift);
+    }
+}
+
+// Chroma samples [start, chromaWidth) from two source rows (the same row twice at an odd
+// bottom edge). The sums of four pixels carry two extra bits, removed with the rounding.
+inline void ChromaRowScalar(const uint8_t* top, const uint8_t* bottom, uint8_t* u, uint8_t* v, bool interleaved,
+                            uint32_t width, uint32_t start, const YuvCoefficients& c) {
+    const int32_t round = (128 << (kShift + 2)) + (1 << (kShift + 1));
+    const uint32_t chromaWidth = YuvChromaWidth(width);
+    for (uint32_t cx = start; cx < chromaWidth; ++cx) {
+        const size_t x0 = static_cast<size_t>(cx) * 8;
+        const size_t x1 = 2 * cx + 1 < width ? x0 + 4 : x0;
+        int32_t sum[3];
+        for (int ch = 0; ch < 3; ++ch) sum[ch] = top[x0 + ch] + top[x1 + ch] + bottom[x0 + ch] + bottom[x1 + ch];
+        uint8_t cb = ClampByte((c.uQ[0] * sum[0] + c.uQ[1] * sum[1] + c.uQ[2] * sum[2] + round) >> (kShift + 2));
+        uint8_t cr = ClampByte((c.vQ[0] * sum[0] + c.vQ[1] * sum[1] + c.vQ[2] * sum[2] + round) >> (kShift + 2));
+        if (interleaved) {
+            u[cx * 2] = cb;
+            u[cx * 2 + 1] = cr;
+        }
+        else {
+            u[cx] = cb;
+            v[cx] = cr;
+        }
+    }
+}
+
+#ifdef PIXEL_KERNELS_X86
+// 8 pixels -> 8 x int32 luma before the shift. Bytes are widened to 16 bits; madd pairs B,G
+// and R,A, and hadd joins the pairs back in pixel order within each 128-bit lane.
+PIXEL_KERNELS_AVX2_TARGET inline __m256i LumaSumsAvx2(const uint8_t* pixels, __m256i coefficients, __m256i round) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels));
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(v, zero), coefficients);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(v, zero), coefficients);
+    return _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(lo, hi), round), kShift);
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline void LumaRowAvx2(const uint8_t* source, uint8_t* y, uint32_t width, const YuvCoefficients& c) {
+    const __m256i coefficients = _mm256_setr_epi16(
+        static_cast<int16_t>(c.yQ[0]), static_cast<int16_t>(c.yQ[1]), static_cast<int16_t>(c.yQ[2]), 0,
+        static_cast<int16_t>(c.yQ[0]), static_cast<int16_t>(c.yQ[1]), static_cast<int16_t>(c.yQ[2]), 0,
+        static_cast<int16_t>(c.yQ[0]), static_cast<int16_t>(c.yQ[1]), static_cast<int16_t>(c.yQ[2]), 0,
+        static_cast<int16_t>(c.yQ[0]), static_cast<int16_t>(c.yQ[1]), static_cast<int16_t>(c.yQ[2]), 0);
+    const __m256i round = _mm256_set1_epi32((static_cast<int32_t>(c.yOffset) << kShift) + (1 << (kShift - 1)));
+    uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i a = LumaSumsAvx2(source + static_cast<size_t>(x) * 4, coefficients, round);
+        __m256i b = LumaSumsAvx2(source + static_cast<size_t>(x) * 4 + 32, coefficients, round);
+        // packs interleaves the lanes (0-3, 8-11, 4-7, 12-15); the permute restores the order
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), bytes);
+    }
+    LumaRowScalar(source, y, width, x, c);
+}
+
+// 8 pixels of two rows -> 4 chroma samples: [u0 u1 v0 v1 | u2 u3 v2 v3], shifted and offset
+PIXEL_KERNELS_AVX2_TARGET inline __m256i ChromaSamplesAvx2(const uint8_t* top, const uint8_t* bottom,
+                                                           __m256i uCoefficients, __m256i vCoefficients, __m256i round) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(top));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom));
+    // Vertical sums: lo holds pixels 0,1 | 4,5 and hi 2,3 | 6,7 as 16-bit B,G,R,A
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(t, zero), _mm256_unpacklo_epi8(b, zero));
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(t, zero), _mm256_unpackhi_epi8(b, zero));
+    // Horizontal pairs: add the neighbouring pixel (the other 64-bit half)
+    lo = _mm256_add_epi16(lo, _mm256_shuffle_epi32(lo, 0x4E));
+    hi = _mm256_add_epi16(hi, _mm256_shuffle_epi32(hi, 0x4E));
+    __m256i sums = _mm256_unpacklo_epi64(lo, hi);   // Blocks 0,1 | 2,3
+    __m256i u = _mm256_madd_epi16(sums, uCoefficients);
+    __m256i v = _mm256_madd_epi16(sums, vCoefficients);
+    return _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(u, v), round), kShift + 2);
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline __m256i ChromaCoefficientsAvx2(const int32_t* q) {
+    const int16_t b = static_cast<int16_t>(q[0]), g = static_cast<int16_t>(q[1]), r = static_cast<int16_t>(q[2]);
+    return _mm256_setr_epi16(b, g, r, 0, b, g, r, 0, b, g, r, 0, b, g, r, 0);
+}
+
+PIXEL_KERNELS_AVX2_TARGET inline void ChromaRowAvx2(const uint8_t* top, const uint8_t* bottom, uint8_t* u, uint8_t* v, bool interleaved,
+                                                    uint32_t width, const YuvCoefficients& c) {
+    const __m256i uCoefficients = ChromaCoefficientsAvx2(c.uQ);
+    const __m256i vCoefficients = ChromaCoefficientsAvx2(c.vQ);
+    const __m256i round = _mm256_set1_epi32((128 << (kShift + 2)) + (1 << (kShift + 1)));
+    // After packing: u0 u1 v0 v1 u4 u5 v4 v5 u2 u3 v2 v3 u6 u7 v6 v7
+    const __m128i order = interleaved
+        ? _mm_setr_epi8(0, 2, 1, 3, 8, 10, 9, 11, 4, 6, 5, 7, 12, 14, 13, 15)
+        : _mm_setr_epi8(0, 1, 8, 9, 4, 5, 12, 13, 2, 3, 10, 11, 6, 7, 14, 15);
+    uint32_t cx = 0;
+    // Whole blocks only; an odd last column goes to the scalar tail
+    for (; (cx + 8) * 2 <= width; cx += 8) {
+        const size_t offset = static_cast<size_t>(cx) * 8;
+        __m256i a = ChromaSamplesAvx2(top + offset, bottom + offset, uCoefficients, vCoefficients, round);
+        __m256i b = ChromaSamplesAvx2(top + offset + 32, bottom + offset + 32, uCoefficients, vCoefficients, round);
+        __m256i words = _mm256_packs_epi32(a, b);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        bytes = _mm_shuffle_epi8(bytes, order);
+        if (interleaved) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(u + static_cast<size_t>(cx) * 2), bytes);
+        }
+        else {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(u + cx), bytes);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(v + cx), _mm_unpackhi_epi64(bytes, bytes));
+        }
+    }
+    ChromaRowScalar(top, bottom, u, v, interleaved, width, cx, c);
+}
+#endif
+
+// Rows [firstRow, endRow) of the frame; firstRow is even, so every band owns whole chroma rows
+inline void ConvertBand(const ImageView& source, const YuvPlanes& dest, const YuvOptions& options, const YuvCoefficients& c,
+                        PixelKernelLevel level, uint32_t firstRow, uint32_t endRow) {
+    const bool interleaved = options.layout == YuvLayout::Nv12;
+    for (uint32_t y = firstRow; y < endRow; y += 2) {
+        const uint8_t* top = source.Row(y);
+        const uint8_t* bottom = y + 1 < source.height ? source.Row(y + 1) : top;
+        uint8_t* u = dest.u + static_cast<size_t>(y / 2) * dest.uPitch;
+        uint8_t* v = interleaved ? nullptr : dest.v + static_cast<size_t>(y / 2) * dest.vPitch;
+#ifdef PIXEL_KERNELS_X86
+        if (level == PixelKernelLevel::Avx2) {
+            LumaRowAvx2(top, dest.y + static_cast<size_t>(y) * dest.yPitch, source.width, c);
+            if (bottom != top) LumaRowAvx2(bottom, dest.y + static_cast<size_t>(y + 1) * dest.yPitch, source.width, c);
+            ChromaRowAvx2(top, bottom, u, v, interleaved, source.width, c);
+            continue;
+        }
+#endif
+        LumaRowScalar(top, dest.y + static_cast<size_t>(y) * dest.yPitch, source.width, 0, c);
+        if (bottom != top) LumaRowScalar(bottom, dest.y + static_cast<size_t>(y + 1) * dest.yPitch, source.width, 0, c);
+        ChromaRowScalar(top, bottom, u, v, interleaved, source.width, 0, c);
+    }
+}
+
+}  // namespace YuvConvertDetail
+
+// Converts 'source' into 'dest' (planes sized for source.width x source.height). With a pool,
+// bands of 'bandRows' rows (rounded up to even) are converted in parallel. An unsupported
+// level falls back to the best one available; SSE2 has no kernel of its own and runs scalar.
+inline void ConvertToYuv(const ImageView& source, const YuvPlanes& dest, const YuvOptions& options, ThreadPool* pool = nullptr,
+                         PixelKernelLevel level = BestPixelKernelLevel(), uint32_t bandRows = 64) {
+    if (source.Empty()) return;
+    if (!PixelKernelLevelSupported(level)) level = BestPixelKernelLevel();
+    const YuvConvertDetail::YuvCoefficients c = YuvConvertDetail::MakeCoefficients(options.matrix, options.fullRange);
+    bandRows = std::max<uint32_t>((bandRows + 1) & ~1u, 2);
+    const uint32_t bands = (source.height + bandRows - 1) / bandRows;
+    auto band = [&](size_t i) {
+        uint32_t first = static_cast<uint32_t>(i) * bandRows;
+        YuvConvertDetail::ConvertBand(source, dest, options, c, level, first, std::min(first + bandRows, source.height));
+    };
+    if (pool) pool->ParallelFor(bands, band);
+    else for (uint32_t i = 0; i < bands; ++i) band(i);
+}
+
+// Owns a tightly packed frame and converts into it
+class YuvFrame {
+public:
+    void Convert(const ImageView& source, const YuvOptions& options, ThreadPool* pool = nullptr) {
+        m_width = source.width;
+        m_height = source.height;
+        m_layout = options.layout;
+        m_data.resize(YuvFrameBytes(m_width, m_height));
+        ConvertToYuv(source, Planes(), options, pool);
+    }
+
+    YuvPlanes Planes() { return PackedYuvPlanes(m_data.data(), m_width, m_height, m_layout); }
+    const std::vector<uint8_t>& Data() const { return m_data; }
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    YuvLayout Layout() const { return m_layout; }
+
+private:
+    std::vector<uint8_t> m_data;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    YuvLayout m_layout = YuvLayout::Nv12;
+};